@@ -0,0 +1,458 @@
+#include "preprocessor.h"
+
+#include <boost/asio/thread_pool.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/log/core.hpp>
+#include <boost/spirit/include/support_multi_pass.hpp>
+#include <boost/wave.hpp>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lexer.h"
+#include "lexer_tables.h"
+#include "parallel_lexer.h"
+#include "parallel_parser.h"
+#include "parser.h"
+#include "symbol_table.h"
+#include "token_arena.h"
+#include "visitor.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+using token_type = p4l::p4lex_token<>;
+using position_type = token_type::position_type;
+
+/// \brief the calls of the global operator new, counted by the replacement below
+std::atomic<std::size_t> allocations{0};
+
+/// \brief the lexer iterator used before p4lex_iterator, kept to compare against
+namespace legacy {
+
+struct functor_shim {
+	using result_type = token_type;
+	using unique = functor_shim;
+	using shared = boost::wave::cpplexer::lex_input_interface<token_type>*;
+
+	static result_type const eof;
+
+	template <typename MultiPass>
+	static result_type& get_next(MultiPass& mp, result_type& result) {
+		return mp.shared()->ftor->get(result);
+	}
+
+	template <typename MultiPass>
+	static void destroy(MultiPass& mp) {
+		delete mp.shared()->ftor;
+	}
+};
+
+functor_shim::result_type const functor_shim::eof = functor_shim::result_type();
+
+using functor_data_type = std::pair<functor_shim::unique, functor_shim::shared>;
+using policy_type = boost::spirit::iterator_policies::default_policy<boost::spirit::iterator_policies::ref_counted,
+																	 boost::spirit::iterator_policies::no_check,
+																	 boost::spirit::iterator_policies::split_functor_input,
+																	 boost::spirit::iterator_policies::split_std_deque>;
+using iterator = boost::spirit::multi_pass<functor_data_type, policy_type>;
+
+iterator make_iterator(std::string& source)
+{
+	return iterator(functor_data_type(functor_shim(),
+									  p4l::p4lex_input_interface<token_type>::new_lexer(source.begin(), source.end(), position_type("bench.p4"),
+																						boost::wave::support_cpp0x)));
+}
+
+} // namespace legacy
+
+p4l::p4lex_iterator<token_type> make_cursor(std::string& source)
+{
+	return p4l::p4lex_iterator<token_type>(source.begin(), source.end(), position_type("bench.p4"), boost::wave::support_cpp0x);
+}
+
+std::string generate_source(std::size_t headers)
+{
+	std::ostringstream source;
+	source << "#define WIDTH 16\n";
+	for (std::size_t it = 0; it != headers; ++it) {
+		source << "header h" << it << "_t {\n"
+			   << "\tbit<WIDTH> f" << it << ";\n"
+			   << "\tbit<8> g; // " << it << "\n"
+			   << "}\n";
+	}
+	source << "control c(inout h0_t h) {\n"
+		   << "\tapply {\n";
+	for (std::size_t it = 0; it != headers; ++it) {
+		source << "\t\th.f0 = h.f0 + " << it << ";\n";
+	}
+	source << "\t}\n}\n";
+	return source.str();
+}
+
+/// \brief read all tokens, as the preprocessor does for the lines with no directive
+template <typename IteratorT>
+std::size_t read_tokens(IteratorT first)
+{
+	std::size_t count = 0;
+	for (IteratorT last; first != last; ++first) {
+		++count;
+	}
+	return count;
+}
+
+/// \brief look ahead on a copy at every new line, as the preprocessor does to find directives
+template <typename IteratorT>
+std::size_t look_ahead(IteratorT first)
+{
+	std::size_t count = 0;
+	for (IteratorT last; first != last; ++first) {
+		++count;
+		if (boost::wave::token_id(*first) == boost::wave::T_NEWLINE) {
+			auto it = first;
+			for (auto ahead = 0; ahead != 8 && it != last; ++ahead, ++it) {
+			}
+		}
+	}
+	return count;
+}
+
+/// \brief preprocess the source into a token arena the way P4_file::compile does
+std::size_t preprocess(std::string const& source, std::string const& path, std::vector<std::string> const& include_paths)
+{
+	std::vector<std::string> command{"p4lsd"};
+	for (auto const& it : include_paths) {
+		command.push_back("-I" + it);
+	}
+	std::vector<char*> argv;
+	for (auto& it : command) {
+		argv.push_back(&it[0]);
+	}
+	auto settings = Context_factory::get_instance().get_settings(argv);
+	auto text = std::make_shared<std::string>(source);
+	// as P4_file does, the tokens refer to the included files the preprocessor read
+	p4l::token_arena tokens([](std::string const& name) { return File_cache::get_instance().load(name); });
+	tokens.add_file(path, text);
+	auto ctx = Context_factory::get_instance().create(text->begin(), text->end(), path, *settings);
+	auto reached = true;
+	for (auto token = ctx->begin(); token != ctx->end();) {
+		try {
+			if (reached) {
+				tokens.append(*token);
+			}
+			reached = false;
+			++token;
+			reached = true;
+		} catch (boost::wave::cpp_exception const& e) {
+			if (!boost::wave::is_recoverable(e)) {
+				break;
+			}
+		}
+	}
+	return tokens.size();
+}
+
+/// \brief read all tokens with the lexer of the parser
+std::size_t read_lexer(p4l::Lexer& lexer)
+{
+	std::size_t count = 0;
+	for (auto token = lexer.next(); token != boost::wave::T_END; token = lexer.next()) {
+		++count;
+	}
+	return count;
+}
+
+/// \brief a whole-tree pass that looks at the declarations and the expressions
+class kind_counter : public p4l::visitor<kind_counter> {
+ public:
+	bool preorder(p4l::kind_tag<p4l::node_kind::block>, p4l::ast const&, std::uint32_t) {
+		++_blocks;
+		return true;
+	}
+	bool preorder(p4l::kind_tag<p4l::node_kind::name>, p4l::ast const&, std::uint32_t) {
+		++_names;
+		return true;
+	}
+	bool preorder_node(p4l::ast const&, std::uint32_t) {
+		++_others;
+		return true;
+	}
+
+	std::size_t _blocks = 0;
+	std::size_t _names = 0;
+	std::size_t _others = 0;
+};
+
+/// \brief longest match scan with 256 transitions per state, the layout before byte classes
+std::size_t scan_wide(std::vector<std::uint16_t> const& transitions, p4l::lexer_tables const& tables, std::string const& source)
+{
+	std::size_t count = 0;
+	for (auto first = source.begin(); first != source.end(); ++count) {
+		std::size_t s = 0;
+		auto accepted = first + 1;
+		for (auto p = first; p != source.end(); ++p) {
+			auto next = transitions[s * 256 + static_cast<unsigned char>(*p)];
+			if (next == 0xffff) {
+				break;
+			}
+			s = next;
+			if (tables.acceptance[s] != 0xffff) {
+				accepted = p + 1;
+			}
+		}
+		first = accepted;
+	}
+	return count;
+}
+
+/// \brief longest match scan over the byte classes as slex does it
+std::size_t scan_classes(p4l::lexer_tables const& tables, std::string const& source)
+{
+	std::size_t count = 0;
+	for (auto first = source.begin(); first != source.end(); ++count) {
+		auto row = tables.transitions;
+		auto accepted = first + 1;
+		for (auto p = first; p != source.end(); ++p) {
+			auto s = row[tables.classes[static_cast<unsigned char>(*p)]];
+			if (s == 0xffff) {
+				break;
+			}
+			row = tables.transitions + s * tables.class_count;
+			if (tables.acceptance[s] != 0xffff) {
+				accepted = p + 1;
+			}
+		}
+		first = accepted;
+	}
+	return count;
+}
+
+std::uint64_t read_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct input {
+	std::string name;
+	std::string path; // the quoted includes are relative to it
+	std::string source;
+};
+
+struct measurement {
+	std::string benchmark;
+	std::string input;
+	std::size_t bytes;
+	std::size_t tokens;
+	std::size_t allocations;
+	double seconds;
+	std::uint64_t cycles;
+};
+
+/// \brief the best of the repetitions of the body, which returns the number of tokens it read
+measurement run(std::string const& name, input const& in, std::size_t repetitions, std::function<std::size_t()> const& body)
+{
+	measurement result{name, in.name, in.source.size(), 0, std::numeric_limits<std::size_t>::max(),
+					   std::numeric_limits<double>::max(), std::numeric_limits<std::uint64_t>::max()};
+	for (std::size_t it = 0; it != repetitions; ++it) {
+		auto allocated = allocations.load(std::memory_order_relaxed);
+		auto start = std::chrono::steady_clock::now();
+		auto cycles = read_cycles();
+		result.tokens = body();
+		cycles = read_cycles() - cycles;
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		// the first repetition also fills the caches, e.g. of the preprocessor settings
+		result.allocations = std::min(result.allocations, allocations.load(std::memory_order_relaxed) - allocated);
+		result.seconds = std::min(result.seconds, elapsed.count());
+		result.cycles = std::min(result.cycles, cycles);
+	}
+	return result;
+}
+
+void write_json(std::ostream& os, std::size_t repetitions, std::vector<measurement> const& results)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	writer.StartObject();
+	writer.Key("repetitions");
+	writer.Uint64(repetitions);
+	writer.Key("results");
+	writer.StartArray();
+	for (auto const& it : results) {
+		auto tokens = std::max<std::size_t>(it.tokens, 1);
+		writer.StartObject();
+		writer.Key("benchmark");
+		writer.String(it.benchmark.c_str());
+		writer.Key("input");
+		writer.String(it.input.c_str());
+		writer.Key("bytes");
+		writer.Uint64(it.bytes);
+		writer.Key("tokens");
+		writer.Uint64(it.tokens);
+		writer.Key("seconds");
+		writer.Double(it.seconds);
+		writer.Key("tokens_per_second");
+		writer.Double(it.tokens / it.seconds);
+		writer.Key("mib_per_second");
+		writer.Double(it.bytes / it.seconds / (1 << 20));
+		writer.Key("bytes_per_cycle");
+		writer.Double(double(it.bytes) / std::max<std::uint64_t>(it.cycles, 1));
+		writer.Key("allocations");
+		writer.Uint64(it.allocations);
+		writer.Key("allocations_per_token");
+		writer.Double(double(it.allocations) / tokens);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+	os << buffer.GetString() << std::endl;
+}
+
+/// \brief the P4 programs in the directory, the included files are in its subdirectory include
+std::vector<input> read_corpus(boost::filesystem::path const& directory)
+{
+	std::vector<input> corpus;
+	if (!boost::filesystem::is_directory(directory)) {
+		return corpus;
+	}
+	for (auto const& it : boost::filesystem::directory_iterator(directory)) {
+		if (it.path().extension() == ".p4") {
+			boost::filesystem::ifstream file(it.path());
+			std::ostringstream text;
+			text << file.rdbuf();
+			corpus.push_back({it.path().filename().string(), it.path().string(), text.str()});
+		}
+	}
+	std::sort(corpus.begin(), corpus.end(), [](input const& a, input const& b) { return a.name < b.name; });
+	return corpus;
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto pointer = std::malloc(size ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+/**
+ * p4ls_bench [headers [repetitions [corpus]]]
+ *
+ *     Measures the lexers and the preprocessor on the P4 programs in the
+ *     corpus directory and on a generated program with as many headers,
+ *     and writes the best of the repetitions of each as JSON to stdout.
+ *     The directories p4_generator writes are corpora too.
+ */
+int main(int argc, char* argv[])
+{
+	// the log goes to stdout, which only has the results
+	boost::log::core::get()->set_logging_enabled(false);
+	std::size_t headers = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+	std::size_t repetitions = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+	boost::filesystem::path corpus_path = argc > 3 ? argv[3] : P4LS_BENCH_CORPUS;
+	// the default corpus has the architecture files generated corpora include
+	std::vector<std::string> include_paths{(corpus_path / "include").string(),
+										   (boost::filesystem::path(P4LS_BENCH_CORPUS) / "include").string()};
+	auto inputs = read_corpus(corpus_path);
+	inputs.push_back({"synthetic, " + std::to_string(headers) + " headers", "bench.p4", generate_source(headers)});
+
+	auto& tables = p4l::precompiled_lexer_tables;
+	std::vector<std::uint16_t> wide(tables.state_count * 256);
+	for (std::size_t s = 0; s != tables.state_count; ++s) {
+		for (std::size_t c = 0; c != 256; ++c) {
+			wide[s * 256 + c] = tables.transitions[s * tables.class_count + tables.classes[c]];
+		}
+	}
+	auto threads = std::max(1U, std::thread::hardware_concurrency());
+	boost::asio::thread_pool pool(threads);
+
+	std::vector<measurement> results;
+	for (auto& in : inputs) {
+		auto& source = in.source;
+		results.push_back(run("p4l::Lexer, istream", in, repetitions, [&source] {
+			std::istringstream is(source);
+			p4l::Lexer lexer(is);
+			return read_lexer(lexer);
+		}));
+		results.push_back(run("p4l::Lexer, string_view", in, repetitions, [&source] {
+			p4l::Lexer lexer{std::string_view(source)};
+			return read_lexer(lexer);
+		}));
+		results.push_back(run("p4l::Lexer, token vector", in, repetitions, [&source] { return p4l::lex_sequential(source).size(); }));
+		results.push_back(run("p4l::Lexer, " + std::to_string(threads) + " threads", in, repetitions, [&source, &pool, threads] {
+			return p4l::lex_parallel(source, pool, threads).size();
+		}));
+		auto lexed = p4l::lex_sequential(source);
+		results.push_back(run("p4l::Parser, token vector", in, repetitions, [&lexed] {
+			p4l::Parser parser(lexed);
+			return parser.run().size() == 0 ? 0 : lexed.size();
+		}));
+		results.push_back(run("p4l::Parser, signatures", in, repetitions, [&lexed] {
+			p4l::Parser parser(lexed, 0, lexed.size(), p4l::parse_mode::signatures);
+			return parser.run().size() == 0 ? 0 : lexed.size();
+		}));
+		results.push_back(run("p4l::Parser, " + std::to_string(threads) + " threads", in, repetitions, [&lexed, &pool, threads] {
+			return p4l::parse_parallel(lexed, pool, 4 * threads).tree.size() == 0 ? 0 : lexed.size();
+		}));
+		p4l::Parser parser(lexed);
+		auto tree = parser.run();
+		results.push_back(run("p4l::visitor, all nodes", in, repetitions, [&lexed, &tree] {
+			kind_counter counter;
+			counter.visit(tree);
+			return counter._blocks + counter._names + counter._others == tree.size() ? lexed.size() : 0;
+		}));
+		p4l::token_arena arena;
+		auto file = arena.add_file(in.path, std::make_shared<std::string const>(source));
+		for (auto const& it : lexed) {
+			arena.push_back(static_cast<boost::wave::token_id>(it.id), file, it.offset, it.length);
+		}
+		p4l::Parser arena_parser(arena);
+		auto arena_tree = arena_parser.run();
+		results.push_back(run("p4l::symbol_table", in, repetitions, [&lexed, &arena, &arena_tree] {
+			p4l::symbol_table table(arena_tree, arena);
+			return table.get_symbols().empty() ? 0 : lexed.size();
+		}));
+		results.push_back(run("slex, multi_pass", in, repetitions, [&source] { return read_tokens(legacy::make_iterator(source)); }));
+		results.push_back(run("slex, p4lex_iterator", in, repetitions, [&source] { return read_tokens(make_cursor(source)); }));
+		results.push_back(run("slex, multi_pass look ahead", in, repetitions, [&source] { return look_ahead(legacy::make_iterator(source)); }));
+		results.push_back(run("slex, p4lex_iterator look ahead", in, repetitions, [&source] { return look_ahead(make_cursor(source)); }));
+		results.push_back(run("slex, dfa with 256 entries per state", in, repetitions, [&] { return scan_wide(wide, tables, source); }));
+		results.push_back(run("slex, dfa with byte classes", in, repetitions, [&] { return scan_classes(tables, source); }));
+		results.push_back(run("wave::context", in, repetitions, [&in, &include_paths] { return preprocess(in.source, in.path, include_paths); }));
+	}
+	write_json(std::cout, repetitions, results);
+	return 0;
+}
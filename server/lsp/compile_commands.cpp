@@ -0,0 +1,515 @@
+#include "compile_commands.h"
+#include "file_cache.h"
+
+#include <rapidjson/error/en.h>
+#include <rapidjson/reader.h>
+
+#include <boost/log/attributes/constant.hpp>
+#include <boost/log/common.hpp>
+#include <boost/log/sinks/syslog_backend.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+namespace {
+boost::log::sources::severity_logger<int> _logger(boost::log::keywords::severity = boost::log::sinks::syslog::debug);
+
+const char INDEX_MAGIC[8] = {'P', '4', 'L', 'S', 'C', 'C', '0', '2'};
+
+/// \brief FNV-1a hash of the content, a rewrite within the resolution of the file times changes it
+uint64_t hash_content(const std::string& content)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (auto it : content)
+	{
+		hash = (hash ^ static_cast<unsigned char>(it)) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template <typename T>
+void write_value(std::ostream& os, const T& value)
+{
+	os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool read_value(std::istream& is, T& value)
+{
+	return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+void write_string(std::ostream& os, const std::string& value)
+{
+	write_value(os, static_cast<uint32_t>(value.size()));
+	os.write(value.data(), value.size());
+}
+
+bool read_string(std::istream& is, std::string& value)
+{
+	uint32_t size;
+	if (!read_value(is, size))
+	{
+		return false;
+	}
+	value.resize(size);
+	return static_cast<bool>(is.read(&value[0], size));
+}
+
+std::vector<std::string> split_command(const std::string& command)
+{
+	std::vector<std::string> result;
+	auto it = command.begin();
+	while (it != command.end())
+	{
+		while (it != command.end() && std::isspace(static_cast<unsigned char>(*it)))
+		{
+			++it;
+		}
+		auto start = it;
+		while (it != command.end() && !std::isspace(static_cast<unsigned char>(*it)))
+		{
+			++it;
+		}
+		if (start != it)
+		{
+			result.emplace_back(start, it);
+		}
+	}
+	return result;
+}
+
+} // namespace
+
+/**
+ * \brief fills the index, sharing the arguments and the argument prefixes
+ */
+class Compile_commands::Builder {
+public:
+	explicit Builder(Compile_commands& index)
+		: _index(index)
+	{}
+
+	void add(const std::string& directory, const std::string& file, const std::vector<std::string>& arguments)
+	{
+		auto node = NO_NODE;
+		for (auto& it : arguments)
+		{
+			auto argument = intern(it);
+			auto key = (static_cast<uint64_t>(node) << 32) | argument;
+			auto child = _children.find(key);
+			if (child == _children.end())
+			{
+				child = _children.emplace(key, static_cast<uint32_t>(_index._nodes.size())).first;
+				_index._nodes.push_back(Node{node, argument});
+			}
+			node = child->second;
+		}
+		boost::filesystem::path path(file);
+		if (path.is_relative() && !directory.empty())
+		{
+			path = boost::filesystem::path(directory) / path;
+		}
+		_index._files[path.lexically_normal().string()] = node;
+	}
+
+private:
+	uint32_t intern(const std::string& argument)
+	{
+		auto found = _arguments.find(argument);
+		if (found != _arguments.end())
+		{
+			return found->second;
+		}
+		auto index = static_cast<uint32_t>(_index._offsets.size() - 1);
+		_index._pool += argument;
+		_index._offsets.push_back(static_cast<uint32_t>(_index._pool.size()));
+		_arguments.emplace(argument, index);
+		return index;
+	}
+
+	Compile_commands& _index;
+	std::unordered_map<std::string, uint32_t> _arguments;
+	std::unordered_map<uint64_t, uint32_t> _children;
+};
+
+/**
+ * \brief SAX handler collecting the entries of the top level array
+ * \detail Only the "directory", "file", "command" and "arguments"
+ * members of the entries are kept, everything else is skipped.
+ */
+class Compile_commands::Handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Handler> {
+public:
+	explicit Handler(Builder& builder)
+		: _builder(builder)
+		, _depth(0)
+		, _is_array(false)
+		, _in_arguments(false)
+		, _has_arguments(false)
+	{}
+
+	bool Default()
+	{
+		return _depth > 0;
+	}
+
+	bool StartArray()
+	{
+		if (_depth == 0)
+		{
+			_is_array = true;
+		}
+		else if (_depth == 2 && _key == "arguments")
+		{
+			_in_arguments = true;
+			_has_arguments = true;
+		}
+		++_depth;
+		return true;
+	}
+
+	bool EndArray(rapidjson::SizeType)
+	{
+		--_depth;
+		_in_arguments = false;
+		return true;
+	}
+
+	bool StartObject()
+	{
+		if (_depth == 0)
+		{
+			return false;
+		}
+		if (++_depth == 2)
+		{
+			_directory.clear();
+			_file.clear();
+			_command.clear();
+			_arguments.clear();
+			_has_arguments = false;
+		}
+		return true;
+	}
+
+	bool EndObject(rapidjson::SizeType)
+	{
+		if (_depth-- == 2)
+		{
+			if (!_has_arguments)
+			{
+				_arguments = split_command(_command);
+			}
+			if (_file.empty() || _arguments.empty())
+			{
+				BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::warning) << "skip an entry without a file or a command";
+				return true;
+			}
+			_builder.add(_directory, _file, _arguments);
+		}
+		return true;
+	}
+
+	bool Key(const char* str, rapidjson::SizeType length, bool)
+	{
+		if (_depth == 2)
+		{
+			_key.assign(str, length);
+		}
+		return true;
+	}
+
+	bool String(const char* str, rapidjson::SizeType length, bool)
+	{
+		if (_depth == 2)
+		{
+			if (_key == "file")
+			{
+				_file.assign(str, length);
+			}
+			else if (_key == "directory")
+			{
+				_directory.assign(str, length);
+			}
+			else if (_key == "command")
+			{
+				_command.assign(str, length);
+			}
+		}
+		else if (_depth == 3 && _in_arguments)
+		{
+			_arguments.emplace_back(str, length);
+		}
+		return _depth > 0;
+	}
+
+	bool is_array() const
+	{
+		return _is_array;
+	}
+
+private:
+	Builder& _builder;
+	int _depth;
+	bool _is_array;
+	bool _in_arguments;
+	bool _has_arguments;
+	std::string _key;
+	std::string _directory;
+	std::string _file;
+	std::string _command;
+	std::vector<std::string> _arguments;
+};
+
+Compile_commands::Compile_commands(const boost::filesystem::path& json_path)
+	: _json_path(json_path)
+	, _valid(false)
+{
+	_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("COMPILE_COMMANDS"));
+}
+
+boost::filesystem::path Compile_commands::get_index_path(const boost::filesystem::path& json_path)
+{
+	return json_path.parent_path() / (json_path.stem().string() + ".p4ls-index");
+}
+
+void Compile_commands::prefetch()
+{
+	std::call_once(_started, [this]{
+		_loaded = std::async(std::launch::async, [this]{load();}).share();
+	});
+}
+
+bool Compile_commands::is_valid()
+{
+	prefetch();
+	_loaded.wait();
+	return _valid;
+}
+
+boost::optional<std::vector<std::string>> Compile_commands::find_arguments(const std::string& file)
+{
+	if (!is_valid())
+	{
+		return boost::none;
+	}
+	auto found = _files.find(boost::filesystem::path(file).lexically_normal().string());
+	if (found == _files.end())
+	{
+		return boost::none;
+	}
+	std::vector<std::string> result;
+	for (auto node = found->second; node != NO_NODE; node = _nodes[node]._parent)
+	{
+		result.push_back(get_argument(_nodes[node]._argument));
+	}
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+boost::optional<std::string> Compile_commands::find_command(const std::string& file)
+{
+	auto arguments = find_arguments(file);
+	if (!arguments)
+	{
+		return boost::none;
+	}
+	std::string command("p4lsd");
+	auto& std_include = get_std_include(arguments->front());
+	if (!std_include.empty())
+	{
+		command += " -I ";
+		command += std_include;
+	}
+	for (auto it = std::next(arguments->begin()); it != arguments->end(); ++it)
+	{
+		command += ' ';
+		command += *it;
+	}
+	return command;
+}
+
+void Compile_commands::load()
+{
+	std::ifstream ifs(_json_path.string(), std::ios::binary);
+	if (!ifs)
+	{
+		BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error) << "cannot read " << _json_path;
+		return;
+	}
+	std::string content{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+	// hashing the content is much cheaper than parsing it
+	auto json_hash = hash_content(content);
+	if (read_index(json_hash, content.size()))
+	{
+		BOOST_LOG(_logger) << "read " << _files.size() << " commands from the index of " << _json_path;
+		_valid = true;
+		return;
+	}
+	_valid = parse_json(content);
+	if (_valid)
+	{
+		BOOST_LOG(_logger) << "parsed " << _files.size() << " commands, " << _nodes.size()
+						   << " argument nodes, " << _offsets.size() - 1 << " distinct arguments from " << _json_path;
+		write_index(json_hash, content.size());
+	}
+}
+
+bool Compile_commands::parse_json(const std::string& content)
+{
+	_pool.clear();
+	_offsets.assign(1, 0);
+	_nodes.clear();
+	_files.clear();
+	Builder builder(*this);
+	Handler handler(builder);
+	rapidjson::Reader reader;
+	rapidjson::StringStream stream(content.c_str());
+	auto result = reader.Parse(stream, handler);
+	if (result.IsError() || !handler.is_array())
+	{
+		BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error)
+			<< "JSON parse error in " << _json_path << ": " << rapidjson::GetParseError_En(result.Code())
+			<< " (" << result.Offset() << ")";
+		return false;
+	}
+	return true;
+}
+
+bool Compile_commands::read_index(uint64_t json_hash, uint64_t json_size)
+{
+	std::ifstream is(get_index_path(_json_path).string(), std::ios::binary);
+	if (!is)
+	{
+		return false;
+	}
+	char magic[sizeof(INDEX_MAGIC)];
+	uint64_t index_hash;
+	uint64_t index_size;
+	uint32_t count;
+	if (!is.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), INDEX_MAGIC)
+		|| !read_value(is, index_hash) || !read_value(is, index_size)
+		|| index_hash != json_hash || index_size != json_size)
+	{
+		BOOST_LOG(_logger) << "index of " << _json_path << " is out of date";
+		return false;
+	}
+	if (!read_string(is, _pool) || !read_value(is, count))
+	{
+		return false;
+	}
+	_offsets.resize(count);
+	for (auto& it : _offsets)
+	{
+		if (!read_value(is, it) || it > _pool.size())
+		{
+			return false;
+		}
+	}
+	if (_offsets.empty() || !read_value(is, count))
+	{
+		return false;
+	}
+	_nodes.resize(count);
+	for (uint32_t it = 0; it != count; ++it)
+	{
+		auto& node = _nodes[it];
+		if (!read_value(is, node._parent) || !read_value(is, node._argument)
+			|| (node._parent != NO_NODE && node._parent >= it) || node._argument + 1 >= _offsets.size())
+		{
+			return false;
+		}
+	}
+	if (!read_value(is, count))
+	{
+		return false;
+	}
+	_files.clear();
+	_files.reserve(count);
+	for (std::string file; count != 0; --count)
+	{
+		uint32_t node;
+		if (!read_string(is, file) || !read_value(is, node) || node >= _nodes.size())
+		{
+			_files.clear();
+			return false;
+		}
+		_files.emplace(file, node);
+	}
+	return true;
+}
+
+void Compile_commands::write_index(uint64_t json_hash, uint64_t json_size) const
+{
+	auto index_path = get_index_path(_json_path);
+	auto temp_path = index_path.parent_path() / boost::filesystem::unique_path(index_path.filename().string() + ".%%%%-%%%%");
+	{
+		std::ofstream os(temp_path.string(), std::ios::binary);
+		if (!os)
+		{
+			BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::warning) << "cannot write the index " << index_path;
+			return;
+		}
+		os.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+		write_value(os, json_hash);
+		write_value(os, json_size);
+		write_string(os, _pool);
+		write_value(os, static_cast<uint32_t>(_offsets.size()));
+		for (auto it : _offsets)
+		{
+			write_value(os, it);
+		}
+		write_value(os, static_cast<uint32_t>(_nodes.size()));
+		for (auto& it : _nodes)
+		{
+			write_value(os, it._parent);
+			write_value(os, it._argument);
+		}
+		write_value(os, static_cast<uint32_t>(_files.size()));
+		for (auto& it : _files)
+		{
+			write_string(os, it.first);
+			write_value(os, it.second);
+		}
+	}
+	boost::system::error_code ec;
+	boost::filesystem::rename(temp_path, index_path, ec);
+	if (ec)
+	{
+		BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::warning) << "cannot write the index " << index_path << ": " << ec.message();
+		boost::filesystem::remove(temp_path, ec);
+	}
+}
+
+std::string Compile_commands::get_argument(uint32_t index) const
+{
+	return _pool.substr(_offsets[index], _offsets[index + 1] - _offsets[index]);
+}
+
+const std::string& Compile_commands::get_std_include(const std::string& compiler)
+{
+	std::lock_guard<std::mutex> lock(_std_include_mutex);
+	auto found = _std_includes.find(compiler);
+	if (found != _std_includes.end())
+	{
+		return found->second;
+	}
+	auto& std_include = _std_includes[compiler];
+	boost::filesystem::path compiler_path(compiler);
+	if (compiler_path.has_parent_path() && compiler_path.parent_path().has_parent_path())
+	{
+		auto& file_cache = File_cache::get_instance();
+		auto prefix = compiler_path.parent_path().parent_path();
+		for (auto& it : {prefix / "share" / "p4c" / "p4include", prefix / "p4include"})
+		{
+			if (file_cache.exists(it))
+			{
+				std_include = it.string();
+				break;
+			}
+		}
+	}
+	return std_include;
+}
@@ -0,0 +1,79 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/**
+ * \brief index of a compile_commands.json file
+ * \detail The JSON file is read with a SAX parser into a compact
+ * index from a file to its argument vector.  Every distinct argument
+ * is stored once, and argument vectors sharing a prefix share the
+ * nodes of the prefix, so that the thousands of entries with the same
+ * compiler options cost little more than their file names.  The file
+ * is parsed on a background thread when the index is used for the
+ * first time, and the parsed index is saved next to the JSON file to
+ * be reused while the hash and size of the content of the JSON file
+ * remain the same.
+ */
+class Compile_commands {
+public:
+	explicit Compile_commands(const boost::filesystem::path& json_path);
+	Compile_commands(const Compile_commands&) = delete;
+	Compile_commands& operator=(const Compile_commands&) = delete;
+
+	/// \brief start loading the index in the background, if not started yet
+	void prefetch();
+	/// \brief arguments of the command compiling file, the compiler first
+	boost::optional<std::vector<std::string>> find_arguments(const std::string& file);
+	/// \brief p4lsd command line for file with the compiler's standard include directory
+	boost::optional<std::string> find_command(const std::string& file);
+	bool is_valid();
+
+	const boost::filesystem::path& get_json_path() const { return _json_path; }
+	static boost::filesystem::path get_index_path(const boost::filesystem::path& json_path);
+
+private:
+	static const uint32_t NO_NODE = UINT32_MAX;
+
+	/// \brief one argument of a command, the last argument of its parent's prefix
+	struct Node {
+		uint32_t _parent;
+		uint32_t _argument;
+	};
+
+	class Builder;
+	class Handler;
+
+	void load();
+	bool parse_json(const std::string& content);
+	/// \brief read the index if it was written for the JSON content with the hash and size
+	bool read_index(uint64_t json_hash, uint64_t json_size);
+	void write_index(uint64_t json_hash, uint64_t json_size) const;
+	std::string get_argument(uint32_t index) const;
+	const std::string& get_std_include(const std::string& compiler);
+
+	boost::filesystem::path _json_path;
+	std::once_flag _started;
+	std::shared_future<void> _loaded;
+	bool _valid;
+
+	std::string _pool;              /// characters of all distinct arguments
+	std::vector<uint32_t> _offsets; /// start of each argument in the pool, and the end of the last one
+	std::vector<Node> _nodes;
+	std::unordered_map<std::string, uint32_t> _files; /// last node of the arguments of every file
+
+	std::mutex _std_include_mutex;
+	std::unordered_map<std::string, std::string> _std_includes;
+};
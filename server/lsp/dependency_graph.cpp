@@ -0,0 +1,69 @@
+#include "dependency_graph.h"
+
+#include <boost/filesystem.hpp>
+
+
+void Dependency_graph::set_dependencies(const std::string& unit, const std::set<std::string>& includes)
+{
+	remove_unit(unit);
+	for (auto& it : includes)
+	{
+		_dependents[it].insert(unit);
+	}
+	_dependencies[unit] = includes;
+}
+
+void Dependency_graph::remove_unit(const std::string& unit)
+{
+	auto found = _dependencies.find(unit);
+	if (found == _dependencies.end())
+	{
+		return;
+	}
+	for (auto& it : found->second)
+	{
+		auto dependents = _dependents.find(it);
+		if (dependents != _dependents.end())
+		{
+			dependents->second.erase(unit);
+			if (dependents->second.empty())
+			{
+				_dependents.erase(dependents);
+			}
+		}
+	}
+	_dependencies.erase(found);
+}
+
+std::set<std::string> Dependency_graph::get_dependents(const std::string& path) const
+{
+	// the preprocessor reports every file it opens, nested includes
+	// are recorded for the unit directly, so one lookup is enough
+	auto found = _dependents.find(path);
+	if (found == _dependents.end())
+	{
+		return {};
+	}
+	return found->second;
+}
+
+std::set<std::string> Dependency_graph::get_dependents_by_name(const std::string& path) const
+{
+	std::set<std::string> result;
+	auto name = boost::filesystem::path(path).filename();
+	for (auto& it : _dependents)
+	{
+		if (boost::filesystem::path(it.first).filename() == name)
+		{
+			result.insert(it.second.begin(), it.second.end());
+		}
+	}
+	return result;
+}
+
+const std::set<std::string>& Dependency_graph::get_dependencies(const std::string& unit) const
+{
+	static const std::set<std::string> none;
+	auto found = _dependencies.find(unit);
+	return found == _dependencies.end() ? none : found->second;
+}
@@ -0,0 +1,37 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <unordered_map>
+
+
+/**
+ * \brief records which files every compiled unit includes
+ * \detail The graph is updated after a unit is preprocessed and is
+ * queried when a file changes on disk to find the units that have
+ * to be compiled again.  Not synchronized, the LSP server accesses
+ * it only from its worker thread.
+ */
+class Dependency_graph {
+public:
+	/// \brief replace the set of files included by unit
+	void set_dependencies(const std::string& unit, const std::set<std::string>& includes);
+	void remove_unit(const std::string& unit);
+
+	/// \brief units that include path directly or transitively
+	std::set<std::string> get_dependents(const std::string& path) const;
+	/// \brief units that include a file with the same name as path
+	/// \detail A file created or removed in any directory of the search
+	/// path may shadow or uncover a file found previously under the
+	/// same name.
+	std::set<std::string> get_dependents_by_name(const std::string& path) const;
+	const std::set<std::string>& get_dependencies(const std::string& unit) const;
+
+private:
+	std::unordered_map<std::string, std::set<std::string>> _dependencies;
+	std::unordered_map<std::string, std::set<std::string>> _dependents;
+};
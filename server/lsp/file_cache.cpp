@@ -0,0 +1,129 @@
+#include "file_cache.h"
+
+#include <boost/log/attributes/constant.hpp>
+#include <boost/log/common.hpp>
+#include <boost/log/sinks/syslog_backend.hpp>
+
+#include <fstream>
+#include <iterator>
+
+namespace {
+boost::log::sources::severity_logger<int> _logger(boost::log::keywords::severity = boost::log::sinks::syslog::debug);
+} // namespace
+
+File_cache& File_cache::get_instance()
+{
+	static File_cache instance;
+	return instance;
+}
+
+File_cache::File_cache(clock_type::duration ttl)
+	: _ttl(ttl)
+{
+	_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("FILE_CACHE"));
+}
+
+bool File_cache::exists(const boost::filesystem::path& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return get_status(path)._exists;
+}
+
+boost::optional<std::time_t> File_cache::last_write_time(const boost::filesystem::path& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto& status = get_status(path);
+	if (!status._exists)
+	{
+		return boost::none;
+	}
+	return status._last_write_time;
+}
+
+std::shared_ptr<const std::string> File_cache::load(const std::string& path)
+{
+	boost::optional<std::time_t> read_time;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto& status = get_status(path);
+		if (status._exists)
+		{
+			read_time = status._last_write_time;
+			auto found = _sources.find(path);
+			if (found != _sources.end() && found->second._last_write_time == status._last_write_time)
+			{
+				return found->second._text;
+			}
+		}
+	}
+	// the file is read without the lock, a concurrent load of the same version reads it too
+	std::ifstream ifs(path, std::ios::binary);
+	if (!ifs)
+	{
+		return nullptr;
+	}
+	auto text = std::make_shared<const std::string>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	if (read_time)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_sources[path] = Source_entry{*read_time, text};
+	}
+	BOOST_LOG(_logger) << "read " << text->size() << " bytes of \"" << path << "\"";
+	return text;
+}
+
+void File_cache::invalidate(const boost::filesystem::path& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	BOOST_LOG(_logger) << "invalidate " << path;
+	_statuses.erase(path.string());
+	_sources.erase(path.string());
+	auto keys = _resolved_keys.find(path.string());
+	if (keys != _resolved_keys.end())
+	{
+		for (auto& key : keys->second)
+		{
+			_includes.erase(key);
+		}
+		_resolved_keys.erase(keys);
+	}
+	// a new file may satisfy a directive that could not be resolved before
+	for (auto it = _includes.begin(); it != _includes.end();)
+	{
+		it = it->second._location ? std::next(it) : _includes.erase(it);
+	}
+}
+
+void File_cache::invalidate_all()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	BOOST_LOG(_logger) << "invalidate all entries";
+	_statuses.clear();
+	_includes.clear();
+	_resolved_keys.clear();
+	_sources.clear();
+}
+
+void File_cache::set_ttl(clock_type::duration ttl)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_ttl = ttl;
+}
+
+const File_cache::Status_entry& File_cache::get_status(const boost::filesystem::path& path)
+{
+	auto now = clock_type::now();
+	auto it = _statuses.find(path.string());
+	if (it != _statuses.end() && now < it->second._expires)
+	{
+		return it->second;
+	}
+	boost::system::error_code ec;
+	auto status = boost::filesystem::status(path, ec);
+	Status_entry entry{boost::filesystem::exists(status), 0, now + _ttl};
+	if (entry._exists)
+	{
+		entry._last_write_time = boost::filesystem::last_write_time(path, ec);
+	}
+	return _statuses[path.string()] = entry;
+}
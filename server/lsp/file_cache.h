@@ -0,0 +1,107 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+
+/**
+ * \brief process-wide cache of file system metadata
+ * \detail Remembers whether a path exists, its last modification
+ * time, where the preprocessor found an included file, and the text
+ * of the files the preprocessor read.  Cached
+ * answers are trusted for the TTL period, after that the file system
+ * is consulted again.  Entries can be dropped explicitly when a file
+ * is known to have changed.
+ */
+class File_cache {
+public:
+	using clock_type = std::chrono::steady_clock;
+
+	struct Include_location {
+		std::string _file_path;   /// path of the included file as found in the search path
+		std::string _dir_path;    /// directory of the included file
+		std::string _native_name; /// unique full name of the included file
+	};
+
+	static File_cache& get_instance();
+
+	explicit File_cache(clock_type::duration ttl = std::chrono::seconds(10));
+	File_cache(const File_cache&) = delete;
+	File_cache& operator=(const File_cache&) = delete;
+
+	bool exists(const boost::filesystem::path& path);
+	boost::optional<std::time_t> last_write_time(const boost::filesystem::path& path);
+	/// \brief the text of the file, read again only if its last modification time changed, or null
+	/// \detail The preprocessor and the token arenas of all units share
+	/// the text, so that a file is read once for every version of it.
+	std::shared_ptr<const std::string> load(const std::string& path);
+
+	/// \brief resolve an include directive, consulting resolver only on a cache miss
+	/// \detail The key must identify the directive completely, i.e. the
+	/// name as written, the kind of the directive, the directory of the
+	/// including file and the include search path.  Failed resolutions
+	/// are cached as well.
+	template <typename Resolver>
+	boost::optional<Include_location> resolve_include(const std::string& key, Resolver resolver)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _includes.find(key);
+			if (it != _includes.end() && clock_type::now() < it->second._expires)
+			{
+				return it->second._location;
+			}
+		}
+		boost::optional<Include_location> location = resolver();
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (location)
+		{
+			_resolved_keys[location->_native_name].insert(key);
+		}
+		_includes[key] = Include_entry{location, clock_type::now() + _ttl};
+		return location;
+	}
+
+	void invalidate(const boost::filesystem::path& path);
+	void invalidate_all();
+	void set_ttl(clock_type::duration ttl);
+
+private:
+	struct Status_entry {
+		bool _exists;
+		std::time_t _last_write_time;
+		clock_type::time_point _expires;
+	};
+
+	struct Include_entry {
+		boost::optional<Include_location> _location;
+		clock_type::time_point _expires;
+	};
+
+	struct Source_entry {
+		std::time_t _last_write_time;
+		std::shared_ptr<const std::string> _text;
+	};
+
+	const Status_entry& get_status(const boost::filesystem::path& path);
+
+	std::mutex _mutex;
+	clock_type::duration _ttl;
+	std::unordered_map<std::string, Status_entry> _statuses;
+	std::unordered_map<std::string, Include_entry> _includes;
+	std::unordered_map<std::string, Source_entry> _sources;
+	/// \brief keys of successfully resolved includes for each found file
+	std::unordered_map<std::string, std::unordered_set<std::string>> _resolved_keys;
+};
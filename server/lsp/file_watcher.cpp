@@ -0,0 +1,252 @@
+#include "file_watcher.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/log/attributes/constant.hpp>
+#include <boost/log/common.hpp>
+#include <boost/log/sinks/syslog_backend.hpp>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace {
+boost::log::sources::severity_logger<int> _logger(boost::log::keywords::severity = boost::log::sinks::syslog::debug);
+
+#ifdef __linux__
+const uint32_t WATCH_MASK = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+#endif
+} // namespace
+
+#ifdef __linux__
+
+File_watcher::File_watcher(Callback callback)
+	: _callback(std::move(callback))
+	, _inotify_fd(inotify_init1(IN_CLOEXEC | IN_NONBLOCK))
+	, _wakeup_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+	_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("WATCHER"));
+	if (_inotify_fd < 0 || _wakeup_fd < 0)
+	{
+		BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error) << "failed to initialize inotify: " << std::strerror(errno);
+		return;
+	}
+	_thread = std::thread([this]{run();});
+}
+
+File_watcher::~File_watcher()
+{
+	stop();
+	if (_inotify_fd >= 0)
+	{
+		close(_inotify_fd);
+	}
+	if (_wakeup_fd >= 0)
+	{
+		close(_wakeup_fd);
+	}
+}
+
+bool File_watcher::watch_file(const std::string& path)
+{
+	boost::filesystem::path file(path);
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto descriptor = add_watch(file.parent_path().string());
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	_directories[descriptor]._files.insert(file.filename().string());
+	return true;
+}
+
+void File_watcher::unwatch_file(const std::string& path)
+{
+	boost::filesystem::path file(path);
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto descriptor = _descriptors.find(file.parent_path().string());
+	if (descriptor == _descriptors.end())
+	{
+		return;
+	}
+	auto& watched = _directories[descriptor->second];
+	watched._files.erase(file.filename().string());
+	if (watched._all_files || !watched._files.empty())
+	{
+		return;
+	}
+	BOOST_LOG(_logger) << "unwatch \"" << watched._path << "\"";
+	inotify_rm_watch(_inotify_fd, descriptor->second);
+	_directories.erase(descriptor->second);
+	_descriptors.erase(descriptor);
+}
+
+bool File_watcher::watch_directory(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto descriptor = add_watch(path);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	_directories[descriptor]._all_files = true;
+	return true;
+}
+
+void File_watcher::stop()
+{
+	if (!_thread.joinable())
+	{
+		return;
+	}
+	uint64_t value = 1;
+	if (write(_wakeup_fd, &value, sizeof(value)) < 0)
+	{
+		BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error) << "failed to wake up the watcher thread: " << std::strerror(errno);
+	}
+	_thread.join();
+}
+
+int File_watcher::add_watch(const std::string& directory)
+{
+	if (_inotify_fd < 0)
+	{
+		return -1;
+	}
+	auto found = _descriptors.find(directory);
+	if (found != _descriptors.end())
+	{
+		return found->second;
+	}
+	auto descriptor = inotify_add_watch(_inotify_fd, directory.c_str(), WATCH_MASK);
+	if (descriptor < 0)
+	{
+		BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::warning) << "cannot watch \"" << directory << "\": " << std::strerror(errno);
+		return -1;
+	}
+	BOOST_LOG(_logger) << "watch \"" << directory << "\"";
+	_descriptors[directory] = descriptor;
+	auto& watched = _directories[descriptor];
+	watched._path = directory;
+	watched._all_files = false;
+	return descriptor;
+}
+
+void File_watcher::run()
+{
+	alignas(struct inotify_event) char buffer[4096];
+	pollfd fds[2] = {{_inotify_fd, POLLIN, 0}, {_wakeup_fd, POLLIN, 0}};
+	while (true)
+	{
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error) << "poll failed: " << std::strerror(errno);
+			return;
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			BOOST_LOG(_logger) << "watcher thread stopped";
+			return;
+		}
+		auto length = read(_inotify_fd, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			continue;
+		}
+		std::vector<std::pair<std::string, FILE_CHANGE_TYPE>> changes;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto ptr = buffer; ptr < buffer + length;)
+			{
+				auto event = reinterpret_cast<const struct inotify_event*>(ptr);
+				ptr += sizeof(struct inotify_event) + event->len;
+				auto found = _directories.find(event->wd);
+				if (found == _directories.end())
+				{
+					continue;
+				}
+				if (event->mask & IN_IGNORED)
+				{
+					_descriptors.erase(found->second._path);
+					_directories.erase(found);
+					continue;
+				}
+				if (event->len == 0)
+				{
+					continue;
+				}
+				std::string name(event->name);
+				if (!found->second._all_files && found->second._files.count(name) == 0)
+				{
+					continue;
+				}
+				auto type = FILE_CHANGE_TYPE::Changed;
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					type = FILE_CHANGE_TYPE::Created;
+				}
+				else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+				{
+					type = FILE_CHANGE_TYPE::Deleted;
+				}
+				changes.emplace_back((boost::filesystem::path(found->second._path) / name).string(), type);
+			}
+		}
+		for (auto& it : changes)
+		{
+			_callback(it.first, it.second);
+		}
+	}
+}
+
+#else
+
+File_watcher::File_watcher(Callback callback)
+	: _callback(std::move(callback))
+	, _inotify_fd(-1)
+	, _wakeup_fd(-1)
+{
+	_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("WATCHER"));
+	BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::warning) << "file watching is not supported on this platform";
+}
+
+File_watcher::~File_watcher() = default;
+
+bool File_watcher::watch_file(const std::string&)
+{
+	return false;
+}
+
+void File_watcher::unwatch_file(const std::string&)
+{
+}
+
+bool File_watcher::watch_directory(const std::string&)
+{
+	return false;
+}
+
+void File_watcher::stop()
+{
+}
+
+int File_watcher::add_watch(const std::string&)
+{
+	return -1;
+}
+
+void File_watcher::run()
+{
+}
+
+#endif
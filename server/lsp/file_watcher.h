@@ -0,0 +1,62 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include "protocol.h"
+
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+
+/**
+ * \brief reports changes of files on disk from a dedicated thread
+ * \detail On Linux the watcher is built on inotify.  Files are
+ * watched through their parent directories, so that the files
+ * replaced by renaming, as many editors and build tools save them,
+ * are still reported.  The callback is invoked on the watcher
+ * thread, clients are expected to forward the notifications to
+ * their own thread.  On other platforms nothing is watched.
+ */
+class File_watcher {
+public:
+	using Callback = std::function<void(const std::string& path, FILE_CHANGE_TYPE type)>;
+
+	explicit File_watcher(Callback callback);
+	~File_watcher();
+	File_watcher(const File_watcher&) = delete;
+	File_watcher& operator=(const File_watcher&) = delete;
+
+	/// \brief report changes of a single file, which need not exist yet
+	bool watch_file(const std::string& path);
+	/// \brief stop reporting changes of a file watched by watch_file
+	/// \detail The directory of the file stays watched as long as it
+	/// has other watched files or is watched by watch_directory.
+	void unwatch_file(const std::string& path);
+	/// \brief report changes of any file directly in a directory
+	bool watch_directory(const std::string& path);
+	void stop();
+
+private:
+	struct Watched_directory {
+		std::string _path;
+		bool _all_files;
+		std::set<std::string> _files;
+	};
+
+	int add_watch(const std::string& directory);
+	void run();
+
+	Callback _callback;
+	int _inotify_fd;
+	int _wakeup_fd;
+	std::mutex _mutex;
+	std::unordered_map<int, Watched_directory> _directories;
+	std::unordered_map<std::string, int> _descriptors;
+	std::thread _thread;
+};
@@ -1,15 +1,14 @@
 #include "lsp_server.h"
 #include "dispatcher.h"
-
-#include <rapidjson/error/en.h>
-#include <rapidjson/istreamwrapper.h>
+#include "file_cache.h"
 
 #include <boost/filesystem.hpp>
-#include <boost/tokenizer.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <functional>
 #include <regex>
+#include <set>
 #include <string>
 
 
@@ -52,6 +51,11 @@ LSP_server::LSP_server(std::istream &input_stream, std::ostream &output_stream)
 	, _is_done(false)
 	, _work(new boost::asio::io_service::work(_io_context))
 	, _worker_thread(std::thread([&]{_io_context.run();}))
+	, _parser_pool(std::max(1U, std::thread::hardware_concurrency()))
+	, _watcher([this](const std::string& path, FILE_CHANGE_TYPE type) {
+		// process file changes on the worker thread with all other requests
+		_io_context.post([this, path, type]{on_file_changed(path, type);});
+	})
 {
 	Protocol::_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("PROTOCOL"));
 	_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("LSP"));
@@ -78,6 +82,7 @@ int LSP_server::run()
 	BOOST_LOG(_logger) << "FINISHED";
 	_work.reset();
 	_worker_thread.join();
+	_parser_pool.join();
 	return 0;
 }
 
@@ -87,9 +92,28 @@ void LSP_server::on_exit(Params_exit&)
 	BOOST_LOG(_logger) << __PRETTY_FUNCTION__;
 }
 
-void LSP_server::on_initialize(Params_initialize&)
+void LSP_server::on_initialize(Params_initialize& params)
 {
 	BOOST_LOG(_logger) << __PRETTY_FUNCTION__;
+	if (!params._root_uri._path.empty())
+	{
+		_watcher.watch_directory(params._root_uri._path);
+		// start reading the commands before the first document is opened
+		auto compile_commands_path = boost::filesystem::path(params._root_uri._path) / "compile_commands.json";
+		if (File_cache::get_instance().exists(compile_commands_path))
+		{
+			get_compile_commands(compile_commands_path);
+		}
+	}
+	if (params._workspace_folders)
+	{
+		for (auto& it : *params._workspace_folders)
+		{
+			URI uri;
+			uri.set_from_uri(it._uri);
+			_watcher.watch_directory(uri._path);
+		}
+	}
 	rapidjson::Document json_document;
 	auto &allocator = json_document.GetAllocator();
 	rapidjson::Value result(rapidjson::kObjectType);
@@ -148,9 +172,12 @@ void LSP_server::on_textDocument_didChange(Params_textDocument_didChange& params
 	}
 }
 
-void LSP_server::on_textDocument_didClose(Params_textDocument_didClose&)
+void LSP_server::on_textDocument_didClose(Params_textDocument_didClose& params)
 {
 	BOOST_LOG(_logger) << __PRETTY_FUNCTION__;
+	auto& path = params._text_document._uri._path;
+	untrack_dependencies(path);
+	_files.erase(path);
 }
 
 void LSP_server::on_textDocument_didOpen(Params_textDocument_didOpen& params)
@@ -159,9 +186,10 @@ void LSP_server::on_textDocument_didOpen(Params_textDocument_didOpen& params)
 	auto& path = params._text_document._uri._path;
 	auto& text = params._text_document._text;
 	BOOST_LOG(_logger) << "create new P4_file \"" << path << "\"";
-	_files.emplace(std::piecewise_construct,
-				   std::forward_as_tuple(path),
-				   std::forward_as_tuple(find_command_for_path(path), path, text));
+	auto file = _files.emplace(std::piecewise_construct,
+							   std::forward_as_tuple(path),
+							   std::forward_as_tuple(_parser_pool, find_command_for_path(path), path, text)).first;
+	track_dependencies(path, file->second);
 }
 
 void LSP_server::on_textDocument_didSave(Params_textDocument_didSave&)
@@ -183,7 +211,10 @@ void LSP_server::on_textDocument_documentHighlight(Params_text_document_position
 	auto file = _files.find(path);
 	if (file != _files.end())
 	{
-		if (auto highlights = file->second.get_highlights(location))
+		auto highlights = file->second.get_highlights(location);
+		// the query compiles the file again if it changed
+		track_dependencies(path, file->second);
+		if (highlights)
 		{
 			rapidjson::Document json_document;
 			auto& allocator = json_document.GetAllocator();
@@ -217,6 +248,7 @@ void LSP_server::on_textDocument_documentSymbol(Params_textDocument_documentSymb
 				result.PushBack(it.get_json(allocator).Move(), allocator);
 			}
 		}
+		track_dependencies(path, file->second);
 	}
 	reply(result);
 }
@@ -242,7 +274,9 @@ void LSP_server::on_textDocument_hover(Params_text_document_position& params)
 	auto file = _files.find(path);
 	if (file != _files.end())
 	{
-		if (auto hover_content = file->second.get_hover(location))
+		auto hover_content = file->second.get_hover(location);
+		track_dependencies(path, file->second);
+		if (hover_content)
 		{
 			BOOST_LOG(_logger) << "found hover content\n\"" << *hover_content << "\"";
 			std::ostringstream os;
@@ -317,9 +351,13 @@ void LSP_server::on_workspace_didChangeConfiguration(Params_workspace_didChangeC
 	BOOST_LOG(_logger) << __PRETTY_FUNCTION__;
 }
 
-void LSP_server::on_workspace_didChangeWatchedFiles(Params_workspace_didChangeWatchedFiles&)
+void LSP_server::on_workspace_didChangeWatchedFiles(Params_workspace_didChangeWatchedFiles& params)
 {
 	BOOST_LOG(_logger) << __PRETTY_FUNCTION__;
+	for (auto& it : params._changes)
+	{
+		on_file_changed(it._uri._path, it._type);
+	}
 }
 
 void LSP_server::on_workspace_executeCommand(Params_workspace_executeCommand&)
@@ -399,66 +437,22 @@ std::string LSP_server::find_command_for_path(const std::string& file)
 	{
 		return search->second;
 	}
+	auto& file_cache = File_cache::get_instance();
 	for (boost::filesystem::path path(file); path.has_parent_path();)
 	{
 		path = path.parent_path();
 		auto compile_commands_path = path / "compile_commands.json";
-		if (boost::filesystem::exists(compile_commands_path))
+		if (file_cache.exists(compile_commands_path))
 		{
-			boost::filesystem::ifstream ifs(compile_commands_path);
-			rapidjson::IStreamWrapper isw(ifs);
-			rapidjson::Document json;
-			json.ParseStream(isw);
-			if (json.HasParseError() || !json.IsArray())
+			auto& compile_commands = get_compile_commands(compile_commands_path);
+			if (!compile_commands.is_valid())
 			{
-				BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error)
-					<< "JSON parse error: " << rapidjson::GetParseError_En(json.GetParseError())
-					<< " (" << json.GetErrorOffset() << ")";
 				return result;
 			}
-			boost::char_separator<char> separator(" ");
-			boost::tokenizer<boost::char_separator<char>> tokens(std::string(json.GetArray()[0]["command"].GetString()), separator);
-			boost::filesystem::path compiler(*tokens.begin());
-			std::string std_include;
-			if (compiler.has_parent_path() && compiler.parent_path().has_parent_path())
+			if (auto command = compile_commands.find_command(file))
 			{
-				auto std_include_path = compiler.parent_path().parent_path() / "share" / "p4c" / "p4include";
-				if (boost::filesystem::exists(std_include_path))
-				{
-					std_include = std_include_path.c_str();
-				}
-				else
-				{
-					std_include_path = compiler.parent_path().parent_path() / "p4include";
-					if (boost::filesystem::exists(std_include_path))
-					{
-						std_include = std_include_path.c_str();
-					}
-				}
-			}
-			for (auto& it : json.GetArray())
-			{
-				std::string the_file(it["file"].GetString());
-				std::string command(it["command"].GetString());
-				boost::char_separator<char> separator(" ");
-				boost::tokenizer<boost::char_separator<char>> tokens(command, separator);
-				std::string the_command("p4lsd");
-				if (!std_include.empty())
-				{
-					the_command += " -I ";
-					the_command += std_include;
-				}
-				auto token = tokens.begin();
-				for (++token; token != tokens.end(); ++token)
-				{
-					the_command += " " + *token;
-				}
-				_commands.emplace(the_file, the_command);
-			}
-			search = _commands.find(file);
-			if (search != _commands.end())
-			{
-				return search->second;
+				_command_files[compile_commands_path.string()].push_back(file);
+				return _commands[file] = *command;
 			}
 			BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::warning)
 				<< "did not find a matching command in \"" << compile_commands_path << "\"";
@@ -468,3 +462,96 @@ std::string LSP_server::find_command_for_path(const std::string& file)
 	BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::warning) << "did not find a compile_commands.json";
 	return result;
 }
+
+Compile_commands& LSP_server::get_compile_commands(const boost::filesystem::path& path)
+{
+	auto found = _compile_commands.find(path.string());
+	if (found == _compile_commands.end())
+	{
+		found = _compile_commands.emplace(path.string(), std::make_unique<Compile_commands>(path)).first;
+		_watcher.watch_file(path.string());
+		found->second->prefetch();
+	}
+	return *found->second;
+}
+
+void LSP_server::on_file_changed(const std::string& path, FILE_CHANGE_TYPE type)
+{
+	BOOST_LOG(_logger) << "file \"" << path << "\" changed, type " << static_cast<int>(type);
+	File_cache::get_instance().invalidate(path);
+	boost::filesystem::path changed_path(path);
+	if (changed_path.filename() == "compile_commands.json")
+	{
+		// forget the commands read from the changed file; a new file may
+		// also take over the units below its directory
+		std::set<std::string> units;
+		_compile_commands.erase(path);
+		auto command_files = _command_files.find(path);
+		if (command_files != _command_files.end())
+		{
+			for (auto& it : command_files->second)
+			{
+				_commands.erase(it);
+				units.insert(it);
+			}
+			_command_files.erase(command_files);
+		}
+		auto directory = changed_path.parent_path().string() + "/";
+		for (auto& it : _files)
+		{
+			if (units.count(it.first) != 0 || it.first.compare(0, directory.size(), directory) == 0)
+			{
+				it.second.set_command(find_command_for_path(it.first));
+			}
+		}
+		return;
+	}
+	auto units = _dependencies.get_dependents(path);
+	if (type != FILE_CHANGE_TYPE::Changed)
+	{
+		auto shadowed = _dependencies.get_dependents_by_name(path);
+		units.insert(shadowed.begin(), shadowed.end());
+	}
+	for (auto& it : units)
+	{
+		auto file = _files.find(it);
+		if (file != _files.end())
+		{
+			file->second.invalidate();
+		}
+	}
+}
+
+void LSP_server::track_dependencies(const std::string& path, const P4_file& file)
+{
+	auto& includes = file.get_included_files();
+	if (includes == _dependencies.get_dependencies(path))
+	{
+		return;
+	}
+	auto previous = _dependencies.get_dependencies(path);
+	_dependencies.set_dependencies(path, includes);
+	for (auto& it : includes)
+	{
+		_watcher.watch_file(it);
+	}
+	unwatch_unused(previous);
+}
+
+void LSP_server::untrack_dependencies(const std::string& path)
+{
+	auto previous = _dependencies.get_dependencies(path);
+	_dependencies.remove_unit(path);
+	unwatch_unused(previous);
+}
+
+void LSP_server::unwatch_unused(const std::set<std::string>& files)
+{
+	for (auto& it : files)
+	{
+		if (_dependencies.get_dependents(it).empty())
+		{
+			_watcher.unwatch_file(it);
+		}
+	}
+}
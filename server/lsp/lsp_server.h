@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include "compile_commands.h"
+#include "dependency_graph.h"
+#include "file_watcher.h"
 #include "protocol.h"
 #include "p4unit.h"
 
@@ -12,7 +15,9 @@
 #include <rapidjson/document.h>
 
 #include <istream>
+#include <memory>
 #include <optional>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -55,6 +60,13 @@ private:
 
 	std::optional<std::string> read_message();
 	std::string find_command_for_path(const std::string& file);
+	Compile_commands& get_compile_commands(const boost::filesystem::path& path);
+	void on_file_changed(const std::string& path, FILE_CHANGE_TYPE type);
+	/// \brief record and watch the files included by the last compilation of the unit
+	void track_dependencies(const std::string& path, const P4_file& file);
+	void untrack_dependencies(const std::string& path);
+	/// \brief stop watching the files that no unit includes any more
+	void unwatch_unused(const std::set<std::string>& files);
 
 	Server_capabilities _capabilities;
 	std::istream& _input_stream;
@@ -64,7 +76,14 @@ private:
 	boost::asio::io_context _io_context;
 	std::shared_ptr<boost::asio::io_service::work> _work;
 	std::thread _worker_thread;
+	/// \brief parses the top-level declarations of the files, it is joined after the worker thread
+	boost::asio::thread_pool _parser_pool;
 
 	std::unordered_map<std::string, P4_file> _files;
 	std::unordered_map<std::string, std::string> _commands;
+	std::unordered_map<std::string, std::unique_ptr<Compile_commands>> _compile_commands;
+	/// \brief files of the commands read from each compile_commands.json
+	std::unordered_map<std::string, std::vector<std::string>> _command_files;
+	Dependency_graph _dependencies;
+	File_watcher _watcher;
 };
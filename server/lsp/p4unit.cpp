@@ -1,13 +1,18 @@
 #include "p4unit.h"
+#include "preprocessor.h"
 
 #include <boost/log/attributes/constant.hpp>
 #include <boost/log/sinks/syslog_backend.hpp>
 #include <boost/tokenizer.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 #include "../p4l/lexer.h"
+#include "../p4l/parallel_parser.h"
+#include "../p4l/parser.h"
 
 namespace {
 boost::log::sources::severity_logger<int> _logger(boost::log::keywords::severity = boost::log::sinks::syslog::debug);
@@ -39,151 +44,73 @@ std::string::size_type get_position_index(const std::string& content, const Posi
 	return std::string::npos;
 }
 
-} // namespace
-#if 0
-bool Symbol_collector::preorder(const IR::Node* node)
+/// \brief the text of an included file as the preprocessor read it
+p4l::token_arena::source_type load_source(const std::string& path)
 {
-	if (!node->is<Util::IHasSourceInfo>())
-	{
-		return false;
-	}
-	if (auto ctxt = getContext())
-	{
-		Range range;
-		const char* file = "";
-		if (auto info = node->getSourceInfo())
-		{
-			range.set(info);
-			file = info.getSourceFile().c_str();
-		}
-		auto unit = _temp_path == file ? _unit_path.c_str() : file;
-		Location location{unit, range};
-		BOOST_LOG(_logger)
-			<< ctxt->depth
-			<< " " << node->node_type_name()
-			<< " " << node->toString()
-			<< " " << location;
-		// definitions
-		if (node->is<IR::Type_Header>() || node->is<IR::Type_HeaderUnion>() || node->is<IR::Type_Struct>() || node->is<IR::Type_Extern>() || node->is<IR::Type_Enum>())
-		{
-			std::ostringstream definition;
-			definition << node;
-			auto name = node->to<IR::IDeclaration>()->getName().toString().c_str();
-			_definitions.emplace(name, definition.str());
-			BOOST_LOG(_logger) << "Header or Struct: \"" << name << "\"\n" << definition.str();
-		}
-		else if (node->is<IR::Type_Typedef>())
-		{
-			auto name = node->to<IR::IDeclaration>()->getName().toString().c_str();
-			std::ostringstream definition;
-			definition << "typedef " << node->to<IR::Type_Typedef>()->type << " " << name << ";";
-			_definitions.emplace(name, definition.str());
-			BOOST_LOG(_logger) << "Typedef:\"" << name << "\"\n" << definition.str();
-		}
-		// highlights
-		if (_unit_path == unit)
-		{
-			if (node->is<IR::Parameter>() || node->is<IR::PathExpression>())
-			{
-				auto name = node->toString().c_str();
-				auto it = _highlights.find(name);
-				if (it == _highlights.end())
-				{
-					it = _highlights.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple()).first;
-				}
-				it->second.emplace_back(range, DOCUMENT_HIGHLIGHT_KIND::Text);
-				_locations[unit].emplace(std::make_pair(range, name));
-			}
-		}
-		// locations of types, but need locations for all other interesting items as well
-		if (node->is<IR::Type_Name>())
-		{
-			_locations[unit].emplace(std::make_pair(range, node->toString().c_str()));
-		}
-		else if (ctxt->depth == _max_depth
-			&& node->is<IR::IDeclaration>()
-			&& !node->is<IR::Type_Control>()
-			&& !node->is<IR::Type_Parser>())
-		{
-			boost::optional<std::string> container;
-			if (!_container.empty())
-			{
-				container.emplace(_container.back());
-			}
-			auto name = node->to<IR::IDeclaration>()->getName().toString().c_str();
-			_indexes[name] = _symbols.size();
-			_symbols.emplace_back(name, get_symbol_kind(node), location, container);
-			if (node->is<IR::Type_Header>()
-				|| node->is<IR::Type_Struct>()
-				|| node->is<IR::P4Control>()
-				|| node->is<IR::P4Parser>())
-			{
-				_container.push_back(name);
-				++_max_depth;
-			}
-		}
-	}
-	return true;
+	return File_cache::get_instance().load(path);
 }
 
-void Symbol_collector::postorder(const IR::Node* node)
+/// \brief the range of the token in its file
+Range get_range(const p4l::token_arena& tokens, const p4l::compact_token& token)
 {
-	if (auto ctxt = getContext())
-	{
-		BOOST_LOG(_logger) << "exit from " << ctxt->depth << " " << node->node_type_name();
-		if (ctxt->depth < _max_depth)
-		{
-			--_max_depth;
-			_container.pop_back();
-		}
-	}
+	auto start = tokens.get_line_character(token);
+	Range range;
+	range._start = Position(start.first, start.second);
+	range._end = Position(start.first, start.second + token._length);
+	return range;
 }
 
-SYMBOL_KIND Symbol_collector::get_symbol_kind(const IR::Node* node)
+SYMBOL_KIND get_symbol_kind(p4l::node_kind kind)
 {
-	if (node->is<IR::Declaration_Constant>())
-	{
-		return SYMBOL_KIND::Constant;
-	}
-	if (node->is<IR::Type_Header>() ||
-		node->is<IR::Type_Struct>())
-	{
-		return SYMBOL_KIND::Class;
-	}
-	if (node->is<IR::P4Parser>() ||
-		node->is<IR::P4Control>())
-	{
-		return SYMBOL_KIND::Class;
+	switch (kind) {
+	case p4l::node_kind::constant: return SYMBOL_KIND::Constant;
+	case p4l::node_kind::header:
+	case p4l::node_kind::header_union:
+	case p4l::node_kind::extern_type:
+	case p4l::node_kind::parser:
+	case p4l::node_kind::control: return SYMBOL_KIND::Class;
+	case p4l::node_kind::struct_type: return SYMBOL_KIND::Struct;
+	case p4l::node_kind::enum_type: return SYMBOL_KIND::Enum;
+	case p4l::node_kind::member: return SYMBOL_KIND::EnumMember;
+	case p4l::node_kind::type_definition:
+	case p4l::node_kind::parser_type:
+	case p4l::node_kind::control_type:
+	case p4l::node_kind::package_type: return SYMBOL_KIND::Interface;
+	case p4l::node_kind::variable:
+	case p4l::node_kind::instantiation:
+	case p4l::node_kind::value_set: return SYMBOL_KIND::Variable;
+	case p4l::node_kind::field: return SYMBOL_KIND::Field;
+	case p4l::node_kind::function: return SYMBOL_KIND::Function;
+	case p4l::node_kind::method:
+	case p4l::node_kind::state:
+	case p4l::node_kind::action:
+	case p4l::node_kind::table: return SYMBOL_KIND::Method;
+	default: return SYMBOL_KIND::Null;
 	}
-	if (node->is<IR::Type_Typedef>())
-	{
-		return SYMBOL_KIND::Interface;
-	}
-	if (node->is<IR::Declaration_Instance>())
-	{
-		return SYMBOL_KIND::Variable;
-	}
-	if (node->is<IR::StructField>())
-	{
-		return SYMBOL_KIND::Field;
-	}
-	if (node->is<IR::ParserState>() ||
-		node->is<IR::P4Action>() ||
-		node->is<IR::P4Table>())
-	{
-		return SYMBOL_KIND::Method;
-	}
-	return SYMBOL_KIND::Null;
 }
-#endif
-P4_file::P4_file(const std::string &command, const std::string &unit_path, const std::string& text)
-	: _command(std::make_unique<char[]>(command.size() + 1))
+
+} // namespace
+
+P4_file::P4_file(boost::asio::thread_pool& pool, const std::string &command, const std::string &unit_path, const std::string& text)
+	: _pool(pool)
 	, _unit_path(unit_path)
 	, _source_code(text)
+	, _tokens(load_source)
+	, _parser(p4l::parse_mode::signatures)
 	, _changed(true)
 {
 	_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("P4UNIT"));
 	BOOST_LOG(_logger) << "constructor started.";
+	set_command(command);
+	compile();
+	BOOST_LOG(_logger) << "constructed.";
+}
+
+void P4_file::set_command(const std::string& command)
+{
+	_command = std::make_unique<char[]>(command.size() + 1);
+	_argv.clear();
+	_changed = true;
 	boost::char_separator<char> separator(" ");
 	boost::tokenizer<boost::char_separator<char>> tokens(command, separator);
 	auto arg = _command.get();
@@ -195,8 +122,18 @@ P4_file::P4_file(const std::string &command, const std::string &unit_path, const
 		_argv.emplace_back(arg);
 		arg += size;
 	}
-	compile();
-	BOOST_LOG(_logger) << "constructed.";
+	_settings = Context_factory::get_instance().get_settings(_argv);
+}
+
+void P4_file::invalidate()
+{
+	BOOST_LOG(_logger) << "dependencies of \"" << _unit_path << "\" changed.";
+	_changed = true;
+}
+
+const std::set<std::string>& P4_file::get_included_files() const
+{
+	return _included_files;
 }
 
 void P4_file::change_source_code(const std::vector<Text_document_content_change_event>& content_changes)
@@ -216,12 +153,7 @@ void P4_file::change_source_code(const std::vector<Text_document_content_change_
 			if (start != std::string::npos && end != std::string::npos &&
 				start <= end && (!it._range_length || *it._range_length == end - start))
 			{
-				std::string content;
-				content.reserve(start + it._text.size() + _source_code.size() - end);
-				content = _source_code.substr(0, start);
-				content += it._text;
-				content += _source_code.substr(end);
-				_source_code = std::move(content);
+				_source_code.replace(start, end - start, it._text);
 				BOOST_LOG(_logger) << "applied content change in range " << *it._range;
 			}
 			else
@@ -244,51 +176,198 @@ std::vector<Symbol_information>& P4_file::get_symbols()
 boost::optional<std::string> P4_file::get_hover(const Location& location)
 {
 	BOOST_LOG(_logger) << "search hover for " << location;
-	for (const auto& it : _locations[location._uri])
+	if (_changed)
+	{
+		compile();
+	}
+	parse_body(location);
+	auto occurrence = find_occurrence(location);
+	if (occurrence == p4l::ast::none)
+	{
+		return boost::none;
+	}
+	if (_saved)
 	{
-		BOOST_LOG(_logger) << "check location " << it.first;
-		if (it.first & location._range)
+		const auto& saved = _saved->get_names()[_saved->get_occurrences()[occurrence].name];
+		if (saved.definition_length == 0)
 		{
-			auto def = _definitions.find(it.second);
-			if (def != _definitions.end())
-			{
-				return def->second;
-			}
 			return boost::none;
 		}
+		return std::string(_saved->get_definition(saved));
+	}
+	const auto& name = _symbol_table.get_names()[_symbol_table.get_occurrences()[occurrence].name];
+	if (name.definition == p4l::ast::none)
+	{
+		return boost::none;
+	}
+	const auto& declared = _symbol_table.get_symbols()[name.definition];
+	if (declared.begin == declared.end)
+	{
+		return boost::none;
 	}
-	return boost::none;
+	return _symbol_table.get_definition(_tokens, declared);
 }
 
 boost::optional<std::vector<Text_document_highlight>> P4_file::get_highlights(const Location& location)
 {
 	BOOST_LOG(_logger) << "search highlight for " << location;
-	for (const auto& it : _locations[location._uri])
+	if (_changed)
+	{
+		compile();
+	}
+	parse_body(location);
+	auto occurrence = find_occurrence(location);
+	if (occurrence == p4l::ast::none)
 	{
-		BOOST_LOG(_logger) << "check location " << it.first;
-		if (it.first & location._range)
+		return boost::none;
+	}
+	std::vector<Text_document_highlight> result;
+	if (_saved)
+	{
+		const auto& saved = _saved->get_occurrences();
+		auto file = *_tokens.find_file(location._uri);
+		for (auto it = _saved->get_names()[saved[occurrence].name].first; it != p4l::ast::none; it = saved[it].next)
+		{
+			p4l::compact_token token{0, file, saved[it].offset, saved[it].end - saved[it].offset};
+			result.emplace_back(get_range(_tokens, token), DOCUMENT_HIGHLIGHT_KIND::Text);
+		}
+		return result;
+	}
+	const auto& occurrences = _symbol_table.get_occurrences();
+	auto file = _tokens[occurrences[occurrence].token]._file;
+	for (auto it = _symbol_table.get_names()[occurrences[occurrence].name].first; it != p4l::ast::none; it = occurrences[it].next)
+	{
+		const auto& token = _tokens[occurrences[it].token];
+		if (token._file == file)
 		{
-			return _highlights[it.second];
+			result.emplace_back(get_range(_tokens, token), DOCUMENT_HIGHLIGHT_KIND::Text);
+		}
+	}
+	return result;
+}
+
+void P4_file::parse_body(const Location& location)
+{
+	if (_saved)
+	{
+		return;
+	}
+	auto file = _tokens.find_file(location._uri);
+	if (!file)
+	{
+		return;
+	}
+	auto offset = _tokens.get_offset(*file, location._range._start._line, location._range._start._character);
+	if (!offset)
+	{
+		return;
+	}
+	auto token = std::find_if(_tokens.begin(), _tokens.end(), [&file, &offset](const p4l::compact_token& it) {
+		return it._file == *file && it._offset <= *offset && *offset <= it._offset + it._length;
+	});
+	if (token == _tokens.end())
+	{
+		return;
+	}
+	auto parsed = _parser.get_body_count();
+	if (_parser.find_body(_tokens, static_cast<std::uint32_t>(token - _tokens.begin())) && _parser.get_body_count() != parsed)
+	{
+		BOOST_LOG(_logger) << "parsed the body at " << location;
+		build_tables();
+	}
+}
+
+std::uint32_t P4_file::find_occurrence(const Location& location) const
+{
+	auto file = _tokens.find_file(location._uri);
+	if (!file)
+	{
+		return p4l::ast::none;
+	}
+	auto offset = _tokens.get_offset(*file, location._range._start._line, location._range._start._character);
+	if (!offset)
+	{
+		return p4l::ast::none;
+	}
+	return _saved ? _saved->find_occurrence(*offset) : _symbol_table.find_occurrence(*file, *offset);
+}
+
+bool P4_file::save_analysis(const std::string& path)
+{
+	// the tables of a loaded analysis were released, they are compiled again
+	if (_changed || _saved)
+	{
+		compile();
+	}
+	// the bodies are left unparsed until they are queried, the saved analysis has the names in all of them
+	auto parsed = p4l::parse_parallel(_tokens, _pool, 4 * std::max(1U, std::thread::hardware_concurrency()));
+	p4l::symbol_table table(parsed.tree, _tokens);
+	auto file = _tokens.find_file(_unit_path);
+	if (!file || !p4l::symbol_file::write(path, table, _tokens, *file))
+	{
+		BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error) << "cannot save analysis of \"" << _unit_path << "\" to \"" << path << "\"";
+		return false;
+	}
+	BOOST_LOG(_logger) << "saved analysis of \"" << _unit_path << "\" to \"" << path << "\"";
+	return true;
+}
+
+bool P4_file::load_analysis(const std::string& path)
+{
+	auto saved = p4l::symbol_file::open(path, _source_code);
+	if (!saved)
+	{
+		BOOST_LOG(_logger) << "no analysis of the current text of \"" << _unit_path << "\" in \"" << path << "\"";
+		return false;
+	}
+	_saved = std::move(saved);
+	// only the lines of the unit file are kept, to convert the positions
+	_tokens.clear();
+	auto file = _tokens.add_file(_unit_path, std::make_shared<std::string>(_source_code));
+	_parser = p4l::incremental_parser(p4l::parse_mode::signatures);
+	_ast = p4l::ast();
+	_symbol_table = p4l::symbol_table();
+	_symbols.clear();
+	const auto& names = _saved->get_names();
+	for (const auto& it : _saved->get_symbols()) {
+		auto kind = static_cast<p4l::node_kind>(it.kind);
+		if (kind == p4l::node_kind::parameter || kind == p4l::node_kind::type_parameter) {
+			continue;
+		}
+		boost::optional<std::string> container;
+		if (it.container != p4l::ast::none) {
+			container.emplace(_saved->get_text(names[_saved->get_symbols()[it.container].name]));
 		}
+		p4l::compact_token token{0, file, it.offset, it.length};
+		Location location{_unit_path, get_range(_tokens, token)};
+		_symbols.emplace_back(std::string(_saved->get_text(names[it.name])), get_symbol_kind(kind), location, container);
 	}
-	return boost::none;
+	_changed = false;
+	BOOST_LOG(_logger) << "loaded " << _saved->get_symbols().size() << " symbols and " << _saved->get_occurrences().size()
+					   << " occurrences of \"" << _unit_path << "\" from \"" << path << "\"";
+	return true;
 }
 
 void P4_file::compile()
 {
-	using token_type = p4l::p4lex_token<>;
-	using lexer_type = p4l::p4lex_iterator<token_type>;
-	using context_type = boost::wave::context<std::string::iterator, lexer_type>;
-	context_type::token_type current_token;
-	context_type ctx(_source_code.begin(), _source_code.end(), _unit_path.c_str());
-	ctx.set_language(boost::wave::support_cpp0x);
-	ctx.set_language(boost::wave::enable_preserve_comments(ctx.get_language()));
-	ctx.set_language(boost::wave::enable_prefer_pp_numbers(ctx.get_language()));
-	ctx.set_language(boost::wave::enable_emit_contnewlines(ctx.get_language()));
-	auto token = ctx.begin();
-	while (token != ctx.end()) {
+	P4_context::token_type current_token;
+	_saved.reset();
+	_tokens.clear();
+	auto source = std::make_shared<std::string>(_source_code);
+	_tokens.add_file(_unit_path, source);
+	auto ctx = Context_factory::get_instance().create(source->begin(), source->end(), _unit_path, *_settings);
+	auto token = ctx->begin();
+	// an exception thrown by ++token, e.g. by #warning, leaves the iterator on the token already appended
+	auto reached = true;
+	while (token != ctx->end()) {
 		try {
+			if (reached) {
+				current_token = *token;
+				_tokens.append(current_token);
+			}
+			reached = false;
 			++token;
+			reached = true;
 		} catch (boost::wave::cpp_exception const& e) {
 			std::cerr << e.file_name() << "(" << e.line_no() << "): " << e.description() << std::endl;
 		} catch (std::exception const& e) {
@@ -297,6 +376,23 @@ void P4_file::compile()
 			std::cerr << current_token.get_position().get_file() << "(" << current_token.get_position().get_line() << "): " << "unexpected exception." << std::endl;
 		}
 	}
+	_included_files = ctx->get_hooks().get_included_files();
+	BOOST_LOG(_logger) << "preprocessed \"" << _unit_path << "\" into " << _tokens.size() << " tokens from " << _tokens.get_file_count() - 1 << " files.";
+	if (_parser.get_declarations().empty())
+	{
+		// the top-level declarations of large programs are parsed on the pool of the server
+		auto parsed = p4l::parse_parallel(_tokens, _pool, 4 * std::max(1U, std::thread::hardware_concurrency()),
+										  p4l::parse_mode::signatures);
+		_parser = p4l::incremental_parser(_tokens, std::move(parsed), p4l::parse_mode::signatures);
+	}
+	else
+	{
+		auto reparsed = _parser.update(_tokens);
+		BOOST_LOG(_logger) << "parsed " << reparsed << " of " << _parser.get_declarations().size() << " declarations again";
+	}
+	BOOST_LOG(_logger) << "kept " << _parser.get_body_count() << " parsed bodies, number of errors " << _parser.get_error_count();
+	build_tables();
+	_changed = false;
 #if 0
 	p4c_options.process(_argv.size(), _argv.data());
 	BOOST_LOG(_logger) << "processed options, number of errors " << ::errorCount();
@@ -311,17 +407,27 @@ void P4_file::compile()
 	BOOST_LOG(_logger) << "compiled p4 source file, number of errors " << error_count;
 	auto existed = remove(temp_file_path);
 	BOOST_LOG(_logger) << "removed temporary file " << temp_file_path << " " << existed;
-	if (_program && error_count == 0)
-	{
-		_definitions.clear();
-		_highlights.clear();
-		_locations.clear();
-		_indexes.clear();
-		_symbols.clear();
-		Collected_data output{_symbols, _definitions, _highlights, _locations, _indexes};
-		Outline outline(p4c_options, _unit_path, output);
-		outline.process(_program);
-		_changed = false;
-	}
 #endif
 }
+
+void P4_file::build_tables()
+{
+	_ast = _parser.get_tree();
+	_symbol_table = p4l::symbol_table(_ast, _tokens);
+	_symbols.clear();
+	for (const auto& it : _symbol_table.get_symbols()) {
+		const auto& token = _tokens[it.token];
+		if (token._file == p4l::token_arena::scratch_file || it.kind == p4l::node_kind::parameter
+			|| it.kind == p4l::node_kind::type_parameter) {
+			continue;
+		}
+		boost::optional<std::string> container;
+		if (it.container != p4l::ast::none) {
+			container.emplace(_symbol_table.get_names()[_symbol_table.get_symbols()[it.container].name].text);
+		}
+		Location location{_tokens.get_file_name(token._file), get_range(_tokens, token)};
+		_symbols.emplace_back(std::string(_symbol_table.get_names()[it.name].text), get_symbol_kind(it.kind), location, container);
+	}
+	BOOST_LOG(_logger) << "collected " << _symbol_table.get_symbols().size() << " symbols and "
+					   << _symbol_table.get_occurrences().size() << " occurrences of " << _symbol_table.get_names().size() << " names";
+}
@@ -5,116 +5,81 @@
 #pragma once
 
 #include "protocol.h"
+#include "../p4l/ast.h"
+#include "../p4l/incremental_parser.h"
+#include "../p4l/symbol_file.h"
+#include "../p4l/symbol_table.h"
+#include "../p4l/token_arena.h"
 
+#include <boost/asio/thread_pool.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 
-#include <map>
 #include <memory>
+#include <set>
 #include <string>
-#include <unordered_map>
 
 
-struct Collected_data {
-	Collected_data(std::vector<Symbol_information>& symbols,
-				   std::unordered_map<std::string, std::string>& definitions,
-				   std::unordered_map<std::string, std::vector<Text_document_highlight>>& highlights,
-				   std::unordered_map<std::string, std::map<Range, std::string>>& locations,
-				   std::unordered_map<std::string, std::vector<Symbol_information>::size_type>& indexes)
-		: _symbols(symbols)
-		, _definitions(definitions)
-		, _highlights(highlights)
-		, _locations(locations)
-		, _indexes(indexes)
-	{}
-	std::vector<Symbol_information>& _symbols;
-	std::unordered_map<std::string, std::string>& _definitions;
-	std::unordered_map<std::string, std::vector<Text_document_highlight>>& _highlights;
-	std::unordered_map<std::string, std::map<Range, std::string>>& _locations;
-	std::unordered_map<std::string, std::vector<Symbol_information>::size_type>& _indexes;
-};
-
-
-class Symbol_collector {
-public:
-	Symbol_collector(std::string& temp_path, std::string& unit_path, Collected_data& /*output*/)
-		: _temp_path(temp_path)
-		, _unit_path(unit_path)
-		  //, _max_depth(1)
-		  //, _symbols(output._symbols)
-		  //, _definitions(output._definitions)
-		  //, _highlights(output._highlights)
-		  //, _locations(output._locations)
-		  //, _indexes(output._indexes)
-	{
-	}
-#if 0
-	bool preorder(const IR::Node* node) override;
-	void postorder(const IR::Node* node) override;
-#endif
-private:
-#if 0
-	SYMBOL_KIND get_symbol_kind(const IR::Node* node);
-#endif
-	std::string _temp_path;
-	std::string _unit_path;
-	//int _max_depth;
-	//std::vector<std::string> _container;
-	//std::vector<Symbol_information>& _symbols;
-	//std::unordered_map<std::string, std::string>& _definitions;
-	//std::unordered_map<std::string, std::vector<Text_document_highlight>>& _highlights;
-	//std::unordered_map<std::string, std::map<Range, std::string>>& _locations;
-	//std::unordered_map<std::string, std::vector<Symbol_information>::size_type>& _indexes;
-};
-
-
-class Outline {
-public:
-#if 0
-	Outline(CompilerOptions& options, std::string& unit_path, Collected_data& output)
-	{
-		addPasses({new Symbol_collector(options.file, unit_path, output)});
-	}
-
-	void process(std::unique_ptr<const IR::P4Program>& program)
-	{
-		program->apply(*this);
-	}
-#endif
-};
-
+struct Preprocessor_settings;
 
 /**
  *
  */
 class P4_file {
 public:
-	P4_file() = default;
 	~P4_file() = default;
-	P4_file(const std::string& command, const std::string& unit_path, const std::string& text);
+	/// \brief the top-level declarations are parsed on the pool, it must outlive the file
+	P4_file(boost::asio::thread_pool& pool, const std::string& command, const std::string& unit_path, const std::string& text);
 	void change_source_code(const std::vector<Text_document_content_change_event>& content_changes);
+	/// \brief replace the command line, e.g. after compile_commands.json changed
+	void set_command(const std::string& command);
+	/// \brief force compilation on the next request, e.g. after an included file changed
+	void invalidate();
+	const std::set<std::string>& get_included_files() const;
+	/// \brief preprocessed tokens of the last compilation
+	const p4l::token_arena& get_tokens() const { return _tokens; }
 	std::vector<Symbol_information>& get_symbols();
 	boost::optional<std::string> get_hover(const Location& location);
 	boost::optional<std::vector<Text_document_highlight>> get_highlights(const Location& location);
+	/// \brief save the symbols and the occurrences of the unit file for load_analysis, false if it is not written
+	bool save_analysis(const std::string& path);
+	/// \brief answer the queries from the analysis saved for the current text and release the compilation
+	/// \detail Only the declarations and the names in the unit file are saved.  Returns false if there is
+	///         no valid analysis at the path.
+	bool load_analysis(const std::string& path);
 
 private:
 	void compile();
+	/// \brief build the symbols from the tree of the declarations
+	void build_tables();
+	/// \brief parse the body the location is in if it is not yet, then build the symbols again
+	void parse_body(const Location& location);
+	/// \brief the occurrence of a name at the start of the location, or none
+	std::uint32_t find_occurrence(const Location& location) const;
 
+	boost::asio::thread_pool& _pool;
 	std::unique_ptr<char[]> _command;
 	std::vector<char*> _argv;
+	std::shared_ptr<const Preprocessor_settings> _settings;
 #if 0
 	std::unique_ptr<const IR::P4Program> _program;
 #endif
 	std::string _unit_path;
+	/// \brief the source code, it is lexed by the preprocessor when it is compiled
 	std::string _source_code;
+	std::set<std::string> _included_files;
+	/// \brief preprocessed tokens of the last compilation
+	p4l::token_arena _tokens;
+	/// \brief the top-level declarations of the preprocessed tokens, those whose tokens did not change are not parsed again
+	/// \detail The bodies are parsed when a query is in them and are kept until their declaration changes.
+	p4l::incremental_parser _parser;
+	/// \brief syntax tree of the preprocessed tokens, its nodes refer to them by index
+	p4l::ast _ast;
+	/// \brief declarations and names of the syntax tree, hovers and highlights are found in it
+	p4l::symbol_table _symbol_table;
+	/// \brief the declarations in source files, except the parameters
 	std::vector<Symbol_information> _symbols;
-	std::unordered_map<std::string, std::string> _definitions;
-	/// \brief dictionary of location maps, one for each compilation unit
-	/// \detail There may be several units per compiled file, if it
-	/// includes other modules.  Each location map binds locations to
-	/// symbols found at those locations.
-	std::unordered_map<std::string, std::map<Range, std::string>> _locations;
-	std::unordered_map<std::string, std::vector<Text_document_highlight>> _highlights;
-	std::unordered_map<std::string, std::vector<Symbol_information>::size_type> _indexes;
+	/// \brief the analysis mapped by load_analysis, it answers the queries until the next compilation
+	std::unique_ptr<p4l::symbol_file> _saved;
 	bool _changed;
 };
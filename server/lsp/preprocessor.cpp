@@ -0,0 +1,131 @@
+#include "preprocessor.h"
+
+#include <boost/log/attributes/constant.hpp>
+#include <boost/log/common.hpp>
+#include <boost/log/sinks/syslog_backend.hpp>
+
+#include <cstring>
+
+namespace {
+boost::log::sources::severity_logger<int> _logger(boost::log::keywords::severity = boost::log::sinks::syslog::debug);
+
+/// \brief macros defined by p4c for every program
+const char* const PREDEFINED_MACROS[] = {"__p4c__=1"};
+
+/// \brief value of option in argv[index], either attached or in the next argument
+boost::optional<std::string> get_option_value(const std::vector<char*>& argv, std::vector<char*>::size_type& index, const char* option)
+{
+	auto length = std::strlen(option);
+	if (std::strncmp(argv[index], option, length) != 0)
+	{
+		return boost::none;
+	}
+	if (argv[index][length] != '\0')
+	{
+		return std::string(argv[index] + length);
+	}
+	if (index + 1 < argv.size())
+	{
+		return std::string(argv[++index]);
+	}
+	return boost::none;
+}
+
+} // namespace
+
+Context_factory& Context_factory::get_instance()
+{
+	static Context_factory instance;
+	return instance;
+}
+
+Context_factory::Context_factory()
+{
+	_logger.add_attribute("Tag", boost::log::attributes::constant<std::string>("PREPROCESSOR"));
+}
+
+std::shared_ptr<const Preprocessor_settings> Context_factory::get_settings(const std::vector<char*>& argv)
+{
+	std::string signature;
+	for (auto arg : argv)
+	{
+		signature += arg;
+		signature += ' ';
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _settings.find(signature);
+	if (found != _settings.end())
+	{
+		return found->second;
+	}
+	auto settings = std::make_shared<Preprocessor_settings>();
+	settings->_signature = signature;
+	auto language = boost::wave::support_cpp0x;
+	language = boost::wave::enable_preserve_comments(language);
+	language = boost::wave::enable_prefer_pp_numbers(language);
+	language = boost::wave::enable_emit_contnewlines(language);
+	settings->_language = language;
+	for (auto it : PREDEFINED_MACROS)
+	{
+		settings->_macros.push_back({it, false});
+	}
+	// the first argument is the name of the program
+	for (std::vector<char*>::size_type it = 1; it < argv.size(); ++it)
+	{
+		if (auto value = get_option_value(argv, it, "-isystem"))
+		{
+			settings->_include_paths.push_back(*value);
+		}
+		else if (auto value = get_option_value(argv, it, "-iquote"))
+		{
+			settings->_quote_paths.push_back(*value);
+		}
+		else if (auto value = get_option_value(argv, it, "-I"))
+		{
+			settings->_include_paths.push_back(*value);
+		}
+		else if (auto value = get_option_value(argv, it, "-D"))
+		{
+			settings->_macros.push_back({*value, false});
+		}
+		else if (auto value = get_option_value(argv, it, "-U"))
+		{
+			settings->_macros.push_back({*value, true});
+		}
+	}
+	BOOST_LOG(_logger) << "new settings with " << settings->_include_paths.size() << " include paths and "
+					   << settings->_macros.size() << " macros for \"" << signature << "\"";
+	return _settings[signature] = settings;
+}
+
+std::unique_ptr<P4_context> Context_factory::create(std::string::iterator first,
+													std::string::iterator last,
+													const std::string& file_name,
+													const Preprocessor_settings& settings) const
+{
+	auto ctx = std::make_unique<P4_context>(first, last, file_name.c_str(), Include_hooks<P4_token>(settings._signature));
+	ctx->set_language(settings._language);
+	for (auto& it : settings._quote_paths)
+	{
+		ctx->add_include_path(it.c_str());
+	}
+	for (auto& it : settings._include_paths)
+	{
+		ctx->add_sysinclude_path(it.c_str());
+	}
+	// as cc does, a later -D or -U of a macro overrides the earlier ones
+	for (auto& it : settings._macros)
+	{
+		if (it._undefine)
+		{
+			ctx->remove_macro_definition(it._macro, true);
+			continue;
+		}
+		try {
+			ctx->add_macro_definition(it._macro, true);
+		} catch (boost::wave::cpp_exception const& e) {
+			BOOST_LOG_SEV(_logger, boost::log::sinks::syslog::error) << "invalid macro definition \"" << it._macro << "\": " << e.description();
+		}
+	}
+	return ctx;
+}
@@ -0,0 +1,173 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include "file_cache.h"
+
+#include <boost/wave.hpp>
+#include <boost/wave/preprocessing_hooks.hpp>
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../p4l/p4lex_iterator.h"
+#include "../p4l/p4lex_token.h"
+
+
+/**
+ * \brief preprocessing hooks resolving include directives through the File_cache
+ * \detail The search path signature distinguishes units compiled
+ * with different include options, so that the same directive can
+ * be resolved differently for each of them.  The hooks also record
+ * every opened file for the dependency graph.
+ */
+template <typename TokenT>
+class Include_hooks : public boost::wave::context_policies::eat_whitespace<TokenT> {
+public:
+	Include_hooks() = default;
+	explicit Include_hooks(const std::string& search_path_signature)
+		: _search_path_signature(search_path_signature)
+	{}
+
+	template <typename ContextT>
+	bool locate_include_file(ContextT& ctx, std::string& file_path, bool is_system, char const* current_name,
+							 std::string& dir_path, std::string& native_name)
+	{
+		std::string key(_search_path_signature);
+		key += '\n';
+		key += ctx.get_current_directory().string();
+		key += '\n';
+		key += is_system ? '<' : '"';
+		key += file_path;
+		if (current_name)
+		{
+			key += '\n';
+			key += current_name;
+		}
+		auto location = File_cache::get_instance().resolve_include(key, [&]() -> boost::optional<File_cache::Include_location> {
+			std::string found_path(file_path);
+			std::string found_dir;
+			if (!ctx.find_include_file(found_path, found_dir, is_system, current_name))
+			{
+				return boost::none;
+			}
+			auto native_path = boost::wave::util::create_path(found_path);
+			return File_cache::Include_location{found_path, found_dir, boost::wave::util::native_file_string(native_path)};
+		});
+		if (!location)
+		{
+			return false;
+		}
+		file_path = location->_file_path;
+		dir_path = location->_dir_path;
+		native_name = location->_native_name;
+		return true;
+	}
+
+	template <typename ContextT>
+	void opened_include_file(ContextT const&, std::string const&, std::string const& absname, bool)
+	{
+		_included_files.insert(boost::filesystem::absolute(absname).lexically_normal().string());
+	}
+
+	/// \brief every file opened by the preprocessor, directly or by nested includes
+	const std::set<std::string>& get_included_files() const
+	{
+		return _included_files;
+	}
+
+private:
+	std::string _search_path_signature;
+	std::set<std::string> _included_files;
+};
+
+/**
+ * \brief Wave input policy reading the included files through the File_cache
+ * \detail The token arenas load the sources of the tokens from the
+ * File_cache too, so that they refer to the text the preprocessor read
+ * instead of reading the file again.
+ */
+struct Load_file_from_cache {
+	template <typename IterContextT>
+	class inner {
+	public:
+		template <typename PositionT>
+		static void init_iterators(IterContextT& iter_ctx, PositionT const& act_pos, boost::wave::language_support language)
+		{
+			using iterator_type = typename IterContextT::iterator_type;
+			iter_ctx._text = File_cache::get_instance().load(iter_ctx.filename.c_str());
+			if (!iter_ctx._text)
+			{
+				BOOST_WAVE_THROW_CTX(iter_ctx.ctx, boost::wave::preprocess_exception, bad_include_file, iter_ctx.filename.c_str(), act_pos);
+				return;
+			}
+			// the lexer is instantiated for mutable iterators, it does not write through them
+			auto& text = const_cast<std::string&>(*iter_ctx._text);
+			iter_ctx.first = iterator_type(text.begin(), text.end(), PositionT(iter_ctx.filename), language);
+			iter_ctx.last = iterator_type();
+		}
+
+	private:
+		std::shared_ptr<const std::string> _text;
+	};
+};
+
+using P4_token = p4l::p4lex_token<>;
+using P4_lexer = p4l::p4lex_iterator<P4_token>;
+using P4_context = boost::wave::context<std::string::iterator,
+										P4_lexer,
+										Load_file_from_cache,
+										Include_hooks<P4_token>>;
+
+
+/**
+ * \brief a macro defined by -D or removed by -U
+ */
+struct Macro_option {
+	std::string _macro;  /// the definition, e.g. X=1, or the name of the removed macro
+	bool _undefine;
+};
+
+/**
+ * \brief preprocessor configuration derived from a command line
+ * \detail Parsed once for every distinct command line and shared by
+ * all units compiled with it.
+ */
+struct Preprocessor_settings {
+	std::string _signature;                   /// the command line the settings were derived from
+	std::vector<std::string> _quote_paths;    /// directories searched for "file" only, -iquote
+	std::vector<std::string> _include_paths;  /// directories searched for "file" and <file>, -I and -isystem
+	std::vector<Macro_option> _macros;        /// predefined macros, then the -D and -U options in command line order
+	boost::wave::language_support _language;
+};
+
+/**
+ * \brief creates Wave contexts configured for a command line
+ * \detail Wave contexts can be neither copied nor reset to the initial
+ * state, so a context is created for every compilation.  The work that
+ * does not depend on the source, i.e. parsing the command line and
+ * collecting the include paths, macros and language options, is done
+ * once per command line and cached.
+ */
+class Context_factory {
+public:
+	static Context_factory& get_instance();
+
+	std::shared_ptr<const Preprocessor_settings> get_settings(const std::vector<char*>& argv);
+	std::unique_ptr<P4_context> create(std::string::iterator first,
+									   std::string::iterator last,
+									   const std::string& file_name,
+									   const Preprocessor_settings& settings) const;
+
+private:
+	Context_factory();
+
+	std::mutex _mutex;
+	std::unordered_map<std::string, std::shared_ptr<const Preprocessor_settings>> _settings;
+};
@@ -276,9 +276,16 @@ bool set_params_from_json(const rapidjson::Value& json, Params_textDocument_didC
 	return result;
 }
 
-bool set_params_from_json(const rapidjson::Value&, Params_textDocument_didClose&)
+bool set_params_from_json(const rapidjson::Value& json, Params_textDocument_didClose& params)
 {
-	return true;
+	auto result = false;
+	BOOST_LOG(Protocol::_logger) << "processing params for method \"textDocument/didClose\"";
+	if (json.HasMember("textDocument"))
+	{
+		result = params._text_document.set(json["textDocument"]);
+	}
+	BOOST_LOG(Protocol::_logger) << "processed  params for method \"textDocument/didClose\" " << result;
+	return result;
 }
 
 bool set_params_from_json(const rapidjson::Value& json, Params_textDocument_didOpen& params)
@@ -351,8 +358,25 @@ bool set_params_from_json(const rapidjson::Value&, Params_workspace_didChangeCon
 	return true;
 }
 
-bool set_params_from_json(const rapidjson::Value&, Params_workspace_didChangeWatchedFiles&)
+bool set_params_from_json(const rapidjson::Value& json, Params_workspace_didChangeWatchedFiles& params)
 {
+	BOOST_LOG(Protocol::_logger) << "processing params for method \"workspace/didChangeWatchedFiles\"";
+	if (!json.HasMember("changes") || !json["changes"].IsArray())
+	{
+		return false;
+	}
+	for (auto& it : json["changes"].GetArray())
+	{
+		if (!it.IsObject() || !it.HasMember("uri") || !it["uri"].IsString() || !it.HasMember("type") || !it["type"].IsInt())
+		{
+			return false;
+		}
+		Params_workspace_didChangeWatchedFiles::File_event event;
+		event._uri.set_from_uri(it["uri"].GetString());
+		event._type = static_cast<FILE_CHANGE_TYPE>(it["type"].GetInt());
+		params._changes.push_back(std::move(event));
+	}
+	BOOST_LOG(Protocol::_logger) << "processed  params for method \"workspace/didChangeWatchedFiles\" " << params._changes.size() << " changes";
 	return true;
 }
 
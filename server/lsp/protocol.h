@@ -101,6 +101,8 @@ enum class TEXT_DOCUMENT_SYNC_KIND {
 	Incremental = 2 /// documents are synced by sending the full content on open; after that only incremental updates to the document are send
 };
 
+enum class FILE_CHANGE_TYPE { Created = 1, Changed = 2, Deleted = 3 };
+
 namespace
 {
 
@@ -229,8 +231,16 @@ struct URI {
 std::ostream& operator<<(std::ostream& os, const URI& item);
 
 struct Workspace_folder {
-	Workspace_folder(const rapidjson::Value&)
+	Workspace_folder(const rapidjson::Value& json)
 	{
+		if (json.HasMember("uri") && !json["uri"].IsNull())
+		{
+			_uri = json["uri"].GetString();
+		}
+		if (json.HasMember("name") && !json["name"].IsNull())
+		{
+			_name = json["name"].GetString();
+		}
 	}
 	std::string _uri;
 	std::string _name;
@@ -1364,6 +1374,7 @@ struct Params_textDocument_didChange {
 bool set_params_from_json(const rapidjson::Value& json, Params_textDocument_didChange& params);
 
 struct Params_textDocument_didClose {
+	Text_document_identifier _text_document;
 };
 
 bool set_params_from_json(const rapidjson::Value& json, Params_textDocument_didClose& params);
@@ -1418,6 +1429,11 @@ struct Params_workspace_didChangeConfiguration {
 bool set_params_from_json(const rapidjson::Value& json, Params_workspace_didChangeConfiguration& params);
 
 struct Params_workspace_didChangeWatchedFiles {
+	struct File_event {
+		URI _uri;              /// the file's URI
+		FILE_CHANGE_TYPE _type; /// the change type
+	};
+	std::vector<File_event> _changes; /// the actual file events
 };
 
 bool set_params_from_json(const rapidjson::Value& json, Params_workspace_didChangeWatchedFiles& params);
@@ -0,0 +1,103 @@
+#include "ast.h"
+
+#include <utility>
+
+namespace p4l {
+
+ast ast::link(std::vector<ast> parts)
+{
+	ast result;
+	std::size_t size = 1;
+	for (auto const& it : parts) {
+		size += it._nodes.size() - 1;
+	}
+	result._nodes.reserve(size);
+	result._nodes.push_back({node_kind::program, 0, none, 0, 0, none, none});
+	if (!parts.empty()) {
+		result._nodes[0].begin = parts.front()._nodes[0].begin;
+		result._nodes[0].end = parts.back()._nodes[0].end;
+	}
+	// the last declaration linked to the root so far
+	auto last = none;
+	for (auto const& part : parts) {
+		// the node 0 of the part is its root, the others follow the nodes before them
+		auto base = static_cast<std::uint32_t>(result._nodes.size()) - 1;
+		auto relocate = [base](std::uint32_t index) { return index == none ? none : index + base; };
+		for (std::size_t it = 1; it < part._nodes.size(); ++it) {
+			auto moved = part._nodes[it];
+			moved.first = relocate(moved.first);
+			moved.next = relocate(moved.next);
+			result._nodes.push_back(moved);
+		}
+		auto first = relocate(part._nodes[0].first);
+		if (first == none) {
+			continue;
+		}
+		if (last == none) {
+			result._nodes[0].first = first;
+		} else {
+			result._nodes[last].next = first;
+		}
+		last = first;
+		while (result._nodes[last].next != none) {
+			last = result._nodes[last].next;
+		}
+	}
+	return result;
+}
+
+ast ast::join(std::vector<subtree> const& parts, replacement_map const& replacements)
+{
+	ast result;
+	result._nodes.push_back({node_kind::program, 0, none, 0, 0, none, none});
+	// the copies whose children are not copied yet, with the subtrees they are copied from
+	std::vector<std::pair<std::uint32_t, subtree>> pending;
+	auto copy = [&](subtree from) {
+		auto found = replacements.find({from.tree, from.node});
+		if (found != replacements.end()) {
+			from = found->second;
+		}
+		auto move = [&from](std::uint32_t token) {
+			return token == none ? none : static_cast<std::uint32_t>(token + from.delta);
+		};
+		auto copied = from.tree->_nodes[from.node];
+		copied.token = move(copied.token);
+		copied.begin = move(copied.begin);
+		copied.end = move(copied.end);
+		copied.first = none;
+		copied.next = none;
+		result._nodes.push_back(copied);
+		auto added = static_cast<std::uint32_t>(result._nodes.size() - 1);
+		pending.emplace_back(added, from);
+		return added;
+	};
+	auto last = none;
+	for (auto const& part : parts) {
+		auto root = copy(part);
+		if (last == none) {
+			result._nodes[0].first = root;
+			result._nodes[0].begin = result._nodes[root].begin;
+		} else {
+			result._nodes[last].next = root;
+		}
+		result._nodes[0].end = result._nodes[root].end;
+		last = root;
+		while (!pending.empty()) {
+			auto [added, from] = pending.back();
+			pending.pop_back();
+			auto previous = none;
+			for (auto child = from.tree->_nodes[from.node].first; child != none; child = from.tree->_nodes[child].next) {
+				auto copied = copy({from.tree, child, from.delta});
+				if (previous == none) {
+					result._nodes[added].first = copied;
+				} else {
+					result._nodes[previous].next = copied;
+				}
+				previous = copied;
+			}
+		}
+	}
+	return result;
+}
+
+} // namespace p4l
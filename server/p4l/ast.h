@@ -4,78 +4,239 @@
 
 #pragma once
 
-#include <istream>
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <utility>
 #include <vector>
 
-#include "lexer.h"
-
 namespace p4l {
 
-class AST {
- public:
-	virtual ~AST() {}
-};
-
-class ExprAST : public AST {
- public:
-	virtual ~ExprAST() {}
+/**
+ * The kinds of the nodes of the syntax tree.  The comment of a kind
+ * lists the token of its nodes and their children in order, the
+ * annotations of a node, if it has any, are its first children.
+ */
+enum class node_kind : std::uint8_t {
+	// declarations
+	program,         // declarations
+	annotation,      // the name after @, its body is not parsed
+	constant,        // name: type, value
+	variable,        // name: type, optional value
+	instantiation,   // name: type, arguments, optional initializer block of declarations
+	header,          // name: optional type_parameters, fields
+	header_union,    // name: optional type_parameters, fields
+	struct_type,     // name: optional type_parameters, fields
+	field,           // name: type
+	enum_type,       // name: optional underlying type, members
+	error_type,      // error: members
+	match_kind_type, // match_kind: members
+	member,          // name: optional value
+	type_definition, // name, the flag is 1 for type and 0 for typedef: type
+	extern_type,     // name: optional type_parameters, methods
+	method,          // name, the flags are those of method_flag: optional return type, optional type_parameters, parameters
+	function,        // name: return type, optional type_parameters, parameters, block
+	action,          // name: parameters, block
+	parser_type,     // name: optional type_parameters, parameters
+	parser,          // name: optional type_parameters, parameters, optional constructor parameters, locals and states
+	state,           // name: block
+	value_set,       // name: type, size
+	control_type,    // name: optional type_parameters, parameters
+	control,         // name: optional type_parameters, parameters, optional constructor parameters, locals, block of apply
+	package_type,    // name: optional type_parameters, parameters
+	table,           // name: properties
+	property,        // name, the flag is 1 for const: value
+	key,             // key: key_elements
+	key_element,     // match kind: expression
+	action_list,     // actions: action_references
+	action_reference,// name: arguments
+	entries,         // entries, the flag is 1 for const: entries
+	entry,           // the colon: keyset, action_reference
+	type_parameters, // <: type_parameter
+	type_parameter,  // name
+	parameters,      // (, the flag is 1 for the constructor parameters: parameter
+	parameter,       // name, the flag is the direction: type, optional default value
+	// types
+	type_name,       // name, the flag is 1 if it starts with a dot
+	base_type,       // bool, error, int, bit, varbit, string, void or match_kind: optional width
+	specialized_type,// <: type_name, type_arguments
+	stack_type,      // [: element type, size
+	tuple_type,      // tuple or list: type_arguments
+	dontcare_type,   // _
+	type_arguments,  // <: types
+	// statements
+	block,           // {, the flag is unparsed_block if the body was skipped: statements and declarations
+	assignment,      // =: target, value
+	call_statement,  // the first token: call
+	if_statement,    // if: condition, statement, optional statement of else
+	switch_statement,// switch: expression, switch_cases
+	switch_case,     // the colon: label, optional block
+	exit_statement,  // exit
+	return_statement,// return: optional value
+	empty_statement, // ;
+	transition,      // transition: state name or select
+	select,          // select: select_expressions, select_cases
+	select_expressions, // (: expressions
+	select_case,     // the colon: keyset, state name
+	// expressions
+	number,          // the literal
+	string,          // the literal
+	boolean,         // true or false
+	name,            // name, the flag is 1 if it starts with a dot
+	this_expression, // this
+	dontcare,        // _
+	default_keyset,  // default
+	member_access,   // the member name: expression
+	index,           // [: expression, index
+	slice,           // [: expression, high bit, low bit
+	call,            // (: callee, optional type_arguments, arguments
+	named_argument,  // name: value
+	unary,           // the operator: operand
+	binary,          // the operator, the flag is 1 for the shift right of two >: left, right
+	ternary,         // ?: condition, true value, false value
+	cast,            // (: type, operand
+	list_expression, // {: expressions
+	struct_expression, // {: named_arguments
+	mask,            // &&&: value, mask
+	range,           // ..: low, high
+	keyset_tuple,    // (: keysets
 };
 
-class NumberExprAST : public ExprAST {
- public:
-	explicit NumberExprAST(int value) : value(value) {
-	}
+constexpr std::size_t node_kind_count = static_cast<std::size_t>(node_kind::keyset_tuple) + 1;
 
- private:
-	int value = 0;
-	int width = 32;
+enum method_flag : std::uint8_t {
+	abstract_method = 1,
+	constructor_method = 2,
 };
 
-class VariableExprAST : public ExprAST {
- public:
-	explicit VariableExprAST(const std::string& name) : name(name) {
-	}
-
- private:
-	std::string name;
+enum block_flag : std::uint8_t {
+	unparsed_block = 1,
 };
 
-class BinaryExprAST : public ExprAST {
- public:
-	BinaryExprAST(Token op, std::unique_ptr<ExprAST> lhs, std::unique_ptr<ExprAST> rhs)
-		: op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {
-	}
+enum direction : std::uint8_t {
+	no_direction = 0,
+	in_direction = 1,
+	out_direction = 2,
+	inout_direction = 3,
+};
 
- private:
-	Token op;
-	std::unique_ptr<ExprAST> lhs, rhs;
+/**
+ * node
+ *
+ *     A node of the syntax tree refers to the tokens it was parsed from
+ *     by their index in the token sequence given to the parser, and to
+ *     its first child and its next sibling by their index in the tree.
+ */
+struct node {
+	node_kind kind;
+	std::uint8_t flags;
+	std::uint32_t token; // the name of a declaration or the operator of an expression
+	std::uint32_t begin; // the first token of the node
+	std::uint32_t end;   // the token after the last token of the node
+	std::uint32_t first; // the first child
+	std::uint32_t next;  // the next sibling
 };
 
-class PrototypeAST : public AST {
+static_assert(sizeof(node) == 24, "node is expected to be 24 bytes");
+
+/**
+ * ast
+ *
+ *     The syntax tree of one version of a document.  The nodes are
+ *     allocated at the end of a single array, they refer to each other
+ *     with 32-bit indices, and the tree is freed all at once.  The root
+ *     is the node 0 of kind program.
+ */
+class ast {
  public:
-	PrototypeAST(const std::string& name, std::vector<std::string> args)
-		: name(name), args(std::move(args)) {
+	static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+	class iterator {
+	 public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::uint32_t;
+		using difference_type = std::ptrdiff_t;
+		using pointer = std::uint32_t const*;
+		using reference = std::uint32_t;
+
+		iterator(std::vector<node> const* nodes, std::uint32_t index) : _nodes(nodes), _index(index) {}
+		std::uint32_t operator*() const noexcept {
+			return _index;
+		}
+		iterator& operator++() noexcept {
+			_index = (*_nodes)[_index].next;
+			return *this;
+		}
+		bool operator==(iterator const& other) const noexcept {
+			return _index == other._index;
+		}
+		bool operator!=(iterator const& other) const noexcept {
+			return _index != other._index;
+		}
+
+	 private:
+		std::vector<node> const* _nodes;
+		std::uint32_t _index;
+	};
+
+	struct children_range {
+		iterator _begin;
+		iterator _end;
+		iterator begin() const noexcept {
+			return _begin;
+		}
+		iterator end() const noexcept {
+			return _end;
+		}
+	};
+
+	std::uint32_t get_root() const noexcept {
+		return 0;
 	}
-
-	const std::string& get_name() const {
-		return name;
+	std::size_t size() const noexcept {
+		return _nodes.size();
 	}
-
- private:
-	std::string name;
-	std::vector<std::string> args;
-};
-
-class FunctionAST : public AST {
- public:
-	FunctionAST(std::unique_ptr<PrototypeAST> proto, std::unique_ptr<ExprAST> body)
-		: proto(std::move(proto)), body(std::move(body)) {
+	bool empty() const noexcept {
+		return _nodes.empty();
+	}
+	node const& operator[](std::uint32_t index) const noexcept {
+		return _nodes[index];
+	}
+	/// \brief the children of the node in order, including its annotations
+	children_range get_children(std::uint32_t index) const noexcept {
+		return {iterator(&_nodes, _nodes[index].first), iterator(&_nodes, none)};
+	}
+	/// \brief a node of another tree with its descendants, the indices of their tokens are moved by delta
+	struct subtree {
+		ast const* tree;
+		std::uint32_t node;
+		std::int64_t delta;
+	};
+
+	/// \brief the trees of consecutive ranges of tokens as one, their nodes follow each other in order
+	static ast link(std::vector<ast> parts);
+	/// \brief the subtrees that replace nodes of other trees, by the tree and the index of the node
+	using replacement_map = std::map<std::pair<ast const*, std::uint32_t>, subtree>;
+
+	/// \brief a tree whose root has copies of the subtrees as its children, in order
+	/// \detail A node that has a replacement is copied from the subtree of the replacement instead.
+	static ast join(std::vector<subtree> const& parts, replacement_map const& replacements = {});
+
+	/// \brief the first child of the node that is not an annotation or none
+	std::uint32_t get_first_child(std::uint32_t index) const noexcept {
+		auto child = _nodes[index].first;
+		while (child != none && _nodes[child].kind == node_kind::annotation) {
+			child = _nodes[child].next;
+		}
+		return child;
 	}
 
  private:
-	std::unique_ptr<PrototypeAST> proto;
-	std::unique_ptr<ExprAST> body;
+	friend class Parser;
+
+	std::vector<node> _nodes;
 };
 
 } // namespace p4l
@@ -0,0 +1,79 @@
+#include "incremental_lexer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace p4l {
+
+incremental_lexer::incremental_lexer(std::string text)
+	: _text(std::move(text))
+	, _lines{{0, 0, line_state::normal}}
+{
+	// there are no old lines after the first one, so all of it is lexed
+	edit(0, 0, std::string_view());
+}
+
+incremental_lexer::change incremental_lexer::edit(std::size_t offset, std::size_t length, std::string_view text)
+{
+	// restart at the line the edit begins on, or where the string a line starts inside of begins
+	auto restart = std::distance(_lines.begin(),
+								 std::upper_bound(_lines.begin(), _lines.end(), offset,
+												  [](std::size_t position, line const& it) { return position < it.offset; })) - 1;
+	while (restart > 0 && _lines[restart].state == line_state::string) {
+		--restart;
+	}
+	auto const start = _lines[restart];
+	auto const delta = static_cast<std::ptrdiff_t>(text.size()) - static_cast<std::ptrdiff_t>(length);
+	auto const edit_end = offset + text.size();
+	_text.replace(offset, length, text);
+
+	std::vector<line_checkpoint> checkpoints;
+	std::vector<token> tokens;
+	std::vector<line> lines;
+	Lexer lexer(_text, start.offset, start.state, static_cast<int>(restart) + 1);
+	lexer.record_lines(&checkpoints);
+	auto synced = _lines.end(); // the first old line that starts the same after the edit
+	while (synced == _lines.end()) {
+		auto id = lexer.next();
+		// the lines reached while lexing the token start before it or inside of it
+		for (auto& it : checkpoints) {
+			if (it.offset >= edit_end && it.state != line_state::string) {
+				auto old_offset = static_cast<std::uint32_t>(it.offset - delta);
+				auto old = std::lower_bound(_lines.begin() + restart + 1, _lines.end(), old_offset,
+											[](line const& other, std::uint32_t position) { return other.offset < position; });
+				if (old != _lines.end() && old->offset == old_offset && old->state == it.state) {
+					synced = old;
+					break;
+				}
+			}
+			lines.push_back({it.offset, static_cast<std::uint32_t>(start.token + tokens.size()), it.state});
+		}
+		checkpoints.clear();
+		if (synced != _lines.end() || id == boost::wave::T_END) {
+			break;
+		}
+		tokens.push_back({id, static_cast<std::uint32_t>(lexer.get_offset()), static_cast<std::uint32_t>(lexer.get_length())});
+	}
+
+	auto first_line = static_cast<std::size_t>(restart) + 1;
+	auto last_line = static_cast<std::size_t>(std::distance(_lines.begin(), synced));
+	std::size_t first = start.token;
+	std::size_t last = synced == _lines.end() ? _tokens.size() : synced->token;
+	change result{first, last - first, tokens.size()};
+	auto moved = static_cast<std::ptrdiff_t>(result.inserted) - static_cast<std::ptrdiff_t>(result.erased);
+	for (auto it = _tokens.begin() + last; it != _tokens.end(); ++it) {
+		it->offset = static_cast<std::uint32_t>(it->offset + delta);
+	}
+	for (auto it = _lines.begin() + last_line; it != _lines.end(); ++it) {
+		it->offset = static_cast<std::uint32_t>(it->offset + delta);
+		it->token = static_cast<std::uint32_t>(it->token + moved);
+	}
+	_tokens.erase(_tokens.begin() + first, _tokens.begin() + last);
+	_tokens.insert(_tokens.begin() + first, tokens.begin(), tokens.end());
+	_lines.erase(_lines.begin() + first_line, _lines.begin() + last_line);
+	_lines.insert(_lines.begin() + first_line, lines.begin(), lines.end());
+	return result;
+}
+
+} // namespace p4l
@@ -0,0 +1,68 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexer.h"
+
+namespace p4l {
+
+/**
+ * incremental_lexer
+ *
+ *     Keeps the tokens of a document of p4l::Lexer together with the
+ *     state of the lexer at the start of each line.  An edit is relexed
+ *     from the start of the line it begins on.  Relexing stops at the
+ *     first line after the edit that starts in the same state as the
+ *     line it was before the edit, from there on the old tokens are
+ *     valid and are only moved.  The work is proportional to the size
+ *     of the edit, except when the edit changes the state of the lines
+ *     after it, e.g. by opening a block comment.
+ */
+class incremental_lexer {
+ public:
+	using token = lexed_token;
+
+	struct line {
+		std::uint32_t offset;
+		std::uint32_t token; // the first token that ends after the start of the line
+		line_state state;
+	};
+
+	/// \brief the tokens [first, first + erased) were replaced by [first, first + inserted)
+	struct change {
+		std::size_t first;
+		std::size_t erased;
+		std::size_t inserted;
+	};
+
+	incremental_lexer() : incremental_lexer(std::string()) {}
+	explicit incremental_lexer(std::string text);
+
+	/// \brief replace length bytes at offset with the text and relex as little as possible
+	change edit(std::size_t offset, std::size_t length, std::string_view text);
+
+	std::string const& get_text() const noexcept {
+		return _text;
+	}
+	std::vector<token> const& get_tokens() const noexcept {
+		return _tokens;
+	}
+	std::vector<line> const& get_lines() const noexcept {
+		return _lines;
+	}
+
+ private:
+	std::string _text;
+	std::vector<token> _tokens;
+	std::vector<line> _lines;
+};
+
+} // namespace p4l
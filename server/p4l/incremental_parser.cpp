@@ -0,0 +1,411 @@
+#include "incremental_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+namespace p4l {
+
+namespace {
+
+/// \brief the tokens of p4l::Lexer with the text they are in
+struct lexed_source {
+	std::vector<lexed_token> const& tokens;
+	std::string_view text;
+
+	std::size_t size() const noexcept {
+		return tokens.size();
+	}
+	int get_id(std::size_t index) const noexcept {
+		return tokens[index].id;
+	}
+	std::string_view get_text(std::size_t index) const noexcept {
+		return text.substr(tokens[index].offset, tokens[index].length);
+	}
+	// as the parser finds it
+	bool is_joined(std::size_t index) const noexcept {
+		return index + 1 != tokens.size() && tokens[index].offset + tokens[index].length == tokens[index + 1].offset;
+	}
+};
+
+/// \brief the preprocessed tokens of a compilation
+struct arena_source {
+	token_arena const& tokens;
+
+	std::size_t size() const noexcept {
+		return tokens.size();
+	}
+	int get_id(std::size_t index) const {
+		return tokens.get_id(tokens[index]);
+	}
+	std::string_view get_text(std::size_t index) const {
+		return tokens.get_text(tokens[index]);
+	}
+	bool is_joined(std::size_t index) const noexcept {
+		return index + 1 != tokens.size() && tokens[index]._file == tokens[index + 1]._file
+			&& tokens[index]._offset + tokens[index]._length == tokens[index + 1]._offset;
+	}
+};
+
+// each token is its id, its length shifted left with the joined flag in the low bit, and its text
+constexpr std::size_t TOKEN_HEADER_SIZE = 2 * sizeof(std::uint32_t);
+
+template <typename Source>
+void get_header(Source const& source, std::size_t index, std::size_t length, char* header)
+{
+	std::uint32_t values[] = {static_cast<std::uint32_t>(source.get_id(index)),
+							  static_cast<std::uint32_t>(length << 1 | source.is_joined(index))};
+	std::memcpy(header, values, TOKEN_HEADER_SIZE);
+}
+
+/// \brief the ids and the text of the tokens, the offsets change when the text before the tokens does
+template <typename Source>
+std::string get_tokens(Source const& source, std::size_t first, std::size_t last)
+{
+	std::string result;
+	char header[TOKEN_HEADER_SIZE];
+	for (auto it = first; it != last; ++it) {
+		auto text = source.get_text(it);
+		get_header(source, it, text.size(), header);
+		result.append(header, TOKEN_HEADER_SIZE);
+		result.append(text);
+	}
+	return result;
+}
+
+/// \brief the tokens from first on are those of get_tokens
+template <typename Source>
+bool has_tokens(Source const& source, std::size_t first, std::string const& tokens)
+{
+	char header[TOKEN_HEADER_SIZE];
+	std::size_t position = 0;
+	for (auto it = first; position != tokens.size(); ++it) {
+		if (it >= source.size()) {
+			return false;
+		}
+		auto text = source.get_text(it);
+		get_header(source, it, text.size(), header);
+		if (tokens.size() - position < TOKEN_HEADER_SIZE + text.size()
+			|| std::memcmp(tokens.data() + position, header, TOKEN_HEADER_SIZE) != 0
+			|| tokens.compare(position + TOKEN_HEADER_SIZE, text.size(), text) != 0) {
+			return false;
+		}
+		position += TOKEN_HEADER_SIZE + text.size();
+	}
+	return true;
+}
+
+std::uint64_t hash_tokens(std::string const& tokens)
+{
+	// FNV-1a
+	std::uint64_t hash = 0xcbf29ce484222325ULL;
+	for (auto c : tokens) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template <typename Tokens>
+std::shared_ptr<incremental_parser::body const> parse_body(Tokens const& tokens,
+														   incremental_parser::declaration const& parsed,
+														   std::uint32_t block)
+{
+	for (auto const& it : *parsed.bodies) {
+		if (it->block == block) {
+			return it;
+		}
+	}
+	auto const& node = (*parsed.tree)[block];
+	auto begin = parsed.get_token(node.begin);
+	Parser parser(tokens, begin, parsed.get_token(node.end));
+	auto result = std::make_shared<incremental_parser::body>();
+	result->block = block;
+	result->origin = parsed.begin;
+	result->tree = std::make_shared<ast const>(parser.run_body());
+	for (auto const& it : parser.get_errors()) {
+		result->errors.push_back({it.token - parsed.begin, it.message});
+	}
+	parsed.bodies->push_back(result);
+	return result;
+}
+
+} // namespace
+
+incremental_parser::incremental_parser(std::vector<lexed_token> const& tokens, std::string_view text, parse_mode mode)
+	: _mode(mode)
+{
+	std::vector<declaration> old;
+	parse(lexed_source{tokens, text}, old, 0, 0, 0);
+}
+
+incremental_parser::incremental_parser(token_arena const& tokens, parse_mode mode)
+	: _mode(mode)
+{
+	std::vector<declaration> old;
+	parse(arena_source{tokens}, old, 0, 0, 0);
+}
+
+incremental_parser::incremental_parser(token_arena const& tokens, parse_result parsed, parse_mode mode)
+	: _mode(mode)
+{
+	arena_source source{tokens};
+	std::vector<declaration> old;
+	// the errors are not told apart by declaration
+	if (!parsed.errors.empty()) {
+		parse(source, old, 0, 0, 0);
+		return;
+	}
+	auto tree = std::make_shared<ast const>(std::move(parsed.tree));
+	auto children = tree->get_children(tree->get_root());
+	for (auto it = children.begin(); it != children.end();) {
+		auto node = *it;
+		auto begin = (*tree)[node].begin;
+		auto end = ++it == children.end() ? static_cast<std::uint32_t>(tokens.size()) : (*tree)[*it].begin;
+		auto key = std::make_shared<std::string const>(get_tokens(source, begin, end));
+		_declarations.push_back({tree, node, begin, end, hash_tokens(*key), key, {},
+								 std::make_shared<std::vector<std::shared_ptr<body const>>>()});
+	}
+	_size = tokens.size();
+}
+
+std::size_t incremental_parser::update(std::vector<lexed_token> const& tokens, std::string_view text,
+									   incremental_lexer::change const& change)
+{
+	return apply(lexed_source{tokens, text}, change);
+}
+
+std::size_t incremental_parser::update(token_arena const& tokens)
+{
+	arena_source source{tokens};
+	// the declarations at the start whose tokens are the same
+	std::size_t first = 0;
+	while (first != _declarations.size() && has_tokens(source, _declarations[first].begin, *_declarations[first].tokens)) {
+		++first;
+	}
+	std::size_t begin = first == 0 ? 0 : _declarations[first - 1].end;
+	// and those at the end, moved by as many tokens as were added
+	auto delta = static_cast<std::ptrdiff_t>(tokens.size()) - static_cast<std::ptrdiff_t>(_size);
+	auto last = _declarations.size();
+	while (last != first) {
+		auto moved = static_cast<std::ptrdiff_t>(_declarations[last - 1].begin) + delta;
+		if (moved < static_cast<std::ptrdiff_t>(begin) || !has_tokens(source, moved, *_declarations[last - 1].tokens)) {
+			break;
+		}
+		--last;
+	}
+	std::size_t end = last == _declarations.size() ? _size : _declarations[last].begin;
+	return apply(source, {begin, end - begin, static_cast<std::size_t>(static_cast<std::ptrdiff_t>(end) + delta) - begin});
+}
+
+template <typename Source>
+std::size_t incremental_parser::apply(Source const& source, incremental_lexer::change const& change)
+{
+	auto old = std::move(_declarations);
+	_declarations.clear();
+	auto delta = static_cast<std::ptrdiff_t>(change.inserted) - static_cast<std::ptrdiff_t>(change.erased);
+	// keep the declarations before the change, after a syntax error the parser may have looked further
+	std::size_t kept = 0;
+	while (kept != old.size()) {
+		auto margin = old[kept].node == ast::none ? Parser::look_ahead : 0;
+		if (old[kept].end + margin > change.first) {
+			break;
+		}
+		++kept;
+	}
+	_declarations.insert(_declarations.end(), std::make_move_iterator(old.begin()),
+						 std::make_move_iterator(old.begin() + kept));
+	// the old declarations starting after the change are the same tokens moved by delta
+	auto after = change.first + change.erased;
+	auto stop = static_cast<std::size_t>(std::distance(
+		old.begin(), std::find_if(old.begin() + kept, old.end(), [after](declaration const& it) { return it.begin >= after; })));
+	return parse(source, old, kept, stop, delta);
+}
+
+template <typename Source>
+std::size_t incremental_parser::parse(Source const& source, std::vector<declaration>& old, std::size_t kept,
+									  std::size_t stop, std::ptrdiff_t delta)
+{
+	struct step {
+		std::uint32_t node;
+		std::uint32_t begin;
+		std::uint32_t end;
+		std::size_t errors; // the errors of the parser before the step
+	};
+	auto first = _declarations.empty() ? 0 : _declarations.back().end;
+	// parse up to the start of an old declaration, and twice as many more each time the parser does not get to one
+	for (std::size_t count = 0;; count = count * 2 + 1) {
+		auto limit = stop + count;
+		auto last = limit < old.size() ? static_cast<std::size_t>(old[limit].begin + delta) : source.size();
+		Parser parser(source.tokens, first, last, _mode);
+		std::vector<step> steps;
+		auto next = stop;
+		auto synced = false;
+		while (!parser.at_end()) {
+			auto begin = parser.get_position();
+			auto errors = parser.get_errors().size();
+			auto node = parser.parse_next();
+			auto end = parser.get_position();
+			steps.push_back({node, begin, end, errors});
+			if (node == ast::none) {
+				continue;
+			}
+			while (next != old.size() && old[next].begin + delta < end) {
+				++next;
+			}
+			if (next != old.size() && old[next].begin + delta == end) {
+				synced = true;
+				break;
+			}
+		}
+		if (!synced) {
+			if (last != source.size()) {
+				continue;
+			}
+			next = old.size();
+		}
+
+		// the trees of the replaced declarations are kept if their tokens did not change
+		std::unordered_multimap<std::uint64_t, std::size_t> replaced;
+		for (auto it = kept; it != next; ++it) {
+			if (old[it].node != ast::none) {
+				replaced.emplace(old[it].hash, it);
+			}
+		}
+		auto find_replaced = [&](declaration const& parsed) {
+			auto range = replaced.equal_range(parsed.hash);
+			for (auto found = range.first; found != range.second; ++found) {
+				// the hashes of different tokens may be equal
+				if (*old[found->second].tokens == *parsed.tokens) {
+					return found->second;
+				}
+			}
+			return old.size();
+		};
+		auto errors = parser.get_errors();
+		auto tree = std::make_shared<ast const>(parser.release());
+		for (std::size_t it = 0; it != steps.size(); ++it) {
+			auto const& s = steps[it];
+			auto key = std::make_shared<std::string const>(get_tokens(source, s.begin, s.end));
+			declaration parsed{tree, s.node, s.begin, s.end, hash_tokens(*key), key, {}, nullptr};
+			auto found = s.node == ast::none ? old.size() : find_replaced(parsed);
+			if (found != old.size()) {
+				parsed.tree = old[found].tree;
+				parsed.node = old[found].node;
+				parsed.bodies = old[found].bodies;
+			} else {
+				parsed.bodies = std::make_shared<std::vector<std::shared_ptr<body const>>>();
+			}
+			auto errors_end = it + 1 == steps.size() ? errors.size() : steps[it + 1].errors;
+			for (auto error = s.errors; error != errors_end; ++error) {
+				parsed.errors.push_back({errors[error].token - s.begin, errors[error].message});
+			}
+			_declarations.push_back(std::move(parsed));
+		}
+		for (auto it = next; it != old.size(); ++it) {
+			old[it].begin += delta;
+			old[it].end += delta;
+			_declarations.push_back(std::move(old[it]));
+		}
+		_size = source.size();
+		return steps.size();
+	}
+}
+
+std::shared_ptr<incremental_parser::body const> incremental_parser::get_body(std::vector<lexed_token> const& tokens,
+																			declaration const& parsed,
+																			std::uint32_t block) const
+{
+	return parse_body(tokens, parsed, block);
+}
+
+std::shared_ptr<incremental_parser::body const> incremental_parser::get_body(token_arena const& tokens,
+																			declaration const& parsed,
+																			std::uint32_t block) const
+{
+	return parse_body(tokens, parsed, block);
+}
+
+std::shared_ptr<incremental_parser::body const> incremental_parser::find_body(std::vector<lexed_token> const& tokens,
+																			 std::uint32_t token) const
+{
+	return find_unparsed(tokens, token);
+}
+
+std::shared_ptr<incremental_parser::body const> incremental_parser::find_body(token_arena const& tokens,
+																			 std::uint32_t token) const
+{
+	return find_unparsed(tokens, token);
+}
+
+template <typename Tokens>
+std::shared_ptr<incremental_parser::body const> incremental_parser::find_unparsed(Tokens const& tokens,
+																				  std::uint32_t token) const
+{
+	auto found = std::upper_bound(_declarations.begin(), _declarations.end(), token,
+								  [](std::uint32_t position, declaration const& it) { return position < it.begin; });
+	if (found == _declarations.begin()) {
+		return nullptr;
+	}
+	auto const& parsed = *std::prev(found);
+	if (parsed.node == ast::none || token >= parsed.end) {
+		return nullptr;
+	}
+	// go down the children the token is in to the unparsed block
+	auto const& tree = *parsed.tree;
+	auto node = parsed.node;
+	while (node != ast::none) {
+		if (tree[node].kind == node_kind::block && tree[node].flags == unparsed_block) {
+			return parse_body(tokens, parsed, node);
+		}
+		auto next = ast::none;
+		for (auto child : tree.get_children(node)) {
+			if (parsed.get_token(tree[child].begin) <= token && token < parsed.get_token(tree[child].end)) {
+				next = child;
+				break;
+			}
+		}
+		node = next;
+	}
+	return nullptr;
+}
+
+std::size_t incremental_parser::get_error_count() const noexcept
+{
+	std::size_t count = 0;
+	for (auto const& it : _declarations) {
+		count += it.errors.size();
+	}
+	return count;
+}
+
+std::size_t incremental_parser::get_body_count() const noexcept
+{
+	std::size_t count = 0;
+	for (auto const& it : _declarations) {
+		count += it.bodies->size();
+	}
+	return count;
+}
+
+ast incremental_parser::get_tree() const
+{
+	std::vector<ast::subtree> parts;
+	ast::replacement_map bodies;
+	parts.reserve(_declarations.size());
+	for (auto const& it : _declarations) {
+		if (it.node == ast::none) {
+			continue;
+		}
+		parts.push_back({it.tree.get(), it.node, static_cast<std::int64_t>(it.begin) - (*it.tree)[it.node].begin});
+		for (auto const& body : *it.bodies) {
+			auto const& tree = *body->tree;
+			bodies[{it.tree.get(), body->block}] = {&tree, tree.get_first_child(tree.get_root()),
+													  static_cast<std::int64_t>(it.begin) - body->origin};
+		}
+	}
+	return ast::join(parts, bodies);
+}
+
+} // namespace p4l
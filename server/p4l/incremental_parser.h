@@ -0,0 +1,118 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.h"
+#include "incremental_lexer.h"
+#include "parallel_parser.h"
+#include "parser.h"
+#include "token_arena.h"
+
+namespace p4l {
+
+/**
+ * incremental_parser
+ *
+ *     Keeps the top-level declarations of a document of p4l::Lexer or
+ *     of a compilation in a token_arena, each with its token span, its
+ *     tokens and their hash, and the tree it was parsed into.  On an edit the declarations the changed tokens
+ *     overlap are reparsed, starting at the first of them and stopping
+ *     at the first old declaration after the change that the parser
+ *     reaches the start of.  The declarations before and after are
+ *     kept, they share their trees with the previous version and only
+ *     their token spans are moved.  The parser decides the same for a
+ *     declaration wherever it starts, except after a syntax error, so
+ *     the declarations are the ones parsing the whole document gives.
+ *     The tokens of a compilation are preprocessed again as a whole,
+ *     the change is the span between the declarations whose tokens are
+ *     the same at its start and, moved, at its end.
+ *
+ *     In the signatures mode the bodies of the declarations are left
+ *     unparsed.  A body is parsed the first time it is asked for and
+ *     kept with the declaration until the declaration changes.
+ */
+class incremental_parser {
+ public:
+	struct body {
+		std::uint32_t block;             // the unparsed block in the tree of the declaration
+		std::uint32_t origin;            // the first token of the declaration when the body was parsed
+		std::shared_ptr<ast const> tree; // the block is the child of the root
+		std::vector<parse_error> errors; // the tokens are relative to origin
+	};
+
+	struct declaration {
+		std::shared_ptr<ast const> tree; // shared with the declarations parsed along with it
+		std::uint32_t node;              // in the tree, it is none if the declaration has errors
+		std::uint32_t begin;             // the first token
+		std::uint32_t end;               // the token after the last one
+		std::uint64_t hash;              // of the ids and the text of the tokens
+		std::shared_ptr<std::string const> tokens; // their ids and text, shared with the versions it is kept in
+		std::vector<parse_error> errors; // the tokens are relative to begin
+		std::shared_ptr<std::vector<std::shared_ptr<body const>>> bodies; // parsed so far, kept along with the tree
+
+		/// \brief the index in the current tokens of a token of the tree
+		std::uint32_t get_token(std::uint32_t token) const noexcept {
+			return token == ast::none ? token : token - (*tree)[node].begin + begin;
+		}
+		/// \brief the index in the current tokens of a token of the tree of the body
+		std::uint32_t get_token(body const& parsed, std::uint32_t token) const noexcept {
+			return token == ast::none ? token : token - parsed.origin + begin;
+		}
+	};
+
+	incremental_parser() = default;
+	explicit incremental_parser(parse_mode mode) : _mode(mode) {}
+	incremental_parser(std::vector<lexed_token> const& tokens, std::string_view text, parse_mode mode = parse_mode::full);
+	incremental_parser(token_arena const& tokens, parse_mode mode = parse_mode::full);
+	/// \brief the declarations of a parse of all of the tokens, e.g. by parse_parallel, they are parsed again if it has errors
+	incremental_parser(token_arena const& tokens, parse_result parsed, parse_mode mode = parse_mode::full);
+
+	/// \brief reparse the declarations the change of the tokens overlaps, returns how many were parsed
+	std::size_t update(std::vector<lexed_token> const& tokens, std::string_view text, incremental_lexer::change const& change);
+	/// \brief reparse the declarations whose tokens are not those of the last version, returns how many were parsed
+	std::size_t update(token_arena const& tokens);
+
+	std::vector<declaration> const& get_declarations() const noexcept {
+		return _declarations;
+	}
+	std::size_t get_error_count() const noexcept;
+	/// \brief the number of bodies parsed of the declarations
+	std::size_t get_body_count() const noexcept;
+	/// \brief the trees of the declarations without errors as one, with the bodies parsed so far in place of
+	///        their unparsed blocks, its nodes refer to the current tokens
+	ast get_tree() const;
+
+	/// \brief the body of the unparsed block of the declaration, it is parsed the first time
+	std::shared_ptr<body const> get_body(std::vector<lexed_token> const& tokens, declaration const& parsed,
+										 std::uint32_t block) const;
+	std::shared_ptr<body const> get_body(token_arena const& tokens, declaration const& parsed, std::uint32_t block) const;
+	/// \brief the unparsed body the token is in, or null if it is in none
+	std::shared_ptr<body const> find_body(std::vector<lexed_token> const& tokens, std::uint32_t token) const;
+	std::shared_ptr<body const> find_body(token_arena const& tokens, std::uint32_t token) const;
+
+ private:
+	template <typename Source>
+	std::size_t apply(Source const& source, incremental_lexer::change const& change);
+	/// \brief parse after the kept declarations until the parser reaches the start of an old one at or after stop
+	template <typename Source>
+	std::size_t parse(Source const& source, std::vector<declaration>& old, std::size_t kept, std::size_t stop,
+					  std::ptrdiff_t delta);
+	template <typename Tokens>
+	std::shared_ptr<body const> find_unparsed(Tokens const& tokens, std::uint32_t token) const;
+
+	parse_mode _mode = parse_mode::full;
+	std::vector<declaration> _declarations;
+	// the number of tokens of the last version
+	std::size_t _size = 0;
+};
+
+} // namespace p4l
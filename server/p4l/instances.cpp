@@ -5,6 +5,7 @@
 #include <boost/wave/grammars/cpp_grammar.hpp>
 #include <boost/wave/grammars/cpp_intlit_grammar.hpp>
 #include <boost/wave/grammars/cpp_literal_grammar_gen.hpp>
+#include <boost/wave/grammars/cpp_predef_macros_grammar.hpp>
 
 #include <list>
 
@@ -35,6 +36,13 @@ template struct boost::wave::grammars::defined_grammar_gen<lexer_type>;
  * (see wave/grammars/cpp_expression_grammar.hpp)
  */
 template struct boost::wave::grammars::expression_grammar_gen<token_type>;
+/**
+ * Explicit instantiation of the predefined_macros_grammar_gen template
+ * with the correct token type. This instantiates the corresponding
+ * parse function used for the macros defined on the command line (see
+ * wave/grammars/cpp_predef_macros_grammar.hpp)
+ */
+template struct boost::wave::grammars::predefined_macros_grammar_gen<lexer_type>;
 /**
  * Explicit instantiation of the intlit_grammar_gen, chlit_grammar_gen
  * and floatlit_grammar_gen templates with the correct token
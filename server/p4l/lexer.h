@@ -9,17 +9,20 @@
 #include <boost/config.hpp>
 #include <boost/throw_exception.hpp>
 
+// Wave defines BOOST_SPIRIT_THREADSAFE, which changes the layout of the
+// Spirit grammars.  It has to be seen before any Spirit header, or the
+// lexer grammar differs between the translation units.
+#include <boost/wave/wave_config.hpp>
+
 #include <boost/spirit/include/classic_core.hpp>
 #include <boost/spirit/include/classic_symbols.hpp>
 #include <boost/spirit/include/classic_chset.hpp>
 #include <boost/spirit/include/classic_escape_char.hpp>
 
 #include <boost/wave.hpp>
-#include <boost/wave/wave_config.hpp>
 #include <boost/wave/language_support.hpp>
 #include <boost/wave/token_ids.hpp>
 #include <boost/wave/util/file_position.hpp>
-#include <boost/wave/util/time_conversion_helper.hpp>
 #include <boost/wave/cpplexer/validate_universal_char.hpp>
 #include <boost/wave/cpplexer/convert_trigraphs.hpp>
 #include <boost/wave/cpplexer/cpplexer_exceptions.hpp>
@@ -28,6 +31,7 @@
 #endif
 #include <boost/wave/cpplexer/cpp_lex_interface.hpp>
 
+#include <cstdint>
 #include <set>
 #include <map>
 #include <memory> // for auto_ptr/unique_ptr
@@ -37,10 +41,12 @@
 #include <iostream>
 #include <istream>
 #include <string>
-#include <fstream>
+#include <string_view>
 #include <boost/assert.hpp>
 #include <boost/limits.hpp>
 
+#include "lexer_tables.h"
+#include "number.h"
 #include "p4lex_interface.h"
 #include "p4lex_token.h"
 #include "p4lex_iterator.h"
@@ -53,88 +59,249 @@
 
 namespace boost::wave {
 
+/**
+ * The tokens of P4-16.  The tokens P4 has in common with C are Wave's
+ * tokens, the preprocessor evaluates them in conditional directives.
+ * The keywords and operators only P4 has get ids after the ones Wave
+ * uses internally, in the categories of Wave's keywords and operators
+ * so that Wave expands them as macro names like any other keyword.
+ */
 enum {
 				  T_END              =  -1,  // end of input
-  // KEYWORDS
 				  T_PRAGMA           =  -2,  // @pragma
 				  T_END_PRAGMA       =  -3,  // end of pragma
-				  T_ABSTRACT         =  -4,  // "abstract"
-				  T_ACTION           =  -5,  // "action"
-				  T_ACTIONS          =  -6,  // "actions"
-				  T_APPLY            =  -7,  // "apply"
-				  T_BIT              =  -9,  // "bit"
-				  T_CONTROL          = -11,  // "control"
-				  T_ENTRIES          = -14,  // "entries"
-				  T_ERROR            = -16,  // "error"
-				  T_EXIT             = -17,  // "exit"
-				  T_HEADER           = -20,  // "header"
-				  T_HEADER_UNION     = -21,  // "header_union"
-				  T_IN               = -23,  // "in"
-				  T_INOUT            = -24,  // "inout"
-				  T_KEY              = -26,  // "key"
-				  T_MATCH_KIND       = -27,  // "match_kind"
-				  T_TYPE             = -28,  // "type"
-				  T_OUT              = -29,  // "out"
-				  T_PARSER           = -30,  // "parser"
-				  T_PACKAGE          = -31,  // "package"
-				  T_SELECT           = -33,  // "select"
-				  T_STATE            = -34,  // "state"
-				  T_TABLE            = -37,  // "table"
-				  T_TRANSITION       = -39,  // "transition"
-				  T_TUPLE            = -41,  // "tuple"
-				  T_VARBIT           = -43,  // "varbit"
-				  T_VALUE_SET        = -44,  // "value_set"
-				  T_DONTCARE         = -46,  // "_"
-  // PRIMARY
 				  T_TYPE_IDENTIFIER  = -48,  //
-				  T_NUMBER           = -49,  // 0[xX][0-9a-fA-F_] | 0[dD][0-9_]+ |
+				  T_START            = -88,  // a token before input
+				  T_P4_FIRST_TOKEN   = T_LAST_TOKEN + 16,
+  // KEYWORDS
+				  T_ABSTRACT         = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  0, KeywordTokenType),  // "abstract"
+				  T_ACTION           = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  1, KeywordTokenType),  // "action"
+				  T_ACTIONS          = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  2, KeywordTokenType),  // "actions"
+				  T_APPLY            = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  3, KeywordTokenType),  // "apply"
+				  T_BIT              = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  4, KeywordTokenType),  // "bit"
+				  T_CONTROL          = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  5, KeywordTokenType),  // "control"
+				  T_ENTRIES          = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  6, KeywordTokenType),  // "entries"
+				  T_ERROR            = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  7, KeywordTokenType),  // "error"
+				  T_EXIT             = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  8, KeywordTokenType),  // "exit"
+				  T_HEADER           = TOKEN_FROM_ID(T_P4_FIRST_TOKEN +  9, KeywordTokenType),  // "header"
+				  T_HEADER_UNION     = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 10, KeywordTokenType),  // "header_union"
+				  T_IN               = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 11, KeywordTokenType),  // "in"
+				  T_INOUT            = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 12, KeywordTokenType),  // "inout"
+				  T_KEY              = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 13, KeywordTokenType),  // "key"
+				  T_LIST             = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 14, KeywordTokenType),  // "list"
+				  T_MATCH_KIND       = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 15, KeywordTokenType),  // "match_kind"
+				  T_TYPE             = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 16, KeywordTokenType),  // "type"
+				  T_OUT              = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 17, KeywordTokenType),  // "out"
+				  T_PARSER           = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 18, KeywordTokenType),  // "parser"
+				  T_PACKAGE          = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 19, KeywordTokenType),  // "package"
+				  T_PRIORITY         = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 20, KeywordTokenType),  // "priority"
+				  T_SELECT           = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 21, KeywordTokenType),  // "select"
+				  T_STATE            = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 22, KeywordTokenType),  // "state"
+				  T_STRING           = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 23, KeywordTokenType),  // "string"
+				  T_TABLE            = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 24, KeywordTokenType),  // "table"
+				  T_TRANSITION       = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 25, KeywordTokenType),  // "transition"
+				  T_TUPLE            = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 26, KeywordTokenType),  // "tuple"
+				  T_VARBIT           = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 27, KeywordTokenType),  // "varbit"
+				  T_VALUE_SET        = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 28, KeywordTokenType),  // "value_set"
+				  T_DONTCARE         = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 29, KeywordTokenType),  // "_"
+  // PRIMARY
+				  T_NUMBER           = T_INTLIT,      // ([0-9]+[ws])?(0[xX][0-9a-fA-F_]+ | 0[oO][0-7_]+ | 0[dD][0-9_]+ | 0[bB][01_]+ | [0-9][0-9_]*)
+				  T_STRING_LITERAL   = T_STRINGLIT,   // ""
   // OPERATORS
-				  T_MASK             = -50,  // "&&&
-				  T_RANGE            = -51,  // ".."
-				  T_SHL              = -52,  // "<<"
-				  T_EQ               = -55,  // "=="
-				  T_NE               = -56,  // "!="
-				  T_GE               = -57,  // ">="
-				  T_LE               = -58,  // "<="
-				  T_PP               = -59,  // "++"
-				  T_PLUS_SAT         = -61,  // "|+|"
-				  T_MINUS_SAT        = -63,  // "|-|"
-				  T_MUL              = -64,  // "*"
-				  T_DIV              = -65,  // "/"
-				  T_MOD              = -66,  // "%"
-				  T_BIT_OR           = -67,  // "|"
-				  T_BIT_AND          = -68,  // "&"
-				  T_BIT_XOR          = -69,  // "^"
-				  T_COMPLEMENT       = -70,  // "~"
-				  T_L_PAREN          = -71,  // "("
-				  T_R_PAREN          = -72,  // ")"
-				  T_L_BRACKET        = -73,  // "["
-				  T_R_BRACKET        = -74,  // "]"
-				  T_L_BRACE          = -75,  // "{"
-				  T_R_BRACE          = -76,  // "}"
-				  T_L_ANGLE          = -77,  // "<"
-				  T_R_ANGLE          = -78,  // ">"
-				  T_QUESTION         = -82,  // "?"
-				  T_AT               = -86,  // "@"
-				  T_STRING_LITERAL   = -87,  // ""
-				  T_START            = -88   // a token before input
+				  T_MASK             = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 40, OperatorTokenType),  // "&&&"
+				  T_RANGE            = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 41, OperatorTokenType),  // ".."
+				  T_PLUS_SAT         = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 42, OperatorTokenType),  // "|+|"
+				  T_MINUS_SAT        = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 43, OperatorTokenType),  // "|-|"
+				  T_AT               = TOKEN_FROM_ID(T_P4_FIRST_TOKEN + 44, OperatorTokenType),  // "@"
+				  T_SHL              = T_SHIFTLEFT,     // "<<"
+				  T_EQ               = T_EQUAL,         // "=="
+				  T_NE               = T_NOTEQUAL,      // "!="
+				  T_GE               = T_GREATEREQUAL,  // ">="
+				  T_LE               = T_LESSEQUAL,     // "<="
+				  T_PP               = T_PLUSPLUS,      // "++"
+				  T_MUL              = T_STAR,          // "*"
+				  T_DIV              = T_DIVIDE,        // "/"
+				  T_MOD              = T_PERCENT,       // "%"
+				  T_BIT_OR           = T_OR,            // "|"
+				  T_BIT_AND          = T_AND,           // "&"
+				  T_BIT_XOR          = T_XOR,           // "^"
+				  T_COMPLEMENT       = T_COMPL,         // "~"
+				  T_L_PAREN          = T_LEFTPAREN,     // "("
+				  T_R_PAREN          = T_RIGHTPAREN,    // ")"
+				  T_L_BRACKET        = T_LEFTBRACKET,   // "["
+				  T_R_BRACKET        = T_RIGHTBRACKET,  // "]"
+				  T_L_BRACE          = T_LEFTBRACE,     // "{"
+				  T_R_BRACE          = T_RIGHTBRACE,    // "}"
+				  T_L_ANGLE          = T_LESS,          // "<"
+				  T_R_ANGLE          = T_GREATER,       // ">"
+				  T_QUESTION         = T_QUESTION_MARK  // "?"
 };
 
 }  // namespace boost::wave
 
 namespace p4l {
 
+/**
+ * The keywords of P4-16 are found with a perfect hash of the length and
+ * the first, second and last characters of an identifier, so that an
+ * identifier is compared to one keyword at most.  Both p4l::Lexer and
+ * the slex lexer, which lexes keywords as identifiers, classify the
+ * identifiers with it.
+ */
+struct keyword {
+	std::string_view text;
+	int token;
+};
+
+inline constexpr keyword keywords[] = {
+	{"abstract", boost::wave::T_ABSTRACT},
+	{"action", boost::wave::T_ACTION},
+	{"actions", boost::wave::T_ACTIONS},
+	{"apply", boost::wave::T_APPLY},
+	{"bit", boost::wave::T_BIT},
+	{"bool", boost::wave::T_BOOL},
+	{"const", boost::wave::T_CONST},
+	{"control", boost::wave::T_CONTROL},
+	{"default", boost::wave::T_DEFAULT},
+	{"else", boost::wave::T_ELSE},
+	{"entries", boost::wave::T_ENTRIES},
+	{"enum", boost::wave::T_ENUM},
+	{"error", boost::wave::T_ERROR},
+	{"exit", boost::wave::T_EXIT},
+	{"extern", boost::wave::T_EXTERN},
+	{"false", boost::wave::T_FALSE},
+	{"header", boost::wave::T_HEADER},
+	{"header_union", boost::wave::T_HEADER_UNION},
+	{"if", boost::wave::T_IF},
+	{"in", boost::wave::T_IN},
+	{"inout", boost::wave::T_INOUT},
+	{"int", boost::wave::T_INT},
+	{"key", boost::wave::T_KEY},
+	{"list", boost::wave::T_LIST},
+	{"match_kind", boost::wave::T_MATCH_KIND},
+	{"out", boost::wave::T_OUT},
+	{"package", boost::wave::T_PACKAGE},
+	{"parser", boost::wave::T_PARSER},
+	{"priority", boost::wave::T_PRIORITY},
+	{"return", boost::wave::T_RETURN},
+	{"select", boost::wave::T_SELECT},
+	{"state", boost::wave::T_STATE},
+	{"string", boost::wave::T_STRING},
+	{"struct", boost::wave::T_STRUCT},
+	{"switch", boost::wave::T_SWITCH},
+	{"table", boost::wave::T_TABLE},
+	{"this", boost::wave::T_THIS},
+	{"transition", boost::wave::T_TRANSITION},
+	{"true", boost::wave::T_TRUE},
+	{"tuple", boost::wave::T_TUPLE},
+	{"type", boost::wave::T_TYPE},
+	{"typedef", boost::wave::T_TYPEDEF},
+	{"value_set", boost::wave::T_VALUE_SET},
+	{"varbit", boost::wave::T_VARBIT},
+	{"void", boost::wave::T_VOID},
+	{"_", boost::wave::T_DONTCARE},
+};
+
+inline constexpr std::size_t keyword_slot_count = 128;
+inline constexpr std::size_t keyword_max_length = sizeof("header_union") - 1;
+
+constexpr std::size_t keyword_hash(std::string_view text)
+{
+	return (text.size() + 6 * static_cast<unsigned char>(text.front()) + 32 * static_cast<unsigned char>(text.back())
+			+ static_cast<unsigned char>(text[text.size() > 1 ? 1 : 0])) % keyword_slot_count;
+}
+
+/// \brief the index into keywords of each hash value or the number of keywords if there is none
+struct keyword_slots {
+	constexpr keyword_slots() : slots() {
+		for (auto& slot : slots) {
+			slot = std::size(keywords);
+		}
+		for (std::size_t it = 0; it != std::size(keywords); ++it) {
+			slots[keyword_hash(keywords[it].text)] = it;
+		}
+	}
+	/// \brief no two keywords have the same hash
+	constexpr bool is_perfect() const {
+		for (std::size_t it = 0; it != std::size(keywords); ++it) {
+			if (slots[keyword_hash(keywords[it].text)] != it) {
+				return false;
+			}
+		}
+		return true;
+	}
+	std::uint8_t slots[keyword_slot_count];
+};
+
+inline constexpr keyword_slots keyword_table;
+static_assert(keyword_table.is_perfect(), "the keyword hash has collisions");
+
+/// \brief the keyword token of the identifier or T_IDENTIFIER
+constexpr int find_keyword(std::string_view text)
+{
+	if (text.empty() || text.size() > keyword_max_length) {
+		return boost::wave::T_IDENTIFIER;
+	}
+	auto slot = keyword_table.slots[keyword_hash(text)];
+	if (slot != std::size(keywords) && keywords[slot].text == text) {
+		return keywords[slot].token;
+	}
+	return boost::wave::T_IDENTIFIER;
+}
+
+/// \brief what the lexer is inside of at the start of a line
+enum class line_state : std::uint8_t {
+	normal,
+	block_comment,
+	string,
+	directive, // a preprocessor directive continued with a backslash
+};
+
+struct line_checkpoint {
+	std::uint32_t offset; // of the start of the line
+	line_state state;
+};
+
+/// \brief a token of p4l::Lexer as a reference into the source
+struct lexed_token {
+	int id;
+	std::uint32_t offset;
+	std::uint32_t length;
+
+	bool operator==(lexed_token const& other) const noexcept {
+		return id == other.id && offset == other.offset && length == other.length;
+	}
+};
+
 class Lexer final {
  public:
-	explicit Lexer(std::istream& is) :is(is) {}
+	/// \brief lex the whole stream, it is read into a buffer first
+	explicit Lexer(std::istream& is);
+	/// \brief lex the source in place, it must outlive the lexer and the token texts
+	explicit Lexer(std::string_view source) :begin(source.data()), cursor(begin), end(begin + source.size()) {}
+	/// \brief lex the source in place from the start of a line, the state is what the line starts in
+	Lexer(std::string_view source, std::size_t offset, line_state state, int row)
+		:begin(source.data()), cursor(begin + offset), end(begin + source.size()), mode(state), row(row) {}
+	Lexer(const Lexer&) = delete;
+	Lexer& operator=(const Lexer&) = delete;
 	~Lexer() = default;
 	int next();
-	std::string get_text() {
+	/// \brief add a checkpoint for the start of every line the lexer reaches
+	void record_lines(std::vector<line_checkpoint>* lines) {
+		checkpoints = lines;
+	}
+	/// \brief the text of the last identifier or string literal, a view into the source
+	std::string_view get_text() {
 		return text;
 	}
+	/// \brief the low bits of the last number, sign extended if it is negative
 	int get_value() {
 		return value;
 	}
+	/// \brief the last number with all its bits
+	number const& get_number() {
+		return literal;
+	}
 	int get_width() {
 		return width;
 	}
@@ -144,6 +311,13 @@ class Lexer final {
 	int get_col() {
 		return col;
 	}
+	/// \brief where the last token starts in the source
+	std::size_t get_offset() const {
+		return token - begin;
+	}
+	std::size_t get_length() const {
+		return position() - token;
+	}
 
  private:
 	int read_other();
@@ -153,25 +327,47 @@ class Lexer final {
 	int read_identifier();
 	void read_comment();
 	void read_location();
+	void skip_block_comment();
+	void skip_directive();
+	char get() {
+		return cursor == end ? EOF : *cursor++;
+	}
 	char advance() {
 		if (last == EOF) {
 			return last;
 		}
-		last = is.get();
+		// a line starts when its first character is read, by then the
+		// state it starts in is known
 		if (last == '\n') {
 			++row;
 			col = 0;
-		} else {
+			if (checkpoints) {
+				checkpoints->push_back({static_cast<std::uint32_t>(cursor - begin), mode});
+			}
+		}
+		last = get();
+		if (last != '\n') {
 			++col;
 		}
 		return last;
 	}
+	/// \brief where the last character read is in the source
+	char const* position() const {
+		return last == EOF ? end : cursor - 1;
+	}
 
-	std::string text;
+	std::string_view text;
+	number literal;
 	int value = 0;
 	int width = 32;
 
-	std::istream& is;
+	std::string buffer;
+	char const* begin = nullptr;
+	char const* cursor = nullptr;
+	char const* end = nullptr;
+	char const* token = nullptr;
+	std::vector<line_checkpoint>* checkpoints = nullptr;
+	line_state mode = line_state::normal;
 	char last = ' ';
 	int row = 1;
 	int col = 0;
@@ -187,6 +383,9 @@ namespace classic {
 typedef unsigned char uchar;
 typedef unsigned int node_id_t;
 const node_id_t invalid_node = node_id_t(-1);
+// the DFA tables store states and regex indices in 16 bits
+typedef std::uint16_t dfa_entry_t;
+const dfa_entry_t invalid_entry = dfa_entry_t(-1);
 typedef std::set<node_id_t> node_set;
 typedef std::vector<uchar> uchar_vector;
 typedef std::map<node_id_t, node_set> followpos_t;
@@ -2241,32 +2440,33 @@ struct regex_match_helper<false> // single byte char
         > string_type;
         typedef typename string_type::size_type size_type;
 
-        node_id_t s = 0;
-        node_id_t last_accepting_index = invalid_node;
+        dfa_entry_t const* const transitions = dfa.transitions;
+        dfa_entry_t const* const acceptance = dfa.acceptance;
+        std::uint8_t const* const classes = dfa.classes;
+        std::size_t const class_count = dfa.class_count;
+
+        dfa_entry_t const* row = transitions;
+        dfa_entry_t last_accepting_index = invalid_entry;
         IteratorT p = first;
         IteratorT last_accepting_cpos = first;
         while (p != last)
         {
-            s = dfa.transition_table[s][(uchar)*p];
-            if (s == invalid_node)
+            dfa_entry_t const s = row[classes[(uchar)*p]];
+            if (s == invalid_entry)
                 break;
+            row = transitions + s * class_count;
             if (token) token->append((size_type)1, *p);
             ++p;
-            if (dfa.acceptance_index[s] != invalid_node)
+            if (acceptance[s] != invalid_entry)
             {
-                last_accepting_index = s;
+                last_accepting_index = acceptance[s];
                 last_accepting_cpos = p;
             }
         }
-        if (last_accepting_index != invalid_node)
+        if (last_accepting_index != invalid_entry)
         {
-#if defined(BOOST_SPIRIT_DEBUG) && (BOOST_SPIRIT_DEBUG_FLAGS & BOOST_SPIRIT_DEBUG_FLAGS_SLEX)
-            std::cout << "dfa.acceptance_index[" << last_accepting_index << "] = " <<
-                dfa.acceptance_index[last_accepting_index] << '\n';
-#endif
-
             first = last_accepting_cpos;
-            regex_index = dfa.acceptance_index[last_accepting_index];
+            regex_index = last_accepting_index;
             return true;
         }
         else
@@ -2291,8 +2491,8 @@ struct regex_match_helper<true> // wide char
         typedef std::basic_string<char_t> string_type;
         typedef typename string_type::size_type size_type;
 
-        node_id_t s = 0;
-        node_id_t last_accepting_index = invalid_node;
+        std::size_t s = 0;
+        dfa_entry_t last_accepting_index = invalid_entry;
         IteratorT wp = first;
         IteratorT last_accepting_cpos = first;
 
@@ -2300,31 +2500,28 @@ struct regex_match_helper<true> // wide char
         {
             for (unsigned int i = 0;  i < sizeof(char_t); ++i)
             {
-                s = dfa.transition_table[s][get_byte(*wp,i)];
-                if (s == invalid_node)
+                dfa_entry_t next = dfa.transitions[s * dfa.class_count + dfa.classes[get_byte(*wp,i)]];
+                if (next == invalid_entry)
                 {
                     goto break_while;
                 }
+                s = next;
             }
             if (token) token->append((size_type)1, *wp);
             ++wp;
-            if (dfa.acceptance_index[s] != invalid_node)
+            if (dfa.acceptance[s] != invalid_entry)
             {
-                last_accepting_index = s;
+                last_accepting_index = dfa.acceptance[s];
                 last_accepting_cpos = wp;
             }
 
         }
 
     break_while:
-        if (last_accepting_index != invalid_node)
+        if (last_accepting_index != invalid_entry)
         {
-#if defined(BOOST_SPIRIT_DEBUG) && (BOOST_SPIRIT_DEBUG_FLAGS & BOOST_SPIRIT_DEBUG_FLAGS_SLEX)
-            std::cout << "dfa.acceptance_index[" << last_accepting_index << "] = " <<
-                dfa.acceptance_index[last_accepting_index] << '\n';
-#endif
             first = last_accepting_cpos;
-            regex_index = dfa.acceptance_index[last_accepting_index];
+            regex_index = last_accepting_index;
 
             return true;
         }
@@ -2382,13 +2579,27 @@ public:
 
     };
 
+    // the DFA of a lexer state, either owned by the lexer or precompiled.
+    // The bytes no token definition tells apart share an equivalence
+    // class, the transition table has an entry for each class.
+    struct dfa_view
+    {
+        std::size_t             state_count;
+        std::size_t             class_count;
+        std::uint8_t const*     classes;        // class of each byte value
+        dfa_entry_t const*      transitions;    // class_count entries per state
+        dfa_entry_t const*      acceptance;     // regex index accepted in a state
+        TokenT const*           tokens;         // token of a regex index
+    };
+
+    // the DFA built by create_dfa
     struct dfa_table
     {
-        std::vector<std::vector<node_id_t> >    transition_table;
-        std::vector<node_id_t>                  acceptance_index;
+        std::vector<std::uint8_t>   classes;
+        std::vector<dfa_entry_t>    transition_table;
+        std::vector<dfa_entry_t>    acceptance_index;
+        std::vector<TokenT>         tokens;
     };
-    typedef std::vector<node_id_t> node_table_t;
-    typedef std::vector<node_table_t> transition_table_t;
     typedef std::vector<dfa_table> dfa_t;
 
 
@@ -2401,9 +2612,18 @@ public:
     TokenT next_token(IteratorT &first, IteratorT const &last,
         std::basic_string<char_t> *token = 0);
 
+    // match in the initial lexer state with no callbacks, only reads the
+    // compiled DFA so that several threads may share the lexer
+    TokenT match_token(IteratorT &first, IteratorT const &last,
+        std::basic_string<char_t> *token = 0) const;
+
     void create_dfa();
     bool has_compiled_dfa() { return m_compiled_dfa; }
 
+    // use tables built elsewhere, they must outlive the lexer
+    void set_dfa(std::vector<dfa_view> const& views);
+    std::vector<dfa_view> const& get_dfa() const { return m_views; }
+
     void set_case_insensitive(bool insensitive);
 
 #if defined(BOOST_SPIRIT_DEBUG) && (BOOST_SPIRIT_DEBUG_FLAGS & BOOST_SPIRIT_DEBUG_FLAGS_SLEX)
@@ -2411,27 +2631,16 @@ public:
 #endif
     typedef std::vector<std::vector<regex_info> > regex_list_t;
 
-    bool load (std::ifstream &in, long unique_id = 0);
-    bool save (std::ofstream &out, long unique_id = 0);
-    enum {
-        SLEX_SIGNATURE = 0x58454C53,    // "SLEX"
-        SLEX_VERSION_100 = 0x0100,      // persistance version
-        SLEX_LAST_KNOWN_VERSION = SLEX_VERSION_100,
-        SLEX_MINOR_VERSION_MASK = 0xFF
-    };
-
 private:
 
     void create_dfa_for_state(int state);
 
-    static bool regex_match(const dfa_t& dfa, IteratorT& first,
-        IteratorT& last, int& regex_index);
-
     mutable std::stack<lexerimpl::node*> node_stack;
     lexerimpl::lexer_grammar g;
 
     mutable bool m_compiled_dfa;
     mutable dfa_t m_dfa;
+    std::vector<dfa_view> m_views;
 
     regex_list_t m_regex_list;
     bool m_case_insensitive;
@@ -2485,17 +2694,20 @@ lexer<IteratorT, TokenT, CallbackT>::next_token(
 
     IteratorT saved = first;
     int regex_index;
-    if (!lexerimpl::regex_match<dfa_table, IteratorT, (sizeof(char_t) > 1)>::
-            do_match(m_dfa[m_state], first, last, regex_index, token))
+    dfa_view const& dfa = m_views[m_state];
+    if (!lexerimpl::regex_match<dfa_view, IteratorT, (sizeof(char_t) > 1)>::
+            do_match(dfa, first, last, regex_index, token))
         return -1;  // TODO: can't return -1, need to return some invalid token.
     // how to figure this out?  We can use traits I guess.
     else
     {
-        regex_info regex = m_regex_list[m_state][regex_index];
-        TokenT rval = regex.token;
-        if (regex.callback)
+        TokenT rval = dfa.tokens[regex_index];
+        // precompiled tables come with no callbacks
+        if (std::size_t(regex_index) < m_regex_list[m_state].size() &&
+            m_regex_list[m_state][regex_index].callback)
         {
             // execute corresponding callback
+            regex_info const& regex = m_regex_list[m_state][regex_index];
             lexer_control<TokenT> controller(rval, m_state, m_state_stack);
             regex.callback(saved, first, last, regex.token, controller);
             if (controller.ignore_current_token_set()) {
@@ -2508,6 +2720,23 @@ lexer<IteratorT, TokenT, CallbackT>::next_token(
     }
 }
 
+template <typename IteratorT, typename TokenT, typename CallbackT>
+inline TokenT
+lexer<IteratorT, TokenT, CallbackT>::match_token(
+    IteratorT &first, IteratorT const& last,
+    std::basic_string<
+        typename BOOST_SPIRIT_IT_NS::iterator_traits<IteratorT>::value_type
+    > *token) const
+{
+    BOOST_ASSERT(m_compiled_dfa);
+    int regex_index;
+    dfa_view const& dfa = m_views.front();
+    if (!lexerimpl::regex_match<dfa_view, IteratorT, (sizeof(char_t) > 1)>::
+            do_match(dfa, first, last, regex_index, token))
+        return -1;
+    return dfa.tokens[regex_index];
+}
+
 namespace lexerimpl
 {
 
@@ -2532,6 +2761,41 @@ bool find_acceptance_state(const node_set& eof_node_ids,
     return false;
 }
 
+// Replace the 256 entries per state of the transition table with one
+// entry per equivalence class of the bytes, the bytes of a class have
+// the same transitions in all states.  Returns the number of classes.
+inline std::size_t
+compress_transitions(std::vector<dfa_entry_t>& transitions,
+        std::vector<std::uint8_t>& classes)
+{
+    std::size_t state_count = transitions.size() / 256;
+    std::map<std::vector<dfa_entry_t>, std::uint8_t> columns;
+    std::vector<std::size_t> representatives;
+    classes.resize(256);
+    for (std::size_t c = 0; c < 256; ++c)
+    {
+        std::vector<dfa_entry_t> column(state_count);
+        for (std::size_t s = 0; s < state_count; ++s)
+            column[s] = transitions[s * 256 + c];
+        std::map<std::vector<dfa_entry_t>, std::uint8_t>::iterator found =
+            columns.find(column);
+        if (found == columns.end())
+        {
+            found = columns.insert(std::make_pair(column,
+                std::uint8_t(representatives.size()))).first;
+            representatives.push_back(c);
+        }
+        classes[c] = found->second;
+    }
+    std::size_t class_count = representatives.size();
+    std::vector<dfa_entry_t> compressed(state_count * class_count);
+    for (std::size_t s = 0; s < state_count; ++s)
+        for (std::size_t k = 0; k < class_count; ++k)
+            compressed[s * class_count + k] = transitions[s * 256 + representatives[k]];
+    transitions.swap(compressed);
+    return class_count;
+}
+
 template <typename RegexListT, typename GrammarT>
 #ifndef BOOST_NO_CXX11_SMART_PTR
 inline std::unique_ptr<node>
@@ -2579,8 +2843,29 @@ inline void
 lexer<IteratorT, TokenT, CallbackT>::create_dfa()
 {
     m_dfa.resize(m_num_states);
+    m_views.resize(m_num_states);
     for (unsigned int i = 0; i < m_num_states; ++i)
+    {
         create_dfa_for_state(i);
+        dfa_table& table = m_dfa[i];
+        std::size_t class_count = lexerimpl::compress_transitions(
+            table.transition_table, table.classes);
+        m_views[i] = dfa_view{table.acceptance_index.size(), class_count,
+            table.classes.data(), table.transition_table.data(),
+            table.acceptance_index.data(), table.tokens.data()};
+    }
+    m_compiled_dfa = true;
+}
+
+template <typename IteratorT, typename TokenT, typename CallbackT>
+inline void
+lexer<IteratorT, TokenT, CallbackT>::set_dfa(std::vector<dfa_view> const& views)
+{
+    m_dfa.clear();
+    m_views = views;
+    m_num_states = (unsigned int)views.size();
+    m_regex_list.resize(m_num_states);
+    m_compiled_dfa = true;
 }
 
 // Algorithm from Compilers: Principles, Techniques, and Tools p. 141
@@ -2609,10 +2894,16 @@ lexer<IteratorT, TokenT, CallbackT>::create_dfa_for_state(int state)
     std::map<node_set, node_id_t> dstates1;
     std::map<node_id_t, node_set> dstates2;
 
-    // the dfa transitions
-    m_dfa[state].transition_table.push_back(
-            std::vector<node_id_t>(256, invalid_node));
-    m_dfa[state].acceptance_index.push_back(invalid_node);
+    // the dfa transitions, 256 entries for each dfa state
+    dfa_table& table = m_dfa[state];
+    table.transition_table.assign(256, invalid_entry);
+    table.acceptance_index.assign(1, invalid_entry);
+    table.tokens.clear();
+    for (typename std::vector<regex_info>::const_iterator ri = m_regex_list[state].begin();
+            ri != m_regex_list[state].end(); ++ri)
+    {
+        table.tokens.push_back((*ri).token);
+    }
 
     // whether the dfa state has been processed yet
     std::vector<node_id_t> marked;
@@ -2647,7 +2938,7 @@ lexer<IteratorT, TokenT, CallbackT>::create_dfa_for_state(int state)
     node_id_t eof_node_id;
     if (lexerimpl::find_acceptance_state(eof_node_ids, fpr, eof_node_id))
     {
-        m_dfa[state].acceptance_index[0] = eof_node_id_map[eof_node_id];
+        table.acceptance_index[0] = dfa_entry_t(eof_node_id_map[eof_node_id]);
     }
 
     std::vector<node_id_t>::iterator i = std::find(marked.begin(), marked.end(),
@@ -2680,18 +2971,20 @@ lexer<IteratorT, TokenT, CallbackT>::create_dfa_for_state(int state)
                 if (l == dstates1.end()) // not in the states yet
                 {
                     ++num_states;
+                    if (num_states >= invalid_entry)
+                        boost::throw_exception(bad_regex());
                     dstates1[U] = target_state = num_states;
                     dstates2[target_state] = U;
                     marked.push_back(0);
-                    m_dfa[state].transition_table.push_back(
-                            std::vector<node_id_t>(256, invalid_node));
-                    m_dfa[state].acceptance_index.push_back(invalid_node);
+                    table.transition_table.resize(
+                        table.transition_table.size() + 256, invalid_entry);
+                    table.acceptance_index.push_back(invalid_entry);
                     // figure out if this is an acceptance state
                     node_id_t eof_node_id;
                     if (lexerimpl::find_acceptance_state(eof_node_ids, U, eof_node_id))
                     {
-                        m_dfa[state].acceptance_index[target_state] =
-                            eof_node_id_map[eof_node_id];
+                        table.acceptance_index[target_state] =
+                            dfa_entry_t(eof_node_id_map[eof_node_id]);
                     }
                 }
                 else
@@ -2699,16 +2992,14 @@ lexer<IteratorT, TokenT, CallbackT>::create_dfa_for_state(int state)
                     target_state = dstates1[U];
                 }
 
-                BOOST_ASSERT(T < m_dfa[state].transition_table.size());
-                BOOST_ASSERT(j < m_dfa[state].transition_table[T].size());
-                m_dfa[state].transition_table[T][j] = target_state;
+                BOOST_ASSERT(T * 256 + j < table.transition_table.size());
+                table.transition_table[T * 256 + j] = dfa_entry_t(target_state);
             }
 
         }
 
         i = std::find(marked.begin(), marked.end(), node_id_t(0));
     }
-    m_compiled_dfa = true;
 }
 
 template <typename IteratorT, typename TokenT, typename CallbackT>
@@ -2724,182 +3015,32 @@ template <typename IteratorT, typename TokenT, typename CallbackT>
 inline void
 lexer<IteratorT, TokenT, CallbackT>::dump(std::ostream& out)
 {
-    for (unsigned x = 0; x < m_dfa.size(); ++x)
+    for (unsigned x = 0; x < m_views.size(); ++x)
     {
-        out << "\nm_dfa[" << x << "] has " << m_dfa[x].transition_table.size() << " states\n";
-        for (node_id_t i = 0; i < m_dfa[x].transition_table.size(); ++i)
+        dfa_view const& dfa = m_views[x];
+        out << "\nm_dfa[" << x << "] has " << dfa.state_count << " states\n";
+        for (std::size_t i = 0; i < dfa.state_count; ++i)
         {
             out << "state " << i << ":";
-            for (node_id_t j = 0; j < m_dfa[x].transition_table[i].size(); ++j)
+            for (std::size_t j = 0; j < 256; ++j)
             {
-                if (m_dfa[x].transition_table[i][j] != invalid_node)
-                    out << j << "->" << m_dfa[x].transition_table[i][j] << " ";
+                dfa_entry_t next = dfa.transitions[i * dfa.class_count + dfa.classes[j]];
+                if (next != invalid_entry)
+                    out << j << "->" << next << " ";
             }
             out << "\n";
         }
         out << "acceptance states: ";
-        for(unsigned int k = 0; k < m_dfa[x].acceptance_index.size(); ++k)
+        for (std::size_t k = 0; k < dfa.state_count; ++k)
         {
-            if (m_dfa[x].acceptance_index[k] != invalid_node)
-                out << '<' << k << ',' << m_dfa[x].acceptance_index[k] << "> ";
+            if (dfa.acceptance[k] != invalid_entry)
+                out << '<' << k << ',' << dfa.acceptance[k] << "> ";
         }
         out << endl;
     }
 }
 #endif
 
-///////////////////////////////////////////////////////////////////////////////
-// load the lexer tables
-#define slex_in(strm, val) \
-    strm.read((char*)&val, sizeof(val)); \
-    if (std::ios::goodbit != strm.rdstate()) return false
-
-template <typename IteratorT, typename TokenT, typename CallbackT>
-inline bool
-lexer<IteratorT, TokenT, CallbackT>::load (std::ifstream &in, long unique_id)
-{
-// ensure correct signature and version
-long signature = 0;
-
-    slex_in (in, signature);
-    if (signature != SLEX_SIGNATURE)
-        return false;       // not for us
-
-long version = 0;
-
-    slex_in (in, version);
-    if ((version & ~SLEX_MINOR_VERSION_MASK) > SLEX_LAST_KNOWN_VERSION)
-        return false;       // to new for us
-
-long uid = 0;
-
-    slex_in (in, uid);
-    if (uid != unique_id)
-        return false;       // not saved by us
-
-// load auxiliary members
-int num_states = 0;
-
-    slex_in (in, num_states);
-
-// load the dfa tables
-dfa_t in_dfa;
-std::size_t dfa_size = 0;
-
-    slex_in (in, dfa_size);
-    in_dfa.resize(dfa_size);
-    for (std::size_t dfa = 0; dfa < dfa_size; ++dfa)
-    {
-    // load the transition tables
-    std::size_t tt_size = 0;
-    transition_table_t &tt_table = in_dfa[dfa].transition_table;
-
-        slex_in (in, tt_size);
-        tt_table.resize(tt_size);
-        for (std::size_t tt = 0; tt < tt_size; ++tt)
-        {
-        std::size_t nt_size = 0;
-        node_table_t &nt_table = tt_table[tt];
-
-            slex_in (in, nt_size);
-            nt_table.resize(nt_size);
-            for (std::size_t nt = 0; nt < nt_size; ++nt)
-            {
-                slex_in (in, nt_table[nt]);
-            }
-        }
-
-    // load the acceptance index table
-    std::size_t ai_size = 0;
-    node_table_t &ai_table = in_dfa[dfa].acceptance_index;
-
-        slex_in (in, ai_size);
-        ai_table.resize(ai_size);
-        for (std::size_t ai = 0; ai < ai_size; ++ai)
-        {
-            slex_in (in, ai_table[ai]);
-        }
-    }
-
-    m_dfa.swap(in_dfa);         // success, swap in the read values
-    m_num_states = num_states;
-
-    m_compiled_dfa = true;
-    return true;
-}
-
-#undef slex_in
-
-///////////////////////////////////////////////////////////////////////////////
-// save the lexer tables
-#define slex_out(strm, val) \
-    strm.write((char*)&val, sizeof(val)); \
-    if (std::ios::goodbit != strm.rdstate()) return false
-
-template <typename IteratorT, typename TokenT, typename CallbackT>
-inline bool
-lexer<IteratorT, TokenT, CallbackT>::save (std::ofstream &out, long unique_id)
-{
-// save signature and version information
-long out_long = SLEX_SIGNATURE;
-
-    slex_out(out, out_long);
-    out_long = SLEX_VERSION_100;
-    slex_out(out, out_long);
-    slex_out(out, unique_id);
-
-// save auxiliary members
-    slex_out(out, m_num_states);
-
-// save the dfa tables
-    typedef typename dfa_t::const_iterator dfa_iter_t;
-    typedef transition_table_t::const_iterator transition_table_iter_t;
-    typedef node_table_t::const_iterator node_table_iter_t;
-
-    std::size_t out_size_t = m_dfa.size();
-    slex_out(out, out_size_t);
-
-    dfa_iter_t end = m_dfa.end();
-    for (dfa_iter_t it = m_dfa.begin(); it != end; ++it)
-    {
-    // save the transition table
-        out_size_t = (*it).transition_table.size();
-        slex_out(out, out_size_t);
-
-        transition_table_iter_t tt_end = (*it).transition_table.end();
-        for (transition_table_iter_t tt_it = (*it).transition_table.begin();
-             tt_it != tt_end;
-             ++tt_it)
-        {
-            out_size_t = (*tt_it).size();
-            slex_out(out, out_size_t);
-
-            node_table_iter_t nt_end = (*tt_it).end();
-            for (node_table_iter_t nt_it = (*tt_it).begin();
-                 nt_it != nt_end;
-                 ++nt_it)
-            {
-                slex_out(out, (*nt_it));
-            }
-        }
-
-    // save the acceptance index table
-        out_size_t = (*it).acceptance_index.size();
-        slex_out(out, out_size_t);
-
-        node_table_iter_t nt_end = (*it).acceptance_index.end();
-        for (node_table_iter_t nt_it = (*it).acceptance_index.begin();
-             nt_it != nt_end;
-             ++nt_it)
-        {
-            slex_out(out, (*nt_it));
-        }
-    }
-    return true;
-}
-
-#undef slex_out
-
 /*
 a lexer_control object supports some operations on the lexer.
     get current lexer state
@@ -3049,18 +3190,6 @@ namespace cpplexer {
 namespace slex {
 namespace lexer {
 
-///////////////////////////////////////////////////////////////////////////////
-//  The following numbers are the array sizes of the token regex's which we
-//  need to specify to make the CW compiler happy (at least up to V9.5).
-#if BOOST_WAVE_SUPPORT_MS_EXTENSIONS != 0
-#define INIT_DATA_SIZE              175
-#else
-#define INIT_DATA_SIZE              158
-#endif
-#define INIT_DATA_CPP_SIZE          15
-#define INIT_DATA_PP_NUMBER_SIZE    2
-#define INIT_DATA_CPP0X_SIZE        15
-
 ///////////////////////////////////////////////////////////////////////////////
 //
 //  encapsulation of the boost::spirit::classic::slex based cpp lexer
@@ -3100,29 +3229,20 @@ class lexer
 public:
     typedef p4l::p4lex_token<PositionT>  token_type;
 
+    // the token definitions are the same in all languages, P4 has no
+    // dialects the language options of Wave could select
     void init_dfa(boost::wave::language_support language);
 
-// get time of last compilation
-    static std::time_t get_compilation_time()
-        { return compilation_time.get_time(); }
-
-// helper for calculation of the time of last compilation
-    static boost::wave::util::time_conversion_helper compilation_time;
-
 private:
     typedef lexer_base<IteratorT, PositionT> base_type;
 
-    static typename base_type::lexer_data const init_data[INIT_DATA_SIZE];          // common patterns
-    static typename base_type::lexer_data const init_data_cpp[INIT_DATA_CPP_SIZE];  // C++ only patterns
-    static typename base_type::lexer_data const init_data_pp_number[INIT_DATA_PP_NUMBER_SIZE];  // pp-number only patterns
-    static typename base_type::lexer_data const init_data_cpp0x[INIT_DATA_CPP0X_SIZE];  // C++0X only patterns
+    static typename base_type::lexer_data const init_data[];    // P4-16 tokens
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 //  data required for initialization of the lexer (token definitions)
 #define OR                  "|"
 #define Q(c)                "\\" c
-#define TRI(c)              Q("?") Q("?") c
 
 // definition of some sub-token regexps to simplify the regex definitions
 #define BLANK               "[ \\t]"
@@ -3130,32 +3250,16 @@ private:
 
 #define PPSPACE             "(" BLANK OR CCOMMENT ")*"
 
-#define OCTALDIGIT          "[0-7]"
 #define DIGIT               "[0-9]"
-#define HEXDIGIT            "[0-9a-fA-F]"
-#define OPTSIGN             "[-+]?"
-#define EXPSTART            "[eE]" "[-+]"
-#define EXPONENT            "(" "[eE]" OPTSIGN "[0-9]+" ")"
-#define NONDIGIT            "[a-zA-Z_]"
-
-#define INTEGER             "(" "(0x|0X)" HEXDIGIT "+" OR "0" OCTALDIGIT "*" OR "[1-9]" DIGIT "*" ")"
 
-#define INTEGER_SUFFIX      "(" "[uU][lL]?|[lL][uU]?" ")"
-#if BOOST_WAVE_SUPPORT_MS_EXTENSIONS != 0
-#define LONGINTEGER_SUFFIX  "(" "[uU]" "(" "[lL][lL]" ")" OR "(" "[lL][lL]" ")" "[uU]" "?" OR "i64" ")"
-#else
-#define LONGINTEGER_SUFFIX  "(" "[uU]" "(" "[lL][lL]" ")" OR "(" "[lL][lL]" ")" "[uU]" "?" ")"
-#endif
-#define FLOAT_SUFFIX        "(" "[fF][lL]?" OR "[lL][fF]?" ")"
-#define CHAR_SPEC           "L?"
-#define EXTCHAR_SPEC        "(" "[uU]" OR "u8" ")"
+// an integer with an optional width and signedness, 8w10 or 8s0x0a
+#define WIDTH               "(" DIGIT "+" "[ws]" ")"
+#define INTEGER             "(" "0[xX][0-9a-fA-F_]+" OR "0[oO][0-7_]+" OR "0[dD][0-9_]+" \
+                            OR "0[bB][01_]+" OR DIGIT "[0-9_]*" ")"
 
-#define BACKSLASH           "(" Q("\\") OR TRI(Q("/")) ")"
-#define ESCAPESEQ           "(" BACKSLASH "(" "[abfnrtv?'\"]" OR BACKSLASH OR "x" HEXDIGIT "+" OR OCTALDIGIT OCTALDIGIT "?" OCTALDIGIT "?" "))"
-#define HEXQUAD             "(" HEXDIGIT HEXDIGIT HEXDIGIT HEXDIGIT ")"
-#define UNIVERSALCHAR       "(" BACKSLASH "(" "u" HEXQUAD OR "U" HEXQUAD HEXQUAD "))"
+#define ESCAPESEQ           "(" Q("\\") "[^\\n\\r]" ")"
 
-#define POUNDDEF            "(" "#" OR TRI("=") OR Q("%:") ")"
+#define POUNDDEF            "#"
 #define NEWLINEDEF          "(" "\n" OR "\r" OR "\r\n" ")"
 
 #if BOOST_WAVE_SUPPORT_INCLUDE_NEXT != 0
@@ -3164,8 +3268,6 @@ private:
 #define INCLUDEDEF          "include"
 #endif
 
-#define PP_NUMBERDEF        Q(".") "?" DIGIT "(" DIGIT OR NONDIGIT OR EXPSTART OR Q(".") ")*"
-
 ///////////////////////////////////////////////////////////////////////////////
 //  lexer state constants
 #define LEXER_STATE_NORMAL  0
@@ -3173,144 +3275,66 @@ private:
 
 #define NUM_LEXER_STATES    1
 
-//  helper for initializing token data
+//  helper for initializing token data, the P4 token ids are plain ints
 #define TOKEN_DATA(id, regex)                                                 \
-        { T_##id, regex, 0, LEXER_STATE_NORMAL }                              \
+        { token_id(T_##id), regex, 0, LEXER_STATE_NORMAL }                    \
     /**/
 
 #define TOKEN_DATA_EX(id, regex, callback)                                    \
-        { T_##id, regex, callback, LEXER_STATE_NORMAL }                       \
+        { token_id(T_##id), regex, callback, LEXER_STATE_NORMAL }             \
     /**/
 
 ///////////////////////////////////////////////////////////////////////////////
-// common C++/C99 token definitions
+// P4-16 token definitions, with the preprocessor directives.  Of the
+// matches of the same length the first definition wins.  The keywords
+// are lexed as identifiers and classified by p4l::find_keyword, which
+// keeps the DFA small.  ">>" and ">>=" keep Wave's ids, so that #if
+// expressions shift, p4l::Parser splits them where nested type
+// arguments as in bit<W<8>> close.
 template <typename IteratorT, typename PositionT>
 typename lexer_base<IteratorT, PositionT>::lexer_data const
-lexer<IteratorT, PositionT>::init_data[INIT_DATA_SIZE] =
+lexer<IteratorT, PositionT>::init_data[] =
 {
     TOKEN_DATA(AND, "&"),
     TOKEN_DATA(ANDAND, "&&"),
+    TOKEN_DATA(MASK, "&&&"),
     TOKEN_DATA(ASSIGN, "="),
-    TOKEN_DATA(ANDASSIGN, "&="),
     TOKEN_DATA(OR, Q("|")),
-    TOKEN_DATA(OR_TRIGRAPH, TRI("!")),
-    TOKEN_DATA(ORASSIGN, Q("|=")),
-    TOKEN_DATA(ORASSIGN_TRIGRAPH, TRI("!=")),
+    TOKEN_DATA(OROR, Q("|") Q("|")),
+    TOKEN_DATA(PLUS_SAT, Q("|") Q("+") Q("|")),
+    TOKEN_DATA(MINUS_SAT, Q("|") Q("-") Q("|")),
     TOKEN_DATA(XOR, Q("^")),
-    TOKEN_DATA(XOR_TRIGRAPH, TRI("'")),
-    TOKEN_DATA(XORASSIGN, Q("^=")),
-    TOKEN_DATA(XORASSIGN_TRIGRAPH, TRI("'=")),
     TOKEN_DATA(COMMA, ","),
     TOKEN_DATA(COLON, ":"),
-    TOKEN_DATA(DIVIDEASSIGN, Q("/=")),
     TOKEN_DATA(DIVIDE, Q("/")),
     TOKEN_DATA(DOT, Q(".")),
+    TOKEN_DATA(RANGE, Q(".") Q(".")),
     TOKEN_DATA(ELLIPSIS, Q(".") Q(".") Q(".")),
     TOKEN_DATA(EQUAL, "=="),
     TOKEN_DATA(GREATER, ">"),
     TOKEN_DATA(GREATEREQUAL, ">="),
     TOKEN_DATA(LEFTBRACE, Q("{")),
-    TOKEN_DATA(LEFTBRACE_ALT, "<" Q("%")),
-    TOKEN_DATA(LEFTBRACE_TRIGRAPH, TRI("<")),
     TOKEN_DATA(LESS, "<"),
     TOKEN_DATA(LESSEQUAL, "<="),
     TOKEN_DATA(LEFTPAREN, Q("(")),
     TOKEN_DATA(LEFTBRACKET, Q("[")),
-    TOKEN_DATA(LEFTBRACKET_ALT, "<:"),
-    TOKEN_DATA(LEFTBRACKET_TRIGRAPH, TRI(Q("("))),
     TOKEN_DATA(MINUS, Q("-")),
-    TOKEN_DATA(MINUSASSIGN, Q("-=")),
-    TOKEN_DATA(MINUSMINUS, Q("-") Q("-")),
     TOKEN_DATA(PERCENT, Q("%")),
-    TOKEN_DATA(PERCENTASSIGN, Q("%=")),
     TOKEN_DATA(NOT, "!"),
     TOKEN_DATA(NOTEQUAL, "!="),
-    TOKEN_DATA(OROR, Q("|") Q("|")),
-    TOKEN_DATA(OROR_TRIGRAPH, TRI("!") Q("|") OR Q("|") TRI("!") OR TRI("!") TRI("!")),
     TOKEN_DATA(PLUS, Q("+")),
-    TOKEN_DATA(PLUSASSIGN, Q("+=")),
     TOKEN_DATA(PLUSPLUS, Q("+") Q("+")),
-    TOKEN_DATA(ARROW, Q("->")),
     TOKEN_DATA(QUESTION_MARK, Q("?")),
     TOKEN_DATA(RIGHTBRACE, Q("}")),
-    TOKEN_DATA(RIGHTBRACE_ALT, Q("%>")),
-    TOKEN_DATA(RIGHTBRACE_TRIGRAPH, TRI(">")),
     TOKEN_DATA(RIGHTPAREN, Q(")")),
     TOKEN_DATA(RIGHTBRACKET, Q("]")),
-    TOKEN_DATA(RIGHTBRACKET_ALT, ":>"),
-    TOKEN_DATA(RIGHTBRACKET_TRIGRAPH, TRI(Q(")"))),
     TOKEN_DATA(SEMICOLON, ";"),
     TOKEN_DATA(SHIFTLEFT, "<<"),
-    TOKEN_DATA(SHIFTLEFTASSIGN, "<<="),
     TOKEN_DATA(SHIFTRIGHT, ">>"),
     TOKEN_DATA(SHIFTRIGHTASSIGN, ">>="),
     TOKEN_DATA(STAR, Q("*")),
     TOKEN_DATA(COMPL, Q("~")),
-    TOKEN_DATA(COMPL_TRIGRAPH, TRI("-")),
-    TOKEN_DATA(STARASSIGN, Q("*=")),
-    TOKEN_DATA(ASM, "asm"),
-    TOKEN_DATA(AUTO, "auto"),
-    TOKEN_DATA(BOOL, "bool"),
-    TOKEN_DATA(FALSE, "false"),
-    TOKEN_DATA(TRUE, "true"),
-    TOKEN_DATA(BREAK, "break"),
-    TOKEN_DATA(CASE, "case"),
-    TOKEN_DATA(CATCH, "catch"),
-    TOKEN_DATA(CHAR, "char"),
-    TOKEN_DATA(CLASS, "class"),
-    TOKEN_DATA(CONST, "const"),
-    TOKEN_DATA(CONSTCAST, "const_cast"),
-    TOKEN_DATA(CONTINUE, "continue"),
-    TOKEN_DATA(DEFAULT, "default"),
-    TOKEN_DATA(DELETE, "delete"),
-    TOKEN_DATA(DO, "do"),
-    TOKEN_DATA(DOUBLE, "double"),
-    TOKEN_DATA(DYNAMICCAST, "dynamic_cast"),
-    TOKEN_DATA(ELSE, "else"),
-    TOKEN_DATA(ENUM, "enum"),
-    TOKEN_DATA(EXPLICIT, "explicit"),
-    TOKEN_DATA(EXPORT, "export"),
-    TOKEN_DATA(EXTERN, "extern"),
-    TOKEN_DATA(FLOAT, "float"),
-    TOKEN_DATA(FOR, "for"),
-    TOKEN_DATA(FRIEND, "friend"),
-    TOKEN_DATA(GOTO, "goto"),
-    TOKEN_DATA(IF, "if"),
-    TOKEN_DATA(INLINE, "inline"),
-    TOKEN_DATA(INT, "int"),
-    TOKEN_DATA(LONG, "long"),
-    TOKEN_DATA(MUTABLE, "mutable"),
-    TOKEN_DATA(NAMESPACE, "namespace"),
-    TOKEN_DATA(NEW, "new"),
-    TOKEN_DATA(OPERATOR, "operator"),
-    TOKEN_DATA(PRIVATE, "private"),
-    TOKEN_DATA(PROTECTED, "protected"),
-    TOKEN_DATA(PUBLIC, "public"),
-    TOKEN_DATA(REGISTER, "register"),
-    TOKEN_DATA(REINTERPRETCAST, "reinterpret_cast"),
-    TOKEN_DATA(RETURN, "return"),
-    TOKEN_DATA(SHORT, "short"),
-    TOKEN_DATA(SIGNED, "signed"),
-    TOKEN_DATA(SIZEOF, "sizeof"),
-    TOKEN_DATA(STATIC, "static"),
-    TOKEN_DATA(STATICCAST, "static_cast"),
-    TOKEN_DATA(STRUCT, "struct"),
-    TOKEN_DATA(SWITCH, "switch"),
-    TOKEN_DATA(TEMPLATE, "template"),
-    TOKEN_DATA(THIS, "this"),
-    TOKEN_DATA(THROW, "throw"),
-    TOKEN_DATA(TRY, "try"),
-    TOKEN_DATA(TYPEDEF, "typedef"),
-    TOKEN_DATA(TYPEID, "typeid"),
-    TOKEN_DATA(TYPENAME, "typename"),
-    TOKEN_DATA(UNION, "union"),
-    TOKEN_DATA(UNSIGNED, "unsigned"),
-    TOKEN_DATA(USING, "using"),
-    TOKEN_DATA(VIRTUAL, "virtual"),
-    TOKEN_DATA(VOID, "void"),
-    TOKEN_DATA(VOLATILE, "volatile"),
-    TOKEN_DATA(WCHART, "wchar_t"),
-    TOKEN_DATA(WHILE, "while"),
+    TOKEN_DATA(AT, "@"),
     TOKEN_DATA(PP_DEFINE, POUNDDEF PPSPACE "define"),
     TOKEN_DATA(PP_IF, POUNDDEF PPSPACE "if"),
     TOKEN_DATA(PP_IFDEF, POUNDDEF PPSPACE "ifdef"),
@@ -3329,128 +3353,21 @@ lexer<IteratorT, PositionT>::init_data[INIT_DATA_SIZE] =
     TOKEN_DATA(PP_PRAGMA, POUNDDEF PPSPACE "pragma"),
     TOKEN_DATA(PP_UNDEF, POUNDDEF PPSPACE "undef"),
     TOKEN_DATA(PP_WARNING, POUNDDEF PPSPACE "warning"),
-#if BOOST_WAVE_SUPPORT_MS_EXTENSIONS != 0
-    TOKEN_DATA(MSEXT_INT8, "__int8"),
-    TOKEN_DATA(MSEXT_INT16, "__int16"),
-    TOKEN_DATA(MSEXT_INT32, "__int32"),
-    TOKEN_DATA(MSEXT_INT64, "__int64"),
-    TOKEN_DATA(MSEXT_BASED, "_?" "_based"),
-    TOKEN_DATA(MSEXT_DECLSPEC, "_?" "_declspec"),
-    TOKEN_DATA(MSEXT_CDECL, "_?" "_cdecl"),
-    TOKEN_DATA(MSEXT_FASTCALL, "_?" "_fastcall"),
-    TOKEN_DATA(MSEXT_STDCALL, "_?" "_stdcall"),
-    TOKEN_DATA(MSEXT_TRY , "__try"),
-    TOKEN_DATA(MSEXT_EXCEPT, "__except"),
-    TOKEN_DATA(MSEXT_FINALLY, "__finally"),
-    TOKEN_DATA(MSEXT_LEAVE, "__leave"),
-    TOKEN_DATA(MSEXT_INLINE, "_?" "_inline"),
-    TOKEN_DATA(MSEXT_ASM, "_?" "_asm"),
-    TOKEN_DATA(MSEXT_PP_REGION, POUNDDEF PPSPACE "region"),
-    TOKEN_DATA(MSEXT_PP_ENDREGION, POUNDDEF PPSPACE "endregion"),
-#endif // BOOST_WAVE_SUPPORT_MS_EXTENSIONS != 0
-//  TOKEN_DATA(OCTALINT, "0" OCTALDIGIT "*" INTEGER_SUFFIX "?"),
-//  TOKEN_DATA(DECIMALINT, "[1-9]" DIGIT "*" INTEGER_SUFFIX "?"),
-//  TOKEN_DATA(HEXAINT, "(0x|0X)" HEXDIGIT "+" INTEGER_SUFFIX "?"),
-    TOKEN_DATA(LONGINTLIT, INTEGER LONGINTEGER_SUFFIX),
-    TOKEN_DATA(INTLIT, INTEGER INTEGER_SUFFIX "?"),
-    TOKEN_DATA(FLOATLIT,
-        "(" DIGIT "*" Q(".") DIGIT "+" OR DIGIT "+" Q(".") ")"
-        EXPONENT "?" FLOAT_SUFFIX "?" OR
-        DIGIT "+" EXPONENT FLOAT_SUFFIX "?"),
+    TOKEN_DATA(NUMBER, WIDTH "?" INTEGER),
     TOKEN_DATA(CCOMMENT, CCOMMENT),
     TOKEN_DATA(CPPCOMMENT, Q("/") Q("/[^\\n\\r]*") NEWLINEDEF ),
-    TOKEN_DATA(CHARLIT, CHAR_SPEC "'"
-                "(" ESCAPESEQ OR UNIVERSALCHAR OR "[^\\n\\r\\\\']" ")+" "'"),
-    TOKEN_DATA(STRINGLIT, CHAR_SPEC Q("\"")
-                "(" ESCAPESEQ OR UNIVERSALCHAR OR "[^\\n\\r\\\\\"]" ")*" Q("\"")),
-#if BOOST_WAVE_USE_STRICT_LEXER != 0
-    TOKEN_DATA(IDENTIFIER, "([a-zA-Z_]" OR UNIVERSALCHAR ")([a-zA-Z0-9_]" OR UNIVERSALCHAR ")*"),
-#else
-    TOKEN_DATA(IDENTIFIER, "([a-zA-Z_$]" OR UNIVERSALCHAR ")([a-zA-Z0-9_$]" OR UNIVERSALCHAR ")*"),
-#endif
+    TOKEN_DATA(STRING_LITERAL, Q("\"")
+                "(" ESCAPESEQ OR "[^\\n\\r\\\\\"]" ")*" Q("\"")),
+    TOKEN_DATA(IDENTIFIER, "[a-zA-Z_][a-zA-Z0-9_]*"),
     TOKEN_DATA(SPACE, "[ \t\v\f]+"),
-//    TOKEN_DATA(SPACE2, "[\\v\\f]+"),
     TOKEN_DATA(CONTLINE, Q("\\") "\n"),
     TOKEN_DATA(NEWLINE, NEWLINEDEF),
     TOKEN_DATA(POUND_POUND, "##"),
-    TOKEN_DATA(POUND_POUND_ALT, Q("%:") Q("%:")),
-    TOKEN_DATA(POUND_POUND_TRIGRAPH, TRI("=") TRI("=")),
     TOKEN_DATA(POUND, "#"),
-    TOKEN_DATA(POUND_ALT, Q("%:")),
-    TOKEN_DATA(POUND_TRIGRAPH, TRI("=")),
-    TOKEN_DATA(ANY_TRIGRAPH, TRI(Q("/"))),
     TOKEN_DATA(ANY, "."),     // this should be the last recognized token
     { token_id(0), "", 0, LEXER_STATE_NORMAL }           // this should be the last entry
 };
 
-///////////////////////////////////////////////////////////////////////////////
-// C++ only token definitions
-template <typename IteratorT, typename PositionT>
-typename lexer_base<IteratorT, PositionT>::lexer_data const
-lexer<IteratorT, PositionT>::init_data_cpp[INIT_DATA_CPP_SIZE] =
-{
-    TOKEN_DATA(AND_ALT, "bitand"),
-    TOKEN_DATA(ANDASSIGN_ALT, "and_eq"),
-    TOKEN_DATA(ANDAND_ALT, "and"),
-    TOKEN_DATA(OR_ALT, "bitor"),
-    TOKEN_DATA(ORASSIGN_ALT, "or_eq"),
-    TOKEN_DATA(OROR_ALT, "or"),
-    TOKEN_DATA(XORASSIGN_ALT, "xor_eq"),
-    TOKEN_DATA(XOR_ALT, "xor"),
-    TOKEN_DATA(NOTEQUAL_ALT, "not_eq"),
-    TOKEN_DATA(NOT_ALT, "not"),
-    TOKEN_DATA(COMPL_ALT, "compl"),
-#if BOOST_WAVE_SUPPORT_IMPORT_KEYWORD != 0
-    TOKEN_DATA(IMPORT, "import"),
-#endif
-    TOKEN_DATA(ARROWSTAR, Q("->") Q("*")),
-    TOKEN_DATA(DOTSTAR, Q(".") Q("*")),
-    TOKEN_DATA(COLON_COLON, "::"),
-    { token_id(0), "", 0, LEXER_STATE_NORMAL }       // this should be the last entry
-};
-
-///////////////////////////////////////////////////////////////////////////////
-// C++ only token definitions
-template <typename IteratorT, typename PositionT>
-typename lexer_base<IteratorT, PositionT>::lexer_data const
-lexer<IteratorT, PositionT>::init_data_pp_number[INIT_DATA_PP_NUMBER_SIZE] =
-{
-    TOKEN_DATA(PP_NUMBER, PP_NUMBERDEF),
-    { token_id(0), "", 0, LEXER_STATE_NORMAL }       // this should be the last entry
-};
-
-///////////////////////////////////////////////////////////////////////////////
-// C++ only token definitions
-
-#define T_EXTCHARLIT      token_id(T_CHARLIT|AltTokenType)
-#define T_EXTSTRINGLIT    token_id(T_STRINGLIT|AltTokenType)
-#define T_EXTRAWSTRINGLIT token_id(T_RAWSTRINGLIT|AltTokenType)
-
-template <typename IteratorT, typename PositionT>
-typename lexer_base<IteratorT, PositionT>::lexer_data const
-lexer<IteratorT, PositionT>::init_data_cpp0x[INIT_DATA_CPP0X_SIZE] =
-{
-    TOKEN_DATA(EXTCHARLIT, EXTCHAR_SPEC "'"
-                "(" ESCAPESEQ OR UNIVERSALCHAR OR "[^\\n\\r\\\\']" ")+" "'"),
-    TOKEN_DATA(EXTSTRINGLIT, EXTCHAR_SPEC Q("\"")
-                "(" ESCAPESEQ OR UNIVERSALCHAR OR "[^\\n\\r\\\\\"]" ")*" Q("\"")),
-    TOKEN_DATA(RAWSTRINGLIT, CHAR_SPEC "R" Q("\"")
-                "(" ESCAPESEQ OR UNIVERSALCHAR OR "[^\\\\\"]" ")*" Q("\"")),
-    TOKEN_DATA(EXTRAWSTRINGLIT, EXTCHAR_SPEC "R" Q("\"")
-                "(" ESCAPESEQ OR UNIVERSALCHAR OR "[^\\\\\"]" ")*" Q("\"")),
-    TOKEN_DATA(ALIGNAS, "alignas"),
-    TOKEN_DATA(ALIGNOF, "alignof"),
-    TOKEN_DATA(CHAR16_T, "char16_t"),
-    TOKEN_DATA(CHAR32_T, "char32_t"),
-    TOKEN_DATA(CONSTEXPR, "constexpr"),
-    TOKEN_DATA(DECLTYPE, "decltype"),
-    TOKEN_DATA(NOEXCEPT, "noexcept"),
-    TOKEN_DATA(NULLPTR, "nullptr"),
-    TOKEN_DATA(STATICASSERT, "static_assert"),
-    TOKEN_DATA(THREADLOCAL, "threadlocal"),
-    { token_id(0), "", 0, LEXER_STATE_NORMAL }       // this should be the last entry
-};
-
 ///////////////////////////////////////////////////////////////////////////////
 //  undefine macros, required for regular expression definitions
 #undef INCLUDEDEF
@@ -3458,25 +3375,11 @@ lexer<IteratorT, PositionT>::init_data_cpp0x[INIT_DATA_CPP0X_SIZE] =
 #undef CCOMMENT
 #undef PPSPACE
 #undef DIGIT
-#undef OCTALDIGIT
-#undef HEXDIGIT
-#undef NONDIGIT
-#undef OPTSIGN
-#undef EXPSTART
-#undef EXPONENT
-#undef LONGINTEGER_SUFFIX
-#undef INTEGER_SUFFIX
+#undef WIDTH
 #undef INTEGER
-#undef FLOAT_SUFFIX
-#undef CHAR_SPEC
-#undef BACKSLASH
 #undef ESCAPESEQ
-#undef HEXQUAD
-#undef UNIVERSALCHAR
-#undef PP_NUMBERDEF
 
 #undef Q
-#undef TRI
 #undef OR
 
 #undef TOKEN_DATA
@@ -3493,52 +3396,17 @@ lexer_base<IteratorT, PositionT>::lexer_base()
 
 template <typename IteratorT, typename PositionT>
 inline void
-lexer<IteratorT, PositionT>::init_dfa(boost::wave::language_support lang)
+lexer<IteratorT, PositionT>::init_dfa(boost::wave::language_support)
 {
     if (this->has_compiled_dfa())
         return;
 
-// if pp-numbers should be preferred, insert the corresponding rule first
-    if (boost::wave::need_prefer_pp_numbers(lang)) {
-        for (int j = 0; 0 != init_data_pp_number[j].tokenid; ++j) {
-            this->register_regex(init_data_pp_number[j].tokenregex,
-                init_data_pp_number[j].tokenid, init_data_pp_number[j].tokencb,
-                init_data_pp_number[j].lexerstate);
-        }
-    }
-
-// if in C99 mode, some of the keywords are not valid
-    if (!boost::wave::need_c99(lang)) {
-        for (int j = 0; 0 != init_data_cpp[j].tokenid; ++j) {
-            this->register_regex(init_data_cpp[j].tokenregex,
-                init_data_cpp[j].tokenid, init_data_cpp[j].tokencb,
-                init_data_cpp[j].lexerstate);
-        }
-    }
-
-// if in C++0x mode, add all new keywords
-#if BOOST_WAVE_SUPPORT_CPP0X != 0
-    if (boost::wave::need_cpp0x(lang)) {
-        for (int j = 0; 0 != init_data_cpp0x[j].tokenid; ++j) {
-            this->register_regex(init_data_cpp0x[j].tokenregex,
-                init_data_cpp0x[j].tokenid, init_data_cpp0x[j].tokencb,
-                init_data_cpp0x[j].lexerstate);
-        }
-    }
-#endif
-
     for (int i = 0; 0 != init_data[i].tokenid; ++i) {
         this->register_regex(init_data[i].tokenregex, init_data[i].tokenid,
             init_data[i].tokencb, init_data[i].lexerstate);
     }
 }
 
-///////////////////////////////////////////////////////////////////////////////
-// get time of last compilation of this file
-template <typename IteratorT, typename PositionT>
-boost::wave::util::time_conversion_helper
-    lexer<IteratorT, PositionT>::compilation_time(__DATE__ " " __TIME__);
-
 ///////////////////////////////////////////////////////////////////////////////
 }   // namespace lexer
 
@@ -3552,34 +3420,26 @@ init_lexer (lexer::lexer<IteratorT, PositionT> &lexer,
     if (lexer.has_compiled_dfa())
         return;     // nothing to do
 
-    using std::ifstream;
-    using std::ofstream;
-    using std::ios;
-    using std::cerr;
-    using std::endl;
-
-ifstream dfa_in("wave_slex_lexer.dfa", ios::in|ios::binary);
+// use the tables generated at build time
+    typedef typename lexer::lexer<IteratorT, PositionT>::dfa_view dfa_view;
+    p4l::lexer_tables const& tables = p4l::precompiled_lexer_tables;
+    if (!force_reinit) {
+        lexer.set_dfa(std::vector<dfa_view>{dfa_view{tables.state_count,
+            tables.class_count, tables.classes, tables.transitions,
+            tables.acceptance, tables.tokens}});
+        return;
+    }
 
-    lexer.init_dfa(language);
-    if (force_reinit || !dfa_in.is_open() ||
-        !lexer.load (dfa_in, (long)lexer.get_compilation_time()))
-    {
 #if defined(BOOST_SPIRIT_DEBUG)
-        cerr << "Compiling regular expressions for slex ...";
+    std::cerr << "Compiling regular expressions for slex ...";
 #endif // defined(BOOST_SPIRIT_DEBUG)
 
-        dfa_in.close();
-        lexer.create_dfa();
-
-    ofstream dfa_out ("wave_slex_lexer.dfa", ios::out|ios::binary|ios::trunc);
-
-        if (dfa_out.is_open())
-            lexer.save (dfa_out, (long)lexer.get_compilation_time());
+    lexer.init_dfa(language);
+    lexer.create_dfa();
 
 #if defined(BOOST_SPIRIT_DEBUG)
-        cerr << " Done." << endl;
+    std::cerr << " Done." << std::endl;
 #endif // defined(BOOST_SPIRIT_DEBUG)
-    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3600,9 +3460,8 @@ class slex_functor : public p4l::p4lex_input_interface<typename lexer::lexer<Ite
 
     slex_functor(IteratorT const &first_, IteratorT const &last_, PositionT const &pos_, boost::wave::language_support language_)
 		: first(first_, last_, pos_), language(language_), at_eof(false)
+		, lexer(get_lexer())
     {
-        // initialize lexer dfa tables
-        init_lexer(lexer, language_);
     }
     virtual ~slex_functor() {}
 
@@ -3614,7 +3473,7 @@ class slex_functor : public p4l::p4lex_input_interface<typename lexer::lexer<Ite
             // generate and return the next token
             std::string value;
             PositionT pos = first.get_position();   // begin of token position
-            token_id id = token_id(lexer.next_token(first, last, &value));
+            token_id id = token_id(lexer.match_token(first, last, &value));
 
                 if ((token_id)(-1) == id)
                     id = T_EOF;     // end of input reached
@@ -3626,6 +3485,9 @@ class slex_functor : public p4l::p4lex_input_interface<typename lexer::lexer<Ite
                 {
                 //  The cast should avoid spurious warnings about missing case labels
                 //  for the other token ids's.
+                    if (T_IDENTIFIER == id)
+                        id = token_id(p4l::find_keyword(value));
+
                     switch (id) {
                     case T_IDENTIFIER:
                     // test identifier characters for validity (throws if
@@ -3741,17 +3603,31 @@ private:
     iterator_type first;
     iterator_type last;
     boost::wave::language_support language;
-    static lexer::lexer<IteratorT, PositionT> lexer;   // needed only once
-
     bool at_eof;
+    lexer::lexer<IteratorT, PositionT> const& lexer;
+
+    static lexer::lexer<IteratorT, PositionT> const& get_lexer();
 
 #if BOOST_WAVE_SUPPORT_PRAGMA_ONCE != 0
     include_guards<token_type> guards;
 #endif
 };
 
+// The DFA tables are the same for all languages, so all functors share
+// one lexer.  It is initialized once on first use, the initialization of
+// a function local static is thread-safe, and it is only read afterwards,
+// so the functors need no locking to get tokens.
 template <typename IteratorT, typename PositionT>
-lexer::lexer<IteratorT, PositionT> slex_functor<IteratorT, PositionT>::lexer;
+inline lexer::lexer<IteratorT, PositionT> const&
+slex_functor<IteratorT, PositionT>::get_lexer()
+{
+    struct initialized_lexer : lexer::lexer<IteratorT, PositionT>
+    {
+        initialized_lexer() { init_lexer(*this, boost::wave::support_cpp0x); }
+    };
+    static initialized_lexer const instance;
+    return instance;
+}
 
 #undef T_EXTCHARLIT
 #undef T_EXTSTRINGLIT
@@ -0,0 +1,34 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace p4l {
+
+/**
+ * lexer_tables
+ *
+ *     The DFA of the slex lexer for the P4 token definitions, generated
+ *     at build time by lexer_tables_generator.  The bytes are mapped to
+ *     equivalence classes, the transition table has an entry for each
+ *     class in each state.  The acceptance table has the index of the
+ *     token definition accepted in each state or 0xffff.
+ */
+struct lexer_tables {
+	std::size_t state_count;
+	std::size_t class_count;
+	std::uint8_t const* classes;
+	std::uint16_t const* transitions;
+	std::uint16_t const* acceptance;
+	int const* tokens;
+	std::size_t token_count;
+};
+
+/// \brief defined in the generated lexer_tables.cpp
+extern lexer_tables const precompiled_lexer_tables;
+
+} // namespace p4l
@@ -0,0 +1,81 @@
+/**
+ * Builds the DFA of the slex lexer for the P4 token definitions and
+ * writes it as constant tables to the C++ source file named on the
+ * command line, so that the lexer need not compile its regular
+ * expressions at run time.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "lexer.h"
+
+namespace {
+
+using lexer_type = boost::wave::cpplexer::slex::lexer::lexer<std::string::iterator, boost::wave::util::file_position_type>;
+
+void write_entries(std::ostream& out, std::uint16_t const* entries, std::size_t count, std::size_t per_line)
+{
+	for (std::size_t it = 0; it != count; ++it) {
+		if (entries[it] == boost::spirit::classic::invalid_entry) {
+			out << 'X';
+		} else {
+			out << entries[it];
+		}
+		out << ((it + 1) % per_line == 0 || it + 1 == count ? ",\n" : ",");
+	}
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc != 2) {
+		std::cerr << "usage: " << argv[0] << " <output file>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::ofstream out(argv[1], std::ios::trunc);
+	out << "// generated by lexer_tables_generator, do not edit\n\n"
+		<< "#include \"lexer_tables.h\"\n\n"
+		<< "namespace p4l {\n\n"
+		<< "namespace {\n\n"
+		<< "constexpr std::uint16_t X = 0xffff;\n";
+	lexer_type lexer;
+	lexer.init_dfa(boost::wave::support_cpp0x);
+	lexer.create_dfa();
+	auto& dfa = lexer.get_dfa().front();
+	out << "\n// " << dfa.state_count << " states, " << dfa.class_count << " byte classes\n"
+		<< "constexpr std::uint8_t classes[] = {\n";
+	for (std::size_t it = 0; it != 256; ++it) {
+		out << unsigned(dfa.classes[it]) << ((it + 1) % 32 == 0 ? ",\n" : ",");
+	}
+	out << "};\n"
+		<< "constexpr std::uint16_t transitions[] = {\n";
+	write_entries(out, dfa.transitions, dfa.state_count * dfa.class_count, dfa.class_count);
+	out << "};\n"
+		<< "constexpr std::uint16_t acceptance[] = {\n";
+	write_entries(out, dfa.acceptance, dfa.state_count, 32);
+	out << "};\n"
+		<< "constexpr int tokens[] = {\n";
+	// the token definitions never accepted in a state are left out
+	std::size_t token_count = 0;
+	for (std::size_t it = 0; it != dfa.state_count; ++it) {
+		if (dfa.acceptance[it] != boost::spirit::classic::invalid_entry) {
+			token_count = std::max<std::size_t>(token_count, dfa.acceptance[it] + 1);
+		}
+	}
+	for (std::size_t it = 0; it != token_count; ++it) {
+		out << dfa.tokens[it] << ",\n";
+	}
+	out << "};\n"
+		<< "\n} // namespace\n\n"
+		<< "lexer_tables const precompiled_lexer_tables = {\n"
+		<< "\t" << dfa.state_count << ", " << dfa.class_count << ", classes, transitions, acceptance, tokens, " << token_count << "\n"
+		<< "};\n\n"
+		<< "} // namespace p4l\n";
+	out.close();
+	return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
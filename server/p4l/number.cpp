@@ -0,0 +1,113 @@
+#include "number.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace p4l {
+
+namespace {
+
+constexpr std::uint64_t MAX_WIDTH = std::numeric_limits<std::uint32_t>::max();
+
+// the value of a digit in any base up to 16, or 16 if it is no digit
+unsigned get_digit(char c) noexcept
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return 16;
+}
+
+} // namespace
+
+boost::optional<number> number::parse(std::string_view text)
+{
+	number result;
+	auto it = text.begin();
+	auto end = text.end();
+	// the leading decimal digits are the width if 'w' or 's' follows them
+	std::uint64_t width = 0;
+	auto digits = it;
+	for (; digits != end && *digits >= '0' && *digits <= '9'; ++digits) {
+		width = std::min(width * 10 + (*digits - '0'), MAX_WIDTH + 1);
+	}
+	if (digits != it && digits != end && (*digits == 'w' || *digits == 's')) {
+		result._signed = *digits == 's';
+		if (width == 0 || width > MAX_WIDTH || (result._signed && width < 2)) {
+			return boost::none;
+		}
+		result._width = static_cast<std::uint32_t>(width);
+		it = digits + 1;
+	}
+	unsigned base = 10;
+	if (end - it > 1 && *it == '0') {
+		switch (it[1]) {
+		case 'b': case 'B': base = 2; it += 2; break;
+		case 'o': case 'O': base = 8; it += 2; break;
+		case 'd': case 'D': base = 10; it += 2; break;
+		case 'x': case 'X': base = 16; it += 2; break;
+		default:;
+		}
+	}
+	bool has_digits = false;
+	for (; it != end; ++it) {
+		if (*it == '_') {
+			continue;
+		}
+		auto digit = get_digit(*it);
+		if (digit >= base) {
+			return boost::none;
+		}
+		result.multiply_add(base, digit);
+		has_digits = true;
+	}
+	if (!has_digits) {
+		return boost::none;
+	}
+	result.truncate();
+	return result;
+}
+
+std::int64_t number::to_int64() const noexcept
+{
+	limb_type low = _limbs.empty() ? 0 : _limbs.front();
+	if (is_negative() && _width < limb_bits) {
+		low |= ~limb_type(0) << _width;
+	}
+	return static_cast<std::int64_t>(low);
+}
+
+void number::multiply_add(limb_type factor, limb_type addend)
+{
+	// the factor is a base up to 16, so the halves of a limb times the
+	// factor fit in a limb with the carry
+	limb_type carry = addend;
+	for (auto& limb : _limbs) {
+		limb_type low = (limb & 0xffffffff) * factor + carry;
+		limb_type high = (limb >> 32) * factor + (low >> 32);
+		limb = high << 32 | (low & 0xffffffff);
+		carry = high >> 32;
+	}
+	// the limbs above the width would be cut off anyway
+	if (carry != 0 && (_width == 0 || _limbs.size() * limb_bits < _width)) {
+		_limbs.push_back(carry);
+	}
+}
+
+void number::truncate()
+{
+	if (_width != 0 && _limbs.size() * limb_bits > _width) {
+		_limbs.back() &= ~limb_type(0) >> (limb_bits - _width % limb_bits);
+	}
+	while (!_limbs.empty() && _limbs.back() == 0) {
+		_limbs.pop_back();
+	}
+}
+
+} // namespace p4l
@@ -0,0 +1,73 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <boost/container/small_vector.hpp>
+#include <boost/optional.hpp>
+
+namespace p4l {
+
+/**
+ * number
+ *
+ *     The value of a P4 integer literal of any width.  The bits are
+ *     kept in 64-bit limbs, least significant first, with no leading
+ *     zero limbs.  Two limbs are kept in place, so the literals up to
+ *     128 bits use no heap.  A literal with a width, e.g. 48w0x0a0b,
+ *     holds its value modulo 2^width, the bits of a negative signed
+ *     literal are its two's complement in the width.
+ */
+class number {
+ public:
+	using limb_type = std::uint64_t;
+	using limbs_type = boost::container::small_vector<limb_type, 2>;
+
+	static constexpr std::size_t limb_bits = 64;
+
+	/// \brief parse the literal [width][ws][0x|0o|0b|0d]digits, the digits may have '_' between them
+	static boost::optional<number> parse(std::string_view text);
+
+	bool has_width() const noexcept {
+		return _width != 0;
+	}
+	std::uint32_t get_width() const noexcept {
+		return _width;
+	}
+	bool is_signed() const noexcept {
+		return _signed;
+	}
+	limbs_type const& get_limbs() const noexcept {
+		return _limbs;
+	}
+	bool test_bit(std::size_t bit) const noexcept {
+		return bit / limb_bits < _limbs.size() && (_limbs[bit / limb_bits] >> bit % limb_bits & 1) != 0;
+	}
+	bool is_negative() const noexcept {
+		return _signed && test_bit(_width - 1);
+	}
+	/// \brief the low 64 bits, sign extended if the number is negative
+	std::int64_t to_int64() const noexcept;
+
+	bool operator==(number const& other) const noexcept {
+		return _width == other._width && _signed == other._signed && _limbs == other._limbs;
+	}
+	bool operator!=(number const& other) const noexcept {
+		return !(*this == other);
+	}
+
+ private:
+	void multiply_add(limb_type factor, limb_type addend);
+	void truncate();
+
+	limbs_type _limbs;
+	std::uint32_t _width = 0;
+	bool _signed = false;
+};
+
+} // namespace p4l
@@ -4,77 +4,131 @@
 
 #pragma once
 
-#include <istream>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
 #include <string>
-#include <iostream>
-
-#include <boost/spirit/include/support_multi_pass.hpp>
+#include <vector>
 
+#include <boost/wave/cpplexer/cpp_lex_interface.hpp>
 #include <boost/wave/language_support.hpp>
 #include <boost/wave/util/file_position.hpp>
-#include <boost/wave/util/functor_input.hpp>
 
 #include "p4lex_interface.h"
 
 namespace p4l {
 
+/// \brief a copy of a p4lex_iterator reads a token that was dropped from the buffer, as multi_pass throws it
+class illegal_backtracking : public std::exception {
+ public:
+	char const* what() const noexcept override {
+		return "p4l::illegal_backtracking";
+	}
+};
+
 namespace impl {
 
+/**
+ * p4lex_token_buffer
+ *
+ *     The lexer shared by all copies of a p4lex_iterator together with
+ *     the tokens that some copy may still need.  The tokens are kept
+ *     in a ring buffer indexed by the sequence number of the token in
+ *     the input.  While a single iterator refers to the buffer and no
+ *     mark is set, tokens behind the iterator are dropped as it
+ *     advances, so the ring holds only a few tokens.  Otherwise the
+ *     ring grows when it is full.
+ *
+ *     The buffer is used by a single thread, the number of iterators
+ *     is a plain counter.
+ */
 template <typename TokenT>
-class p4lex_iterator_functor_shim {
-
+class p4lex_token_buffer {
+ public:
+	using lexer_type = boost::wave::cpplexer::lex_input_interface<TokenT>;
 	using position_type = typename TokenT::position_type;
 
- public:
-	p4lex_iterator_functor_shim() = default;
+	explicit p4lex_token_buffer(lexer_type* lexer)
+		: _lexer(lexer), _ring(initial_capacity), _first(0), _last(0), _iterators(1)
+	{}
 
-	using result_type = TokenT;
-	using unique = p4lex_iterator_functor_shim;
-	using shared = boost::wave::cpplexer::lex_input_interface<TokenT>*;
+	TokenT& at(std::uint64_t index) {
+		if (index < _first) {
+			throw illegal_backtracking();
+		}
+		while (index >= _last) {
+			fetch();
+		}
+		return _ring[index & (_ring.size() - 1)];
+	}
 
-	static result_type const eof;
+	// called after the only iterator has moved to index
+	void advance_to(std::uint64_t index) noexcept {
+		if (_iterators == 1 && _marks.empty()) {
+			_first = index;
+		}
+	}
 
-	template <typename MultiPass>
-	static result_type& get_next(MultiPass& mp, result_type& result) {
-		return mp.shared()->ftor->get(result);
+	// called when no iterator will go back beyond index
+	void discard_before(std::uint64_t index) noexcept {
+		if (_marks.empty()) {
+			_first = index;
+		}
 	}
 
-	// this will be called whenever the last reference to a multi_pass will
-	// be released
-	template <typename MultiPass>
-	static void destroy(MultiPass& mp) {
-		delete mp.shared()->ftor;
+	void set_position(position_type const& pos) {
+		_lexer->set_position(pos);
 	}
 
-	template <typename MultiPass>
-	static void set_position(MultiPass& mp, position_type const& pos) {
-		mp.shared()->ftor->set_position(pos);
+	bool has_include_guards(std::string& guard_name) const {
+		return _lexer->has_include_guards(guard_name);
 	}
 
-	template <typename MultiPass>
-	static bool has_include_guards(MultiPass& mp, std::string& guard_name) {
-		return mp.shared()->ftor->has_include_guards(guard_name);
+	std::uint64_t push_mark(std::uint64_t index) {
+		_marks.push_back(index);
+		return index;
 	}
-};
 
-template <typename TokenT>
-typename p4lex_iterator_functor_shim<TokenT>::result_type const
-p4lex_iterator_functor_shim<TokenT>::eof = typename p4lex_iterator_functor_shim<TokenT>::result_type();
+	void pop_mark() {
+		_marks.pop_back();
+	}
 
-}  // namespace impl
+	void attach() noexcept {
+		++_iterators;
+	}
+
+	static void detach(p4lex_token_buffer* buffer) noexcept {
+		if (buffer && --buffer->_iterators == 0) {
+			delete buffer;
+		}
+	}
 
-template <typename FunctorData>
-struct make_multi_pass {
-	using functor_data_type = std::pair<typename FunctorData::unique, typename FunctorData::shared>;
-	using result_type = typename FunctorData::result_type;
-	using input_policy = boost::spirit::iterator_policies::split_functor_input;
-	using ownership_policy = boost::spirit::iterator_policies::ref_counted;
-	using check_policy = boost::spirit::iterator_policies::no_check;
-	using storage_policy = boost::spirit::iterator_policies::split_std_deque;
-	using policy_type = boost::spirit::iterator_policies::default_policy<ownership_policy, check_policy, input_policy, storage_policy>;
-	using type = boost::spirit::multi_pass<functor_data_type, policy_type>;
+ private:
+	static constexpr std::size_t initial_capacity = 16;
+
+	void fetch() {
+		if (_last - _first == _ring.size()) {
+			std::vector<TokenT> ring(2 * _ring.size());
+			for (auto it = _first; it != _last; ++it) {
+				ring[it & (ring.size() - 1)] = std::move(_ring[it & (_ring.size() - 1)]);
+			}
+			_ring.swap(ring);
+		}
+		_lexer->get(_ring[_last & (_ring.size() - 1)]);
+		++_last;
+	}
+
+	std::unique_ptr<lexer_type> _lexer;
+	std::vector<TokenT> _ring;       // capacity is a power of 2
+	std::uint64_t _first;            // the oldest token kept
+	std::uint64_t _last;             // the next token to be read from the lexer
+	std::vector<std::uint64_t> _marks;
+	std::size_t _iterators;
 };
 
+}  // namespace impl
+
 /**
  * p4lex_iterator
  *
@@ -93,50 +147,155 @@ struct make_multi_pass {
  *           the 4th parameter contains the information about the mode the
  *           preprocessor is used in (C99/C++ mode etc.)
  *
- * Divide the given functor type into its components (unique and shared)
- * and build a std::pair from these parts
+ * The iterator is a cursor into the token buffer shared by its copies.
+ * Wave backtracks by copying the iterator, a copy keeps the tokens from
+ * its position on in the buffer.  Users of the iterator that look ahead
+ * themselves may instead mark the position and rewind to it.
  */
 template <typename TokenT>
-class p4lex_iterator : public make_multi_pass<impl::p4lex_iterator_functor_shim<TokenT>>::type {
-	using input_policy_type = impl::p4lex_iterator_functor_shim<TokenT>;
-	using base_type = typename make_multi_pass<input_policy_type>::type;
-	using functor_data_type = typename make_multi_pass<input_policy_type>::functor_data_type;
-	using unique_functor_type = typename input_policy_type::unique;
-	using shared_functor_type = typename input_policy_type::shared;
+class p4lex_iterator {
+	using buffer_type = impl::p4lex_token_buffer<TokenT>;
 
  public:
 	using token_type = TokenT;
 	using iterator_category = std::forward_iterator_tag;
+	using value_type = TokenT;
+	using difference_type = std::ptrdiff_t;
+	using pointer = TokenT const*;
+	using reference = TokenT const&;
+	using mark_type = std::uint64_t;
 
-	p4lex_iterator() = default;
+	p4lex_iterator() noexcept
+		: _buffer(nullptr), _index(0)
+	{}
 
 	template <typename IteratorT>
 	p4lex_iterator(IteratorT const &first, IteratorT const &last,
 				   typename TokenT::position_type const &pos,
 				   boost::wave::language_support language)
-		: base_type(functor_data_type(unique_functor_type(),
-									  p4lex_input_interface<TokenT>::new_lexer(first, last, pos, language)))
+		: _buffer(new buffer_type(p4lex_input_interface<TokenT>::new_lexer(first, last, pos, language))), _index(0)
 	{}
 
+	p4lex_iterator(p4lex_iterator const& other) noexcept
+		: _buffer(other._buffer), _index(other._index) {
+		if (_buffer) {
+			_buffer->attach();
+		}
+	}
+
+	p4lex_iterator(p4lex_iterator&& other) noexcept
+		: _buffer(other._buffer), _index(other._index) {
+		other._buffer = nullptr;
+	}
+
+	p4lex_iterator& operator=(p4lex_iterator const& other) noexcept {
+		if (other._buffer) {
+			other._buffer->attach();
+		}
+		buffer_type::detach(_buffer);
+		_buffer = other._buffer;
+		_index = other._index;
+		return *this;
+	}
+
+	p4lex_iterator& operator=(p4lex_iterator&& other) noexcept {
+		if (this != &other) {
+			buffer_type::detach(_buffer);
+			_buffer = other._buffer;
+			_index = other._index;
+			other._buffer = nullptr;
+		}
+		return *this;
+	}
+
+	~p4lex_iterator() {
+		buffer_type::detach(_buffer);
+	}
+
+	reference operator*() const {
+		return _buffer->at(_index);
+	}
+
+	pointer operator->() const {
+		return &_buffer->at(_index);
+	}
+
+	p4lex_iterator& operator++() {
+		// the token passed over has to be read from the lexer
+		_buffer->at(_index);
+		_buffer->advance_to(++_index);
+		return *this;
+	}
+
+	p4lex_iterator operator++(int) {
+		p4lex_iterator result(*this);
+		++*this;
+		return result;
+	}
+
+	friend bool operator==(p4lex_iterator const& lhs, p4lex_iterator const& rhs) {
+		if (lhs.is_eof()) {
+			return rhs.is_eof();
+		}
+		if (rhs.is_eof()) {
+			return false;
+		}
+		return lhs._buffer == rhs._buffer && lhs._index == rhs._index;
+	}
+
+	friend bool operator!=(p4lex_iterator const& lhs, p4lex_iterator const& rhs) {
+		return !(lhs == rhs);
+	}
+
+	/**
+	 * Keep the tokens from the current one on in the buffer until the
+	 * mark is released.  Marks are released in the reverse order.
+	 */
+	mark_type mark() {
+		return _buffer->push_mark(_index);
+	}
+
+	void rewind(mark_type mark) noexcept {
+		_index = mark;
+	}
+
+	void release() {
+		_buffer->pop_mark();
+		_buffer->advance_to(_index);
+	}
+
+	// Wave's cpp_grammar calls this at the points where it no longer backtracks
+	void clear_queue() noexcept {
+		_buffer->discard_before(_index);
+	}
+
 	void set_position(typename TokenT::position_type const &pos) {
 		// set the new position in the current token
-		auto &currtoken = this->base_type::dereference(*this);
+		auto &currtoken = _buffer->at(_index);
 		auto currpos = currtoken.get_position();
 
 		currpos.set_file(pos.get_file());
 		currpos.set_line(pos.get_line());
-		const_cast<token_type&>(currtoken).set_position(currpos);
+		currtoken.set_position(currpos);
 
 		// set the new position for future tokens as well
 		if (token_type::string_type::npos != currtoken.get_value().find_first_of('\n')) {
 			currpos.set_line(pos.get_line() + 1);
 		}
-		unique_functor_type::set_position(*this, currpos);
+		_buffer->set_position(currpos);
 	}
 
 	bool has_include_guards(std::string& guard_name) const {
-		return unique_functor_type::has_include_guards(*this, guard_name);
+		return _buffer->has_include_guards(guard_name);
+	}
+
+ private:
+	bool is_eof() const {
+		return !_buffer || _buffer->at(_index).is_eoi();
 	}
+
+	buffer_type* _buffer;
+	mark_type _index;
 };
 
 } // namespace p4l
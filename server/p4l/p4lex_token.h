@@ -106,7 +106,7 @@ inline std::ostream& operator<<(std::ostream& stream, p4lex_token<PositionT> con
 }
 
 /**
- * This overload is needed by the multi_pass/functor_input_policy to
+ * This overload is needed by the Wave pp_iterator to
  * validate a token instance.  It has to be defined in the same
  * namespace as the token class itself to allow ADL to find it.
 */
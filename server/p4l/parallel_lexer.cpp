@@ -0,0 +1,151 @@
+#include "parallel_lexer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+
+#include <boost/asio/post.hpp>
+
+namespace p4l {
+
+namespace {
+
+// the source is not split in chunks smaller than this
+constexpr std::size_t MIN_CHUNK_SIZE = 1 << 16;
+
+struct chunk {
+	std::vector<lexed_token> tokens;
+	line_state end_state = line_state::normal;
+};
+
+/// \brief lex the source from the start of a line in the state to its end
+void lex(std::string_view source, std::size_t offset, line_state state, std::vector<lexed_token>& tokens)
+{
+	Lexer lexer(source, offset, state, 1);
+	for (auto id = lexer.next(); id != boost::wave::T_END; id = lexer.next()) {
+		tokens.push_back({id, static_cast<std::uint32_t>(lexer.get_offset()), static_cast<std::uint32_t>(lexer.get_length())});
+	}
+}
+
+/// \brief lex the chunk [begin, end) of the source starting in normal state
+chunk lex_chunk(std::string_view source, std::size_t begin, std::size_t end)
+{
+	chunk result;
+	// the tokens are about 4 bytes apart in typical sources
+	result.tokens.reserve((end - begin) / 4);
+	std::vector<line_checkpoint> lines;
+	Lexer lexer(source.substr(0, end), begin, line_state::normal, 1);
+	lexer.record_lines(&lines);
+	for (auto id = lexer.next(); id != boost::wave::T_END; id = lexer.next()) {
+		result.tokens.push_back({id, static_cast<std::uint32_t>(lexer.get_offset()), static_cast<std::uint32_t>(lexer.get_length())});
+		if (lines.size() > 1) {
+			lines.erase(lines.begin(), lines.end() - 1);
+		}
+	}
+	// the end of the chunk is the start of a line, the lexer reached it
+	if (!lines.empty() && lines.back().offset == end) {
+		result.end_state = lines.back().state;
+	}
+	return result;
+}
+
+} // namespace
+
+std::vector<lexed_token> lex_sequential(std::string_view source)
+{
+	std::vector<lexed_token> tokens;
+	lex(source, 0, line_state::normal, tokens);
+	return tokens;
+}
+
+std::vector<std::size_t> find_chunk_boundaries(std::string_view source, std::size_t chunks)
+{
+	std::vector<std::size_t> boundaries{0};
+	auto size = source.size();
+	auto chunk_size = std::max(MIN_CHUNK_SIZE, size / std::max<std::size_t>(chunks, 1) + 1);
+	auto data = source.data();
+	auto next = chunk_size;
+	auto state = line_state::normal;
+	for (std::size_t it = 0; it < size; ++it) {
+		auto c = data[it];
+		switch (state) {
+		case line_state::normal:
+			if (c == '\n') {
+				if (it + 1 >= next && it + 1 < size) {
+					boundaries.push_back(it + 1);
+					next = it + 1 + chunk_size;
+				}
+			} else if (c == '/' && it + 1 < size && data[it + 1] == '/') {
+				auto newline = static_cast<char const*>(std::memchr(data + it, '\n', size - it));
+				it = (newline ? newline - data : size) - 1;
+			} else if (c == '/' && it + 1 < size && data[it + 1] == '*') {
+				state = line_state::block_comment;
+				++it;
+			} else if (c == '"') {
+				state = line_state::string;
+			} else if (c == '#') {
+				state = line_state::directive;
+			}
+			break;
+		case line_state::block_comment:
+			if (c == '*' && it + 1 < size && data[it + 1] == '/') {
+				state = line_state::normal;
+				++it;
+			}
+			break;
+		case line_state::string:
+			if (c == '\\') {
+				++it;
+			} else if (c == '"') {
+				state = line_state::normal;
+			}
+			break;
+		case line_state::directive:
+			if (c == '\\' && it + 1 < size && data[it + 1] == '\n') {
+				++it;
+			} else if (c == '\n') {
+				state = line_state::normal;
+				--it; // the newline ends a line outside of the directive
+			}
+			break;
+		}
+	}
+	return boundaries;
+}
+
+std::vector<lexed_token> lex_parallel(std::string_view source, boost::asio::thread_pool& pool, std::size_t chunks)
+{
+	auto boundaries = find_chunk_boundaries(source, chunks);
+	boundaries.push_back(source.size());
+	std::vector<std::future<chunk>> futures;
+	for (std::size_t it = 0; it + 1 != boundaries.size(); ++it) {
+		std::packaged_task<chunk()> task(
+			[source, begin = boundaries[it], end = boundaries[it + 1]] { return lex_chunk(source, begin, end); });
+		futures.push_back(task.get_future());
+		boost::asio::post(pool, std::move(task));
+	}
+	std::vector<lexed_token> tokens;
+	std::size_t it = 0;
+	for (; it != futures.size(); ++it) {
+		auto result = futures[it].get();
+		if (it + 1 != futures.size() && result.end_state != line_state::normal) {
+			// the scan missed something, lex the rest from where this chunk starts
+			break;
+		}
+		if (tokens.empty()) {
+			tokens = std::move(result.tokens);
+		} else {
+			tokens.insert(tokens.end(), result.tokens.begin(), result.tokens.end());
+		}
+	}
+	if (it != futures.size()) {
+		auto begin = boundaries[it];
+		for (++it; it != futures.size(); ++it) {
+			futures[it].wait();
+		}
+		lex(source, begin, line_state::normal, tokens);
+	}
+	return tokens;
+}
+
+} // namespace p4l
@@ -0,0 +1,36 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include "lexer.h"
+
+namespace p4l {
+
+/// \brief all tokens of the source lexed by p4l::Lexer on the calling thread
+std::vector<lexed_token> lex_sequential(std::string_view source);
+
+/**
+ * lex_parallel
+ *
+ *     Splits the source in about as many chunks at the starts of lines
+ *     outside of comments, strings and directives, found by a scan that
+ *     only follows those, and lexes the chunks on the pool.  The chunks
+ *     are lexed up to their ends, so that the tokens have their offsets
+ *     in the source and are joined as they are.  Should a chunk end
+ *     inside of something after all, the rest is lexed sequentially, so
+ *     that the tokens are always the ones of lex_sequential.
+ */
+std::vector<lexed_token> lex_parallel(std::string_view source, boost::asio::thread_pool& pool, std::size_t chunks);
+
+/// \brief the offsets the chunks of lex_parallel start at, the first is 0
+std::vector<std::size_t> find_chunk_boundaries(std::string_view source, std::size_t chunks);
+
+} // namespace p4l
@@ -0,0 +1,171 @@
+#include "parallel_parser.h"
+
+#include <algorithm>
+#include <future>
+#include <iterator>
+
+#include <boost/asio/post.hpp>
+
+namespace p4l {
+
+using namespace boost::wave;
+
+namespace {
+
+// the tokens are not split in chunks smaller than this
+constexpr std::size_t MIN_CHUNK_SIZE = 1 << 12;
+
+struct chunk {
+	ast tree;
+	std::vector<parse_error> errors;
+	bool complete = false; // every declaration is parsed without an error at the top level
+};
+
+int get_id(std::vector<lexed_token> const& tokens, std::size_t index)
+{
+	return tokens[index].id;
+}
+
+int get_id(token_arena const& tokens, std::size_t index)
+{
+	return tokens.get_id(tokens[index]);
+}
+
+bool is_skipped(int id) noexcept
+{
+	return IS_CATEGORY(id, WhiteSpaceTokenType) || IS_CATEGORY(id, EOLTokenType) || IS_CATEGORY(id, EOFTokenType)
+		|| IS_CATEGORY(id, PPTokenType);
+}
+
+template <typename Tokens>
+std::vector<std::size_t> find_boundaries(Tokens const& tokens, std::size_t chunks)
+{
+	std::vector<std::size_t> boundaries{0};
+	auto size = tokens.size();
+	auto chunk_size = std::max(MIN_CHUNK_SIZE, size / std::max<std::size_t>(chunks, 1) + 1);
+	auto next = chunk_size;
+	std::ptrdiff_t braces = 0;
+	std::ptrdiff_t parentheses = 0;
+	int last = T_END;
+	auto ended = false; // a declaration may end at the last token
+	for (std::size_t it = 0; it != size; ++it) {
+		auto id = get_id(tokens, it);
+		if (is_skipped(id)) {
+			continue;
+		}
+		// a semicolon after a brace ends an initializer, e.g. of a constant
+		if (ended && it >= next && !(last == T_R_BRACE && id == T_SEMICOLON)) {
+			boundaries.push_back(it);
+			next = it + chunk_size;
+		}
+		switch (id) {
+		case T_L_BRACE: ++braces; break;
+		case T_R_BRACE: --braces; break;
+		case T_L_PAREN: ++parentheses; break;
+		case T_R_PAREN: --parentheses; break;
+		default:;
+		}
+		ended = (id == T_SEMICOLON || id == T_R_BRACE) && braces == 0 && parentheses == 0;
+		last = id;
+	}
+	return boundaries;
+}
+
+template <typename Tokens>
+chunk parse_chunk(Tokens const& tokens, std::size_t begin, std::size_t end, parse_mode mode)
+{
+	chunk result;
+	Parser parser(tokens, begin, end, mode);
+	result.complete = true;
+	while (!parser.at_end()) {
+		if (parser.parse_next() == ast::none) {
+			// the parser may have looked past the end to recover
+			result.complete = false;
+		}
+	}
+	result.errors = parser.get_errors();
+	result.tree = parser.release();
+	return result;
+}
+
+template <typename Tokens>
+parse_result parse(Tokens const& tokens, boost::asio::thread_pool& pool, std::size_t chunks, parse_mode mode)
+{
+	auto boundaries = find_boundaries(tokens, chunks);
+	boundaries.push_back(tokens.size());
+	parse_result result;
+	if (boundaries.size() == 2) {
+		Parser parser(tokens, 0, tokens.size(), mode);
+		result.tree = parser.run();
+		result.errors = parser.get_errors();
+		return result;
+	}
+	std::vector<std::future<chunk>> futures;
+	for (std::size_t it = 0; it + 1 != boundaries.size(); ++it) {
+		std::packaged_task<chunk()> task([&tokens, begin = boundaries[it], end = boundaries[it + 1], mode] {
+			return parse_chunk(tokens, begin, end, mode);
+		});
+		futures.push_back(task.get_future());
+		boost::asio::post(pool, std::move(task));
+	}
+	std::vector<ast> parts;
+	std::size_t it = 0;
+	while (it != futures.size()) {
+		auto part = futures[it].get();
+		if (part.complete) {
+			parts.push_back(std::move(part.tree));
+			result.errors.insert(result.errors.end(), part.errors.begin(), part.errors.end());
+			++it;
+			continue;
+		}
+		// the chunk starts where a declaration does, parse from there to where another chunk starts
+		Parser parser(tokens, boundaries[it], tokens.size(), mode);
+		auto next = it + 1;
+		while (!parser.at_end()) {
+			auto node = parser.parse_next();
+			auto position = parser.get_position();
+			while (boundaries[next] < position) {
+				++next;
+			}
+			if (node != ast::none && boundaries[next] == position) {
+				break;
+			}
+		}
+		if (parser.at_end()) {
+			next = futures.size();
+		}
+		result.errors.insert(result.errors.end(), parser.get_errors().begin(), parser.get_errors().end());
+		parts.push_back(parser.release());
+		// the chunks parsed again refer to the tokens until they are done
+		for (++it; it < next; ++it) {
+			futures[it].wait();
+		}
+	}
+	result.tree = ast::link(std::move(parts));
+	return result;
+}
+
+} // namespace
+
+parse_result parse_parallel(std::vector<lexed_token> const& tokens, boost::asio::thread_pool& pool, std::size_t chunks,
+							parse_mode mode)
+{
+	return parse(tokens, pool, chunks, mode);
+}
+
+parse_result parse_parallel(token_arena const& tokens, boost::asio::thread_pool& pool, std::size_t chunks, parse_mode mode)
+{
+	return parse(tokens, pool, chunks, mode);
+}
+
+std::vector<std::size_t> find_declaration_boundaries(std::vector<lexed_token> const& tokens, std::size_t chunks)
+{
+	return find_boundaries(tokens, chunks);
+}
+
+std::vector<std::size_t> find_declaration_boundaries(token_arena const& tokens, std::size_t chunks)
+{
+	return find_boundaries(tokens, chunks);
+}
+
+} // namespace p4l
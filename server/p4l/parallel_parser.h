@@ -0,0 +1,46 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include "ast.h"
+#include "parser.h"
+#include "token_arena.h"
+
+namespace p4l {
+
+struct parse_result {
+	ast tree;
+	std::vector<parse_error> errors;
+};
+
+/**
+ * parse_parallel
+ *
+ *     Splits the tokens in about as many chunks between top-level
+ *     declarations, found by a pass that only matches the braces and
+ *     the parentheses, and parses the chunks on the pool, each into a
+ *     tree of its own.  The trees are linked in order into one.  A
+ *     chunk is taken if all of its declarations are parsed without an
+ *     error at the top level, otherwise it is parsed again sequentially
+ *     from its start until a declaration ends where a later chunk
+ *     starts, so that the tree is always the one of Parser::run.
+ *     More chunks than threads let the threads that are done early
+ *     take the chunks left in the queue of the pool.
+ */
+parse_result parse_parallel(std::vector<lexed_token> const& tokens, boost::asio::thread_pool& pool, std::size_t chunks,
+							parse_mode mode = parse_mode::full);
+parse_result parse_parallel(token_arena const& tokens, boost::asio::thread_pool& pool, std::size_t chunks,
+							parse_mode mode = parse_mode::full);
+
+/// \brief the tokens the chunks of parse_parallel start at, the first is 0
+std::vector<std::size_t> find_declaration_boundaries(std::vector<lexed_token> const& tokens, std::size_t chunks);
+std::vector<std::size_t> find_declaration_boundaries(token_arena const& tokens, std::size_t chunks);
+
+} // namespace p4l
@@ -1,16 +1,1870 @@
 #include "parser.h"
 
+#include <utility>
 
 namespace p4l {
 
-void Parser::run()
+using namespace boost::wave;
+
+namespace {
+
+bool is_skipped(int id) noexcept
 {
-	while (true) {
-		switch (token) {
-		case Token::END: return;
+	return IS_CATEGORY(id, WhiteSpaceTokenType) || IS_CATEGORY(id, EOLTokenType) || IS_CATEGORY(id, EOFTokenType)
+		|| IS_CATEGORY(id, PPTokenType);
+}
+
+/// \brief an identifier or one of the keywords P4 allows as a name
+bool is_name(int id) noexcept
+{
+	switch (id) {
+	case T_IDENTIFIER:
+	case T_TYPE_IDENTIFIER:
+	case T_APPLY:
+	case T_KEY:
+	case T_ACTIONS:
+	case T_STATE:
+	case T_ENTRIES:
+	case T_TYPE:
+	case T_PRIORITY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/// \brief any identifier or keyword, e.g. the name of a member or an annotation
+bool is_word(int id) noexcept
+{
+	return id > 0 && (IS_CATEGORY(id, IdentifierTokenType) || IS_CATEGORY(id, KeywordTokenType) || is_name(id));
+}
+
+bool is_number(int id) noexcept
+{
+	return id == T_PP_NUMBER || (id > 0 && IS_CATEGORY(id, IntegerLiteralTokenType));
+}
+
+bool is_string(int id) noexcept
+{
+	return id > 0 && IS_CATEGORY(id, StringLiteralTokenType);
+}
+
+/// \brief a token an operand may start with, other than a sign
+bool starts_operand(int id) noexcept
+{
+	return is_name(id) || is_number(id) || is_string(id) || id == T_L_PAREN || id == T_NOT || id == T_COMPLEMENT
+		|| id == T_TRUE || id == T_FALSE || id == T_THIS || id == T_L_BRACE || id == T_DOT || id == T_ERROR;
+}
+
+/// \brief the binding strength of the binary operator or 0
+int get_precedence(int id) noexcept
+{
+	switch (id) {
+	case T_OROR: return 1;
+	case T_ANDAND: return 2;
+	case T_EQ:
+	case T_NE: return 3;
+	case T_L_ANGLE:
+	case T_R_ANGLE:
+	case T_LE:
+	case T_GE: return 4;
+	case T_BIT_OR: return 5;
+	case T_BIT_XOR: return 6;
+	case T_BIT_AND: return 7;
+	case T_SHL: return 8;
+	case T_PP:
+	case T_PLUS:
+	case T_MINUS:
+	case T_PLUS_SAT:
+	case T_MINUS_SAT: return 9;
+	case T_MUL:
+	case T_DIV:
+	case T_MOD: return 10;
+	default: return 0;
+	}
+}
+
+constexpr int SHIFT_PRECEDENCE = 8;
+
+} // namespace
+
+Parser::Parser(std::vector<lexed_token> const& tokens)
+	: Parser(tokens, 0, tokens.size())
+{
+}
+
+Parser::Parser(std::vector<lexed_token> const& tokens, std::size_t first, std::size_t last, parse_mode mode)
+	: _mode(mode)
+{
+	_items.reserve(last - first + look_ahead);
+	for (std::size_t it = first; it != last; ++it) {
+		auto joined = it + 1 != tokens.size() && tokens[it].offset + tokens[it].length == tokens[it + 1].offset;
+		add_item(tokens[it].id, static_cast<std::uint32_t>(it), joined);
+	}
+	finish_items(last);
+}
+
+Parser::Parser(token_arena const& tokens)
+	: Parser(tokens, 0, tokens.size())
+{
+}
+
+Parser::Parser(token_arena const& tokens, std::size_t first, std::size_t last, parse_mode mode)
+	: _mode(mode)
+{
+	_items.reserve(last - first + look_ahead);
+	for (std::size_t it = first; it != last; ++it) {
+		int id = tokens.get_id(tokens[it]);
+		if (is_skipped(id)) {
+			continue;
+		}
+		auto joined = it + 1 != tokens.size() && tokens[it]._file == tokens[it + 1]._file
+			&& tokens[it]._offset + tokens[it]._length == tokens[it + 1]._offset;
+		add_item(id, static_cast<std::uint32_t>(it), joined);
+	}
+	finish_items(last);
+}
+
+void Parser::add_item(int id, std::uint32_t index, bool joined)
+{
+	// the preprocessor lexes >> and >>= as one token, P4 as > followed by > or >=, both refer to the token
+	if (id == T_SHIFTRIGHT || id == T_SHIFTRIGHTASSIGN) {
+		_items.push_back({T_R_ANGLE, index, true});
+		id = id == T_SHIFTRIGHT ? T_R_ANGLE : T_GE;
+	}
+	_items.push_back({id, index, joined});
+}
+
+void Parser::finish_items(std::size_t count)
+{
+	// the sentinels let the parser look ahead without checks
+	for (std::size_t it = 0; it != look_ahead; ++it) {
+		_items.push_back({T_END, static_cast<std::uint32_t>(count), false});
+	}
+	// the depths are not clamped at 0, so that the parser decides the same in any range of the tokens
+	_depths.reserve(_items.size());
+	std::int32_t depth = 0;
+	for (auto const& it : _items) {
+		_depths.push_back(depth);
+		depth += (it.id == T_L_BRACE) - (it.id == T_R_BRACE);
+	}
+	start();
+}
+
+void Parser::start()
+{
+	// there are fewer nodes than tokens, the tree is allocated once
+	_nodes.reserve(_items.size());
+	make(node_kind::program, ast::none, 0);
+}
+
+ast Parser::run()
+{
+	while (!at_end()) {
+		parse_next();
+	}
+	return release();
+}
+
+std::uint32_t Parser::parse_next()
+{
+	auto start = _position;
+	auto depth = _depths[_position];
+	auto declaration = parse_declaration();
+	if (declaration != ast::none) {
+		add(_declarations, declaration);
+		return declaration;
+	}
+	synchronize(depth);
+	if (_position == start) {
+		++_position;
+	}
+	return ast::none;
+}
+
+ast Parser::run_body()
+{
+	auto saved = _mode;
+	_mode = parse_mode::full;
+	auto block = parse_block();
+	_mode = saved;
+	if (block != ast::none) {
+		add(_declarations, block);
+	}
+	return release();
+}
+
+ast Parser::release()
+{
+	finish(0, _declarations);
+	ast result;
+	result._nodes = std::move(_nodes);
+	return result;
+}
+
+bool Parser::expect(int id, char const* message)
+{
+	if (accept(id)) {
+		return true;
+	}
+	error(message);
+	return false;
+}
+
+void Parser::error(char const* message)
+{
+	if (_errors.empty() || _errors.back().token != current()) {
+		_errors.push_back({current(), message});
+	}
+}
+
+bool Parser::nesting::too_deep() const
+{
+	if (_parser._nesting <= max_nesting) {
+		return false;
+	}
+	_parser.error("nesting too deep");
+	return true;
+}
+
+void Parser::restore(mark const& m)
+{
+	_position = m.position;
+	_nodes.resize(m.nodes);
+	_errors.resize(m.errors);
+}
+
+void Parser::skip_balanced()
+{
+	std::size_t depth = 0;
+	do {
+		switch (peek()) {
+		case T_L_PAREN:
+		case T_L_BRACKET:
+		case T_L_BRACE: ++depth; break;
+		case T_R_PAREN:
+		case T_R_BRACKET:
+		case T_R_BRACE: --depth; break;
+		case T_END: return;
 		default:;
 		}
+		++_position;
+	} while (depth != 0);
+}
+
+void Parser::synchronize(std::int32_t depth)
+{
+	// skip to after the next semicolon or block at the depth, or to the brace closing it
+	while (peek() != T_END) {
+		auto here = _depths[_position];
+		if (here < depth) {
+			return;
+		}
+		if (here == depth && peek() == T_R_BRACE) {
+			return;
+		}
+		++_position;
+		if ((here == depth && _items[_position - 1].id == T_SEMICOLON)
+			|| (here == depth + 1 && _items[_position - 1].id == T_R_BRACE)) {
+			return;
+		}
+	}
+}
+
+std::uint32_t Parser::make(node_kind kind, std::size_t token, std::size_t begin, std::uint8_t flags)
+{
+	auto index = static_cast<std::uint32_t>(_nodes.size());
+	auto token_index = token == ast::none ? ast::none : _items[token].index;
+	_nodes.push_back({kind, flags, token_index, _items[begin].index, _items[begin].index, ast::none, ast::none});
+	return index;
+}
+
+std::uint32_t Parser::leaf(node_kind kind, std::uint8_t flags)
+{
+	auto index = make(kind, _position, _position, flags);
+	++_position;
+	_nodes[index].end = _items[_position - 1].index + 1;
+	return index;
+}
+
+std::uint32_t Parser::finish(std::uint32_t node, child_list const& children)
+{
+	_nodes[node].first = children.first;
+	if (_position != 0) {
+		_nodes[node].end = std::max(_nodes[node].begin, _items[_position - 1].index + 1);
+	}
+	return node;
+}
+
+void Parser::add(child_list& children, std::uint32_t child)
+{
+	if (children.last == ast::none) {
+		children.first = child;
+	} else {
+		_nodes[children.last].next = child;
+	}
+	children.last = child;
+}
+
+void Parser::prepend(std::uint32_t node, child_list const& children, std::size_t begin)
+{
+	if (children.first == ast::none) {
+		return;
+	}
+	_nodes[children.last].next = _nodes[node].first;
+	_nodes[node].first = children.first;
+	_nodes[node].begin = _items[begin].index;
+}
+
+Parser::child_list Parser::parse_annotations()
+{
+	child_list annotations;
+	while (peek() == T_AT || peek() == T_END_PRAGMA) {
+		auto begin = _position++;
+		if (!is_word(peek())) {
+			error("annotation name expected");
+			break;
+		}
+		auto annotation = make(node_kind::annotation, _position, begin);
+		++_position;
+		if (peek() == T_L_PAREN || peek() == T_L_BRACKET) {
+			skip_balanced();
+		}
+		add(annotations, finish(annotation, {}));
+	}
+	return annotations;
+}
+
+std::uint32_t Parser::parse_declaration()
+{
+	auto begin = _position;
+	auto annotations = parse_annotations();
+	std::uint32_t declaration = ast::none;
+	switch (peek()) {
+	case T_CONST: declaration = parse_constant(_position); break;
+	case T_EXTERN: declaration = parse_extern(_position); break;
+	case T_ACTION: declaration = parse_action(_position); break;
+	case T_PARSER: declaration = parse_parser(_position); break;
+	case T_CONTROL: declaration = parse_control(_position); break;
+	case T_PACKAGE: declaration = parse_package(_position); break;
+	case T_HEADER:
+	case T_HEADER_UNION:
+	case T_STRUCT: declaration = parse_struct(_position); break;
+	case T_ENUM: declaration = parse_enum(_position); break;
+	case T_TYPEDEF:
+	case T_TYPE: declaration = parse_type_definition(_position); break;
+	case T_SEMICOLON: declaration = leaf(node_kind::empty_statement); break;
+	case T_ERROR:
+		if (peek(1) == T_L_BRACE) {
+			declaration = parse_members(node_kind::error_type, _position);
+			break;
+		}
+		declaration = parse_typed_declaration(_position, false);
+		break;
+	case T_MATCH_KIND:
+		if (peek(1) == T_L_BRACE) {
+			declaration = parse_members(node_kind::match_kind_type, _position);
+			break;
+		}
+		declaration = parse_typed_declaration(_position, false);
+		break;
+	default: declaration = parse_typed_declaration(_position, false);
+	}
+	if (declaration != ast::none) {
+		prepend(declaration, annotations, begin);
+	}
+	return declaration;
+}
+
+std::uint32_t Parser::parse_constant(std::size_t begin)
+{
+	++_position;
+	child_list children;
+	auto type = parse_type();
+	if (type == ast::none) {
+		error("type expected");
+		return ast::none;
+	}
+	add(children, type);
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	if (!expect(T_ASSIGN, "= expected")) {
+		return ast::none;
+	}
+	auto value = parse_expression();
+	if (value == ast::none || !expect(T_SEMICOLON, "; expected")) {
+		return ast::none;
+	}
+	add(children, value);
+	return finish(make(node_kind::constant, name, begin), children);
+}
+
+std::uint32_t Parser::parse_struct(std::size_t begin)
+{
+	auto kind = peek() == T_HEADER ? node_kind::header : peek() == T_HEADER_UNION ? node_kind::header_union : node_kind::struct_type;
+	++_position;
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	child_list children;
+	if (peek() == T_L_ANGLE) {
+		auto parameters = parse_type_parameters();
+		if (parameters == ast::none) {
+			return ast::none;
+		}
+		add(children, parameters);
+	}
+	if (!expect(T_L_BRACE, "{ expected")) {
+		return ast::none;
+	}
+	while (peek() != T_R_BRACE && peek() != T_END) {
+		auto field_begin = _position;
+		auto annotations = parse_annotations();
+		auto type = parse_type();
+		if (type == ast::none) {
+			error("type expected");
+			return ast::none;
+		}
+		if (!is_name(peek())) {
+			error("name expected");
+			return ast::none;
+		}
+		auto field = make(node_kind::field, _position++, field_begin);
+		if (!expect(T_SEMICOLON, "; expected")) {
+			return ast::none;
+		}
+		child_list field_children;
+		add(field_children, type);
+		finish(field, field_children);
+		prepend(field, annotations, field_begin);
+		add(children, field);
+	}
+	if (!expect(T_R_BRACE, "} expected")) {
+		return ast::none;
+	}
+	return finish(make(kind, name, begin), children);
+}
+
+std::uint32_t Parser::parse_enum(std::size_t begin)
+{
+	++_position;
+	child_list children;
+	if (!is_name(peek()) || peek(1) != T_L_BRACE) {
+		auto type = parse_type();
+		if (type == ast::none) {
+			error("type expected");
+			return ast::none;
+		}
+		add(children, type);
+	}
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	if (!expect(T_L_BRACE, "{ expected")) {
+		return ast::none;
+	}
+	while (peek() != T_R_BRACE && peek() != T_END) {
+		auto member_begin = _position;
+		auto annotations = parse_annotations();
+		if (!is_name(peek())) {
+			error("name expected");
+			return ast::none;
+		}
+		auto member = make(node_kind::member, _position++, member_begin);
+		child_list member_children;
+		if (accept(T_ASSIGN)) {
+			auto value = parse_expression();
+			if (value == ast::none) {
+				return ast::none;
+			}
+			add(member_children, value);
+		}
+		finish(member, member_children);
+		prepend(member, annotations, member_begin);
+		add(children, member);
+		if (!accept(T_COMMA)) {
+			break;
+		}
+	}
+	if (!expect(T_R_BRACE, "} expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::enum_type, name, begin), children);
+}
+
+std::uint32_t Parser::parse_members(node_kind kind, std::size_t begin)
+{
+	auto keyword = _position++;
+	if (!expect(T_L_BRACE, "{ expected")) {
+		return ast::none;
+	}
+	child_list children;
+	while (is_name(peek())) {
+		add(children, leaf(node_kind::member));
+		if (!accept(T_COMMA)) {
+			break;
+		}
+	}
+	if (!expect(T_R_BRACE, "} expected")) {
+		return ast::none;
+	}
+	return finish(make(kind, keyword, begin), children);
+}
+
+std::uint32_t Parser::parse_type_definition(std::size_t begin)
+{
+	std::uint8_t flags = peek() == T_TYPE ? 1 : 0;
+	++_position;
+	auto type = parse_type();
+	if (type == ast::none) {
+		error("type expected");
+		return ast::none;
+	}
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	if (!expect(T_SEMICOLON, "; expected")) {
+		return ast::none;
+	}
+	child_list children;
+	add(children, type);
+	return finish(make(node_kind::type_definition, name, begin, flags), children);
+}
+
+std::uint32_t Parser::parse_extern(std::size_t begin)
+{
+	++_position;
+	if (is_name(peek()) && (peek(1) == T_L_BRACE || peek(1) == T_L_ANGLE)) {
+		auto m = save();
+		auto name = _position++;
+		child_list children;
+		auto parameters = peek() == T_L_ANGLE ? parse_type_parameters() : ast::none;
+		if (peek() == T_L_BRACE) {
+			++_position;
+			if (parameters != ast::none) {
+				add(children, parameters);
+			}
+			while (peek() != T_R_BRACE && peek() != T_END) {
+				auto method = parse_method();
+				if (method == ast::none) {
+					return ast::none;
+				}
+				add(children, method);
+			}
+			if (!expect(T_R_BRACE, "} expected")) {
+				return ast::none;
+			}
+			return finish(make(node_kind::extern_type, name, begin), children);
+		}
+		// a function with a specialized return type
+		restore(m);
+	}
+	auto method = parse_method();
+	if (method != ast::none) {
+		_nodes[method].begin = _items[begin].index;
+	}
+	return method;
+}
+
+std::uint32_t Parser::parse_method()
+{
+	auto begin = _position;
+	auto annotations = parse_annotations();
+	std::uint8_t flags = 0;
+	if (accept(T_ABSTRACT)) {
+		flags |= abstract_method;
+	}
+	child_list children;
+	std::size_t name;
+	if (is_name(peek()) && peek(1) == T_L_PAREN) {
+		flags |= constructor_method;
+		name = _position++;
+	} else {
+		auto type = parse_type();
+		if (type == ast::none) {
+			error("type expected");
+			return ast::none;
+		}
+		add(children, type);
+		if (!is_name(peek())) {
+			error("name expected");
+			return ast::none;
+		}
+		name = _position++;
+		if (peek() == T_L_ANGLE) {
+			auto parameters = parse_type_parameters();
+			if (parameters == ast::none) {
+				return ast::none;
+			}
+			add(children, parameters);
+		}
+	}
+	auto parameters = parse_parameters(0);
+	if (parameters == ast::none || !expect(T_SEMICOLON, "; expected")) {
+		return ast::none;
+	}
+	add(children, parameters);
+	auto method = finish(make(node_kind::method, name, begin, flags), children);
+	prepend(method, annotations, begin);
+	return method;
+}
+
+std::uint32_t Parser::parse_action(std::size_t begin)
+{
+	++_position;
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	child_list children;
+	auto parameters = parse_parameters(0);
+	if (parameters == ast::none) {
+		return ast::none;
+	}
+	add(children, parameters);
+	auto body = parse_body();
+	if (body == ast::none) {
+		return ast::none;
+	}
+	add(children, body);
+	return finish(make(node_kind::action, name, begin), children);
+}
+
+std::uint32_t Parser::parse_parser(std::size_t begin)
+{
+	++_position;
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	child_list children;
+	if (peek() == T_L_ANGLE) {
+		auto parameters = parse_type_parameters();
+		if (parameters == ast::none) {
+			return ast::none;
+		}
+		add(children, parameters);
+	}
+	auto parameters = parse_parameters(0);
+	if (parameters == ast::none) {
+		return ast::none;
+	}
+	add(children, parameters);
+	if (accept(T_SEMICOLON)) {
+		return finish(make(node_kind::parser_type, name, begin), children);
+	}
+	if (peek() == T_L_PAREN) {
+		auto constructor = parse_parameters(1);
+		if (constructor == ast::none) {
+			return ast::none;
+		}
+		add(children, constructor);
+	}
+	if (!expect(T_L_BRACE, "{ expected")) {
+		return ast::none;
+	}
+	while (peek() != T_R_BRACE && peek() != T_END) {
+		auto start = _position;
+		auto depth = _depths[_position];
+		auto local = parse_local(true);
+		if (local != ast::none) {
+			add(children, local);
+			continue;
+		}
+		synchronize(depth);
+		if (_position == start) {
+			++_position;
+		}
+	}
+	if (!expect(T_R_BRACE, "} expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::parser, name, begin), children);
+}
+
+std::uint32_t Parser::parse_state(std::size_t begin)
+{
+	++_position;
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	auto body = parse_body();
+	if (body == ast::none) {
+		return ast::none;
+	}
+	return finish(make(node_kind::state, name, begin), {body, body});
+}
+
+std::uint32_t Parser::parse_value_set(std::size_t begin)
+{
+	++_position;
+	if (!expect(T_L_ANGLE, "< expected")) {
+		return ast::none;
+	}
+	child_list children;
+	auto type = parse_type();
+	if (type == ast::none) {
+		error("type expected");
+		return ast::none;
+	}
+	add(children, type);
+	if (!expect(T_R_ANGLE, "> expected") || !expect(T_L_PAREN, "( expected")) {
+		return ast::none;
+	}
+	auto size = parse_expression();
+	if (size == ast::none || !expect(T_R_PAREN, ") expected")) {
+		return ast::none;
+	}
+	add(children, size);
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	if (!expect(T_SEMICOLON, "; expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::value_set, name, begin), children);
+}
+
+std::uint32_t Parser::parse_control(std::size_t begin)
+{
+	++_position;
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	child_list children;
+	if (peek() == T_L_ANGLE) {
+		auto parameters = parse_type_parameters();
+		if (parameters == ast::none) {
+			return ast::none;
+		}
+		add(children, parameters);
+	}
+	auto parameters = parse_parameters(0);
+	if (parameters == ast::none) {
+		return ast::none;
+	}
+	add(children, parameters);
+	if (accept(T_SEMICOLON)) {
+		return finish(make(node_kind::control_type, name, begin), children);
+	}
+	if (peek() == T_L_PAREN) {
+		auto constructor = parse_parameters(1);
+		if (constructor == ast::none) {
+			return ast::none;
+		}
+		add(children, constructor);
+	}
+	if (!expect(T_L_BRACE, "{ expected")) {
+		return ast::none;
+	}
+	while (peek() != T_APPLY && peek() != T_R_BRACE && peek() != T_END) {
+		auto start = _position;
+		auto depth = _depths[_position];
+		auto local = parse_local(false);
+		if (local != ast::none) {
+			add(children, local);
+			continue;
+		}
+		synchronize(depth);
+		if (_position == start) {
+			++_position;
+		}
+	}
+	if (!expect(T_APPLY, "apply expected")) {
+		return ast::none;
+	}
+	auto body = parse_body();
+	if (body == ast::none) {
+		return ast::none;
+	}
+	add(children, body);
+	if (!expect(T_R_BRACE, "} expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::control, name, begin), children);
+}
+
+std::uint32_t Parser::parse_package(std::size_t begin)
+{
+	++_position;
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	child_list children;
+	if (peek() == T_L_ANGLE) {
+		auto parameters = parse_type_parameters();
+		if (parameters == ast::none) {
+			return ast::none;
+		}
+		add(children, parameters);
+	}
+	auto parameters = parse_parameters(0);
+	if (parameters == ast::none || !expect(T_SEMICOLON, "; expected")) {
+		return ast::none;
+	}
+	add(children, parameters);
+	return finish(make(node_kind::package_type, name, begin), children);
+}
+
+std::uint32_t Parser::parse_table(std::size_t begin)
+{
+	++_position;
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	if (!expect(T_L_BRACE, "{ expected")) {
+		return ast::none;
+	}
+	child_list children;
+	while (peek() != T_R_BRACE && peek() != T_END) {
+		auto property = parse_property();
+		if (property == ast::none) {
+			return ast::none;
+		}
+		add(children, property);
+	}
+	if (!expect(T_R_BRACE, "} expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::table, name, begin), children);
+}
+
+std::uint32_t Parser::parse_property()
+{
+	auto begin = _position;
+	auto annotations = parse_annotations();
+	std::uint8_t flags = accept(T_CONST) ? 1 : 0;
+	auto name = _position;
+	auto id = peek();
+	if (!is_name(id)) {
+		error("property name expected");
+		return ast::none;
+	}
+	++_position;
+	if (!expect(T_ASSIGN, "= expected")) {
+		return ast::none;
+	}
+	child_list children;
+	std::uint32_t property;
+	if (id == T_KEY || id == T_ACTIONS || id == T_ENTRIES) {
+		if (!expect(T_L_BRACE, "{ expected")) {
+			return ast::none;
+		}
+		while (peek() != T_R_BRACE && peek() != T_END) {
+			auto element_begin = _position;
+			std::uint32_t element = ast::none;
+			if (id == T_KEY) {
+				auto expression = parse_expression();
+				if (expression == ast::none || !expect(T_COLON, ": expected")) {
+					return ast::none;
+				}
+				if (!is_name(peek())) {
+					error("match kind expected");
+					return ast::none;
+				}
+				element = make(node_kind::key_element, _position++, element_begin);
+				child_list element_children;
+				add(element_children, expression);
+				auto annotations = parse_annotations();
+				if (annotations.first != ast::none) {
+					_nodes[annotations.last].next = expression;
+					element_children.first = annotations.first;
+				}
+				finish(element, element_children);
+			} else if (id == T_ACTIONS) {
+				auto annotations = parse_annotations();
+				element = parse_action_reference();
+				if (element == ast::none) {
+					return ast::none;
+				}
+				prepend(element, annotations, element_begin);
+			} else {
+				auto keyset = parse_keyset();
+				if (keyset == ast::none) {
+					return ast::none;
+				}
+				auto colon = _position;
+				if (!expect(T_COLON, ": expected")) {
+					return ast::none;
+				}
+				auto action = parse_action_reference();
+				if (action == ast::none) {
+					return ast::none;
+				}
+				child_list entry_children;
+				add(entry_children, keyset);
+				add(entry_children, action);
+				element = finish(make(node_kind::entry, colon, element_begin), entry_children);
+				prepend(element, parse_annotations(), element_begin);
+			}
+			if (!expect(T_SEMICOLON, "; expected")) {
+				return ast::none;
+			}
+			add(children, element);
+		}
+		if (!expect(T_R_BRACE, "} expected")) {
+			return ast::none;
+		}
+		auto kind = id == T_KEY ? node_kind::key : id == T_ACTIONS ? node_kind::action_list : node_kind::entries;
+		property = finish(make(kind, name, begin, flags), children);
+		accept(T_SEMICOLON);
+	} else {
+		auto value = parse_expression();
+		if (value == ast::none || !expect(T_SEMICOLON, "; expected")) {
+			return ast::none;
+		}
+		add(children, value);
+		property = finish(make(node_kind::property, name, begin, flags), children);
+	}
+	prepend(property, annotations, begin);
+	return property;
+}
+
+std::uint32_t Parser::parse_action_reference()
+{
+	auto begin = _position;
+	std::uint8_t flags = accept(T_DOT) ? 1 : 0;
+	if (!is_name(peek())) {
+		error("action name expected");
+		return ast::none;
+	}
+	auto reference = make(node_kind::action_reference, _position++, begin, flags);
+	child_list children;
+	if (peek() == T_L_PAREN) {
+		auto errors = _errors.size();
+		parse_arguments(children);
+		if (_errors.size() != errors) {
+			return ast::none;
+		}
+	}
+	return finish(reference, children);
+}
+
+std::uint32_t Parser::parse_typed_declaration(std::size_t begin, bool local)
+{
+	auto type = parse_type();
+	if (type == ast::none) {
+		error("declaration expected");
+		return ast::none;
+	}
+	child_list children;
+	add(children, type);
+	if (peek() == T_L_PAREN) {
+		// an instantiation
+		auto errors = _errors.size();
+		parse_arguments(children);
+		if (_errors.size() != errors) {
+			return ast::none;
+		}
+		if (!is_name(peek())) {
+			error("name expected");
+			return ast::none;
+		}
+		auto name = _position++;
+		if (accept(T_ASSIGN)) {
+			auto initializer = parse_block();
+			if (initializer == ast::none) {
+				return ast::none;
+			}
+			add(children, initializer);
+		}
+		if (!expect(T_SEMICOLON, "; expected")) {
+			return ast::none;
+		}
+		return finish(make(node_kind::instantiation, name, begin), children);
+	}
+	if (!is_name(peek())) {
+		error("name expected");
+		return ast::none;
+	}
+	auto name = _position++;
+	if (!local && (peek() == T_L_PAREN || peek() == T_L_ANGLE)) {
+		if (peek() == T_L_ANGLE) {
+			auto parameters = parse_type_parameters();
+			if (parameters == ast::none) {
+				return ast::none;
+			}
+			add(children, parameters);
+		}
+		auto parameters = parse_parameters(0);
+		if (parameters == ast::none) {
+			return ast::none;
+		}
+		add(children, parameters);
+		auto body = parse_body();
+		if (body == ast::none) {
+			return ast::none;
+		}
+		add(children, body);
+		return finish(make(node_kind::function, name, begin), children);
+	}
+	if (accept(T_ASSIGN)) {
+		auto value = parse_expression();
+		if (value == ast::none) {
+			return ast::none;
+		}
+		add(children, value);
+	}
+	if (!expect(T_SEMICOLON, "; expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::variable, name, begin), children);
+}
+
+std::uint32_t Parser::parse_local(bool in_parser)
+{
+	auto begin = _position;
+	auto annotations = parse_annotations();
+	std::uint32_t local;
+	switch (peek()) {
+	case T_CONST: local = parse_constant(_position); break;
+	case T_ACTION: local = parse_action(_position); break;
+	case T_TABLE: local = in_parser ? parse_typed_declaration(_position, true) : parse_table(_position); break;
+	case T_STATE: local = in_parser ? parse_state(_position) : parse_typed_declaration(_position, true); break;
+	case T_VALUE_SET: local = parse_value_set(_position); break;
+	default: local = parse_typed_declaration(_position, true);
+	}
+	if (local != ast::none) {
+		prepend(local, annotations, begin);
+	}
+	return local;
+}
+
+std::uint32_t Parser::parse_type_parameters()
+{
+	auto begin = _position;
+	if (!expect(T_L_ANGLE, "< expected")) {
+		return ast::none;
+	}
+	child_list children;
+	do {
+		if (!is_name(peek())) {
+			error("type parameter expected");
+			return ast::none;
+		}
+		add(children, leaf(node_kind::type_parameter));
+	} while (accept(T_COMMA));
+	if (!expect(T_R_ANGLE, "> expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::type_parameters, begin, begin), children);
+}
+
+std::uint32_t Parser::parse_parameters(std::uint8_t flags)
+{
+	auto begin = _position;
+	if (!expect(T_L_PAREN, "( expected")) {
+		return ast::none;
+	}
+	child_list children;
+	if (!accept(T_R_PAREN)) {
+		do {
+			auto parameter_begin = _position;
+			auto annotations = parse_annotations();
+			std::uint8_t direction = no_direction;
+			switch (peek()) {
+			case T_IN: direction = in_direction; ++_position; break;
+			case T_OUT: direction = out_direction; ++_position; break;
+			case T_INOUT: direction = inout_direction; ++_position; break;
+			default:;
+			}
+			child_list parameter_children;
+			auto type = parse_type();
+			if (type == ast::none) {
+				error("type expected");
+				return ast::none;
+			}
+			add(parameter_children, type);
+			if (!is_name(peek())) {
+				error("name expected");
+				return ast::none;
+			}
+			auto parameter = make(node_kind::parameter, _position++, parameter_begin, direction);
+			if (accept(T_ASSIGN)) {
+				auto value = parse_expression();
+				if (value == ast::none) {
+					return ast::none;
+				}
+				add(parameter_children, value);
+			}
+			finish(parameter, parameter_children);
+			prepend(parameter, annotations, parameter_begin);
+			add(children, parameter);
+		} while (accept(T_COMMA));
+		if (!expect(T_R_PAREN, ") expected")) {
+			return ast::none;
+		}
+	}
+	return finish(make(node_kind::parameters, begin, begin, flags), children);
+}
+
+std::uint32_t Parser::parse_type()
+{
+	nesting guard(*this);
+	if (guard.too_deep()) {
+		return ast::none;
+	}
+	auto begin = _position;
+	std::uint32_t type;
+	switch (peek()) {
+	case T_BOOL:
+	case T_ERROR:
+	case T_STRING:
+	case T_VOID:
+	case T_MATCH_KIND:
+		type = leaf(node_kind::base_type);
+		break;
+	case T_BIT:
+	case T_INT:
+	case T_VARBIT: {
+		type = make(node_kind::base_type, _position, begin);
+		++_position;
+		child_list children;
+		if (accept(T_L_ANGLE)) {
+			std::uint32_t width;
+			if (is_number(peek())) {
+				width = leaf(node_kind::number);
+			} else if (is_name(peek())) {
+				width = leaf(node_kind::name);
+			} else if (accept(T_L_PAREN)) {
+				width = parse_expression();
+				if (width == ast::none || !expect(T_R_PAREN, ") expected")) {
+					return ast::none;
+				}
+			} else {
+				error("width expected");
+				return ast::none;
+			}
+			add(children, width);
+			if (!expect(T_R_ANGLE, "> expected")) {
+				return ast::none;
+			}
+		}
+		finish(type, children);
+		break;
+	}
+	case T_TUPLE:
+	case T_LIST: {
+		type = make(node_kind::tuple_type, _position, begin);
+		++_position;
+		auto arguments = parse_type_arguments();
+		if (arguments == ast::none) {
+			error("type arguments expected");
+			return ast::none;
+		}
+		finish(type, {arguments, arguments});
+		break;
+	}
+	case T_DONTCARE:
+		type = leaf(node_kind::dontcare_type);
+		break;
+	default: {
+		std::uint8_t flags = accept(T_DOT) ? 1 : 0;
+		if (!is_name(peek())) {
+			_position = begin;
+			return ast::none;
+		}
+		type = make(node_kind::type_name, _position, begin, flags);
+		++_position;
+		finish(type, {});
+		if (peek() == T_L_ANGLE) {
+			auto m = save();
+			auto arguments = parse_type_arguments();
+			if (arguments == ast::none) {
+				restore(m);
+				break;
+			}
+			child_list children;
+			add(children, type);
+			add(children, arguments);
+			type = finish(make(node_kind::specialized_type, m.position, begin), children);
+		}
+	}
+	}
+	while (peek() == T_L_BRACKET) {
+		auto bracket = _position++;
+		auto size = parse_expression();
+		if (size == ast::none || !expect(T_R_BRACKET, "] expected")) {
+			return ast::none;
+		}
+		child_list children;
+		add(children, type);
+		add(children, size);
+		type = finish(make(node_kind::stack_type, bracket, begin), children);
+	}
+	return type;
+}
+
+std::uint32_t Parser::parse_type_arguments()
+{
+	auto begin = _position;
+	if (!accept(T_L_ANGLE)) {
+		return ast::none;
+	}
+	child_list children;
+	do {
+		auto type = parse_type();
+		if (type == ast::none) {
+			return ast::none;
+		}
+		add(children, type);
+	} while (accept(T_COMMA));
+	if (!accept(T_R_ANGLE)) {
+		return ast::none;
+	}
+	return finish(make(node_kind::type_arguments, begin, begin), children);
+}
+
+std::uint32_t Parser::parse_body()
+{
+	if (_mode == parse_mode::full) {
+		return parse_block();
+	}
+	auto begin = _position;
+	if (peek() != T_L_BRACE) {
+		error("{ expected");
+		return ast::none;
+	}
+	skip_balanced();
+	if (_depths[_position] != _depths[begin]) {
+		error("} expected");
+		return ast::none;
+	}
+	return finish(make(node_kind::block, begin, begin, unparsed_block), {});
+}
+
+std::uint32_t Parser::parse_block()
+{
+	auto begin = _position;
+	if (!expect(T_L_BRACE, "{ expected")) {
+		return ast::none;
+	}
+	auto depth = _depths[_position];
+	child_list children;
+	while (peek() != T_R_BRACE && peek() != T_END) {
+		auto start = _position;
+		auto statement = parse_statement();
+		if (statement != ast::none) {
+			add(children, statement);
+			continue;
+		}
+		synchronize(depth);
+		if (_position == start) {
+			++_position;
+		}
+	}
+	if (!expect(T_R_BRACE, "} expected")) {
+		return ast::none;
+	}
+	return finish(make(node_kind::block, begin, begin), children);
+}
+
+std::uint32_t Parser::parse_statement()
+{
+	nesting guard(*this);
+	if (guard.too_deep()) {
+		return ast::none;
+	}
+	auto begin = _position;
+	auto annotations = parse_annotations();
+	auto start = _position;
+	child_list children;
+	std::uint32_t statement = ast::none;
+	switch (peek()) {
+	case T_L_BRACE:
+		statement = parse_block();
+		break;
+	case T_SEMICOLON:
+		statement = leaf(node_kind::empty_statement);
+		break;
+	case T_CONST:
+		statement = parse_constant(start);
+		break;
+	case T_TRANSITION:
+		statement = parse_transition();
+		break;
+	case T_EXIT:
+		statement = leaf(node_kind::exit_statement);
+		if (!expect(T_SEMICOLON, "; expected")) {
+			return ast::none;
+		}
+		finish(statement, {});
+		break;
+	case T_RETURN: {
+		++_position;
+		if (peek() != T_SEMICOLON) {
+			auto value = parse_expression();
+			if (value == ast::none) {
+				return ast::none;
+			}
+			add(children, value);
+		}
+		if (!expect(T_SEMICOLON, "; expected")) {
+			return ast::none;
+		}
+		statement = finish(make(node_kind::return_statement, start, start), children);
+		break;
+	}
+	case T_IF: {
+		// the ifs of an else if chain are parsed in a loop, each one is the last child of the one before it
+		std::vector<std::pair<std::size_t, child_list>> chain;
+		std::uint32_t otherwise = ast::none;
+		while (true) {
+			auto if_start = _position++;
+			if (!expect(T_L_PAREN, "( expected")) {
+				return ast::none;
+			}
+			auto condition = parse_expression();
+			if (condition == ast::none || !expect(T_R_PAREN, ") expected")) {
+				return ast::none;
+			}
+			auto then = parse_statement();
+			if (then == ast::none) {
+				return ast::none;
+			}
+			chain.emplace_back(if_start, child_list());
+			add(chain.back().second, condition);
+			add(chain.back().second, then);
+			if (!accept(T_ELSE)) {
+				break;
+			}
+			if (peek() != T_IF) {
+				otherwise = parse_statement();
+				if (otherwise == ast::none) {
+					return ast::none;
+				}
+				break;
+			}
+		}
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+			if (otherwise != ast::none) {
+				add(it->second, otherwise);
+			}
+			otherwise = finish(make(node_kind::if_statement, it->first, it->first), it->second);
+		}
+		statement = otherwise;
+		break;
+	}
+	case T_SWITCH: {
+		++_position;
+		if (!expect(T_L_PAREN, "( expected")) {
+			return ast::none;
+		}
+		auto expression = parse_expression();
+		if (expression == ast::none || !expect(T_R_PAREN, ") expected") || !expect(T_L_BRACE, "{ expected")) {
+			return ast::none;
+		}
+		add(children, expression);
+		while (peek() != T_R_BRACE && peek() != T_END) {
+			auto case_begin = _position;
+			auto label = peek() == T_DEFAULT ? leaf(node_kind::default_keyset) : parse_expression();
+			if (label == ast::none) {
+				return ast::none;
+			}
+			auto colon = _position;
+			if (!expect(T_COLON, ": expected")) {
+				return ast::none;
+			}
+			child_list case_children;
+			add(case_children, label);
+			if (peek() == T_L_BRACE) {
+				auto block = parse_block();
+				if (block == ast::none) {
+					return ast::none;
+				}
+				add(case_children, block);
+			}
+			add(children, finish(make(node_kind::switch_case, colon, case_begin), case_children));
+		}
+		if (!expect(T_R_BRACE, "} expected")) {
+			return ast::none;
+		}
+		statement = finish(make(node_kind::switch_statement, start, start), children);
+		break;
+	}
+	default: {
+		// a declaration is a type followed by a name, anything else is an expression
+		auto m = save();
+		auto type = parse_type();
+		auto declaration = type != ast::none && is_name(peek()) && (peek(1) == T_SEMICOLON || peek(1) == T_ASSIGN);
+		restore(m);
+		if (declaration) {
+			statement = parse_typed_declaration(start, true);
+			break;
+		}
+		auto target = parse_expression();
+		if (target == ast::none) {
+			return ast::none;
+		}
+		add(children, target);
+		if (peek() == T_ASSIGN) {
+			auto assign = _position++;
+			auto value = parse_expression();
+			if (value == ast::none) {
+				return ast::none;
+			}
+			add(children, value);
+			statement = make(node_kind::assignment, assign, start);
+		} else if (_nodes[target].kind == node_kind::call) {
+			statement = make(node_kind::call_statement, start, start);
+		} else {
+			error("assignment or call expected");
+			return ast::none;
+		}
+		if (!expect(T_SEMICOLON, "; expected")) {
+			return ast::none;
+		}
+		finish(statement, children);
+	}
+	}
+	if (statement != ast::none) {
+		prepend(statement, annotations, begin);
+	}
+	return statement;
+}
+
+std::uint32_t Parser::parse_transition()
+{
+	auto begin = _position++;
+	child_list children;
+	if (peek() == T_SELECT) {
+		auto select_begin = _position++;
+		auto open = _position;
+		if (!expect(T_L_PAREN, "( expected")) {
+			return ast::none;
+		}
+		child_list expressions;
+		if (peek() != T_R_PAREN) {
+			do {
+				auto expression = parse_expression();
+				if (expression == ast::none) {
+					return ast::none;
+				}
+				add(expressions, expression);
+			} while (accept(T_COMMA));
+		}
+		if (!expect(T_R_PAREN, ") expected")) {
+			return ast::none;
+		}
+		child_list select_children;
+		add(select_children, finish(make(node_kind::select_expressions, open, open), expressions));
+		if (!expect(T_L_BRACE, "{ expected")) {
+			return ast::none;
+		}
+		while (peek() != T_R_BRACE && peek() != T_END) {
+			auto case_begin = _position;
+			auto annotations = parse_annotations();
+			auto keyset = parse_keyset();
+			if (keyset == ast::none) {
+				return ast::none;
+			}
+			auto colon = _position;
+			if (!expect(T_COLON, ": expected")) {
+				return ast::none;
+			}
+			std::uint8_t flags = accept(T_DOT) ? 1 : 0;
+			if (!is_name(peek())) {
+				error("state name expected");
+				return ast::none;
+			}
+			child_list case_children;
+			add(case_children, keyset);
+			add(case_children, leaf(node_kind::name, flags));
+			if (!expect(T_SEMICOLON, "; expected")) {
+				return ast::none;
+			}
+			auto select_case = finish(make(node_kind::select_case, colon, case_begin), case_children);
+			prepend(select_case, annotations, case_begin);
+			add(select_children, select_case);
+		}
+		if (!expect(T_R_BRACE, "} expected")) {
+			return ast::none;
+		}
+		add(children, finish(make(node_kind::select, select_begin, select_begin), select_children));
+		accept(T_SEMICOLON);
+	} else {
+		auto state = parse_expression();
+		if (state == ast::none || !expect(T_SEMICOLON, "; expected")) {
+			return ast::none;
+		}
+		add(children, state);
+	}
+	return finish(make(node_kind::transition, begin, begin), children);
+}
+
+std::uint32_t Parser::parse_keyset()
+{
+	if (peek() != T_L_PAREN) {
+		return parse_simple_keyset();
+	}
+	auto m = save();
+	auto begin = _position++;
+	child_list children;
+	auto first = parse_simple_keyset();
+	if (first != ast::none && peek() == T_COMMA) {
+		add(children, first);
+		while (accept(T_COMMA)) {
+			auto keyset = parse_simple_keyset();
+			if (keyset == ast::none) {
+				return ast::none;
+			}
+			add(children, keyset);
+		}
+		if (!expect(T_R_PAREN, ") expected")) {
+			return ast::none;
+		}
+		return finish(make(node_kind::keyset_tuple, begin, begin), children);
+	}
+	// a parenthesized expression
+	restore(m);
+	return parse_simple_keyset();
+}
+
+std::uint32_t Parser::parse_simple_keyset()
+{
+	switch (peek()) {
+	case T_DEFAULT: return leaf(node_kind::default_keyset);
+	case T_DONTCARE: return leaf(node_kind::dontcare);
+	default:;
+	}
+	auto begin = _position;
+	auto value = parse_expression();
+	if (value == ast::none) {
+		return ast::none;
+	}
+	if (peek() == T_MASK || peek() == T_RANGE) {
+		auto kind = peek() == T_MASK ? node_kind::mask : node_kind::range;
+		auto op = _position++;
+		auto other = parse_expression();
+		if (other == ast::none) {
+			return ast::none;
+		}
+		child_list children;
+		add(children, value);
+		add(children, other);
+		return finish(make(kind, op, begin), children);
+	}
+	return value;
+}
+
+std::uint32_t Parser::parse_expression(int precedence)
+{
+	nesting guard(*this);
+	if (guard.too_deep()) {
+		return ast::none;
+	}
+	auto begin = _position;
+	auto left = parse_unary();
+	if (left == ast::none) {
+		return ast::none;
+	}
+	while (true) {
+		auto id = peek();
+		if (id == T_QUESTION) {
+			if (precedence != 0) {
+				break;
+			}
+			auto op = _position++;
+			child_list children;
+			add(children, left);
+			auto then = parse_expression();
+			if (then == ast::none || !expect(T_COLON, ": expected")) {
+				return ast::none;
+			}
+			add(children, then);
+			auto otherwise = parse_expression();
+			if (otherwise == ast::none) {
+				return ast::none;
+			}
+			add(children, otherwise);
+			left = finish(make(node_kind::ternary, op, begin), children);
+			continue;
+		}
+		// P4 lexes >> as two >, next to each other they shift
+		auto shift = id == T_R_ANGLE && _items[_position].joined && peek(1) == T_R_ANGLE;
+		auto level = shift ? SHIFT_PRECEDENCE : get_precedence(id);
+		if (level == 0 || level < precedence) {
+			break;
+		}
+		auto op = _position;
+		_position += shift ? 2 : 1;
+		auto right = parse_expression(level + 1);
+		if (right == ast::none) {
+			return ast::none;
+		}
+		child_list children;
+		add(children, left);
+		add(children, right);
+		left = finish(make(node_kind::binary, op, begin, shift ? 1 : 0), children);
+	}
+	return left;
+}
+
+std::uint32_t Parser::parse_unary()
+{
+	nesting guard(*this);
+	if (guard.too_deep()) {
+		return ast::none;
+	}
+	auto begin = _position;
+	switch (peek()) {
+	case T_NOT:
+	case T_COMPLEMENT:
+	case T_MINUS:
+	case T_PLUS: {
+		auto op = _position++;
+		auto operand = parse_unary();
+		if (operand == ast::none) {
+			return ast::none;
+		}
+		child_list children;
+		add(children, operand);
+		return finish(make(node_kind::unary, op, begin), children);
+	}
+	case T_L_PAREN:
+		if (is_cast()) {
+			++_position;
+			auto type = parse_type();
+			if (type == ast::none || !expect(T_R_PAREN, ") expected")) {
+				return ast::none;
+			}
+			auto operand = parse_unary();
+			if (operand == ast::none) {
+				return ast::none;
+			}
+			child_list children;
+			add(children, type);
+			add(children, operand);
+			return finish(make(node_kind::cast, begin, begin), children);
+		}
+		break;
+	default:;
+	}
+	auto primary = parse_primary();
+	if (primary == ast::none) {
+		return ast::none;
+	}
+	return parse_postfix(primary, begin);
+}
+
+std::uint32_t Parser::parse_primary()
+{
+	auto begin = _position;
+	auto id = peek();
+	if (is_number(id)) {
+		return leaf(node_kind::number);
+	}
+	if (is_string(id)) {
+		return leaf(node_kind::string);
+	}
+	if (is_name(id) || id == T_ERROR) {
+		return leaf(node_kind::name);
+	}
+	switch (id) {
+	case T_TRUE:
+	case T_FALSE: return leaf(node_kind::boolean);
+	case T_THIS: return leaf(node_kind::this_expression);
+	case T_DONTCARE: return leaf(node_kind::dontcare);
+	case T_DEFAULT: return leaf(node_kind::default_keyset);
+	case T_DOT:
+		++_position;
+		if (!is_name(peek())) {
+			error("name expected");
+			return ast::none;
+		}
+		return finish(make(node_kind::name, _position++, begin, 1), {});
+	case T_L_PAREN: {
+		++_position;
+		auto expression = parse_expression();
+		if (expression == ast::none || !expect(T_R_PAREN, ") expected")) {
+			return ast::none;
+		}
+		return expression;
+	}
+	case T_L_BRACE: {
+		++_position;
+		auto named = is_name(peek()) && peek(1) == T_ASSIGN;
+		child_list children;
+		while (peek() != T_R_BRACE && peek() != T_END) {
+			if (named) {
+				if (!is_name(peek()) || peek(1) != T_ASSIGN) {
+					error("name = expected");
+					return ast::none;
+				}
+				auto argument_begin = _position;
+				auto argument = make(node_kind::named_argument, _position, argument_begin);
+				_position += 2;
+				auto value = parse_expression();
+				if (value == ast::none) {
+					return ast::none;
+				}
+				add(children, finish(argument, {value, value}));
+			} else {
+				auto value = parse_expression();
+				if (value == ast::none) {
+					return ast::none;
+				}
+				add(children, value);
+			}
+			if (!accept(T_COMMA)) {
+				break;
+			}
+		}
+		if (!expect(T_R_BRACE, "} expected")) {
+			return ast::none;
+		}
+		return finish(make(named ? node_kind::struct_expression : node_kind::list_expression, begin, begin), children);
+	}
+	default:;
+	}
+	error("expression expected");
+	return ast::none;
+}
+
+std::uint32_t Parser::parse_postfix(std::uint32_t expression, std::size_t begin)
+{
+	while (true) {
+		switch (peek()) {
+		case T_DOT: {
+			++_position;
+			if (!is_word(peek())) {
+				error("member name expected");
+				return ast::none;
+			}
+			auto member = make(node_kind::member_access, _position++, begin);
+			expression = finish(member, {expression, expression});
+			break;
+		}
+		case T_L_BRACKET: {
+			auto bracket = _position++;
+			child_list children;
+			add(children, expression);
+			auto index = parse_expression();
+			if (index == ast::none) {
+				return ast::none;
+			}
+			add(children, index);
+			auto kind = node_kind::index;
+			if (accept(T_COLON)) {
+				auto low = parse_expression();
+				if (low == ast::none) {
+					return ast::none;
+				}
+				add(children, low);
+				kind = node_kind::slice;
+			}
+			if (!expect(T_R_BRACKET, "] expected")) {
+				return ast::none;
+			}
+			expression = finish(make(kind, bracket, begin), children);
+			break;
+		}
+		case T_L_ANGLE: {
+			// type arguments of a call, otherwise it is less than
+			auto kind = _nodes[expression].kind;
+			if (kind != node_kind::name && kind != node_kind::member_access) {
+				return expression;
+			}
+			auto m = save();
+			auto arguments = parse_type_arguments();
+			if (arguments == ast::none || peek() != T_L_PAREN) {
+				restore(m);
+				return expression;
+			}
+			auto paren = _position;
+			child_list children;
+			add(children, expression);
+			add(children, arguments);
+			auto errors = _errors.size();
+			parse_arguments(children);
+			if (_errors.size() != errors) {
+				return ast::none;
+			}
+			expression = finish(make(node_kind::call, paren, begin), children);
+			break;
+		}
+		case T_L_PAREN: {
+			auto paren = _position;
+			child_list children;
+			add(children, expression);
+			auto errors = _errors.size();
+			parse_arguments(children);
+			if (_errors.size() != errors) {
+				return ast::none;
+			}
+			expression = finish(make(node_kind::call, paren, begin), children);
+			break;
+		}
+		default:
+			return expression;
+		}
+	}
+}
+
+void Parser::parse_arguments(child_list& children)
+{
+	if (!expect(T_L_PAREN, "( expected")) {
+		return;
+	}
+	if (accept(T_R_PAREN)) {
+		return;
+	}
+	do {
+		if (is_name(peek()) && peek(1) == T_ASSIGN) {
+			auto argument = make(node_kind::named_argument, _position, _position);
+			_position += 2;
+			auto value = peek() == T_DONTCARE ? leaf(node_kind::dontcare) : parse_expression();
+			if (value == ast::none) {
+				return;
+			}
+			add(children, finish(argument, {value, value}));
+			continue;
+		}
+		auto value = peek() == T_DONTCARE ? leaf(node_kind::dontcare) : parse_expression();
+		if (value == ast::none) {
+			return;
+		}
+		add(children, value);
+	} while (accept(T_COMMA));
+	expect(T_R_PAREN, ") expected");
+}
+
+bool Parser::is_cast() const
+{
+	switch (peek(1)) {
+	case T_BIT:
+	case T_INT:
+	case T_VARBIT:
+	case T_BOOL:
+	case T_STRING:
+	case T_TUPLE:
+		return true;
+	default:;
 	}
+	// a parenthesized name is a type if an operand follows it
+	std::size_t ahead = peek(1) == T_DOT ? 2 : 1;
+	return is_name(peek(ahead)) && peek(ahead + 1) == T_R_PAREN && starts_operand(peek(ahead + 2));
 }
 
 } // namespace p4l
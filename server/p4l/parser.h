@@ -4,22 +4,192 @@
 
 #pragma once
 
-#include <istream>
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "ast.h"
 #include "lexer.h"
+#include "token_arena.h"
 
 namespace p4l {
 
+/// \brief whether the bodies of actions, functions, parser states and apply are parsed or skipped
+enum class parse_mode : std::uint8_t {
+	full,
+	signatures, // the bodies are unparsed blocks without children
+};
+
+struct parse_error {
+	std::uint32_t token; // the index of the token the error is found at
+	char const* message;
+};
+
+/**
+ * Parser
+ *
+ *     A recursive descent parser of P4-16.  It reads the token ids of
+ *     p4l::Lexer or of the preprocessed tokens of a token_arena, and
+ *     builds an ast whose nodes refer to the tokens by their index in
+ *     that sequence.  The grammar needs to know the type names to tell
+ *     declarations from expressions, instead the parser tries to read a
+ *     type where both may start and goes back if no name follows it.
+ *     On a syntax error the parser records it and skips to the end of
+ *     the statement or declaration, so that the rest is still parsed.
+ *     Statements, expressions and types nested deeper than max_nesting
+ *     are errors too, an else if chain is parsed in a loop.
+ */
 class Parser final {
  public:
-	explicit Parser(std::istream& is) : lexer(is) {}
-	void run();
+	/// \brief the most tokens the parser looks at after the one it is at
+	static constexpr std::size_t look_ahead = 4;
+	/// \brief the most statements, expressions and types the parser is in at once, deeper ones are errors
+	static constexpr std::size_t max_nesting = 1000;
+
+	/// \brief parse the tokens of p4l::Lexer
+	explicit Parser(std::vector<lexed_token> const& tokens);
+	/// \brief parse the tokens [first, last) of p4l::Lexer, the nodes refer to the tokens by their index in all of them
+	Parser(std::vector<lexed_token> const& tokens, std::size_t first, std::size_t last,
+		   parse_mode mode = parse_mode::full);
+	/// \brief parse the tokens of a compilation, the whitespace and comments among them are skipped
+	explicit Parser(token_arena const& tokens);
+	/// \brief parse the tokens [first, last) of a compilation
+	Parser(token_arena const& tokens, std::size_t first, std::size_t last, parse_mode mode = parse_mode::full);
+	Parser(const Parser&) = delete;
+	Parser& operator=(const Parser&) = delete;
+
+	/// \brief parse all of the tokens
+	ast run();
+	/// \brief parse the next top-level declaration, it is none if it has errors
+	std::uint32_t parse_next();
+	bool at_end() const noexcept {
+		return peek() == boost::wave::T_END;
+	}
+	/// \brief the index of the next token to parse
+	std::uint32_t get_position() const noexcept {
+		return current();
+	}
+	/// \brief parse the block the tokens are, e.g. an unparsed body, it is the child of the root
+	ast run_body();
+	/// \brief the tree of the declarations parsed so far, the parser is not used after it
+	ast release();
+	std::vector<parse_error> const& get_errors() const noexcept {
+		return _errors;
+	}
 
  private:
-	Token token = Token::START;
-	Lexer lexer;
+	struct item {
+		int id;
+		std::uint32_t index;  // in the token sequence
+		bool joined;          // the next token follows without space in between
+	};
+	struct child_list {
+		std::uint32_t first = ast::none;
+		std::uint32_t last = ast::none;
+	};
+	struct mark {
+		std::size_t position;
+		std::size_t nodes;
+		std::size_t errors;
+	};
+	/// \brief counts a statement, expression or type the parser is in, so that the recursion is bounded
+	class nesting {
+	 public:
+		explicit nesting(Parser& parser) noexcept : _parser(parser) {
+			++_parser._nesting;
+		}
+		~nesting() {
+			--_parser._nesting;
+		}
+		nesting(const nesting&) = delete;
+		nesting& operator=(const nesting&) = delete;
+		/// \brief records an error if the parser is in too many
+		bool too_deep() const;
+
+	 private:
+		Parser& _parser;
+	};
+
+	void add_item(int id, std::uint32_t index, bool joined);
+	void finish_items(std::size_t count);
+	void start();
+
+	int peek(std::size_t ahead = 0) const noexcept {
+		return _items[_position + ahead].id;
+	}
+	bool accept(int id) noexcept {
+		if (_items[_position].id == id) {
+			++_position;
+			return true;
+		}
+		return false;
+	}
+	bool expect(int id, char const* message);
+	void error(char const* message);
+	std::uint32_t current() const noexcept {
+		return _items[_position].index;
+	}
+	mark save() const noexcept {
+		return {_position, _nodes.size(), _errors.size()};
+	}
+	void restore(mark const& m);
+	void skip_balanced();
+	void synchronize(std::int32_t depth);
+
+	std::uint32_t make(node_kind kind, std::size_t token, std::size_t begin, std::uint8_t flags = 0);
+	std::uint32_t leaf(node_kind kind, std::uint8_t flags = 0);
+	std::uint32_t finish(std::uint32_t node, child_list const& children);
+	void add(child_list& children, std::uint32_t child);
+	void prepend(std::uint32_t node, child_list const& children, std::size_t begin);
+
+	child_list parse_annotations();
+	std::uint32_t parse_declaration();
+	std::uint32_t parse_constant(std::size_t begin);
+	std::uint32_t parse_struct(std::size_t begin);
+	std::uint32_t parse_enum(std::size_t begin);
+	std::uint32_t parse_members(node_kind kind, std::size_t begin);
+	std::uint32_t parse_type_definition(std::size_t begin);
+	std::uint32_t parse_extern(std::size_t begin);
+	std::uint32_t parse_method();
+	std::uint32_t parse_action(std::size_t begin);
+	std::uint32_t parse_parser(std::size_t begin);
+	std::uint32_t parse_state(std::size_t begin);
+	std::uint32_t parse_value_set(std::size_t begin);
+	std::uint32_t parse_control(std::size_t begin);
+	std::uint32_t parse_package(std::size_t begin);
+	std::uint32_t parse_table(std::size_t begin);
+	std::uint32_t parse_property();
+	std::uint32_t parse_action_reference();
+	std::uint32_t parse_typed_declaration(std::size_t begin, bool local);
+	std::uint32_t parse_local(bool in_parser);
+	std::uint32_t parse_type_parameters();
+	std::uint32_t parse_parameters(std::uint8_t flags);
+
+	std::uint32_t parse_type();
+	std::uint32_t parse_type_arguments();
+
+	std::uint32_t parse_body();
+	std::uint32_t parse_block();
+	std::uint32_t parse_statement();
+	std::uint32_t parse_transition();
+	std::uint32_t parse_keyset();
+	std::uint32_t parse_simple_keyset();
+
+	std::uint32_t parse_expression(int precedence = 0);
+	std::uint32_t parse_unary();
+	std::uint32_t parse_primary();
+	std::uint32_t parse_postfix(std::uint32_t expression, std::size_t begin);
+	void parse_arguments(child_list& children);
+	bool is_cast() const;
+
+	parse_mode _mode = parse_mode::full;
+	std::vector<item> _items;
+	std::vector<std::int32_t> _depths; // of the braces before each item, relative to the first one
+	std::size_t _position = 0;
+	std::size_t _nesting = 0;
+	std::vector<node> _nodes;
+	child_list _declarations;
+	std::vector<parse_error> _errors;
 };
 
 } // namespace p4l
@@ -0,0 +1,263 @@
+#include "symbol_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace p4l {
+
+namespace {
+
+const char SYMBOL_FILE_MAGIC[8] = {'P', '4', 'L', 'S', 'S', 'Y', 'M', 'B'};
+// written as it is in memory, a reader of the other byte order sees 0x04030201
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct section {
+	std::uint32_t offset; // from the start of the image
+	std::uint32_t count;  // of the records, or the bytes of the strings
+};
+
+struct file_header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order;
+	std::uint64_t size;         // of the image
+	std::uint64_t content_hash; // of the source text
+	std::uint64_t checksum;     // of the image after the header
+	section symbols;
+	section names;
+	section occurrences;
+	section strings;
+};
+
+static_assert(sizeof(file_header) == 72, "file_header is expected to be 72 bytes");
+
+std::uint64_t hash_bytes(void const* data, std::size_t size)
+{
+	// FNV-1a
+	std::uint64_t hash = 0xcbf29ce484222325ULL;
+	auto bytes = static_cast<unsigned char const*>(data);
+	for (std::size_t it = 0; it != size; ++it) {
+		hash = (hash ^ bytes[it]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template <typename T>
+section append(std::string& image, T const* data, std::size_t count)
+{
+	section result{static_cast<std::uint32_t>(image.size()), static_cast<std::uint32_t>(count)};
+	image.append(reinterpret_cast<char const*>(data), count * sizeof(T));
+	return result;
+}
+
+/// \brief the records of the section are within the image and aligned
+template <typename T>
+bool is_within(section const& records, std::size_t size)
+{
+	return records.offset % alignof(T) == 0 && records.offset >= sizeof(file_header)
+		&& records.offset + static_cast<std::uint64_t>(records.count) * sizeof(T) <= size;
+}
+
+bool is_valid(file_header const& header, void const* image, std::size_t size, std::string_view source)
+{
+	return std::equal(header.magic, header.magic + sizeof(header.magic), SYMBOL_FILE_MAGIC)
+		&& header.version == symbol_file::version && header.byte_order == BYTE_ORDER_MARK && header.size == size
+		&& is_within<symbol_file::symbol>(header.symbols, size) && is_within<symbol_file::name>(header.names, size)
+		&& is_within<symbol_file::occurrence>(header.occurrences, size) && is_within<char>(header.strings, size)
+		&& header.content_hash == hash_bytes(source.data(), source.size())
+		&& header.checksum
+			== hash_bytes(static_cast<char const*>(image) + sizeof(file_header), size - sizeof(file_header));
+}
+
+/// \brief the records refer to records and strings within the image and to offsets within the source
+bool has_valid_records(file_header const& header, void const* image, std::size_t source_size)
+{
+	auto bytes = static_cast<char const*>(image);
+	auto symbols = reinterpret_cast<symbol_file::symbol const*>(bytes + header.symbols.offset);
+	auto names = reinterpret_cast<symbol_file::name const*>(bytes + header.names.offset);
+	auto occurrences = reinterpret_cast<symbol_file::occurrence const*>(bytes + header.occurrences.offset);
+	auto is_within_strings = [&header](std::uint32_t offset, std::uint32_t length) {
+		return static_cast<std::uint64_t>(offset) + length <= header.strings.count;
+	};
+	auto is_within_source = [source_size](std::uint32_t offset, std::uint64_t end) {
+		return offset <= end && end <= source_size;
+	};
+	for (std::uint32_t it = 0; it != header.names.count; ++it) {
+		auto const& entry = names[it];
+		if (!is_within_strings(entry.text, entry.length) || !is_within_strings(entry.definition, entry.definition_length)
+			|| (entry.first != ast::none && entry.first >= header.occurrences.count)) {
+			return false;
+		}
+	}
+	// the containers come before the symbols in them
+	for (std::uint32_t it = 0; it != header.symbols.count; ++it) {
+		auto const& entry = symbols[it];
+		if (entry.name >= header.names.count || (entry.container != ast::none && entry.container >= it)
+			|| !is_within_source(entry.offset, static_cast<std::uint64_t>(entry.offset) + entry.length)) {
+			return false;
+		}
+	}
+	// the occurrences are in the order of the offsets, a chain goes forward so that it ends
+	for (std::uint32_t it = 0; it != header.occurrences.count; ++it) {
+		auto const& entry = occurrences[it];
+		if (entry.name >= header.names.count
+			|| (entry.next != ast::none && (entry.next <= it || entry.next >= header.occurrences.count))
+			|| !is_within_source(entry.offset, entry.end) || (it != 0 && entry.offset < occurrences[it - 1].offset)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+std::string symbol_file::build(symbol_table const& table, token_arena const& tokens, token_arena::file_id file)
+{
+	auto const& positions = table.get_positions();
+	auto first = std::lower_bound(positions.begin(), positions.end(), file,
+								  [](symbol_table::position const& it, token_arena::file_id key) { return it.file < key; });
+	auto last = std::upper_bound(first, positions.end(), file,
+								 [](token_arena::file_id key, symbol_table::position const& it) { return key < it.file; });
+	// the names of the table in the file, with their occurrences chained in the order of the offsets
+	std::vector<std::uint32_t> names(table.get_names().size(), ast::none);
+	std::vector<std::uint32_t> last_occurrences;
+	std::vector<name> file_names;
+	std::vector<occurrence> occurrences;
+	occurrences.reserve(static_cast<std::size_t>(std::distance(first, last)));
+	std::string strings;
+	for (auto it = first; it != last; ++it) {
+		auto index = static_cast<std::uint32_t>(occurrences.size());
+		auto table_name = table.get_occurrences()[it->occurrence].name;
+		auto& mapped = names[table_name];
+		if (mapped == ast::none) {
+			mapped = static_cast<std::uint32_t>(file_names.size());
+			auto const& entry = table.get_names()[table_name];
+			name record{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(entry.text.size()), 0, 0,
+						index};
+			strings += entry.text;
+			if (entry.definition != ast::none) {
+				auto text = table.get_definition(tokens, table.get_symbols()[entry.definition]);
+				record.definition = static_cast<std::uint32_t>(strings.size());
+				record.definition_length = static_cast<std::uint32_t>(text.size());
+				strings += text;
+			}
+			file_names.push_back(record);
+			last_occurrences.push_back(index);
+		} else {
+			occurrences[last_occurrences[mapped]].next = index;
+			last_occurrences[mapped] = index;
+		}
+		occurrences.push_back({it->offset, it->end, mapped, ast::none});
+	}
+	// the containers come before the symbols in them
+	std::vector<std::uint32_t> symbols(table.get_symbols().size(), ast::none);
+	std::vector<symbol> file_symbols;
+	for (std::size_t it = 0; it != table.get_symbols().size(); ++it) {
+		auto const& declared = table.get_symbols()[it];
+		auto const& token = tokens[declared.token];
+		if (token._file != file) {
+			continue;
+		}
+		symbols[it] = static_cast<std::uint32_t>(file_symbols.size());
+		auto container = declared.container == ast::none ? ast::none : symbols[declared.container];
+		file_symbols.push_back(
+			{names[declared.name], container, token._offset, token._length, static_cast<std::uint32_t>(declared.kind)});
+	}
+
+	std::string image(sizeof(file_header), '\0');
+	file_header header{};
+	std::copy(SYMBOL_FILE_MAGIC, SYMBOL_FILE_MAGIC + sizeof(SYMBOL_FILE_MAGIC), header.magic);
+	header.version = version;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.symbols = append(image, file_symbols.data(), file_symbols.size());
+	header.names = append(image, file_names.data(), file_names.size());
+	header.occurrences = append(image, occurrences.data(), occurrences.size());
+	header.strings = append(image, strings.data(), strings.size());
+	// the next image mapped after this one starts aligned
+	image.resize((image.size() + alignof(file_header) - 1) / alignof(file_header) * alignof(file_header), '\0');
+	header.size = image.size();
+	auto const& source = tokens.get_source(file);
+	header.content_hash = source ? hash_bytes(source->data(), source->size()) : hash_bytes(nullptr, 0);
+	header.checksum = hash_bytes(image.data() + sizeof(file_header), image.size() - sizeof(file_header));
+	std::memcpy(&image[0], &header, sizeof(header));
+	return image;
+}
+
+bool symbol_file::write(std::string const& path, symbol_table const& table, token_arena const& tokens,
+						token_arena::file_id file)
+{
+	auto image = build(table, tokens, file);
+	// a reader never maps a partly written image
+	auto temporary = path + ".tmp";
+	auto fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	auto written = ::write(fd, image.data(), image.size());
+	auto closed = ::close(fd);
+	if (written != static_cast<ssize_t>(image.size()) || closed != 0 || ::rename(temporary.c_str(), path.c_str()) != 0) {
+		::unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+std::unique_ptr<symbol_file> symbol_file::open(std::string const& path, std::string_view source)
+{
+	auto fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat status;
+	if (::fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(file_header)) {
+		::close(fd);
+		return nullptr;
+	}
+	auto size = static_cast<std::size_t>(status.st_size);
+	auto image = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (image == MAP_FAILED) {
+		return nullptr;
+	}
+	auto const& header = *static_cast<file_header const*>(image);
+	if (!is_valid(header, image, size, source) || !has_valid_records(header, image, source.size())) {
+		::munmap(image, size);
+		return nullptr;
+	}
+	return std::unique_ptr<symbol_file>(new symbol_file(image, size));
+}
+
+symbol_file::symbol_file(void const* image, std::size_t size)
+	: _image(image)
+	, _size(size)
+{
+	auto const& header = *static_cast<file_header const*>(image);
+	auto bytes = static_cast<char const*>(image);
+	_symbols = {reinterpret_cast<symbol const*>(bytes + header.symbols.offset), header.symbols.count};
+	_names = {reinterpret_cast<name const*>(bytes + header.names.offset), header.names.count};
+	_occurrences = {reinterpret_cast<occurrence const*>(bytes + header.occurrences.offset), header.occurrences.count};
+	_strings = std::string_view(bytes + header.strings.offset, header.strings.count);
+}
+
+symbol_file::~symbol_file()
+{
+	::munmap(const_cast<void*>(_image), _size);
+}
+
+std::uint32_t symbol_file::find_occurrence(std::uint32_t offset) const noexcept
+{
+	auto found = std::upper_bound(_occurrences.begin(), _occurrences.end(), offset,
+								  [](std::uint32_t key, occurrence const& it) { return key < it.offset; });
+	if (found == _occurrences.begin() || offset > std::prev(found)->end) {
+		return ast::none;
+	}
+	return static_cast<std::uint32_t>(std::prev(found) - _occurrences.begin());
+}
+
+} // namespace p4l
@@ -0,0 +1,127 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "symbol_table.h"
+#include "token_arena.h"
+
+namespace p4l {
+
+/**
+ * symbol_file
+ *
+ *     The symbols, the definitions and the occurrences of the names of
+ *     one source file of a compilation, saved in a binary image that is
+ *     used where it is mapped.  The image is a header followed by flat
+ *     arrays of fixed-size records and a table of the strings, the
+ *     records refer to each other by index and to the strings by
+ *     offset, so that nothing is parsed or relocated on loading.  The
+ *     image is written with one write to a temporary file that is then
+ *     renamed.  It is mapped only if its version and byte order are
+ *     those of the reader, its arrays are within it, the checksum of the
+ *     contents matches and it was saved for the same source text.  The
+ *     indices and offsets in the records are checked once on mapping,
+ *     the accessors do not check them.
+ *
+ *     The positions are offsets in the source text of the file.  Names
+ *     are resolved in their scopes as in symbol_table, the definition of
+ *     a name is saved even if it is in another file of the compilation.
+ */
+class symbol_file {
+ public:
+	// 2: the names are scoped, the analyses of the names matched by text are not used
+	static constexpr std::uint32_t version = 2;
+
+	struct symbol {
+		std::uint32_t name;      // the index of the name
+		std::uint32_t container; // the symbol of the declaration it is in, or none
+		std::uint32_t offset;    // of the name of the declaration
+		std::uint32_t length;
+		std::uint32_t kind;      // node_kind of the declaration
+	};
+
+	struct name {
+		std::uint32_t text;       // offset in the strings
+		std::uint32_t length;
+		std::uint32_t definition; // offset in the strings of the definition text
+		std::uint32_t definition_length;
+		std::uint32_t first;      // occurrence in the file
+	};
+
+	struct occurrence {
+		std::uint32_t offset;
+		std::uint32_t end;
+		std::uint32_t name;
+		std::uint32_t next; // the next occurrence of the name in the file, or none
+	};
+
+	/// \brief a contiguous array of the records in the image
+	template <typename T>
+	struct array_view {
+		T const* _data;
+		std::size_t _size;
+		T const* begin() const noexcept {
+			return _data;
+		}
+		T const* end() const noexcept {
+			return _data + _size;
+		}
+		std::size_t size() const noexcept {
+			return _size;
+		}
+		T const& operator[](std::size_t index) const noexcept {
+			return _data[index];
+		}
+	};
+
+	symbol_file(const symbol_file&) = delete;
+	symbol_file& operator=(const symbol_file&) = delete;
+	~symbol_file();
+
+	/// \brief the image of the symbols and the occurrences in the file of the compilation
+	static std::string build(symbol_table const& table, token_arena const& tokens, token_arena::file_id file);
+	/// \brief save the image of the file of the compilation to the path, returns false if it is not written
+	static bool write(std::string const& path, symbol_table const& table, token_arena const& tokens,
+					  token_arena::file_id file);
+	/// \brief map the image at the path, or null if it is not valid or not saved for the source text
+	static std::unique_ptr<symbol_file> open(std::string const& path, std::string_view source);
+
+	array_view<symbol> get_symbols() const noexcept {
+		return _symbols;
+	}
+	array_view<name> get_names() const noexcept {
+		return _names;
+	}
+	/// \brief the occurrences in the order of their offsets
+	array_view<occurrence> get_occurrences() const noexcept {
+		return _occurrences;
+	}
+	std::string_view get_text(name const& entry) const {
+		return _strings.substr(entry.text, entry.length);
+	}
+	std::string_view get_definition(name const& entry) const {
+		return _strings.substr(entry.definition, entry.definition_length);
+	}
+	/// \brief the occurrence whose name covers the offset, the offset after the name included, or none
+	std::uint32_t find_occurrence(std::uint32_t offset) const noexcept;
+
+ private:
+	symbol_file(void const* image, std::size_t size);
+
+	void const* _image;
+	std::size_t _size;
+	array_view<symbol> _symbols;
+	array_view<name> _names;
+	array_view<occurrence> _occurrences;
+	std::string_view _strings;
+};
+
+} // namespace p4l
@@ -0,0 +1,313 @@
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "visitor.h"
+
+namespace p4l {
+
+namespace {
+
+constexpr bool is_declaration(node_kind kind) noexcept
+{
+	switch (kind) {
+	case node_kind::constant:
+	case node_kind::variable:
+	case node_kind::instantiation:
+	case node_kind::header:
+	case node_kind::header_union:
+	case node_kind::struct_type:
+	case node_kind::field:
+	case node_kind::enum_type:
+	case node_kind::member:
+	case node_kind::type_definition:
+	case node_kind::extern_type:
+	case node_kind::method:
+	case node_kind::function:
+	case node_kind::action:
+	case node_kind::parser_type:
+	case node_kind::parser:
+	case node_kind::state:
+	case node_kind::value_set:
+	case node_kind::control_type:
+	case node_kind::control:
+	case node_kind::package_type:
+	case node_kind::table:
+	case node_kind::type_parameter:
+	case node_kind::parameter:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/// \brief the token of the node is a name that refers to a declaration
+constexpr bool is_reference(node_kind kind) noexcept
+{
+	switch (kind) {
+	case node_kind::name:
+	case node_kind::type_name:
+	case node_kind::member_access:
+	case node_kind::action_reference:
+	case node_kind::named_argument:
+	case node_kind::key_element:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/// \brief the definition text stops before the body, which may be all of a program
+constexpr bool has_body(node_kind kind) noexcept
+{
+	return kind == node_kind::action || kind == node_kind::function || kind == node_kind::parser
+		|| kind == node_kind::control || kind == node_kind::state || kind == node_kind::table;
+}
+
+/// \brief the token of the node is a member of a value or of a callee, it is not looked up in the scopes
+constexpr bool is_member_reference(node_kind kind) noexcept
+{
+	return kind == node_kind::member_access || kind == node_kind::named_argument;
+}
+
+/// \brief a member reference may refer to the declaration
+constexpr bool is_member(node_kind kind) noexcept
+{
+	return kind == node_kind::field || kind == node_kind::member || kind == node_kind::method
+		|| kind == node_kind::parameter;
+}
+
+bool is_name(std::string_view text) noexcept
+{
+	return !text.empty() && (std::isalpha(static_cast<unsigned char>(text[0])) || text[0] == '_');
+}
+
+} // namespace
+
+/**
+ * symbol_collector
+ *
+ *     Fills a symbol_table in one walk of the tree.  A declaration is
+ *     the container of the declarations below it, and its name is
+ *     declared in its container.  The references are resolved after the
+ *     walk, so that they may come before their declarations, e.g. the
+ *     states of a parser, and the occurrences are chained then.
+ */
+class symbol_collector : public visitor<symbol_collector> {
+ public:
+	symbol_collector(symbol_table& table, token_arena const& tokens) : _table(table), _tokens(tokens) {
+		_references.reserve(table._occurrences.capacity());
+	}
+
+	template <node_kind Kind, std::enable_if_t<is_declaration(Kind), int> = 0>
+	bool preorder(kind_tag<Kind>, ast const& tree, std::uint32_t index) {
+		auto const& node = tree[index];
+		auto text = get_name(node.token);
+		if (text.empty()) {
+			return true;
+		}
+		auto end = node.end;
+		if (has_body(Kind)) {
+			// the signature up to the end of the parameters, tables and states have only the name
+			end = std::max(node.begin, node.token + 1);
+			for (auto child : tree.get_children(index)) {
+				if (tree[child].kind == node_kind::parameters) {
+					end = std::max(end, tree[child].end);
+				}
+			}
+		}
+		auto container = get_container();
+		auto name = get_name(text, container);
+		auto symbol = static_cast<std::uint32_t>(_table._symbols.size());
+		_table._symbols.push_back({index, node.token, name, container, node.begin, end, Kind});
+		auto& entry = _table._names[name];
+		if (entry.definition == ast::none) {
+			entry.definition = symbol;
+		}
+		add_occurrence(node.token, name);
+		_containers.push_back(symbol);
+		return true;
+	}
+	template <node_kind Kind, std::enable_if_t<is_declaration(Kind), int> = 0>
+	void postorder(kind_tag<Kind>, ast const&, std::uint32_t index) {
+		if (!_containers.empty() && _table._symbols[_containers.back()].node == index) {
+			_containers.pop_back();
+		}
+	}
+	template <node_kind Kind, std::enable_if_t<is_reference(Kind), int> = 0>
+	bool preorder(kind_tag<Kind>, ast const& tree, std::uint32_t index) {
+		auto const& node = tree[index];
+		auto text = get_name(node.token);
+		if (text.empty()) {
+			return true;
+		}
+		// a name that starts with a dot is a top-level one
+		auto top_level = (Kind == node_kind::name || Kind == node_kind::type_name) && node.flags == 1;
+		auto scope = is_member_reference(Kind) ? member_scope : top_level ? ast::none : get_container();
+		_references.push_back({text, static_cast<std::uint32_t>(_table._occurrences.size()), scope});
+		add_occurrence(node.token, ast::none);
+		return true;
+	}
+
+	/// \brief find the names of the references and chain the occurrences of every name in order
+	void resolve() {
+		// the members by their text, to find the only one with the text of a member reference
+		std::vector<std::pair<std::string_view, std::uint32_t>> members;
+		for (std::uint32_t it = 0; it != _table._symbols.size(); ++it) {
+			auto const& declared = _table._symbols[it];
+			if (is_member(declared.kind) && declared.container != ast::none) {
+				members.emplace_back(_table._names[declared.name].text, it);
+			}
+		}
+		std::sort(members.begin(), members.end());
+		for (auto const& it : _references) {
+			auto name = ast::none;
+			if (it.scope == member_scope) {
+				auto range = std::equal_range(members.begin(), members.end(), std::make_pair(it.text, std::uint32_t(0)),
+											  [](auto const& lhs, auto const& rhs) { return lhs.first < rhs.first; });
+				if (range.second - range.first == 1) {
+					name = _table._symbols[range.first->second].name;
+				}
+			} else {
+				for (auto scope = it.scope; scope != ast::none && name == ast::none; scope = _table._symbols[scope].container) {
+					name = _table._name_slots[_table.find_slot(it.text, scope)];
+				}
+			}
+			_table._occurrences[it.occurrence].name = name == ast::none ? get_name(it.text, ast::none) : name;
+		}
+		for (std::uint32_t it = 0; it != _table._occurrences.size(); ++it) {
+			auto& entry = _table._names[_table._occurrences[it].name];
+			if (entry.first == ast::none) {
+				entry.first = it;
+			} else {
+				_table._occurrences[entry.last].next = it;
+			}
+			entry.last = it;
+		}
+	}
+
+ private:
+	/// \brief the scope of a member reference, its name is not looked up in the containers
+	static constexpr std::uint32_t member_scope = ast::none - 1;
+
+	struct reference {
+		std::string_view text;
+		std::uint32_t occurrence;
+		std::uint32_t scope; // the innermost declaration the reference is in, none or member_scope
+	};
+
+	std::uint32_t get_container() const noexcept {
+		return _containers.empty() ? ast::none : _containers.back();
+	}
+	/// \brief the text of the token, empty if it is not a name
+	std::string_view get_name(std::uint32_t token) const {
+		if (token == ast::none || token >= _tokens.size()) {
+			return {};
+		}
+		auto text = _tokens.get_text(_tokens[token]);
+		return is_name(text) ? text : std::string_view();
+	}
+	/// \brief the name with the text declared in the scope, it is added if there is none
+	std::uint32_t get_name(std::string_view text, std::uint32_t scope) {
+		auto& slot = _table._name_slots[_table.find_slot(text, scope)];
+		if (slot == ast::none) {
+			slot = static_cast<std::uint32_t>(_table._names.size());
+			_table._names.push_back({text, scope, ast::none, ast::none, ast::none});
+		}
+		return slot;
+	}
+	/// \brief the occurrence of the name of the token, the occurrences are chained by resolve
+	void add_occurrence(std::uint32_t token, std::uint32_t name) {
+		auto occurrence = static_cast<std::uint32_t>(_table._occurrences.size());
+		_table._occurrences.push_back({token, name, ast::none});
+		auto const& compact = _tokens[token];
+		if (compact._file != token_arena::scratch_file) {
+			_table._positions.push_back({compact._file, compact._offset, compact._offset + compact._length, occurrence});
+		}
+	}
+
+	symbol_table& _table;
+	token_arena const& _tokens;
+	std::vector<std::uint32_t> _containers;
+	std::vector<reference> _references;
+};
+
+symbol_table::symbol_table(ast const& tree, token_arena const& tokens)
+{
+	// a node adds at most one symbol and one occurrence
+	_symbols.reserve(tree.size());
+	_occurrences.reserve(tree.size());
+	_positions.reserve(tree.size());
+	_names.reserve(tree.size());
+	// at most half of the slots are used
+	std::size_t slots = 16;
+	while (slots < 2 * tree.size()) {
+		slots *= 2;
+	}
+	_name_slots.assign(slots, ast::none);
+	symbol_collector collector(*this, tokens);
+	collector.visit(tree);
+	collector.resolve();
+	// the walk finds them in the order of the tree, mostly the order of the source
+	std::sort(_positions.begin(), _positions.end(), [](position const& lhs, position const& rhs) {
+		return std::tie(lhs.file, lhs.offset) < std::tie(rhs.file, rhs.offset);
+	});
+}
+
+std::uint32_t symbol_table::find_name(std::string_view text, std::uint32_t scope) const
+{
+	if (_name_slots.empty()) {
+		return ast::none;
+	}
+	return _name_slots[find_slot(text, scope)];
+}
+
+std::size_t symbol_table::find_slot(std::string_view text, std::uint32_t scope) const
+{
+	auto mask = _name_slots.size() - 1;
+	auto hash = std::hash<std::string_view>()(text) ^ (std::size_t(scope) * 0x9e3779b97f4a7c15ULL);
+	for (auto it = hash & mask;; it = (it + 1) & mask) {
+		auto slot = _name_slots[it];
+		if (slot == ast::none || (_names[slot].scope == scope && _names[slot].text == text)) {
+			return it;
+		}
+	}
+}
+
+std::uint32_t symbol_table::find_occurrence(token_arena::file_id file, std::uint32_t offset) const
+{
+	auto found = std::upper_bound(_positions.begin(), _positions.end(), std::make_pair(file, offset),
+								  [](std::pair<token_arena::file_id, std::uint32_t> const& key, position const& it) {
+									  return key < std::make_pair(it.file, it.offset);
+								  });
+	if (found == _positions.begin()) {
+		return ast::none;
+	}
+	--found;
+	return found->file == file && offset <= found->end ? found->occurrence : ast::none;
+}
+
+std::string symbol_table::get_definition(token_arena const& tokens, symbol const& declared) const
+{
+	if (declared.begin == declared.end || declared.end > tokens.size()) {
+		return {};
+	}
+	// the source as it is written if the text is in one file, the whitespace in the tokens is not
+	auto const& first = tokens[declared.begin];
+	auto const& last = tokens[declared.end - 1];
+	if (first._file != token_arena::scratch_file && first._file == last._file && first._offset <= last._offset) {
+		return tokens.get_source(first._file)->substr(first._offset, last._offset + last._length - first._offset);
+	}
+	std::string result;
+	for (auto it = declared.begin; it != declared.end; ++it) {
+		result += tokens.get_text(tokens[it]);
+	}
+	return result;
+}
+
+} // namespace p4l
@@ -0,0 +1,109 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.h"
+#include "token_arena.h"
+
+namespace p4l {
+
+/**
+ * symbol_table
+ *
+ *     The declarations of a syntax tree of a compilation and the
+ *     occurrences of their names, collected by one walk of the tree.
+ *     A name is declared in the declaration the symbol is in, e.g. a
+ *     parameter in its action or a field in its header, or at the top
+ *     level.  A name in an expression or a type refers to the nearest
+ *     enclosing declaration that declares its text, or to the top-level
+ *     name.  The member of a member access or a named argument refers to
+ *     the field, member, method or parameter with its text if there is
+ *     only one, the types of the expressions are not known.  The names
+ *     that are not declared are top-level names.  A symbol keeps the
+ *     span of tokens of its definition text, the text is taken from the
+ *     source only when it is asked for.  The occurrences of a name are
+ *     chained in the order of the tree, and the occurrences in source
+ *     files are indexed by their position for the queries of an editor.
+ *     The storage is reserved for the size of the tree before the walk.
+ *
+ *     The string views of the names refer to the texts of the tokens,
+ *     the table is used only as long as its token_arena is unchanged.
+ */
+class symbol_table {
+ public:
+	struct symbol {
+		std::uint32_t node;      // the declaration in the tree
+		std::uint32_t token;     // the name of the declaration
+		std::uint32_t name;      // the index of the name
+		std::uint32_t container; // the symbol of the declaration it is in, or none
+		std::uint32_t begin;     // the first token of the definition text
+		std::uint32_t end;       // the token after the definition text, it is begin if there is none
+		node_kind kind;
+	};
+
+	struct occurrence {
+		std::uint32_t token;
+		std::uint32_t name;
+		std::uint32_t next; // the next occurrence of the name, or none
+	};
+
+	struct position {
+		token_arena::file_id file;
+		std::uint32_t offset;
+		std::uint32_t end;
+		std::uint32_t occurrence;
+	};
+
+	struct name_entry {
+		std::string_view text;
+		std::uint32_t scope;      // the symbol the name is declared in, or none at the top level
+		std::uint32_t first;      // occurrence
+		std::uint32_t last;       // occurrence
+		std::uint32_t definition; // the first symbol of the name, or none
+	};
+
+	symbol_table() = default;
+	symbol_table(ast const& tree, token_arena const& tokens);
+
+	std::vector<symbol> const& get_symbols() const noexcept {
+		return _symbols;
+	}
+	std::vector<occurrence> const& get_occurrences() const noexcept {
+		return _occurrences;
+	}
+	std::vector<name_entry> const& get_names() const noexcept {
+		return _names;
+	}
+	/// \brief the occurrences in source files in the order of the files and the offsets
+	std::vector<position> const& get_positions() const noexcept {
+		return _positions;
+	}
+	/// \brief the index of the name declared in the scope, the top-level one by default, or none
+	std::uint32_t find_name(std::string_view text, std::uint32_t scope = ast::none) const;
+	/// \brief the occurrence whose token covers the offset of the file, the offset after the token included
+	std::uint32_t find_occurrence(token_arena::file_id file, std::uint32_t offset) const;
+	/// \brief the definition text of the symbol as it is in the source, or the text of its tokens if it is not in one file
+	std::string get_definition(token_arena const& tokens, symbol const& declared) const;
+
+ private:
+	friend class symbol_collector;
+
+	/// \brief the slot of the name with the text in the scope, or the free slot it goes to
+	std::size_t find_slot(std::string_view text, std::uint32_t scope) const;
+
+	std::vector<symbol> _symbols;
+	std::vector<occurrence> _occurrences;
+	std::vector<name_entry> _names;
+	/// \brief open addressing of the names by the hash of their text and scope, a free slot is none
+	std::vector<std::uint32_t> _name_slots;
+	std::vector<position> _positions;
+};
+
+} // namespace p4l
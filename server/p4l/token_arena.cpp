@@ -0,0 +1,217 @@
+#include "token_arena.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace p4l {
+
+namespace {
+
+constexpr std::size_t TOKEN_ID_TABLE_SIZE = 1 << 12;
+// code 0 is reserved for token id 0, an empty slot holds 0 as well
+std::array<std::atomic<std::uint32_t>, TOKEN_ID_TABLE_SIZE> token_ids;
+
+// Wave's position iterator advances the column to the next multiple of 4 on a tab
+constexpr std::size_t TAB_CHARS = 4;
+
+std::size_t next_column(char c, std::size_t column) {
+	return c == '\t' ? column + TAB_CHARS - (column - 1) % TAB_CHARS : column + 1;
+}
+
+token_arena::source_type load_source(std::string const& name) {
+	std::ifstream ifs(name, std::ios::binary);
+	if (!ifs) {
+		return nullptr;
+	}
+	return std::make_shared<std::string const>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+std::uint16_t token_id_table::encode(boost::wave::token_id id) {
+	auto key = static_cast<std::uint32_t>(id);
+	if (key == 0) {
+		return 0;
+	}
+	auto slot = ((key * 2654435761u) >> 20) & (TOKEN_ID_TABLE_SIZE - 1);
+	for (std::size_t probe = 0; probe != TOKEN_ID_TABLE_SIZE; ++probe) {
+		if (slot != 0) {
+			auto current = token_ids[slot].load(std::memory_order_acquire);
+			if (current == 0 && token_ids[slot].compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+				return static_cast<std::uint16_t>(slot);
+			}
+			if (current == key) {
+				return static_cast<std::uint16_t>(slot);
+			}
+		}
+		slot = (slot + 1) & (TOKEN_ID_TABLE_SIZE - 1);
+	}
+	throw std::length_error("token id table is full");
+}
+
+boost::wave::token_id token_id_table::decode(std::uint16_t code) {
+	return boost::wave::token_id(token_ids[code].load(std::memory_order_acquire));
+}
+
+token_arena::token_arena()
+	: token_arena(load_source)
+{}
+
+token_arena::token_arena(loader_type loader)
+	: _loader(std::move(loader))
+	, _last_file(scratch_file)
+	, _last_line(0)
+	, _last_column(0)
+	, _last_offset(0)
+{
+	_files.push_back(file_entry{"<scratch>", "<scratch>", nullptr, {}});
+}
+
+token_arena::file_id token_arena::add_file(std::string const& name, source_type source) {
+	if (_files.size() > std::numeric_limits<file_id>::max()) {
+		throw std::length_error("too many files in the token arena");
+	}
+	auto id = static_cast<file_id>(_files.size());
+	file_entry entry{name, wave_token_type::string_type(name.c_str()), std::move(source), {0}};
+	if (entry._source) {
+		auto& text = *entry._source;
+		for (std::uint32_t it = 0; it < text.size(); ++it) {
+			if (text[it] == '\n' || (text[it] == '\r' && (it + 1 == text.size() || text[it + 1] != '\n'))) {
+				entry._lines.push_back(it + 1);
+			}
+		}
+	}
+	_files.push_back(std::move(entry));
+	_file_ids[name] = id;
+	return id;
+}
+
+boost::optional<token_arena::file_id> token_arena::find_file(std::string const& name) const {
+	auto found = _file_ids.find(name);
+	if (found == _file_ids.end()) {
+		return boost::none;
+	}
+	return found->second;
+}
+
+std::string const& token_arena::get_file_name(file_id file) const {
+	return _files[file]._name;
+}
+
+void token_arena::push_back(boost::wave::token_id id, file_id file, std::uint32_t offset, std::uint32_t length) {
+	_tokens.push_back(compact_token{token_id_table::encode(id), file, offset, length});
+}
+
+void token_arena::push_back_scratch(boost::wave::token_id id, std::string_view text) {
+	auto offset = static_cast<std::uint32_t>(_scratch.size());
+	_scratch.append(text.data(), text.size());
+	push_back(id, scratch_file, offset, static_cast<std::uint32_t>(text.size()));
+}
+
+void token_arena::append(wave_token_type const& token) {
+	auto& value = token.get_value();
+	std::string_view text(value.data(), value.size());
+	auto& position = token.get_position();
+	auto& name = position.get_file();
+	auto found = _file_ids.find(std::string(name.c_str(), name.size()));
+	auto file = found != _file_ids.end() ? found->second : add_file(std::string(name.c_str(), name.size()), _loader ? _loader(name.c_str()) : nullptr);
+	if (auto offset = find_offset(file, position.get_line(), position.get_column())) {
+		auto& source = *_files[file]._source;
+		if (source.compare(*offset, text.size(), text.data(), text.size()) == 0) {
+			push_back(token, file, *offset, static_cast<std::uint32_t>(text.size()));
+			return;
+		}
+	}
+	push_back_scratch(token, text);
+}
+
+void token_arena::clear() {
+	_files.resize(1);
+	_file_ids.clear();
+	_scratch.clear();
+	_tokens.clear();
+	_last_file = scratch_file;
+}
+
+std::string_view token_arena::get_text(compact_token const& token) const {
+	if (token._file == scratch_file) {
+		return std::string_view(_scratch).substr(token._offset, token._length);
+	}
+	return std::string_view(*_files[token._file]._source).substr(token._offset, token._length);
+}
+
+std::pair<std::size_t, std::size_t> token_arena::get_line_column(compact_token const& token) const {
+	auto& entry = _files[token._file];
+	if (token._file == scratch_file || entry._lines.empty()) {
+		return {0, 0};
+	}
+	auto line = std::upper_bound(entry._lines.begin(), entry._lines.end(), token._offset) - entry._lines.begin();
+	std::size_t column = 1;
+	auto& source = *entry._source;
+	for (auto it = entry._lines[line - 1]; it != token._offset; ++it) {
+		column = next_column(source[it], column);
+	}
+	return {static_cast<std::size_t>(line), column};
+}
+
+std::pair<std::size_t, std::size_t> token_arena::get_line_character(compact_token const& token) const {
+	auto& entry = _files[token._file];
+	if (token._file == scratch_file || entry._lines.empty()) {
+		return {0, 0};
+	}
+	auto line = std::upper_bound(entry._lines.begin(), entry._lines.end(), token._offset) - entry._lines.begin() - 1;
+	return {static_cast<std::size_t>(line), token._offset - entry._lines[line]};
+}
+
+boost::optional<std::uint32_t> token_arena::get_offset(file_id file, std::size_t line, std::size_t character) const {
+	auto& entry = _files[file];
+	if (!entry._source || line >= entry._lines.size()) {
+		return boost::none;
+	}
+	auto end = line + 1 < entry._lines.size() ? entry._lines[line + 1] : static_cast<std::uint32_t>(entry._source->size());
+	if (entry._lines[line] + character > end) {
+		return boost::none;
+	}
+	return static_cast<std::uint32_t>(entry._lines[line] + character);
+}
+
+token_arena::wave_token_type token_arena::materialize(compact_token const& token) const {
+	auto text = get_text(token);
+	auto line_column = get_line_column(token);
+	return wave_token_type(get_id(token),
+						   wave_token_type::string_type(text.data(), text.size()),
+						   wave_token_type::position_type(_files[token._file]._wave_name, line_column.first, line_column.second));
+}
+
+boost::optional<std::uint32_t> token_arena::find_offset(file_id file, std::size_t line, std::size_t column) {
+	auto& entry = _files[file];
+	if (!entry._source || line == 0 || line > entry._lines.size()) {
+		return boost::none;
+	}
+	auto& source = *entry._source;
+	std::size_t current = 1;
+	std::uint32_t offset = entry._lines[line - 1];
+	if (file == _last_file && line == _last_line && column >= _last_column) {
+		current = _last_column;
+		offset = _last_offset;
+	}
+	auto end = line < entry._lines.size() ? entry._lines[line] : static_cast<std::uint32_t>(source.size());
+	while (current < column && offset < end) {
+		current = next_column(source[offset++], current);
+	}
+	if (current != column) {
+		return boost::none;
+	}
+	_last_file = file;
+	_last_line = line;
+	_last_column = column;
+	_last_offset = offset;
+	return offset;
+}
+
+} // namespace p4l
@@ -0,0 +1,144 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/wave/token_ids.hpp>
+
+#include "p4lex_token.h"
+
+namespace p4l {
+
+/**
+ * compact_token
+ *
+ *     A token as a reference into an immutable source buffer.  The
+ *     text and the position of the token are not stored but found
+ *     through the file table of the token_arena owning it.
+ */
+struct compact_token {
+	std::uint16_t _id;     // token id encoded by token_id_table
+	std::uint16_t _file;   // index in the file table of the arena
+	std::uint32_t _offset; // start of the token text in the file
+	std::uint32_t _length; // length of the token text
+};
+
+static_assert(sizeof(compact_token) == 12, "compact_token is expected to be 12 bytes");
+
+/**
+ * token_id_table
+ *
+ *     Maps Wave token ids, which use the upper bits for the token
+ *     category, and the negative P4 token ids to 16-bit codes.  The
+ *     table is shared by all threads and is filled without locking
+ *     as new token ids are encountered.
+ */
+class token_id_table {
+ public:
+	static std::uint16_t encode(boost::wave::token_id id);
+	static boost::wave::token_id decode(std::uint16_t code);
+};
+
+/**
+ * token_arena
+ *
+ *     Owns the tokens of one compilation together with the table of
+ *     the source files they refer to.  Tokens whose text is not found
+ *     in any source, e.g. the results of macro expansion, are copied
+ *     to a scratch buffer, file 0 of the table.  Tokens are turned
+ *     into Wave's token type only on request.
+ *
+ *     The string views returned by get_text are invalidated when a
+ *     token is added to the scratch buffer.
+ */
+class token_arena {
+ public:
+	using file_id = std::uint16_t;
+	using source_type = std::shared_ptr<std::string const>;
+	using loader_type = std::function<source_type(std::string const&)>;
+	using wave_token_type = p4lex_token<>;
+
+	static constexpr file_id scratch_file = 0;
+
+	token_arena();
+	explicit token_arena(loader_type loader);
+
+	file_id add_file(std::string const& name, source_type source);
+	boost::optional<file_id> find_file(std::string const& name) const;
+	std::string const& get_file_name(file_id file) const;
+	source_type const& get_source(file_id file) const {
+		return _files[file]._source;
+	}
+	std::size_t get_file_count() const noexcept {
+		return _files.size();
+	}
+
+	void push_back(boost::wave::token_id id, file_id file, std::uint32_t offset, std::uint32_t length);
+	void push_back_scratch(boost::wave::token_id id, std::string_view text);
+	// append a token produced by Wave, referring to its source where possible
+	void append(wave_token_type const& token);
+	void clear();
+
+	std::size_t size() const noexcept {
+		return _tokens.size();
+	}
+	bool empty() const noexcept {
+		return _tokens.empty();
+	}
+	compact_token const& operator[](std::size_t index) const noexcept {
+		return _tokens[index];
+	}
+	std::vector<compact_token>::const_iterator begin() const noexcept {
+		return _tokens.begin();
+	}
+	std::vector<compact_token>::const_iterator end() const noexcept {
+		return _tokens.end();
+	}
+
+	boost::wave::token_id get_id(compact_token const& token) const {
+		return token_id_table::decode(token._id);
+	}
+	std::string_view get_text(compact_token const& token) const;
+	// line and column of the token as Wave counts them, both start at 1
+	std::pair<std::size_t, std::size_t> get_line_column(compact_token const& token) const;
+	// line and character of the token as LSP counts them in ASCII text, both start at 0
+	std::pair<std::size_t, std::size_t> get_line_character(compact_token const& token) const;
+	// offset in the file of the line and character as LSP counts them, if the file has them
+	boost::optional<std::uint32_t> get_offset(file_id file, std::size_t line, std::size_t character) const;
+	wave_token_type materialize(compact_token const& token) const;
+
+ private:
+	struct file_entry {
+		std::string _name;
+		wave_token_type::string_type _wave_name;
+		source_type _source;
+		std::vector<std::uint32_t> _lines; // offsets of the line starts
+	};
+
+	boost::optional<std::uint32_t> find_offset(file_id file, std::size_t line, std::size_t column);
+
+	loader_type _loader;
+	std::vector<file_entry> _files;
+	std::unordered_map<std::string, file_id> _file_ids;
+	std::string _scratch;
+	std::vector<compact_token> _tokens;
+
+	// the last position found, tokens arrive mostly in order
+	file_id _last_file;
+	std::size_t _last_line;
+	std::size_t _last_column;
+	std::uint32_t _last_offset;
+};
+
+} // namespace p4l
@@ -0,0 +1,136 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "ast.h"
+
+namespace p4l {
+
+/// \brief the tag the hooks of a visitor for one kind of nodes are overloaded on
+template <node_kind Kind>
+using kind_tag = std::integral_constant<node_kind, Kind>;
+
+/**
+ * visitor
+ *
+ *     Walks a syntax tree in depth-first order and calls the hooks of
+ *     Derived for every node, without virtual calls.  Derived defines
+ *     the hooks of the kinds it is interested in as overloads on their
+ *     tags, the other kinds go to the hooks of any node:
+ *
+ *         bool preorder(kind_tag<node_kind::header>, ast const&, std::uint32_t);
+ *         void postorder(kind_tag<node_kind::header>, ast const&, std::uint32_t);
+ *         bool preorder_node(ast const&, std::uint32_t);
+ *         void postorder_node(ast const&, std::uint32_t);
+ *
+ *     A preorder hook returns false to skip the children of the node,
+ *     postorder is still called.  Which hook a kind goes to is decided
+ *     at compile time, the walk calls it through a table indexed by the
+ *     kind.  The hooks are public, so that the visitor can find them.
+ *     The walk keeps the path to the node it is at on its own stack, so
+ *     that a deep tree, e.g. a long chain of binary operators, does not
+ *     overflow the call stack.
+ */
+template <typename Derived>
+class visitor {
+ public:
+	/// \brief visit all of the tree
+	void visit(ast const& tree) {
+		if (!tree.empty()) {
+			visit(tree, tree.get_root());
+		}
+	}
+	/// \brief visit the node and its descendants
+	void visit(ast const& tree, std::uint32_t index) {
+		// the nodes from the index to the one being visited, the depth of a tree is not bounded by the call stack
+		std::vector<frame> path;
+		enter(tree, index, path);
+		while (!path.empty()) {
+			auto& top = path.back();
+			if (top.next == ast::none) {
+				auto node = top.node;
+				path.pop_back();
+				get_entry(tree[node].kind).postorder(static_cast<Derived&>(*this), tree, node);
+				continue;
+			}
+			auto child = top.next;
+			top.next = tree[child].next;
+			enter(tree, child, path);
+		}
+	}
+
+	bool preorder_node(ast const&, std::uint32_t) {
+		return true;
+	}
+	void postorder_node(ast const&, std::uint32_t) {}
+
+ private:
+	struct entry {
+		bool (*preorder)(Derived&, ast const&, std::uint32_t);
+		void (*postorder)(Derived&, ast const&, std::uint32_t);
+	};
+	struct frame {
+		std::uint32_t node;
+		std::uint32_t next; // the child to visit next, or none
+	};
+
+	/// \brief call preorder of the node, its children are visited next unless it returns false
+	void enter(ast const& tree, std::uint32_t index, std::vector<frame>& path) {
+		auto const& entry = get_entry(tree[index].kind);
+		auto& derived = static_cast<Derived&>(*this);
+		if (entry.preorder(derived, tree, index)) {
+			path.push_back({index, tree[index].first});
+		} else {
+			entry.postorder(derived, tree, index);
+		}
+	}
+
+	// the hook of the kind if Derived has one, the one of any node otherwise, D defers the lookup until Derived is complete
+	template <node_kind Kind, typename D = Derived>
+	static auto call_preorder(D& derived, ast const& tree, std::uint32_t index, int)
+		-> decltype(derived.preorder(kind_tag<Kind>{}, tree, index)) {
+		return derived.preorder(kind_tag<Kind>{}, tree, index);
+	}
+	template <node_kind Kind>
+	static bool call_preorder(Derived& derived, ast const& tree, std::uint32_t index, long) {
+		return derived.preorder_node(tree, index);
+	}
+	template <node_kind Kind, typename D = Derived>
+	static auto call_postorder(D& derived, ast const& tree, std::uint32_t index, int)
+		-> decltype(derived.postorder(kind_tag<Kind>{}, tree, index)) {
+		derived.postorder(kind_tag<Kind>{}, tree, index);
+	}
+	template <node_kind Kind>
+	static void call_postorder(Derived& derived, ast const& tree, std::uint32_t index, long) {
+		derived.postorder_node(tree, index);
+	}
+
+	template <std::size_t Kind>
+	static constexpr entry make_entry() {
+		return {[](Derived& derived, ast const& tree, std::uint32_t index) -> bool {
+					return call_preorder<static_cast<node_kind>(Kind)>(derived, tree, index, 0);
+				},
+				[](Derived& derived, ast const& tree, std::uint32_t index) {
+					call_postorder<static_cast<node_kind>(Kind)>(derived, tree, index, 0);
+				}};
+	}
+	template <std::size_t... Kinds>
+	static constexpr std::array<entry, node_kind_count> make_table(std::index_sequence<Kinds...>) {
+		return {make_entry<Kinds>()...};
+	}
+	// the table is made when it is first used, Derived is complete by then
+	static entry const& get_entry(node_kind kind) noexcept {
+		static constexpr std::array<entry, node_kind_count> table = make_table(std::make_index_sequence<node_kind_count>{});
+		return table[static_cast<std::size_t>(kind)];
+	}
+};
+
+} // namespace p4l
@@ -0,0 +1,64 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include "preprocessor.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+#include "symbol_table.h"
+
+/**
+ * compilation
+ *
+ *     The tokens, the tree and the symbol table of a source text
+ *     preprocessed as main.p4 in the current directory, the way
+ *     P4_file compiles a document.
+ */
+struct compilation {
+	explicit compilation(std::string const& source) {
+		// Wave reports the positions with the absolute path of the file
+		name = (boost::filesystem::current_path() / "main.p4").string();
+		file = arena.add_file(name, std::make_shared<const std::string>(source));
+		std::string command[] = {"p4lsd"};
+		std::vector<char*> argv;
+		for (auto& it : command) {
+			argv.push_back(&it[0]);
+		}
+		auto settings = Context_factory::get_instance().get_settings(argv);
+		auto text = source;
+		auto ctx = Context_factory::get_instance().create(text.begin(), text.end(), name, *settings);
+		for (auto token = ctx->begin(); token != ctx->end(); ++token) {
+			arena.append(*token);
+		}
+		p4l::Parser parser(arena);
+		tree = parser.run();
+		BOOST_TEST(parser.get_errors().empty());
+		table = p4l::symbol_table(tree, arena);
+	}
+
+	/// \brief the first declaration of the text in any scope
+	p4l::symbol_table::symbol const& find_symbol(std::string const& text) const {
+		auto const& symbols = table.get_symbols();
+		auto found = std::find_if(symbols.begin(), symbols.end(), [this, &text](auto const& it) {
+			return table.get_names()[it.name].text == text;
+		});
+		BOOST_REQUIRE(found != symbols.end());
+		return *found;
+	}
+
+	std::string name;
+	p4l::token_arena::file_id file;
+	p4l::token_arena arena;
+	p4l::ast tree;
+	p4l::symbol_table table;
+};
@@ -0,0 +1,77 @@
+#include "compile_commands.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+
+BOOST_AUTO_TEST_SUITE(compile_commands_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_find_commands)
+{
+	auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%");
+	boost::filesystem::create_directory(directory);
+	auto json_path = directory / "compile_commands.json";
+	std::ofstream(json_path.string())
+		<< "[\n"
+		<< "{\"directory\": \"/w\", \"command\": \"/opt/bin/p4c -I include -D X=1 /w/a.p4\", \"file\": \"/w/a.p4\"},\n"
+		<< "{\"directory\": \"/w\", \"command\": \"/opt/bin/p4c -I include -D X=1 b.p4\", \"file\": \"b.p4\", \"output\": \"b.json\"},\n"
+		<< "{\"directory\": \"/w\", \"arguments\": [\"/opt/bin/p4c\", \"-I\", \"other include\", \"c.p4\"], \"file\": \"./sub/../c.p4\"}\n"
+		<< "]\n";
+	{
+		Compile_commands compile_commands(json_path);
+		BOOST_TEST(compile_commands.is_valid());
+		auto arguments = compile_commands.find_arguments("/w/b.p4");
+		BOOST_REQUIRE(arguments);
+		BOOST_TEST(arguments->size() == 6U);
+		BOOST_TEST(arguments->front() == "/opt/bin/p4c");
+		BOOST_TEST(arguments->back() == "b.p4");
+		arguments = compile_commands.find_arguments("/w/c.p4");
+		BOOST_REQUIRE(arguments);
+		BOOST_TEST((*arguments)[2] == "other include");
+		auto command = compile_commands.find_command("/w/a.p4");
+		BOOST_REQUIRE(command);
+		BOOST_TEST(*command == "p4lsd -I include -D X=1 /w/a.p4");
+		BOOST_TEST(!compile_commands.find_command("/w/d.p4"));
+	}
+	BOOST_TEST(boost::filesystem::exists(Compile_commands::get_index_path(json_path)));
+	{
+		// the same answers from the saved index
+		Compile_commands compile_commands(json_path);
+		auto arguments = compile_commands.find_arguments("/w/c.p4");
+		BOOST_REQUIRE(arguments);
+		BOOST_TEST(arguments->size() == 4U);
+		BOOST_TEST((*arguments)[2] == "other include");
+		BOOST_TEST(compile_commands.find_command("/w/b.p4").value_or("") == "p4lsd -I include -D X=1 b.p4");
+	}
+	std::ofstream(json_path.string()) << "[{\"directory\": \"/w\", \"command\": \"p4c -I new /w/a.p4\", \"file\": \"/w/a.p4\"}]";
+	{
+		// the index is stale after the JSON file changed
+		Compile_commands compile_commands(json_path);
+		BOOST_TEST(compile_commands.find_command("/w/a.p4").value_or("") == "p4lsd -I new /w/a.p4");
+		BOOST_TEST(!compile_commands.find_command("/w/b.p4"));
+	}
+	// a rewrite of the same size within the same second, as generators do
+	std::ofstream(json_path.string()) << "[{\"directory\": \"/w\", \"command\": \"p4c -I old /w/a.p4\", \"file\": \"/w/a.p4\"}]";
+	{
+		Compile_commands compile_commands(json_path);
+		BOOST_TEST(compile_commands.find_command("/w/a.p4").value_or("") == "p4lsd -I old /w/a.p4");
+	}
+	boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_json)
+{
+	auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%");
+	boost::filesystem::create_directory(directory);
+	auto json_path = directory / "compile_commands.json";
+	std::ofstream(json_path.string()) << "{\"file\": \"/w/a.p4\"}";
+	Compile_commands compile_commands(json_path);
+	BOOST_TEST(!compile_commands.is_valid());
+	BOOST_TEST(!compile_commands.find_arguments("/w/a.p4"));
+	BOOST_TEST(!boost::filesystem::exists(Compile_commands::get_index_path(json_path)));
+	boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,89 @@
+#include "file_cache.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+
+BOOST_AUTO_TEST_SUITE(file_cache_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_exists_is_cached_until_invalidated)
+{
+	auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%.p4");
+	File_cache cache(std::chrono::hours(1));
+	BOOST_TEST(!cache.exists(path));
+	BOOST_TEST(!cache.last_write_time(path));
+	std::ofstream(path.string()) << "header h {}\n";
+	BOOST_TEST(!cache.exists(path));
+	cache.invalidate(path);
+	BOOST_TEST(cache.exists(path));
+	BOOST_TEST(cache.last_write_time(path).has_value());
+	boost::filesystem::remove(path);
+	BOOST_TEST(cache.exists(path));
+	cache.invalidate_all();
+	BOOST_TEST(!cache.exists(path));
+}
+
+BOOST_AUTO_TEST_CASE(test_expired_entries_are_refreshed)
+{
+	auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%.p4");
+	File_cache cache(std::chrono::seconds(0));
+	BOOST_TEST(!cache.exists(path));
+	std::ofstream(path.string()) << "header h {}\n";
+	BOOST_TEST(cache.exists(path));
+	boost::filesystem::remove(path);
+	BOOST_TEST(!cache.exists(path));
+}
+
+BOOST_AUTO_TEST_CASE(test_load_shares_text_until_changed)
+{
+	auto path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%.p4")).string();
+	File_cache cache(std::chrono::hours(1));
+	BOOST_TEST(!cache.load(path));
+	std::ofstream(path) << "header h {}\n";
+	cache.invalidate(path);
+	auto text = cache.load(path);
+	BOOST_REQUIRE(text);
+	BOOST_TEST(*text == "header h {}\n");
+	BOOST_TEST(cache.load(path) == text);
+	// a changed file is read again once it is invalidated
+	std::ofstream(path) << "header g {}\n";
+	BOOST_TEST(cache.load(path) == text);
+	cache.invalidate(path);
+	auto changed = cache.load(path);
+	BOOST_REQUIRE(changed);
+	BOOST_TEST(*changed == "header g {}\n");
+	boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(test_include_resolution)
+{
+	File_cache cache(std::chrono::hours(1));
+	auto calls = 0;
+	auto resolver = [&calls]() -> boost::optional<File_cache::Include_location> {
+		++calls;
+		return File_cache::Include_location{"/usr/share/p4c/p4include/core.p4", "/usr/share/p4c/p4include", "/usr/share/p4c/p4include/core.p4"};
+	};
+	auto location = cache.resolve_include("<core.p4", resolver);
+	BOOST_REQUIRE(location);
+	BOOST_TEST(location->_dir_path == "/usr/share/p4c/p4include");
+	cache.resolve_include("<core.p4", resolver);
+	BOOST_TEST(calls == 1);
+	cache.invalidate("/usr/share/p4c/p4include/core.p4");
+	cache.resolve_include("<core.p4", resolver);
+	BOOST_TEST(calls == 2);
+	auto missing = 0;
+	auto failing = [&missing]() -> boost::optional<File_cache::Include_location> {
+		++missing;
+		return boost::none;
+	};
+	BOOST_TEST(!cache.resolve_include("\"missing.p4", failing));
+	BOOST_TEST(!cache.resolve_include("\"missing.p4", failing));
+	BOOST_TEST(missing == 1);
+	cache.invalidate("/some/other/missing.p4");
+	BOOST_TEST(!cache.resolve_include("\"missing.p4", failing));
+	BOOST_TEST(missing == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,114 @@
+#include "dependency_graph.h"
+#include "file_watcher.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+
+BOOST_AUTO_TEST_SUITE(file_watcher_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_dependency_graph)
+{
+	Dependency_graph graph;
+	graph.set_dependencies("/w/main.p4", {"/p4include/core.p4", "/p4include/v1model.p4"});
+	graph.set_dependencies("/w/other.p4", {"/p4include/core.p4", "/w/headers.p4"});
+	BOOST_TEST(graph.get_dependents("/p4include/core.p4").size() == 2);
+	BOOST_TEST(graph.get_dependents("/w/headers.p4").count("/w/other.p4") == 1);
+	BOOST_TEST(graph.get_dependents("/w/main.p4").empty());
+	BOOST_TEST(graph.get_dependents_by_name("/w/include/v1model.p4").count("/w/main.p4") == 1);
+	graph.set_dependencies("/w/other.p4", {"/w/headers.p4"});
+	BOOST_TEST(graph.get_dependents("/p4include/core.p4").size() == 1);
+	graph.remove_unit("/w/main.p4");
+	BOOST_TEST(graph.get_dependents("/p4include/core.p4").empty());
+	BOOST_TEST(graph.get_dependencies("/w/main.p4").empty());
+	BOOST_TEST(graph.get_dependencies("/w/other.p4").size() == 1);
+}
+
+#ifdef __linux__
+BOOST_AUTO_TEST_CASE(test_watched_file_changes_are_reported)
+{
+	auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%");
+	boost::filesystem::create_directory(directory);
+	auto watched = (directory / "headers.p4").string();
+	auto ignored = (directory / "ignored.p4").string();
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<std::pair<std::string, FILE_CHANGE_TYPE>> changes;
+	File_watcher watcher([&](const std::string& path, FILE_CHANGE_TYPE type) {
+		std::lock_guard<std::mutex> lock(mutex);
+		changes.emplace_back(path, type);
+		changed.notify_one();
+	});
+	BOOST_REQUIRE(watcher.watch_file(watched));
+	std::ofstream(ignored) << "header h {}\n";
+	std::ofstream(watched) << "header h {}\n";
+	boost::filesystem::remove(watched);
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait_for(lock, std::chrono::seconds(5), [&changes]{ return changes.size() >= 3; });
+	}
+	watcher.stop();
+	boost::filesystem::remove_all(directory);
+	BOOST_REQUIRE(changes.size() == 3);
+	for (auto& it : changes)
+	{
+		BOOST_TEST(it.first == watched);
+	}
+	BOOST_TEST(static_cast<int>(changes[0].second) == static_cast<int>(FILE_CHANGE_TYPE::Created));
+	BOOST_TEST(static_cast<int>(changes[1].second) == static_cast<int>(FILE_CHANGE_TYPE::Changed));
+	BOOST_TEST(static_cast<int>(changes[2].second) == static_cast<int>(FILE_CHANGE_TYPE::Deleted));
+}
+
+BOOST_AUTO_TEST_CASE(test_unwatched_file_changes_are_not_reported)
+{
+	auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%");
+	boost::filesystem::create_directory(directory);
+	auto watched = (directory / "headers.p4").string();
+	auto unwatched = (directory / "types.p4").string();
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<std::pair<std::string, FILE_CHANGE_TYPE>> changes;
+	File_watcher watcher([&](const std::string& path, FILE_CHANGE_TYPE type) {
+		std::lock_guard<std::mutex> lock(mutex);
+		changes.emplace_back(path, type);
+		changed.notify_one();
+	});
+	BOOST_REQUIRE(watcher.watch_file(watched));
+	BOOST_REQUIRE(watcher.watch_file(unwatched));
+	watcher.unwatch_file(unwatched);
+	// the changes are reported in order, the last one is of the watched file
+	std::ofstream(unwatched) << "typedef bit<8> t;\n";
+	std::ofstream(watched) << "header h {}\n";
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait_for(lock, std::chrono::seconds(5), [&changes]{ return changes.size() >= 2; });
+	}
+	BOOST_REQUIRE(!changes.empty());
+	for (auto& it : changes)
+	{
+		BOOST_TEST(it.first == watched);
+	}
+	// the directory is not watched once its last file is unwatched
+	watcher.unwatch_file(watched);
+	auto reported = changes.size();
+	boost::filesystem::remove(watched);
+	BOOST_REQUIRE(watcher.watch_file((directory / "other.p4").string()));
+	std::ofstream((directory / "other.p4").string()) << "header h {}\n";
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait_for(lock, std::chrono::seconds(5), [&changes, reported]{ return changes.size() > reported; });
+	}
+	watcher.stop();
+	boost::filesystem::remove_all(directory);
+	BOOST_REQUIRE(changes.size() > reported);
+	BOOST_TEST(changes[reported].first == (directory / "other.p4").string());
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,112 @@
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "incremental_lexer.h"
+
+namespace {
+
+using token = p4l::incremental_lexer::token;
+
+const std::string SOURCE{
+	"#include <core.p4>\n"
+	"#define WIDTH \\\n"
+	"    16\n"
+	"/* a comment\n"
+	" * on lines */\n"
+	"header h_t {\n"
+	"\tbit<WIDTH> f; // field\n"
+	"\tbit<8> g;\n"
+	"}\n"
+	"control c(inout h_t h) {\n"
+	"\tapply {\n"
+	"\t\th.f = h.f |+| 48w0xffff_ffff_ffff;\n"
+	"\t\tlog_msg(\"text\");\n"
+	"\t}\n"
+	"}\n"};
+
+void check_lines(p4l::incremental_lexer const& lexer)
+{
+	p4l::incremental_lexer expected(lexer.get_text());
+	BOOST_TEST(lexer.get_tokens() == expected.get_tokens(), boost::test_tools::per_element());
+	BOOST_REQUIRE_EQUAL(lexer.get_lines().size(), expected.get_lines().size());
+	for (std::size_t it = 0; it != expected.get_lines().size(); ++it) {
+		BOOST_TEST(lexer.get_lines()[it].offset == expected.get_lines()[it].offset);
+		BOOST_TEST(lexer.get_lines()[it].token == expected.get_lines()[it].token);
+		BOOST_TEST(int(lexer.get_lines()[it].state) == int(expected.get_lines()[it].state));
+	}
+}
+
+} // namespace
+
+namespace p4l {
+std::ostream& operator<<(std::ostream& os, incremental_lexer::token const& it) {
+	return os << '{' << it.id << ", " << it.offset << ", " << it.length << '}';
+}
+}
+
+BOOST_AUTO_TEST_SUITE(incremental_lexer_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_line_states)
+{
+	p4l::incremental_lexer lexer(SOURCE);
+	auto& lines = lexer.get_lines();
+	BOOST_REQUIRE_EQUAL(lines.size(), 16U);
+	BOOST_TEST(int(lines[1].state) == int(p4l::line_state::normal));
+	BOOST_TEST(int(lines[2].state) == int(p4l::line_state::directive));
+	BOOST_TEST(int(lines[3].state) == int(p4l::line_state::normal));
+	BOOST_TEST(int(lines[4].state) == int(p4l::line_state::block_comment));
+	BOOST_TEST(int(lines[5].state) == int(p4l::line_state::normal));
+	BOOST_TEST(lexer.get_tokens()[lines[5].token].id == boost::wave::T_HEADER);
+}
+
+BOOST_AUTO_TEST_CASE(test_small_edit)
+{
+	p4l::incremental_lexer lexer(SOURCE);
+	auto tokens = lexer.get_tokens();
+	auto offset = SOURCE.find("bit<8> g");
+	auto change = lexer.edit(offset + 4, 1, "16");
+	// only the line of the edit is relexed
+	BOOST_TEST(change.erased == 6U);
+	BOOST_TEST(change.inserted == 6U);
+	BOOST_TEST(lexer.get_tokens()[change.first].offset == offset);
+	BOOST_TEST(lexer.get_tokens()[change.first + 2].offset == offset + 4);
+	BOOST_TEST(lexer.get_tokens()[change.first + 2].length == 2U);
+	BOOST_TEST(lexer.get_tokens().back().offset == tokens.back().offset + 1);
+	check_lines(lexer);
+}
+
+BOOST_AUTO_TEST_CASE(test_state_change)
+{
+	p4l::incremental_lexer lexer(SOURCE);
+	auto size = lexer.get_tokens().size();
+	// opening a comment relexes up to where the old comment ends
+	auto change = lexer.edit(SOURCE.find("header"), 0, "/*");
+	BOOST_TEST(change.inserted == 0U);
+	check_lines(lexer);
+	change = lexer.edit(SOURCE.find("header"), 2, "");
+	BOOST_TEST(lexer.get_tokens().size() == size);
+	check_lines(lexer);
+	// a backslash continues the directive on the next line
+	lexer.edit(SOURCE.find("\n/*"), 0, "\\");
+	check_lines(lexer);
+}
+
+BOOST_AUTO_TEST_CASE(test_random_edits)
+{
+	std::mt19937 generator(42);
+	const std::string pieces[] = {"\n", "/*", "*/", "\"", "\\", "#", " x", "8w1", "\n\t", "//", "table", ";"};
+	p4l::incremental_lexer lexer(SOURCE);
+	for (auto it = 0; it != 500; ++it) {
+		auto size = lexer.get_text().size();
+		auto offset = std::uniform_int_distribution<std::size_t>(0, size)(generator);
+		auto length = std::uniform_int_distribution<std::size_t>(0, std::min<std::size_t>(3, size - offset))(generator);
+		auto& piece = pieces[std::uniform_int_distribution<std::size_t>(0, std::size(pieces) - 1)(generator)];
+		lexer.edit(offset, length, piece);
+		check_lines(lexer);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,259 @@
+#include <boost/asio/thread_pool.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "incremental_parser.h"
+#include "p4_generator.h"
+#include "parallel_parser.h"
+
+namespace {
+
+std::string generate()
+{
+	p4l::generator_options options;
+	options.headers = 8;
+	options.parser_states = 8;
+	options.tables = 4;
+	options.actions = 4;
+	p4l::program_generator generator(options);
+	std::ostringstream os;
+	generator.write(0, os);
+	return os.str();
+}
+
+/// \brief the subtrees are the same, the tokens of the tree are moved to where they are now
+template <typename Translate>
+void check_same(p4l::ast const& tree, std::uint32_t node, p4l::ast const& expected, std::uint32_t other,
+				Translate const& translate)
+{
+	BOOST_REQUIRE((tree[node].kind == expected[other].kind));
+	BOOST_TEST(tree[node].flags == expected[other].flags);
+	BOOST_TEST(translate(tree[node].token) == expected[other].token);
+	BOOST_TEST(translate(tree[node].begin) == expected[other].begin);
+	BOOST_TEST(translate(tree[node].end) == expected[other].end);
+	auto children = tree.get_children(node);
+	auto expected_children = expected.get_children(other);
+	auto it = children.begin();
+	auto expected_it = expected_children.begin();
+	for (; it != children.end() && expected_it != expected_children.end(); ++it, ++expected_it) {
+		check_same(tree, *it, expected, *expected_it, translate);
+	}
+	BOOST_TEST((it == children.end() && expected_it == expected_children.end()));
+}
+
+/// \brief the declarations are those of parsing all of the tokens
+void check_declarations(p4l::incremental_parser const& parser, p4l::incremental_lexer const& lexer,
+						p4l::parse_mode mode = p4l::parse_mode::full)
+{
+	p4l::Parser full(lexer.get_tokens(), 0, lexer.get_tokens().size(), mode);
+	auto expected = full.run();
+	auto children = expected.get_children(expected.get_root());
+	auto it = children.begin();
+	std::uint32_t end = 0;
+	for (auto const& declaration : parser.get_declarations()) {
+		BOOST_TEST(declaration.begin == end);
+		end = declaration.end;
+		if (declaration.node == p4l::ast::none) {
+			continue;
+		}
+		BOOST_REQUIRE(it != children.end());
+		BOOST_TEST(declaration.begin == expected[*it].begin);
+		BOOST_TEST(declaration.end == expected[*it].end);
+		check_same(*declaration.tree, declaration.node, expected, *it,
+				   [&declaration](std::uint32_t token) { return declaration.get_token(token); });
+		++it;
+	}
+	BOOST_TEST(end == lexer.get_tokens().size());
+	BOOST_TEST((it == children.end()));
+}
+
+/// \brief the tokens of the text as a compilation of one file
+p4l::token_arena get_arena(p4l::incremental_lexer const& lexer)
+{
+	p4l::token_arena arena;
+	auto file = arena.add_file("main.p4", std::make_shared<std::string const>(lexer.get_text()));
+	for (auto const& it : lexer.get_tokens()) {
+		arena.push_back(static_cast<boost::wave::token_id>(it.id), file, it.offset, it.length);
+	}
+	return arena;
+}
+
+/// \brief the tree of the declarations is the one of parsing all of the tokens
+void check_tree(p4l::incremental_parser const& parser, p4l::token_arena const& tokens)
+{
+	p4l::Parser full(tokens);
+	auto expected = full.run();
+	auto tree = parser.get_tree();
+	auto children = tree.get_children(tree.get_root());
+	auto expected_children = expected.get_children(expected.get_root());
+	auto it = children.begin();
+	auto expected_it = expected_children.begin();
+	for (; it != children.end() && expected_it != expected_children.end(); ++it, ++expected_it) {
+		check_same(tree, *it, expected, *expected_it, [](std::uint32_t token) { return token; });
+	}
+	BOOST_TEST((it == children.end() && expected_it == expected_children.end()));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(incremental_parser_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_reuse)
+{
+	p4l::incremental_lexer lexer(generate());
+	p4l::incremental_parser parser(lexer.get_tokens(), lexer.get_text());
+	BOOST_TEST(parser.get_error_count() == 0U);
+	check_declarations(parser, lexer);
+	auto old = parser.get_declarations();
+
+	// change a statement of the action of the first control
+	auto offset = lexer.get_text().find("standard_metadata.egress_spec = port;");
+	auto change = lexer.edit(offset, 0, "standard_metadata.egress_spec = port + 1;\n        ");
+	BOOST_TEST(parser.update(lexer.get_tokens(), lexer.get_text(), change) == 1U);
+	check_declarations(parser, lexer);
+	auto const& declarations = parser.get_declarations();
+	BOOST_REQUIRE_EQUAL(declarations.size(), old.size());
+	std::size_t changed = 0;
+	for (std::size_t it = 0; it != old.size(); ++it) {
+		changed += declarations[it].tree != old[it].tree;
+		BOOST_TEST(((declarations[it].tree != old[it].tree) == (declarations[it].hash != old[it].hash)), it);
+	}
+	BOOST_TEST(changed == 1U);
+}
+
+BOOST_AUTO_TEST_CASE(test_same_tokens)
+{
+	p4l::incremental_lexer lexer(generate());
+	p4l::incremental_parser parser(lexer.get_tokens(), lexer.get_text());
+	auto old = parser.get_declarations();
+	// the tokens of the control are the same, only moved
+	auto offset = lexer.get_text().find("control c0");
+	auto change = lexer.edit(lexer.get_text().find('{', offset) + 1, 0, "\n\n    ");
+	parser.update(lexer.get_tokens(), lexer.get_text(), change);
+	check_declarations(parser, lexer);
+	for (std::size_t it = 0; it != old.size(); ++it) {
+		BOOST_TEST(parser.get_declarations()[it].tree == old[it].tree);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_compilation)
+{
+	p4l::incremental_lexer lexer(generate());
+	auto tokens = get_arena(lexer);
+	boost::asio::thread_pool pool(2);
+	p4l::incremental_parser parser(tokens, p4l::parse_parallel(tokens, pool, 4));
+	BOOST_TEST(parser.get_error_count() == 0U);
+	check_tree(parser, tokens);
+	auto old = parser.get_declarations();
+
+	// the compilation is preprocessed again, the declarations before and after the change are found by their tokens
+	auto offset = lexer.get_text().find("standard_metadata.egress_spec = port;");
+	lexer.edit(offset, 0, "standard_metadata.egress_spec = port + 1;\n        ");
+	tokens = get_arena(lexer);
+	BOOST_TEST(parser.update(tokens) == 1U);
+	check_tree(parser, tokens);
+	auto const& declarations = parser.get_declarations();
+	BOOST_REQUIRE_EQUAL(declarations.size(), old.size());
+	std::size_t changed = 0;
+	for (std::size_t it = 0; it != old.size(); ++it) {
+		changed += declarations[it].tree != old[it].tree;
+	}
+	BOOST_TEST(changed == 1U);
+
+	// the same tokens are not parsed again
+	BOOST_TEST(parser.update(tokens) == 0U);
+	lexer.edit(0, 0, "const bit<8> K = 1;\n");
+	tokens = get_arena(lexer);
+	BOOST_TEST(parser.update(tokens) == 1U);
+	check_tree(parser, tokens);
+}
+
+BOOST_AUTO_TEST_CASE(test_random_edits)
+{
+	const std::string snippets[] = {"{", "}", ";", "(", ")", " ", "\n", "x", "bit<8> y;", "header h_t { bit<8> f; }",
+									"control c() { apply { } }", "/*", "*/", "\"", "=", "apply", "a.b(c);"};
+	p4l::incremental_lexer lexer(generate());
+	p4l::incremental_parser parser(lexer.get_tokens(), lexer.get_text());
+	std::mt19937 random(17);
+	for (int edit = 0; edit != 300; ++edit) {
+		auto offset = random() % (lexer.get_text().size() + 1);
+		auto length = std::min<std::size_t>(random() % 8, lexer.get_text().size() - offset);
+		auto& snippet = snippets[random() % std::size(snippets)];
+		auto change = lexer.edit(offset, length, snippet);
+		parser.update(lexer.get_tokens(), lexer.get_text(), change);
+		BOOST_TEST_CONTEXT("edit " << edit << " at " << offset) {
+			check_declarations(parser, lexer);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_bodies)
+{
+	p4l::incremental_lexer lexer(generate());
+	p4l::incremental_parser parser(lexer.get_tokens(), lexer.get_text(), p4l::parse_mode::signatures);
+	BOOST_TEST(parser.get_error_count() == 0U);
+	check_declarations(parser, lexer, p4l::parse_mode::signatures);
+	auto find = [&lexer, &parser](std::string const& text) {
+		auto offset = lexer.get_text().find(text);
+		auto& tokens = lexer.get_tokens();
+		auto token = std::lower_bound(tokens.begin(), tokens.end(), offset,
+									  [](p4l::lexed_token const& it, std::size_t position) { return it.offset < position; });
+		return parser.find_body(tokens, static_cast<std::uint32_t>(std::distance(tokens.begin(), token)));
+	};
+	BOOST_TEST(!find("header h0_t"));
+	BOOST_TEST(!find("table t0"));
+	auto action = find("standard_metadata.egress_spec = port;");
+	BOOST_REQUIRE(action);
+	BOOST_TEST(action->errors.empty());
+	BOOST_TEST(find("standard_metadata.egress_spec = port;") == action);
+
+	// the body is the one of parsing all of it
+	p4l::Parser full(lexer.get_tokens());
+	auto expected = full.run();
+	auto const& declarations = parser.get_declarations();
+	auto control = std::find_if(declarations.begin(), declarations.end(), [&action](auto const& it) {
+		return std::find(it.bodies->begin(), it.bodies->end(), action) != it.bodies->end();
+	});
+	BOOST_REQUIRE((control != declarations.end()));
+	auto const& body = *action->tree;
+	auto block = body.get_first_child(body.get_root());
+	auto begin = control->get_token(*action, body[block].begin);
+	std::uint32_t other = 0;
+	for (; other != expected.size(); ++other) {
+		if (expected[other].kind == p4l::node_kind::block && expected[other].begin == begin) {
+			break;
+		}
+	}
+	BOOST_REQUIRE(other != expected.size());
+	check_same(body, block, expected, other, [&control, &action](std::uint32_t token) { return control->get_token(*action, token); });
+	// the tree of the declarations has the body in place of the unparsed block
+	auto tree = parser.get_tree();
+	std::uint32_t spliced = 0;
+	for (; spliced != tree.size(); ++spliced) {
+		if (tree[spliced].kind == p4l::node_kind::block && tree[spliced].begin == begin) {
+			break;
+		}
+	}
+	BOOST_REQUIRE(spliced != tree.size());
+	check_same(tree, spliced, expected, other, [](std::uint32_t token) { return token; });
+
+	// the body is kept while its declaration does not change
+	auto change = lexer.edit(0, 0, "const bit<8> K = 1;\n");
+	parser.update(lexer.get_tokens(), lexer.get_text(), change);
+	BOOST_TEST(find("standard_metadata.egress_spec = port;") == action);
+	auto offset = lexer.get_text().find("standard_metadata.egress_spec = port;");
+	change = lexer.edit(offset, 0, "exit; ");
+	parser.update(lexer.get_tokens(), lexer.get_text(), change);
+	auto changed = find("standard_metadata.egress_spec = port;");
+	BOOST_REQUIRE(changed);
+	BOOST_TEST(changed != action);
+	BOOST_TEST(changed->tree->size() == action->tree->size() + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
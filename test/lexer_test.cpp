@@ -1,8 +1,13 @@
 #include "lexer.h"
+#include "p4lex_iterator.h"
 
 #include <boost/test/unit_test.hpp>
 
 #include <sstream>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace p4l {
 std::ostream& boost_test_print_type(std::ostream& os, const boost::wave::token_id tok) {
@@ -128,4 +133,105 @@ BOOST_AUTO_TEST_CASE(test_comments)
 	BOOST_REQUIRE_EQUAL(col, 32);
 }
 
+BOOST_AUTO_TEST_CASE(test_string_view_source)
+{
+	std::string_view source{"header h_t { bit<8> f; } // text\n@name(\"a \\\" b\")"};
+	std::istringstream input{std::string(source)};
+	p4l::Lexer lexer(source);
+	p4l::Lexer stream_lexer(input);
+	std::size_t count = 0;
+	for (auto token = stream_lexer.next(); token != boost::wave::T_END; token = stream_lexer.next(), ++count) {
+		BOOST_REQUIRE_EQUAL(token, lexer.next());
+		BOOST_REQUIRE_EQUAL(stream_lexer.get_text(), lexer.get_text());
+		BOOST_REQUIRE_EQUAL(stream_lexer.get_row(), lexer.get_row());
+		BOOST_REQUIRE_EQUAL(stream_lexer.get_col(), lexer.get_col());
+		if (token == boost::wave::T_IDENTIFIER && count == 1) {
+			BOOST_REQUIRE_EQUAL(lexer.get_text(), "h_t");
+			BOOST_TEST(lexer.get_text().data() == source.data() + 7);
+		}
+		if (token == boost::wave::T_STRING_LITERAL) {
+			BOOST_REQUIRE_EQUAL(lexer.get_text(), "a \\\" b");
+		}
+	}
+	BOOST_REQUIRE_EQUAL(lexer.next(), boost::wave::T_END);
+}
+
+BOOST_AUTO_TEST_CASE(test_keywords)
+{
+	for (auto& keyword : p4l::keywords) {
+		BOOST_TEST(p4l::find_keyword(keyword.text) == keyword.token);
+		std::istringstream input{std::string(keyword.text)};
+		p4l::Lexer lexer(input);
+		BOOST_TEST(lexer.next() == keyword.token);
+	}
+	static_assert(p4l::find_keyword("header_union") == boost::wave::T_HEADER_UNION);
+	for (auto text : {"class", "selec", "structs", "Header", "header_union_", "__", "a", "sw"}) {
+		BOOST_TEST(p4l::find_keyword(text) == boost::wave::T_IDENTIFIER);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_precompiled_tables)
+{
+	using lexer_type = boost::wave::cpplexer::slex::lexer::lexer<std::string::iterator, boost::wave::util::file_position_type>;
+	auto& tables = p4l::precompiled_lexer_tables;
+	lexer_type lexer;
+	boost::wave::cpplexer::slex::init_lexer(lexer, boost::wave::support_cpp0x, true);
+	auto& dfa = lexer.get_dfa().front();
+	BOOST_REQUIRE_EQUAL(dfa.state_count, tables.state_count);
+	BOOST_REQUIRE_EQUAL(dfa.class_count, tables.class_count);
+	BOOST_TEST(dfa.class_count < 256U);
+	BOOST_TEST(std::equal(dfa.classes, dfa.classes + 256, tables.classes));
+	BOOST_TEST(std::equal(dfa.transitions, dfa.transitions + dfa.class_count * dfa.state_count, tables.transitions));
+	BOOST_TEST(std::equal(dfa.acceptance, dfa.acceptance + dfa.state_count, tables.acceptance));
+	BOOST_TEST(std::equal(tables.tokens, tables.tokens + tables.token_count, dfa.tokens));
+}
+
+BOOST_AUTO_TEST_CASE(test_p4_tokens)
+{
+	std::string input{"header h { bit<8> f; } 8w10 &&& 1..2 |+| |-| >> >>= key table class"};
+	p4l::p4lex_iterator<p4l::p4lex_token<>> first(input.begin(), input.end(), boost::wave::util::file_position_type("test.p4"),
+												  boost::wave::support_cpp0x);
+	using namespace boost::wave;
+	std::vector<int> tokens;
+	for (p4l::p4lex_iterator<p4l::p4lex_token<>> last; first != last; ++first) {
+		if (token_id(*first) != T_SPACE) {
+			tokens.push_back(token_id(*first));
+		}
+	}
+	std::vector<int> expected{
+		T_HEADER, T_IDENTIFIER, T_L_BRACE, T_BIT, T_L_ANGLE, T_NUMBER, T_R_ANGLE, T_IDENTIFIER, T_SEMICOLON, T_R_BRACE,
+		T_NUMBER, T_MASK, T_NUMBER, T_RANGE, T_NUMBER, T_PLUS_SAT, T_MINUS_SAT, T_SHIFTRIGHT, T_SHIFTRIGHTASSIGN, T_KEY,
+		T_TABLE, T_IDENTIFIER, T_EOF};
+	BOOST_TEST(tokens == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_lexing)
+{
+	using iterator_type = p4l::p4lex_iterator<p4l::p4lex_token<>>;
+	std::string input;
+	for (auto it = 0; it != 200; ++it) {
+		input += "header h" + std::to_string(it) + "_t { bit<8> f; varbit<16> g; }\n";
+	}
+	auto lex = [&input] {
+		std::vector<std::string> tokens;
+		iterator_type first(input.begin(), input.end(), boost::wave::util::file_position_type("test.p4"), boost::wave::support_cpp0x);
+		for (iterator_type last; first != last; ++first) {
+			tokens.push_back(first->get_value().c_str());
+		}
+		return tokens;
+	};
+	std::vector<std::vector<std::string>> results(8);
+	std::vector<std::thread> threads;
+	for (auto& result : results) {
+		threads.emplace_back([&result, &lex] { result = lex(); });
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	auto expected = lex();
+	for (auto& result : results) {
+		BOOST_TEST(result == expected);
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
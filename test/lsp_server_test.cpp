@@ -42,4 +42,24 @@ BOOST_AUTO_TEST_CASE(test_case3)
 	BOOST_REQUIRE_EQUAL(lsp.run(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(test_close_document)
+{
+	std::istringstream input{
+		"Content-Length: 91\r\n\r\n{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"initialize\",\"params\":{\"processId\":123,\"capabilities\":{}}}"
+		"Content-Length: 176\r\n\r\n{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":{\"uri\":\"file:///tmp/p4ls-test/main.p4\",\"languageId\":\"p4\",\"version\":1,\"text\":\"const bit<8> K = 1;\\n\"}}}"
+		"Content-Length: 157\r\n\r\n{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"textDocument/hover\",\"params\":{\"textDocument\":{\"uri\":\"file:///tmp/p4ls-test/main.p4\"},\"position\":{\"line\":0,\"character\":13}}}"
+		"Content-Length: 116\r\n\r\n{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didClose\",\"params\":{\"textDocument\":{\"uri\":\"file:///tmp/p4ls-test/main.p4\"}}}"
+		"Content-Length: 157\r\n\r\n{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"textDocument/hover\",\"params\":{\"textDocument\":{\"uri\":\"file:///tmp/p4ls-test/main.p4\"},\"position\":{\"line\":0,\"character\":13}}}"
+		"Content-Length: 44\r\n\r\n{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"shutdown\"}"
+	};
+	std::ostringstream output;
+	LSP_server lsp(input, output);
+	BOOST_REQUIRE_EQUAL(lsp.run(), 0);
+	// the hover of the open document is found, the closed document is forgotten
+	auto replies = output.str();
+	BOOST_TEST(replies.find("\"id\":1,\"result\":{\"contents\"") != std::string::npos);
+	BOOST_TEST(replies.find("const bit<8> K = 1;") != std::string::npos);
+	BOOST_TEST(replies.find("\"id\":2,\"result\":null") != std::string::npos);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,73 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include "number.h"
+
+namespace {
+
+using limbs_type = p4l::number::limbs_type;
+
+p4l::number parse(std::string const& text)
+{
+	auto result = p4l::number::parse(text);
+	BOOST_REQUIRE_MESSAGE(result, "cannot parse " << text);
+	return *result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(number_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_bases)
+{
+	BOOST_TEST(parse("0").get_limbs().empty());
+	BOOST_TEST(parse("12_345").to_int64() == 12345);
+	BOOST_TEST(parse("0x1F").to_int64() == 31);
+	BOOST_TEST(parse("0o17").to_int64() == 15);
+	BOOST_TEST(parse("0B1010_1010").to_int64() == 170);
+	BOOST_TEST(parse("0d099").to_int64() == 99);
+	BOOST_TEST(!parse("12").has_width());
+	for (auto text : {"0b102", "0o8", "0d1a", "12a", "0x", "0x_", "8w", "0w1", "1s0", "8q1", "4294967296w1"}) {
+		BOOST_TEST(!p4l::number::parse(text), text);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_widths)
+{
+	auto mac = parse("48w0xffff_ffff_ffff");
+	BOOST_TEST(mac.get_width() == 48U);
+	BOOST_TEST(!mac.is_signed());
+	BOOST_TEST(mac.get_limbs() == limbs_type{0xffffffffffffULL});
+	BOOST_TEST(mac.to_int64() == 0xffffffffffffLL);
+	BOOST_TEST(parse("8w256").get_limbs().empty());
+	BOOST_TEST(parse("8w0x1ff").to_int64() == 255);
+	auto minus_one = parse("2s3");
+	BOOST_TEST(minus_one.is_negative());
+	BOOST_TEST(minus_one.to_int64() == -1);
+	BOOST_TEST(parse("8s127").to_int64() == 127);
+	BOOST_TEST(parse("8s128").to_int64() == -128);
+	BOOST_TEST(parse("64s0xffffffffffffffff").to_int64() == -1);
+}
+
+BOOST_AUTO_TEST_CASE(test_wide_values)
+{
+	auto wide = parse("128w0x0123456789abcdef_fedcba9876543210");
+	BOOST_TEST(wide.get_limbs() == (limbs_type{0xfedcba9876543210ULL, 0x0123456789abcdefULL}));
+	BOOST_TEST(wide.get_limbs().capacity() == 2U);
+	// 2^128 - 1 in decimal
+	BOOST_TEST(parse("340282366920938463463374607431768211455").get_limbs() == (limbs_type{~0ULL, ~0ULL}));
+	BOOST_TEST(parse("128w340282366920938463463374607431768211456").get_limbs().empty());
+	std::string ones(512, 'f');
+	auto widest = parse("2048w0x" + ones);
+	BOOST_TEST(widest.get_limbs().size() == 32U);
+	BOOST_TEST(widest.test_bit(2047));
+	BOOST_TEST(!widest.test_bit(2048));
+	auto truncated = parse("2047s0x" + ones);
+	BOOST_TEST(truncated.get_limbs().size() == 32U);
+	BOOST_TEST(truncated.get_limbs().back() == 0x7fffffffffffffffULL);
+	BOOST_TEST(truncated.is_negative());
+	BOOST_TEST(truncated.to_int64() == -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
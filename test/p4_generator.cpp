@@ -0,0 +1,285 @@
+#include "p4_generator.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace p4l {
+
+namespace {
+
+constexpr unsigned WIDTHS[] = {1, 3, 4, 8, 9, 12, 16, 32, 48};
+
+// the keys of the random choices
+enum choice : std::uint64_t { WIDTH, WIDTH_MACRO, SIZE_MACRO, STATEMENT_MACRO, FIELD, STRUCT };
+
+std::uint64_t mix(std::uint64_t x) noexcept
+{
+	// splitmix64, the choices do not depend on the order they are made in
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+std::uint64_t key(std::uint64_t a, std::uint64_t b) noexcept
+{
+	return (a << 32) ^ b;
+}
+
+} // namespace
+
+program_generator::program_generator(generator_options const& options)
+	: _options(options)
+{
+	// the parser and the tables need something to extract and match
+	_options.headers = std::max<std::size_t>(_options.headers, 1);
+	_options.fields = std::max<std::size_t>(_options.fields, 1);
+	_options.macro_percent = std::min(_options.macro_percent, 100U);
+}
+
+std::string program_generator::get_file_name(std::size_t file) const
+{
+	return file == 0 ? "main.p4" : "include/gen_" + std::to_string(file) + ".p4";
+}
+
+void program_generator::write(std::size_t file, std::ostream& os) const
+{
+	if (file != 0) {
+		auto guard = "GEN_" + std::to_string(file) + "_P4";
+		os << "/* generated: headers of include level " << file << " */\n"
+		   << "#ifndef " << guard << "\n"
+		   << "#define " << guard << "\n\n";
+		if (file < _options.include_depth) {
+			os << "#include \"gen_" << file + 1 << ".p4\"\n\n";
+		}
+		for (std::size_t it = 0; it != _options.headers; ++it) {
+			if (get_file(it) == file) {
+				write_header(it, os);
+			}
+		}
+		os << "#endif /* " << guard << " */\n";
+		return;
+	}
+	os << "/* generated: " << _options.headers << " headers, " << _options.structs << " structs, "
+	   << _options.parser_states << " parser states, " << _options.controls << " controls with "
+	   << _options.tables << " tables and " << _options.actions << " actions */\n"
+	   << "#include <core.p4>\n"
+	   << "#include <v1model.p4>\n";
+	if (_options.include_depth != 0) {
+		os << "#include \"" << get_file_name(1) << "\"\n";
+	}
+	os << "\n";
+	if (_options.macro_percent != 0) {
+		os << "#define INCREMENT(x) x = x + 1\n\n";
+	}
+	for (std::size_t it = 0; it != _options.headers; ++it) {
+		if (get_file(it) == 0) {
+			write_header(it, os);
+		}
+	}
+	write_types(os);
+	write_parser(os);
+	for (std::size_t it = 0; it != _options.controls; ++it) {
+		write_control(it, os);
+	}
+	write_package(os);
+}
+
+std::uint64_t program_generator::random(std::uint64_t a, std::uint64_t b) const noexcept
+{
+	return mix(_options.seed ^ mix(key(a, b)));
+}
+
+bool program_generator::is_macro(std::uint64_t a, std::uint64_t b) const noexcept
+{
+	return random(a, b) % 100 < _options.macro_percent;
+}
+
+unsigned program_generator::get_width(std::size_t header, std::size_t field) const noexcept
+{
+	return WIDTHS[random(WIDTH, key(header, field)) % std::size(WIDTHS)];
+}
+
+std::size_t program_generator::get_file(std::size_t header) const noexcept
+{
+	// the headers are spread evenly over the include chain, the main file has none of them
+	return _options.include_depth == 0 ? 0 : 1 + header * _options.include_depth / _options.headers;
+}
+
+void program_generator::write_header(std::size_t header, std::ostream& os) const
+{
+	auto name = std::to_string(header);
+	for (std::size_t it = 0; it != _options.fields; ++it) {
+		if (is_macro(WIDTH_MACRO, key(header, it))) {
+			os << "#define H" << name << "_F" << it << "_WIDTH " << get_width(header, it) << "\n";
+		}
+	}
+	os << "header h" << name << "_t {\n";
+	for (std::size_t it = 0; it != _options.fields; ++it) {
+		os << "    bit<";
+		if (is_macro(WIDTH_MACRO, key(header, it))) {
+			os << "H" << name << "_F" << it << "_WIDTH";
+		} else {
+			os << get_width(header, it);
+		}
+		os << "> f" << it << ";\n";
+	}
+	os << "}\n\n";
+}
+
+void program_generator::write_types(std::ostream& os) const
+{
+	for (std::size_t it = 0; it != _options.structs; ++it) {
+		os << "struct s" << it << "_t {\n"
+		   << "    bit<32> a;\n"
+		   << "    bit<16> b;\n"
+		   << "}\n\n";
+	}
+	os << "struct metadata_t {\n";
+	for (std::size_t it = 0; it != _options.structs; ++it) {
+		os << "    s" << it << "_t s" << it << ";\n";
+	}
+	os << "}\n\n"
+	   << "struct headers_t {\n";
+	for (std::size_t it = 0; it != _options.headers; ++it) {
+		os << "    h" << it << "_t h" << it << ";\n";
+	}
+	os << "}\n\n";
+}
+
+void program_generator::write_parser(std::ostream& os) const
+{
+	os << "parser MyParser(packet_in packet,\n"
+	   << "                out headers_t hdr,\n"
+	   << "                inout metadata_t meta,\n"
+	   << "                inout standard_metadata_t standard_metadata) {\n"
+	   << "    state start {\n"
+	   << "        transition " << (_options.parser_states == 0 ? "accept" : "state0") << ";\n"
+	   << "    }\n";
+	for (std::size_t it = 0; it != _options.parser_states; ++it) {
+		auto header = "hdr.h" + std::to_string(it % _options.headers);
+		os << "\n"
+		   << "    state state" << it << " {\n"
+		   << "        packet.extract(" << header << ");\n";
+		if (it + 1 == _options.parser_states) {
+			os << "        transition accept;\n";
+		} else {
+			os << "        transition select(" << header << ".f0) {\n"
+			   << "            1: state" << it + 1 << ";\n"
+			   << "            default: accept;\n"
+			   << "        }\n";
+		}
+		os << "    }\n";
+	}
+	os << "}\n\n";
+}
+
+void program_generator::write_control(std::size_t control, std::ostream& os) const
+{
+	auto name = std::to_string(control);
+	auto field = [this](std::size_t a, std::size_t b) {
+		auto header = random(FIELD, key(a, b)) % _options.headers;
+		auto index = random(FIELD, key(b, a)) % _options.fields;
+		return "hdr.h" + std::to_string(header) + ".f" + std::to_string(index);
+	};
+	for (std::size_t it = 0; it != _options.tables; ++it) {
+		if (is_macro(SIZE_MACRO, key(control, it))) {
+			os << "#define C" << name << "_T" << it << "_SIZE " << (1024 << (it % 4)) << "\n";
+		}
+	}
+	os << "control c" << name << "(inout headers_t hdr,\n"
+	   << "           inout metadata_t meta,\n"
+	   << "           inout standard_metadata_t standard_metadata) {\n";
+	for (std::size_t it = 0; it != _options.actions; ++it) {
+		auto target = field(control, it);
+		os << "    action a" << it << "(bit<9> port) {\n"
+		   << "        standard_metadata.egress_spec = port;\n";
+		if (is_macro(STATEMENT_MACRO, key(control, it))) {
+			os << "        INCREMENT(" << target << ");\n";
+		} else {
+			os << "        " << target << " = " << target << " + 1;\n";
+		}
+		if (_options.structs != 0) {
+			auto meta = "meta.s" + std::to_string(random(STRUCT, key(control, it)) % _options.structs) + ".a";
+			os << "        " << meta << " = " << meta << " + 1;\n";
+		}
+		os << "    }\n\n";
+	}
+	for (std::size_t it = 0; it != _options.tables; ++it) {
+		auto header = "hdr.h" + std::to_string(random(FIELD, key(it, control)) % _options.headers);
+		os << "    table t" << it << " {\n"
+		   << "        key = {\n"
+		   << "            " << header << ".f0 : exact;\n";
+		if (_options.fields > 1) {
+			auto other = 1 + random(FIELD, key(control, it)) % (_options.fields - 1);
+			os << "            " << header << ".f" << other << " : ternary;\n";
+		}
+		os << "        }\n"
+		   << "        actions = {\n";
+		for (std::size_t action = 0; action != std::min<std::size_t>(_options.actions, 2); ++action) {
+			os << "            a" << (it + action) % _options.actions << ";\n";
+		}
+		os << "            NoAction;\n"
+		   << "        }\n"
+		   << "        size = ";
+		if (is_macro(SIZE_MACRO, key(control, it))) {
+			os << "C" << name << "_T" << it << "_SIZE";
+		} else {
+			os << (1024 << (it % 4));
+		}
+		os << ";\n"
+		   << "        default_action = NoAction();\n"
+		   << "    }\n\n";
+	}
+	os << "    apply {\n";
+	for (std::size_t it = 0; it != _options.tables; ++it) {
+		auto header = "hdr.h" + std::to_string(random(FIELD, key(it, control)) % _options.headers);
+		os << "        if (" << header << ".isValid()) {\n"
+		   << "            t" << it << ".apply();\n"
+		   << "        }\n";
+	}
+	os << "    }\n"
+	   << "}\n\n";
+}
+
+void program_generator::write_package(std::ostream& os) const
+{
+	os << "control MyIngress(inout headers_t hdr,\n"
+	   << "                  inout metadata_t meta,\n"
+	   << "                  inout standard_metadata_t standard_metadata) {\n";
+	for (std::size_t it = 0; it != _options.controls; ++it) {
+		os << "    c" << it << "() c" << it << "_instance;\n";
+	}
+	os << "    apply {\n";
+	for (std::size_t it = 0; it != _options.controls; ++it) {
+		os << "        c" << it << "_instance.apply(hdr, meta, standard_metadata);\n";
+	}
+	os << "    }\n"
+	   << "}\n\n"
+	   << "control MyEgress(inout headers_t hdr,\n"
+	   << "                 inout metadata_t meta,\n"
+	   << "                 inout standard_metadata_t standard_metadata) {\n"
+	   << "    apply {}\n"
+	   << "}\n\n"
+	   << "control MyVerifyChecksum(inout headers_t hdr, inout metadata_t meta) {\n"
+	   << "    apply {}\n"
+	   << "}\n\n"
+	   << "control MyComputeChecksum(inout headers_t hdr, inout metadata_t meta) {\n"
+	   << "    apply {}\n"
+	   << "}\n\n"
+	   << "control MyDeparser(packet_out packet, in headers_t hdr) {\n"
+	   << "    apply {\n";
+	for (std::size_t it = 0; it != _options.headers; ++it) {
+		os << "        packet.emit(hdr.h" << it << ");\n";
+	}
+	os << "    }\n"
+	   << "}\n\n"
+	   << "V1Switch(MyParser(),\n"
+	   << "         MyVerifyChecksum(),\n"
+	   << "         MyIngress(),\n"
+	   << "         MyEgress(),\n"
+	   << "         MyComputeChecksum(),\n"
+	   << "         MyDeparser()) main;\n";
+}
+
+} // namespace p4l
@@ -0,0 +1,63 @@
+/*
+ * -*- c++ -*-
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace p4l {
+
+struct generator_options {
+	std::size_t headers = 16;
+	std::size_t fields = 8;        // in each header
+	std::size_t structs = 4;       // in the metadata
+	std::size_t parser_states = 8;
+	std::size_t controls = 2;      // applied one after the other in the ingress
+	std::size_t tables = 4;        // in each control
+	std::size_t actions = 4;       // in each control
+	std::size_t include_depth = 0; // the headers are declared in a chain of as many included files
+	unsigned macro_percent = 0;    // of the widths, sizes and statements that are macros
+	std::uint64_t seed = 1;
+};
+
+/**
+ * program_generator
+ *
+ *     Writes a v1model P4-16 program of the shape of the options, to
+ *     measure how the server scales with the size of the program.  The
+ *     program is the same for the same options, and each of its files
+ *     is written on its own, so that programs of millions of lines are
+ *     never held in memory.  The main file includes <core.p4> and
+ *     <v1model.p4>, and the first file of the include chain.
+ */
+class program_generator {
+ public:
+	explicit program_generator(generator_options const& options);
+
+	/// \brief the main file and the files of the include chain
+	std::size_t get_file_count() const noexcept {
+		return _options.include_depth + 1;
+	}
+	/// \brief the path of the file relative to the directory of the main file
+	std::string get_file_name(std::size_t file) const;
+	void write(std::size_t file, std::ostream& os) const;
+
+ private:
+	std::uint64_t random(std::uint64_t a, std::uint64_t b) const noexcept;
+	bool is_macro(std::uint64_t a, std::uint64_t b) const noexcept;
+	unsigned get_width(std::size_t header, std::size_t field) const noexcept;
+	std::size_t get_file(std::size_t header) const noexcept;
+	void write_header(std::size_t header, std::ostream& os) const;
+	void write_types(std::ostream& os) const;
+	void write_parser(std::ostream& os) const;
+	void write_control(std::size_t control, std::ostream& os) const;
+	void write_package(std::ostream& os) const;
+
+	generator_options _options;
+};
+
+} // namespace p4l
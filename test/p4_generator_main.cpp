@@ -0,0 +1,82 @@
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "p4_generator.h"
+
+namespace {
+
+void usage(char const* name)
+{
+	std::cerr << "usage: " << name << " [options] directory\n"
+			  << "  --headers N         headers of --fields fields each (16)\n"
+			  << "  --fields N          (8)\n"
+			  << "  --structs N         structs in the metadata (4)\n"
+			  << "  --parser-states N   (8)\n"
+			  << "  --controls N        controls of --tables tables and --actions actions each (2)\n"
+			  << "  --tables N          (4)\n"
+			  << "  --actions N         (4)\n"
+			  << "  --include-depth N   included files the headers are declared in (0)\n"
+			  << "  --macro-percent N   widths, sizes and statements that are macros (0)\n"
+			  << "  --seed N            (1)\n";
+}
+
+} // namespace
+
+/**
+ * p4_generator writes a P4-16 program to main.p4 in the directory, and
+ * the files it includes to the include subdirectory of it.
+ */
+int main(int argc, char* argv[])
+{
+	p4l::generator_options options;
+	struct {
+		char const* name;
+		std::size_t* value;
+	} counts[] = {{"--headers", &options.headers},
+				  {"--fields", &options.fields},
+				  {"--structs", &options.structs},
+				  {"--parser-states", &options.parser_states},
+				  {"--controls", &options.controls},
+				  {"--tables", &options.tables},
+				  {"--actions", &options.actions},
+				  {"--include-depth", &options.include_depth}};
+	boost::filesystem::path directory;
+	for (auto index = 1; index < argc; ++index) {
+		auto count = std::find_if(std::begin(counts), std::end(counts), [argv, index](auto const& it) { return std::strcmp(it.name, argv[index]) == 0; });
+		if (count != std::end(counts) && index + 1 < argc) {
+			*count->value = std::strtoull(argv[++index], nullptr, 10);
+		} else if (std::string("--macro-percent") == argv[index] && index + 1 < argc) {
+			options.macro_percent = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+		} else if (std::string("--seed") == argv[index] && index + 1 < argc) {
+			options.seed = std::strtoull(argv[++index], nullptr, 10);
+		} else if (argv[index][0] != '-' && directory.empty()) {
+			directory = argv[index];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (directory.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+	p4l::program_generator generator(options);
+	for (std::size_t it = 0; it != generator.get_file_count(); ++it) {
+		auto path = directory / generator.get_file_name(it);
+		boost::filesystem::create_directories(path.parent_path());
+		boost::filesystem::ofstream file(path);
+		generator.write(it, file);
+		if (!file) {
+			std::cerr << "could not write " << path.string() << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,101 @@
+#include "preprocessor.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+
+#include "lexer.h"
+#include "p4_generator.h"
+
+namespace {
+
+std::string generate(p4l::program_generator const& generator, std::size_t file)
+{
+	std::ostringstream os;
+	generator.write(file, os);
+	return os.str();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(p4_generator_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_tokens)
+{
+	p4l::generator_options options;
+	options.headers = 40;
+	options.include_depth = 3;
+	options.macro_percent = 50;
+	p4l::program_generator generator(options);
+	BOOST_TEST(generator.get_file_count() == 4U);
+	std::size_t headers = 0;
+	std::size_t tables = 0;
+	for (std::size_t it = 0; it != generator.get_file_count(); ++it) {
+		auto text = generate(generator, it);
+		p4l::Lexer lexer{std::string_view(text)};
+		int depth = 0;
+		for (auto id = lexer.next(); id != boost::wave::T_END; id = lexer.next()) {
+			BOOST_TEST(id != boost::wave::T_UNKNOWN, lexer.get_text());
+			headers += id == boost::wave::T_HEADER;
+			tables += id == boost::wave::T_TABLE;
+			depth += (id == boost::wave::T_LEFTBRACE) - (id == boost::wave::T_RIGHTBRACE);
+			BOOST_TEST(depth >= 0);
+		}
+		BOOST_TEST(depth == 0);
+	}
+	BOOST_TEST(headers == options.headers);
+	BOOST_TEST(tables == options.controls * options.tables);
+}
+
+BOOST_AUTO_TEST_CASE(test_seed)
+{
+	p4l::generator_options options;
+	p4l::program_generator generator(options);
+	BOOST_TEST(generate(generator, 0) == generate(p4l::program_generator(options), 0));
+	options.seed = 2;
+	BOOST_TEST(generate(generator, 0) != generate(p4l::program_generator(options), 0));
+}
+
+BOOST_AUTO_TEST_CASE(test_preprocessed)
+{
+	p4l::generator_options options;
+	options.headers = 10;
+	options.include_depth = 2;
+	options.macro_percent = 100;
+	p4l::program_generator generator(options);
+	auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%");
+	for (std::size_t it = 0; it != generator.get_file_count(); ++it) {
+		auto path = directory / generator.get_file_name(it);
+		boost::filesystem::create_directories(path.parent_path());
+		boost::filesystem::ofstream file(path);
+		generator.write(it, file);
+	}
+	// the architecture is not needed to expand the macros
+	boost::filesystem::ofstream(directory / "core.p4");
+	boost::filesystem::ofstream(directory / "v1model.p4");
+	std::string include_path = directory.string();
+	std::string command[] = {"p4lsd", "-I", include_path};
+	std::vector<char*> argv;
+	for (auto& it : command) {
+		argv.push_back(&it[0]);
+	}
+	auto settings = Context_factory::get_instance().get_settings(argv);
+	boost::filesystem::ifstream main(directory / "main.p4");
+	std::string source((std::istreambuf_iterator<char>(main)), std::istreambuf_iterator<char>());
+	auto ctx = Context_factory::get_instance().create(source.begin(), source.end(), (directory / "main.p4").string(), *settings);
+	std::string output;
+	for (auto token = ctx->begin(); token != ctx->end(); ++token) {
+		output += token->get_value().c_str();
+	}
+	BOOST_TEST(output.find("header h0_t") != std::string::npos);
+	BOOST_TEST(output.find("header h9_t") != std::string::npos);
+	BOOST_TEST(output.find("_WIDTH") == std::string::npos);
+	BOOST_TEST(output.find("INCREMENT") == std::string::npos);
+	BOOST_TEST(ctx->get_hooks().get_included_files().size() == 4U);
+	boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
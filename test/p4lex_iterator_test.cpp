@@ -0,0 +1,80 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/wave.hpp>
+
+#include <string>
+#include <vector>
+
+#include "lexer.h"
+
+namespace {
+
+using token_type = p4l::p4lex_token<>;
+using lexer_type = p4l::p4lex_iterator<token_type>;
+
+lexer_type make_lexer(std::string& source)
+{
+	return lexer_type(source.begin(), source.end(), token_type::position_type("main.p4"), boost::wave::support_cpp0x);
+}
+
+std::vector<std::string> get_values(lexer_type first, lexer_type const& last)
+{
+	std::vector<std::string> values;
+	for (; first != last; ++first) {
+		values.emplace_back(first->get_value().c_str());
+	}
+	return values;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(p4lex_iterator_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_copies_replay_tokens)
+{
+	std::string source("header h { bit<8> f; }\nheader g { bit<16> f; }\nheader k { bit<32> f; }\n");
+	auto first = make_lexer(source);
+	auto expected = get_values(make_lexer(source), lexer_type());
+	BOOST_REQUIRE_GT(expected.size(), 40U);
+	std::vector<lexer_type> copies;
+	for (auto it = first; it != lexer_type(); ++it) {
+		copies.push_back(it);
+	}
+	BOOST_REQUIRE_EQUAL(copies.size(), expected.size());
+	for (std::size_t it = 0; it != copies.size(); ++it) {
+		BOOST_TEST(get_values(copies[it], lexer_type()) == std::vector<std::string>(expected.begin() + it, expected.end()));
+	}
+	BOOST_TEST((copies[3] == copies[3]));
+	BOOST_TEST((copies[3] != copies[4]));
+	BOOST_TEST((lexer_type() == lexer_type()));
+}
+
+BOOST_AUTO_TEST_CASE(test_mark_and_rewind)
+{
+	std::string source("control c() {\n\tapply {\n\t\tt.apply();\n\t}\n}\ncontrol d() {\n\tapply {\n\t}\n}\n");
+	auto expected = get_values(make_lexer(source), lexer_type());
+	auto it = make_lexer(source);
+	++it;
+	auto mark = it.mark();
+	for (int count = 0; count != 40; ++count) {
+		++it;
+	}
+	it.rewind(mark);
+	it.release();
+	BOOST_TEST(get_values(it, lexer_type()) == std::vector<std::string>(expected.begin() + 1, expected.end()));
+}
+
+BOOST_AUTO_TEST_CASE(test_illegal_backtracking)
+{
+	std::string source("header h { bit<8> f; }\nheader g { bit<16> f; }\nheader k { bit<32> f; }\n");
+	auto it = make_lexer(source);
+	auto behind = it;
+	for (int count = 0; count != 40; ++count) {
+		++it;
+	}
+	// the tokens before the iterator are dropped, the copy behind it cannot read them
+	it.clear_queue();
+	BOOST_CHECK_THROW(*behind, p4l::illegal_backtracking);
+	BOOST_CHECK_NO_THROW(*it);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
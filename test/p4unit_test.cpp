@@ -0,0 +1,137 @@
+#include "p4unit.h"
+
+#include <boost/asio/thread_pool.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+#include <string>
+#include <utility>
+
+
+BOOST_AUTO_TEST_SUITE(p4unit_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_recoverable_errors)
+{
+	boost::asio::thread_pool pool(2);
+	// Wave reports the positions with the absolute path of the file
+	auto path = (boost::filesystem::current_path() / "main.p4").string();
+	P4_file file(pool, "p4lsd", path, "const bit<8> a = 1;\n#warning careful\n#include \"missing.p4\"\nconst bit<8> b = a;\n");
+	// the token before a directive that throws is appended once
+	const auto& tokens = file.get_tokens();
+	std::set<std::pair<std::uint16_t, std::uint32_t>> positions;
+	for (std::size_t it = 0; it != tokens.size(); ++it)
+	{
+		BOOST_TEST(positions.emplace(tokens[it]._file, tokens[it]._offset).second);
+	}
+	Location location;
+	location._uri = path;
+	location._range._start = Position(3, 17);
+	auto highlights = file.get_highlights(location);
+	BOOST_REQUIRE(highlights);
+	BOOST_TEST(highlights->size() == 2U);
+}
+
+BOOST_AUTO_TEST_CASE(test_hover_without_parameters)
+{
+	boost::asio::thread_pool pool(2);
+	auto path = (boost::filesystem::current_path() / "main.p4").string();
+	P4_file file(pool, "p4lsd", path, "parser p(packet_in b) {\n    state start { transition accept; }\n}\n"
+				 "control c() {\n    table t { actions = { } }\n    apply { t.apply(); }\n}\n");
+	Location location;
+	location._uri = path;
+	// a table and a state have no parameters, their signatures end with the name
+	location._range._start = Position(5, 12);
+	BOOST_TEST(file.get_hover(location).value_or("") == "table t");
+	location._range._start = Position(1, 10);
+	BOOST_TEST(file.get_hover(location).value_or("") == "state start");
+}
+
+BOOST_AUTO_TEST_CASE(test_edit)
+{
+	boost::asio::thread_pool pool(2);
+	auto path = (boost::filesystem::current_path() / "main.p4").string();
+	P4_file file(pool, "p4lsd", path, "const bit<8> a = 1;\nconst bit<8> b = a;\nconst bit<8> c = b;\n");
+	// a declaration is added between the ones that are not parsed again
+	Text_document_content_change_event change;
+	change._range.emplace();
+	change._range->_start = Position(1, 0);
+	change._range->_end = Position(1, 0);
+	change._text = "const bit<8> d = a;\n";
+	file.change_source_code({change});
+	Location location;
+	location._uri = path;
+	location._range._start = Position(0, 13);
+	auto highlights = file.get_highlights(location);
+	BOOST_REQUIRE(highlights);
+	BOOST_TEST(highlights->size() == 3U);
+	location._range._start = Position(3, 17);
+	BOOST_TEST(file.get_hover(location).value_or("") == "const bit<8> b = a;");
+	BOOST_TEST(file.get_symbols().size() == 4U);
+}
+
+BOOST_AUTO_TEST_CASE(test_bodies)
+{
+	boost::asio::thread_pool pool(2);
+	auto path = (boost::filesystem::current_path() / "main.p4").string();
+	P4_file file(pool, "p4lsd", path, "action a(bit<8> v) { }\ncontrol c() {\n"
+				 "    action b() { a(1); }\n    apply { b(); b(); }\n}\n");
+	Location location;
+	location._uri = path;
+	// the body of apply is parsed when it is queried
+	location._range._start = Position(3, 12);
+	auto highlights = file.get_highlights(location);
+	BOOST_REQUIRE(highlights);
+	BOOST_TEST(highlights->size() == 3U);
+	// the unparsed body of b has no names yet
+	location._range._start = Position(0, 7);
+	BOOST_TEST(file.get_highlights(location)->size() == 1U);
+	location._range._start = Position(2, 17);
+	BOOST_TEST(file.get_hover(location).value_or("") == "action a(bit<8> v)");
+	location._range._start = Position(0, 7);
+	BOOST_TEST(file.get_highlights(location)->size() == 2U);
+
+	// the parsed bodies of a declaration are dropped when it changes
+	Text_document_content_change_event change;
+	change._range.emplace();
+	change._range->_start = Position(2, 17);
+	change._range->_end = Position(2, 17);
+	change._text = "a(2); ";
+	file.change_source_code({change});
+	BOOST_TEST(file.get_highlights(location)->size() == 1U);
+	location._range._start = Position(2, 17);
+	BOOST_TEST(file.get_highlights(location)->size() == 3U);
+}
+
+BOOST_AUTO_TEST_CASE(test_saved_analysis)
+{
+	boost::asio::thread_pool pool(2);
+	auto path = (boost::filesystem::current_path() / "main.p4").string();
+	const std::string text = "header h_t { bit<8> f; }\ncontrol c(inout h_t h) {\n"
+		"    action a(bit<8> v) { h.f = v; }\n    apply { a(1); a(2); }\n}\n";
+	auto saved = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+	P4_file compiled(pool, "p4lsd", path, text);
+	BOOST_REQUIRE(compiled.save_analysis(saved));
+
+	P4_file loaded(pool, "p4lsd", path, text);
+	BOOST_REQUIRE(loaded.load_analysis(saved));
+	// the queries of the loaded analysis give the answers of the compilation
+	Location location;
+	location._uri = path;
+	location._range._start = Position(3, 12);
+	BOOST_TEST(loaded.get_hover(location).value_or("") == "action a(bit<8> v)");
+	BOOST_TEST(loaded.get_hover(location).value_or("") == compiled.get_hover(location).value_or(""));
+	auto highlights = loaded.get_highlights(location);
+	BOOST_REQUIRE(highlights);
+	BOOST_TEST(highlights->size() == 3U);
+	BOOST_TEST(highlights->size() == compiled.get_highlights(location)->size());
+	BOOST_TEST(loaded.get_symbols().size() == compiled.get_symbols().size());
+
+	// the analysis is not loaded for another text
+	P4_file edited(pool, "p4lsd", path, text + "\n");
+	BOOST_TEST(!edited.load_analysis(saved));
+	boost::system::error_code ec;
+	boost::filesystem::remove(saved, ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,70 @@
+#include <boost/asio/thread_pool.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include "parallel_lexer.h"
+
+namespace {
+
+std::string generate_source(std::size_t headers)
+{
+	std::string source;
+	for (std::size_t it = 0; it != headers; ++it) {
+		auto index = std::to_string(it);
+		source += "#define W" + index + " \\\n    16\n"
+			"/* header " + index + "\n * on lines */\n"
+			"header h" + index + "_t {\n"
+			"\tbit<W" + index + "> f; // " + index + "\n"
+			"\tbit<48> mac = 48w0xffff_ffff_ffff;\n"
+			"}\n"
+			"@name(\"h\\\"" + index + "\")\n";
+	}
+	return source;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(parallel_lexer_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_boundaries)
+{
+	auto source = generate_source(5000);
+	auto boundaries = p4l::find_chunk_boundaries(source, 8);
+	BOOST_TEST(boundaries.size() == 8U);
+	for (auto it : boundaries) {
+		// every chunk starts at a header or a directive
+		BOOST_TEST((it == 0 || source[it - 1] == '\n'));
+		BOOST_TEST((source.compare(it, 2, "/*") == 0 || source.compare(it, 6, "header") == 0
+					|| source.compare(it, 1, "#") == 0 || source.compare(it, 1, "\t") == 0
+					|| source.compare(it, 1, "}") == 0 || source.compare(it, 1, "@") == 0),
+				   source.substr(it, 16));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_same_tokens)
+{
+	auto source = generate_source(5000);
+	auto expected = p4l::lex_sequential(source);
+	boost::asio::thread_pool pool(4);
+	for (std::size_t chunks : {1, 2, 3, 8, 64}) {
+		auto tokens = p4l::lex_parallel(source, pool, chunks);
+		BOOST_TEST(tokens.size() == expected.size());
+		BOOST_TEST((tokens == expected), chunks << " chunks");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_unbalanced_quote)
+{
+	// the quotes pair up differently after the stray one, the strings span lines
+	auto source = generate_source(2000);
+	source.insert(source.size() / 2, "\"");
+	auto expected = p4l::lex_sequential(source);
+	boost::asio::thread_pool pool(2);
+	auto tokens = p4l::lex_parallel(source, pool, 8);
+	BOOST_TEST(tokens.size() == expected.size());
+	BOOST_TEST((tokens == expected));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
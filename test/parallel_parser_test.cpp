@@ -0,0 +1,133 @@
+#include <boost/asio/thread_pool.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "p4_generator.h"
+#include "parallel_lexer.h"
+#include "parallel_parser.h"
+
+namespace {
+
+std::string generate()
+{
+	p4l::generator_options options;
+	options.headers = 64;
+	options.parser_states = 64;
+	options.controls = 24;
+	options.tables = 16;
+	options.actions = 16;
+	p4l::program_generator generator(options);
+	std::ostringstream os;
+	generator.write(0, os);
+	return os.str();
+}
+
+/// \brief the trees have the same nodes in the same order
+void check_same(p4l::ast const& tree, p4l::ast const& expected)
+{
+	BOOST_REQUIRE_EQUAL(tree.size(), expected.size());
+	std::size_t different = 0;
+	for (std::uint32_t it = 0; it != tree.size(); ++it) {
+		auto const& node = tree[it];
+		auto const& other = expected[it];
+		different += node.kind != other.kind || node.flags != other.flags || node.token != other.token
+			|| node.begin != other.begin || node.end != other.end || node.first != other.first || node.next != other.next;
+	}
+	BOOST_TEST(different == 0U);
+}
+
+void check_errors(std::vector<p4l::parse_error> const& errors, std::vector<p4l::parse_error> const& expected)
+{
+	BOOST_REQUIRE_EQUAL(errors.size(), expected.size());
+	for (std::size_t it = 0; it != errors.size(); ++it) {
+		BOOST_TEST(errors[it].token == expected[it].token);
+		BOOST_TEST(errors[it].message == expected[it].message);
+	}
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(parallel_parser_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_boundaries)
+{
+	auto source = generate();
+	auto tokens = p4l::lex_sequential(source);
+	auto boundaries = p4l::find_declaration_boundaries(tokens, 8);
+	BOOST_TEST(boundaries.size() > 2U);
+	BOOST_TEST(boundaries.front() == 0U);
+	// every chunk starts at a top-level declaration of the full parse
+	p4l::Parser parser(tokens);
+	auto tree = parser.run();
+	for (auto it : boundaries) {
+		auto found = false;
+		for (auto child : tree.get_children(tree.get_root())) {
+			found = found || tree[child].begin == it;
+		}
+		BOOST_TEST(found, it);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_same_tree)
+{
+	auto source = generate();
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto expected = parser.run();
+	boost::asio::thread_pool pool(4);
+	for (std::size_t chunks : {1, 2, 3, 8, 64}) {
+		BOOST_TEST_CONTEXT(chunks << " chunks") {
+			auto result = p4l::parse_parallel(tokens, pool, chunks);
+			check_same(result.tree, expected);
+			BOOST_TEST(result.errors.empty());
+		}
+	}
+	p4l::Parser signatures(tokens, 0, tokens.size(), p4l::parse_mode::signatures);
+	auto result = p4l::parse_parallel(tokens, pool, 8, p4l::parse_mode::signatures);
+	check_same(result.tree, signatures.run());
+}
+
+BOOST_AUTO_TEST_CASE(test_errors)
+{
+	// the chunks with errors are parsed again from their start
+	auto source = generate();
+	for (auto position : {source.size() / 4, source.size() / 2, source.size() * 3 / 4}) {
+		source.insert(source.find("apply {", position), "} ) ");
+	}
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto expected = parser.run();
+	BOOST_TEST(!parser.get_errors().empty());
+	boost::asio::thread_pool pool(2);
+	for (std::size_t chunks : {3, 8, 64}) {
+		BOOST_TEST_CONTEXT(chunks << " chunks") {
+			auto result = p4l::parse_parallel(tokens, pool, chunks);
+			check_same(result.tree, expected);
+			check_errors(result.errors, parser.get_errors());
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_arena)
+{
+	// the whitespace of a compilation is in the tokens
+	auto source = generate();
+	auto lexed = p4l::lex_sequential(source);
+	p4l::token_arena arena;
+	for (auto const& it : lexed) {
+		arena.push_back_scratch(static_cast<boost::wave::token_id>(it.id), source.substr(it.offset, it.length));
+		arena.push_back_scratch(boost::wave::T_SPACE, " ");
+	}
+	p4l::Parser parser(arena);
+	auto expected = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	boost::asio::thread_pool pool(2);
+	auto result = p4l::parse_parallel(arena, pool, 8);
+	check_same(result.tree, expected);
+	BOOST_TEST(result.errors.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,279 @@
+#include "preprocessor.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "p4_generator.h"
+#include "parallel_lexer.h"
+#include "parser.h"
+#include "main.p4"
+
+namespace {
+
+std::size_t count(p4l::ast const& tree, p4l::node_kind kind)
+{
+	std::size_t result = 0;
+	for (std::uint32_t it = 0; it != tree.size(); ++it) {
+		result += tree[it].kind == kind;
+	}
+	return result;
+}
+
+/// \brief the subtree as an s-expression of the tokens of the nodes
+std::string to_string(p4l::ast const& tree, std::vector<p4l::lexed_token> const& tokens, std::string_view source,
+					  std::uint32_t index)
+{
+	auto const& node = tree[index];
+	std::string result;
+	if (node.token != p4l::ast::none) {
+		result = source.substr(tokens[node.token].offset, tokens[node.token].length);
+	}
+	if (node.first == p4l::ast::none) {
+		return result;
+	}
+	result = "(" + result;
+	for (auto child : tree.get_children(index)) {
+		result += " " + to_string(tree, tokens, source, child);
+	}
+	return result + ")";
+}
+
+/// \brief the value of a constant initialized with the expression
+std::string parse_expression(std::string const& expression)
+{
+	auto source = "const bit<8> x = " + expression + ";";
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty(), expression);
+	auto constant = tree.get_first_child(tree.get_root());
+	BOOST_TEST((tree[constant].kind == p4l::node_kind::constant));
+	return to_string(tree, tokens, source, tree[tree.get_first_child(constant)].next);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(parser_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_main)
+{
+	std::string_view source(source_code);
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	BOOST_TEST((tree[tree.get_root()].kind == p4l::node_kind::program));
+	BOOST_TEST(tree[tree.get_root()].end == tokens.size());
+	BOOST_TEST(count(tree, p4l::node_kind::header) == 2U);
+	BOOST_TEST(count(tree, p4l::node_kind::state) == 3U);
+	BOOST_TEST(count(tree, p4l::node_kind::table) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::action) == 2U);
+	BOOST_TEST(count(tree, p4l::node_kind::parser) + count(tree, p4l::node_kind::control) == 6U);
+	BOOST_TEST(count(tree, p4l::node_kind::instantiation) == 1U);
+	// every node lies within its parent
+	for (std::uint32_t it = 0; it != tree.size(); ++it) {
+		for (auto child : tree.get_children(it)) {
+			BOOST_TEST(tree[child].begin >= tree[it].begin);
+			BOOST_TEST(tree[child].end <= tree[it].end);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_signatures)
+{
+	std::string_view source(source_code);
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens, 0, tokens.size(), p4l::parse_mode::signatures);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	BOOST_TEST(count(tree, p4l::node_kind::table) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::assignment) == 0U);
+	// the bodies of the actions, the states and the controls
+	std::size_t unparsed = 0;
+	for (std::uint32_t it = 0; it != tree.size(); ++it) {
+		if (tree[it].kind == p4l::node_kind::block) {
+			BOOST_TEST(tree[it].flags == p4l::unparsed_block);
+			BOOST_TEST(tree[it].first == p4l::ast::none);
+			p4l::Parser body(tokens, tree[it].begin, tree[it].end);
+			auto parsed = body.run_body();
+			BOOST_TEST(body.get_errors().empty());
+			BOOST_TEST((parsed[parsed.get_first_child(parsed.get_root())].kind == p4l::node_kind::block));
+			++unparsed;
+		}
+	}
+	BOOST_TEST(unparsed == 10U);
+	BOOST_TEST(tree.size() < p4l::Parser(tokens).run().size());
+}
+
+BOOST_AUTO_TEST_CASE(test_precedence)
+{
+	BOOST_TEST(parse_expression("a + b * c") == "(+ a (* b c))");
+	BOOST_TEST(parse_expression("a - b - c") == "(- (- a b) c)");
+	BOOST_TEST(parse_expression("a || b && c == d") == "(|| a (&& b (== c d)))");
+	BOOST_TEST(parse_expression("a & b | c ^ d") == "(| (& a b) (^ c d))");
+	BOOST_TEST(parse_expression("a ? b : c ? d : e") == "(? a b (? c d e))");
+	BOOST_TEST(parse_expression("-a.b[1][7:0]") == "(- ([ ([ (b a) 1) 7 0))");
+	BOOST_TEST(parse_expression("a ++ b |+| c") == "(|+| (++ a b) c)");
+	BOOST_TEST(parse_expression("a < b") == "(< a b)");
+	BOOST_TEST(parse_expression("{a, b}") == "({ a b)");
+	BOOST_TEST(parse_expression("{f = 1, g = 2}") == "({ (f 1) (g 2))");
+}
+
+BOOST_AUTO_TEST_CASE(test_ambiguities)
+{
+	// a shift right is two angle brackets next to each other
+	BOOST_TEST(parse_expression("a >> 2 + b") == "(> a (+ 2 b))");
+	BOOST_TEST(parse_expression("a > (b > c)") == "(> a (> b c))");
+	BOOST_TEST(parse_expression("(bit<8>) a + b") == "(+ (( (bit 8) a) b)");
+	BOOST_TEST(parse_expression("(T) a") == "(( T a)");
+	BOOST_TEST(parse_expression("(a) - b") == "(- a b)");
+	BOOST_TEST(parse_expression("f<bit<8>>(a)") == "(( f (< (bit 8)) a)");
+	std::string source = "header_stack<h_t>[4] hs; control c() { apply { h_t x = y; x.f = 1; f(x); r.read<bit<8>>(v, 0); } }";
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	BOOST_TEST(count(tree, p4l::node_kind::stack_type) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::variable) == 2U);
+	BOOST_TEST(count(tree, p4l::node_kind::assignment) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::call_statement) == 2U);
+	for (std::uint32_t it = 0; it != tree.size(); ++it) {
+		if (tree[it].kind == p4l::node_kind::binary) {
+			BOOST_TEST(tree[it].flags == 0);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_recovery)
+{
+	std::string source = "header h_t { bit<8> f; }\n"
+		"control c(inout h_t h) {\n"
+		"    action a() { h.f = ; h.f = 1; }\n"
+		"    table t { key = { h.f : exact; } actions = { a; } }\n"
+		"    apply { if (h.f == 1 { t.apply(); } t.apply(); }\n"
+		"}\n"
+		"struct s_t { bit<8> g; }\n";
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().size() == 2U);
+	BOOST_TEST(count(tree, p4l::node_kind::header) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::control) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::table) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::struct_type) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::assignment) == 1U);
+}
+
+BOOST_AUTO_TEST_CASE(test_deep_nesting)
+{
+	// an else if chain is as long as it is, the parser does not recurse on it
+	constexpr std::size_t branches = 50000;
+	std::string source = "control c() { apply { bit<8> x = 0; ";
+	for (std::size_t it = 0; it != branches; ++it) {
+		source += "if (x == " + std::to_string(it) + ") { x = 1; } else ";
+	}
+	source += "{ x = 2; } } }\n";
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser chain_parser(tokens);
+	auto tree = chain_parser.run();
+	BOOST_TEST(chain_parser.get_errors().empty());
+	BOOST_TEST(count(tree, p4l::node_kind::if_statement) == branches);
+	BOOST_TEST(count(tree, p4l::node_kind::assignment) == branches + 1);
+	// nested parentheses and blocks deeper than the limit are errors, the declarations after them are parsed
+	source = "const bit<8> x = " + std::string(branches, '(') + "1" + std::string(branches, ')') + ";\n"
+		"control c() { apply { " + std::string(branches, '{') + std::string(branches, '}') + " } }\n"
+		"struct s_t { bit<8> g; }\n";
+	tokens = p4l::lex_sequential(source);
+	p4l::Parser nested_parser(tokens);
+	tree = nested_parser.run();
+	BOOST_TEST(!nested_parser.get_errors().empty());
+	BOOST_TEST(count(tree, p4l::node_kind::control) == 1U);
+	BOOST_TEST(count(tree, p4l::node_kind::struct_type) == 1U);
+}
+
+BOOST_AUTO_TEST_CASE(test_generated)
+{
+	p4l::generator_options options;
+	options.headers = 32;
+	options.parser_states = 32;
+	options.controls = 4;
+	options.tables = 16;
+	options.actions = 16;
+	p4l::program_generator generator(options);
+	std::ostringstream os;
+	generator.write(0, os);
+	auto source = os.str();
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	BOOST_TEST(count(tree, p4l::node_kind::header) == options.headers);
+	BOOST_TEST(count(tree, p4l::node_kind::state) == options.parser_states + 1);
+	BOOST_TEST(count(tree, p4l::node_kind::table) == options.controls * options.tables);
+	BOOST_TEST(tree.size() < tokens.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_preprocessed)
+{
+	std::string source = "#define WIDTH 16\n"
+		"#define FIELD(n) bit<WIDTH> n;\n"
+		"header h_t {\n"
+		"    FIELD(a)\n"
+		"    FIELD(b) // comment\n"
+		"}\n";
+	std::string command[] = {"p4lsd"};
+	std::vector<char*> argv;
+	for (auto& it : command) {
+		argv.push_back(&it[0]);
+	}
+	auto settings = Context_factory::get_instance().get_settings(argv);
+	auto ctx = Context_factory::get_instance().create(source.begin(), source.end(), "main.p4", *settings);
+	p4l::token_arena arena;
+	for (auto token = ctx->begin(); token != ctx->end(); ++token) {
+		arena.append(*token);
+	}
+	p4l::Parser parser(arena);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	BOOST_TEST(count(tree, p4l::node_kind::field) == 2U);
+	auto header = tree.get_first_child(tree.get_root());
+	BOOST_TEST(arena.get_text(arena[tree[header].token]) == "h_t");
+	auto field = tree.get_first_child(header);
+	BOOST_TEST(arena.get_text(arena[tree[field].token]) == "a");
+	auto width = tree.get_first_child(tree.get_first_child(field));
+	BOOST_TEST(arena.get_text(arena[tree[width].token]) == "16");
+}
+
+BOOST_AUTO_TEST_CASE(test_preprocessed_shifts)
+{
+	// the preprocessor lexes >> as one token, it closes two type argument lists or shifts
+	std::string source = "const bit<8> x = a >> 2;\n"
+		"control c() { apply { r.read<bit<8>>(v, 0); } }\n"
+		"extern e<T> { e(); }\n"
+		"e<e<bit<8>>>() i;\n";
+	std::string command[] = {"p4lsd"};
+	std::vector<char*> argv;
+	for (auto& it : command) {
+		argv.push_back(&it[0]);
+	}
+	auto settings = Context_factory::get_instance().get_settings(argv);
+	auto ctx = Context_factory::get_instance().create(source.begin(), source.end(), "main.p4", *settings);
+	p4l::token_arena arena;
+	for (auto token = ctx->begin(); token != ctx->end(); ++token) {
+		arena.append(*token);
+	}
+	p4l::Parser parser(arena);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	auto constant = tree.get_first_child(tree.get_root());
+	auto shift = tree[tree.get_first_child(constant)].next;
+	BOOST_TEST((tree[shift].kind == p4l::node_kind::binary));
+	BOOST_TEST(arena.get_text(arena[tree[shift].token]) == ">>");
+	BOOST_TEST(count(tree, p4l::node_kind::instantiation) == 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
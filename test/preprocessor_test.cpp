@@ -0,0 +1,107 @@
+#include "preprocessor.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+#include "token_arena.h"
+
+
+BOOST_AUTO_TEST_SUITE(preprocessor_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_settings_from_command_line)
+{
+	std::string command[] = {"p4lsd", "-I", "/p4include", "-Iinclude", "-DX=1", "-D", "Y", "-UZ", "-iquote", "local", "main.p4"};
+	std::vector<char*> argv;
+	for (auto& it : command)
+	{
+		argv.push_back(&it[0]);
+	}
+	auto settings = Context_factory::get_instance().get_settings(argv);
+	BOOST_TEST(settings->_include_paths == std::vector<std::string>({"/p4include", "include"}));
+	BOOST_TEST(settings->_quote_paths == std::vector<std::string>({"local"}));
+	BOOST_REQUIRE(settings->_macros.size() >= 3U);
+	auto last = settings->_macros.end() - 3;
+	BOOST_TEST((last[0]._macro == "X=1" && !last[0]._undefine));
+	BOOST_TEST((last[1]._macro == "Y" && !last[1]._undefine));
+	BOOST_TEST((last[2]._macro == "Z" && last[2]._undefine));
+	BOOST_TEST(settings == Context_factory::get_instance().get_settings(argv));
+}
+
+BOOST_AUTO_TEST_CASE(test_context_uses_settings)
+{
+	auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%");
+	boost::filesystem::create_directory(directory);
+	std::ofstream((directory / "defs.p4").string()) << "#define WIDTH 16\n";
+	std::string include_path = directory.string();
+	std::string command[] = {"p4lsd", "-I", include_path, "-DSIZE=42"};
+	std::vector<char*> argv;
+	for (auto& it : command)
+	{
+		argv.push_back(&it[0]);
+	}
+	auto settings = Context_factory::get_instance().get_settings(argv);
+	std::string source("#include <defs.p4>\nconst bit<WIDTH> size = SIZE;\n");
+	auto ctx = Context_factory::get_instance().create(source.begin(), source.end(), (directory / "main.p4").string(), *settings);
+	std::string output;
+	p4l::token_arena arena([](const std::string& path) { return File_cache::get_instance().load(path); });
+	for (auto token = ctx->begin(); token != ctx->end(); ++token)
+	{
+		output += token->get_value().c_str();
+		arena.append(*token);
+	}
+	BOOST_TEST(output.find("bit<16> size = 42;") != std::string::npos);
+	BOOST_TEST(ctx->get_hooks().get_included_files().count((directory / "defs.p4").string()) == 1);
+	// the tokens of the included file refer to the text the preprocessor read
+	auto defs = arena.find_file((directory / "defs.p4").string());
+	BOOST_REQUIRE(defs);
+	BOOST_TEST(arena.get_source(*defs) == File_cache::get_instance().load((directory / "defs.p4").string()));
+	boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(test_macro_options_in_order)
+{
+	// the last -D or -U of a macro decides whether it is defined
+	auto preprocess = [](std::vector<std::string> command) {
+		std::vector<char*> argv;
+		for (auto& it : command)
+		{
+			argv.push_back(&it[0]);
+		}
+		auto settings = Context_factory::get_instance().get_settings(argv);
+		std::string source("#ifdef FOO\nconst bit<8> defined = FOO;\n#endif\n");
+		auto ctx = Context_factory::get_instance().create(source.begin(), source.end(), "main.p4", *settings);
+		std::string output;
+		for (auto token = ctx->begin(); token != ctx->end(); ++token)
+		{
+			output += token->get_value().c_str();
+		}
+		return output;
+	};
+	BOOST_TEST(preprocess({"p4lsd", "-UFOO", "-DFOO=1"}).find("defined = 1;") != std::string::npos);
+	BOOST_TEST(preprocess({"p4lsd", "-DFOO=1", "-UFOO"}).find("defined") == std::string::npos);
+	BOOST_TEST(preprocess({"p4lsd", "-DFOO=1", "-UFOO", "-DFOO=2"}).find("defined = 2;") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_conditional_shifts)
+{
+	std::string command[] = {"p4lsd"};
+	std::vector<char*> argv;
+	for (auto& it : command)
+	{
+		argv.push_back(&it[0]);
+	}
+	auto settings = Context_factory::get_instance().get_settings(argv);
+	std::string source("#if (8 >> 1) == 4 && (1 << 2) == 4\nconst bit<8> shifted = 1;\n#else\nconst bit<8> not_shifted = 1;\n#endif\n");
+	auto ctx = Context_factory::get_instance().create(source.begin(), source.end(), "main.p4", *settings);
+	std::string output;
+	for (auto token = ctx->begin(); token != ctx->end(); ++token)
+	{
+		output += token->get_value().c_str();
+	}
+	BOOST_TEST(output.find("shifted = 1;") != std::string::npos);
+	BOOST_TEST(output.find("not_shifted") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
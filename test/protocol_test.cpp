@@ -66,4 +66,27 @@ BOOST_AUTO_TEST_CASE(test_case1)
 	BOOST_TEST(*params._capabilities._text_document->_document_symbol->_symbol_kind->_value_set == v);
 }
 
+BOOST_AUTO_TEST_CASE(test_malformed_file_events)
+{
+	const char* inputs[] = {
+		"{\"changes\":[{\"uri\":\"file:///w/main.p4\",\"type\":\"changed\"}]}",
+		"{\"changes\":[{\"uri\":2,\"type\":2}]}",
+		"{\"changes\":[3]}",
+	};
+	for (auto input : inputs)
+	{
+		rapidjson::Document json;
+		json.Parse(input);
+		Params_workspace_didChangeWatchedFiles params;
+		BOOST_TEST(!set_params_from_json(json, params));
+	}
+	rapidjson::Document json;
+	json.Parse("{\"changes\":[{\"uri\":\"file:///w/main.p4\",\"type\":2}]}");
+	Params_workspace_didChangeWatchedFiles params;
+	BOOST_TEST(set_params_from_json(json, params));
+	BOOST_REQUIRE(params._changes.size() == 1);
+	BOOST_TEST(params._changes[0]._uri._path == "/w/main.p4");
+	BOOST_TEST(static_cast<int>(params._changes[0]._type) == static_cast<int>(FILE_CHANGE_TYPE::Changed));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
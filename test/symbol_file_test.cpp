@@ -0,0 +1,212 @@
+#include "compilation.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "symbol_file.h"
+
+namespace {
+
+const std::string source = "#define WIDTH 8\n"
+	"header h_t {\n"
+	"    bit<WIDTH> f;\n"
+	"}\n"
+	"struct s_t { h_t h; }\n"
+	"const bit<8> K = 1;\n"
+	"control c(inout s_t s) {\n"
+	"    action a(bit<8> v) { s.h.f = v + K; }\n"
+	"    apply { a(8); }\n"
+	"}\n";
+
+/// \brief the compilation of the source and a temporary path to save it to
+struct saved_compilation : compilation {
+	saved_compilation() : compilation(source) {
+		path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+	}
+	~saved_compilation() {
+		boost::system::error_code ec;
+		boost::filesystem::remove(path, ec);
+	}
+
+	std::string read() const {
+		std::ifstream in(path, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	void overwrite(std::string const& image) const {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << image;
+	}
+	std::uint32_t find_name(p4l::symbol_file const& saved, std::string const& text) const {
+		auto const& names = saved.get_names();
+		for (std::size_t it = 0; it != names.size(); ++it) {
+			if (saved.get_text(names[it]) == text) {
+				return static_cast<std::uint32_t>(it);
+			}
+		}
+		return p4l::ast::none;
+	}
+
+	/// \brief the image with the record at the offset replaced and the checksum of the contents updated
+	template <typename T>
+	static std::string replace_record(std::string image, std::size_t offset, T const& record) {
+		std::memcpy(&image[offset], &record, sizeof(record));
+		// FNV-1a of the image after the header, as symbol_file computes it
+		std::uint64_t checksum = 0xcbf29ce484222325ULL;
+		for (std::size_t it = header_size; it != image.size(); ++it) {
+			checksum = (checksum ^ static_cast<unsigned char>(image[it])) * 0x100000001b3ULL;
+		}
+		std::memcpy(&image[checksum_offset], &checksum, sizeof(checksum));
+		return image;
+	}
+	/// \brief the offset in the image of the records of the section of the header at the offset
+	static std::size_t get_section(std::string const& image, std::size_t offset) {
+		std::uint32_t result;
+		std::memcpy(&result, &image[offset], sizeof(result));
+		return result;
+	}
+
+	static constexpr std::size_t header_size = 72;
+	static constexpr std::size_t checksum_offset = 32;
+	static constexpr std::size_t names_section = 48;
+	static constexpr std::size_t occurrences_section = 56;
+
+	std::string path;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(symbol_file_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_round_trip)
+{
+	saved_compilation unit;
+	BOOST_REQUIRE(p4l::symbol_file::write(unit.path, unit.table, unit.arena, unit.file));
+	auto saved = p4l::symbol_file::open(unit.path, source);
+	BOOST_REQUIRE(saved);
+	BOOST_TEST(saved->get_symbols().size() == unit.table.get_symbols().size());
+	BOOST_TEST(saved->get_occurrences().size() == unit.table.get_positions().size());
+
+	auto header = unit.find_name(*saved, "h_t");
+	BOOST_REQUIRE(header != p4l::ast::none);
+	BOOST_TEST(saved->get_definition(saved->get_names()[header]) == "header h_t {\n    bit<WIDTH> f;\n}");
+	auto action = unit.find_name(*saved, "a");
+	BOOST_REQUIRE(action != p4l::ast::none);
+	BOOST_TEST(saved->get_definition(saved->get_names()[action]) == "action a(bit<8> v)");
+	BOOST_TEST(unit.find_name(*saved, "WIDTH") == p4l::ast::none);
+
+	// the occurrences of a name are chained in the order of the offsets
+	auto const& occurrences = saved->get_occurrences();
+	std::size_t count = 0;
+	std::uint32_t offset = 0;
+	for (auto it = saved->get_names()[action].first; it != p4l::ast::none; it = occurrences[it].next) {
+		BOOST_TEST(occurrences[it].name == action);
+		BOOST_TEST(occurrences[it].offset >= offset);
+		BOOST_TEST(source.substr(occurrences[it].offset, occurrences[it].end - occurrences[it].offset) == "a");
+		offset = occurrences[it].offset;
+		++count;
+	}
+	BOOST_TEST(count == 2U);
+
+	// the same occurrences as the table at every offset
+	for (std::uint32_t it = 0; it <= source.size(); ++it) {
+		auto expected = unit.table.find_occurrence(unit.file, it);
+		auto found = saved->find_occurrence(it);
+		BOOST_REQUIRE((expected == p4l::ast::none) == (found == p4l::ast::none));
+		if (found != p4l::ast::none) {
+			BOOST_TEST(saved->get_text(saved->get_names()[occurrences[found].name])
+					   == unit.table.get_names()[unit.table.get_occurrences()[expected].name].text);
+		}
+	}
+
+	// the containers are the symbols of the enclosing declarations
+	auto const& symbols = saved->get_symbols();
+	for (auto const& it : symbols) {
+		auto text = saved->get_text(saved->get_names()[it.name]);
+		BOOST_TEST(source.substr(it.offset, it.length) == text);
+		if (text == "v") {
+			BOOST_REQUIRE(it.container != p4l::ast::none);
+			auto const& container = symbols[it.container];
+			BOOST_TEST(saved->get_text(saved->get_names()[container.name]) == "a");
+			BOOST_TEST((static_cast<p4l::node_kind>(container.kind) == p4l::node_kind::action));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_validation)
+{
+	saved_compilation unit;
+	BOOST_REQUIRE(p4l::symbol_file::write(unit.path, unit.table, unit.arena, unit.file));
+	auto image = unit.read();
+	BOOST_TEST(image == p4l::symbol_file::build(unit.table, unit.arena, unit.file));
+	BOOST_TEST(!boost::filesystem::exists(unit.path + ".tmp"));
+
+	// saved for another source text
+	auto edited = source;
+	edited[source.find("K = 1")] = 'L';
+	BOOST_TEST(!p4l::symbol_file::open(unit.path, edited).get());
+	BOOST_TEST(!p4l::symbol_file::open(unit.path + ".missing", source).get());
+
+	auto corrupted = image;
+	corrupted[corrupted.size() / 2] ^= 0x20;
+	unit.overwrite(corrupted);
+	BOOST_TEST(!p4l::symbol_file::open(unit.path, source).get());
+
+	unit.overwrite(image.substr(0, image.size() - 8));
+	BOOST_TEST(!p4l::symbol_file::open(unit.path, source).get());
+	unit.overwrite(image.substr(0, 16));
+	BOOST_TEST(!p4l::symbol_file::open(unit.path, source).get());
+
+	// the version follows the magic
+	auto other_version = image;
+	other_version[8] ^= 0x7f;
+	unit.overwrite(other_version);
+	BOOST_TEST(!p4l::symbol_file::open(unit.path, source).get());
+
+	unit.overwrite(image);
+	BOOST_TEST(p4l::symbol_file::open(unit.path, source).get() != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_records)
+{
+	saved_compilation unit;
+	auto image = p4l::symbol_file::build(unit.table, unit.arena, unit.file);
+	unit.overwrite(image);
+	auto saved = p4l::symbol_file::open(unit.path, source);
+	BOOST_REQUIRE(saved);
+	BOOST_REQUIRE(saved->get_occurrences().size() > 1U);
+	auto names = saved_compilation::get_section(image, saved_compilation::names_section);
+	auto occurrences = saved_compilation::get_section(image, saved_compilation::occurrences_section);
+	auto name = saved->get_names()[0];
+	auto occurrence = saved->get_occurrences()[0];
+	saved.reset();
+
+	// the checksums match, the indices and the offsets in the records do not
+	auto check = [&unit, &image](std::size_t offset, auto const& record) {
+		unit.overwrite(saved_compilation::replace_record(image, offset, record));
+		return p4l::symbol_file::open(unit.path, source) == nullptr;
+	};
+	auto changed_name = name;
+	changed_name.length = static_cast<std::uint32_t>(image.size());
+	BOOST_TEST(check(names, changed_name));
+	changed_name = name;
+	changed_name.definition = static_cast<std::uint32_t>(image.size());
+	BOOST_TEST(check(names, changed_name));
+	auto changed_occurrence = occurrence;
+	changed_occurrence.next = 0;
+	BOOST_TEST(check(occurrences, changed_occurrence));
+	changed_occurrence = occurrence;
+	changed_occurrence.name = p4l::ast::none;
+	BOOST_TEST(check(occurrences, changed_occurrence));
+	changed_occurrence = occurrence;
+	changed_occurrence.end = static_cast<std::uint32_t>(source.size() + 1);
+	BOOST_TEST(check(occurrences, changed_occurrence));
+	// the unchanged records with the updated checksum are valid
+	BOOST_TEST(!check(occurrences, occurrence));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
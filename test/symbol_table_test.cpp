@@ -0,0 +1,150 @@
+#include "compilation.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string source = "#define WIDTH 8\n"
+	"header h_t {\n"
+	"    bit<WIDTH> f;\n"
+	"}\n"
+	"struct s_t { h_t h; }\n"
+	"const bit<8> K = 1;\n"
+	"control c(inout s_t s) {\n"
+	"    action a(bit<8> v) { s.h.f = v + K; }\n"
+	"    table t { key = { s.h.f : exact; } actions = { a; } }\n"
+	"    apply { t.apply(); }\n"
+	"}\n";
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(symbol_table_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_symbols)
+{
+	compilation unit(source);
+	auto const& symbols = unit.table.get_symbols();
+	auto const& header = unit.find_symbol("h_t");
+	BOOST_TEST((header.kind == p4l::node_kind::header));
+	BOOST_TEST(header.container == p4l::ast::none);
+	auto const& field = unit.find_symbol("f");
+	BOOST_TEST((field.kind == p4l::node_kind::field));
+	BOOST_TEST(&symbols[field.container] == &header);
+	auto const& control = unit.find_symbol("c");
+	auto const& action = unit.find_symbol("a");
+	BOOST_TEST((action.kind == p4l::node_kind::action));
+	BOOST_TEST(&symbols[action.container] == &control);
+	auto const& parameter = unit.find_symbol("v");
+	BOOST_TEST(&symbols[parameter.container] == &action);
+	BOOST_TEST(&symbols[unit.find_symbol("t").container] == &control);
+	BOOST_TEST((unit.find_symbol("K").kind == p4l::node_kind::constant));
+}
+
+BOOST_AUTO_TEST_CASE(test_definitions)
+{
+	compilation unit(source);
+	// the text as it is in the source
+	BOOST_TEST(unit.table.get_definition(unit.arena, unit.find_symbol("h_t")) == "header h_t {\n    bit<WIDTH> f;\n}");
+	BOOST_TEST(unit.table.get_definition(unit.arena, unit.find_symbol("K")) == "const bit<8> K = 1;");
+	// the signature of a declaration with a body
+	BOOST_TEST(unit.table.get_definition(unit.arena, unit.find_symbol("a")) == "action a(bit<8> v)");
+	BOOST_TEST(unit.table.get_definition(unit.arena, unit.find_symbol("c")) == "control c(inout s_t s)");
+	BOOST_TEST(unit.table.get_definition(unit.arena, unit.find_symbol("t")) == "table t");
+}
+
+BOOST_AUTO_TEST_CASE(test_occurrences)
+{
+	compilation unit(source);
+	auto count = [&unit](std::uint32_t name) {
+		std::size_t result = 0;
+		auto const& occurrences = unit.table.get_occurrences();
+		auto text = unit.table.get_names()[name].text;
+		for (auto it = unit.table.get_names()[name].first; it != p4l::ast::none; it = occurrences[it].next) {
+			BOOST_TEST(occurrences[it].name == name);
+			BOOST_TEST(unit.arena.get_text(unit.arena[occurrences[it].token]) == text);
+			++result;
+		}
+		return result;
+	};
+	BOOST_TEST(count(unit.find_symbol("h_t").name) == 2U);
+	BOOST_TEST(count(unit.find_symbol("s").name) == 3U);
+	BOOST_TEST(count(unit.find_symbol("f").name) == 3U);
+	BOOST_TEST(count(unit.find_symbol("K").name) == 2U);
+	BOOST_TEST(count(unit.find_symbol("a").name) == 2U);
+	BOOST_TEST(count(unit.table.find_name("exact")) == 1U);
+	BOOST_TEST(unit.table.find_name("WIDTH") == p4l::ast::none);
+}
+
+BOOST_AUTO_TEST_CASE(test_scopes)
+{
+	compilation unit("header a_t { bit<16> type; bit<8> f; }\n"
+					 "header b_t { bit<16> type; }\n"
+					 "struct s_t { a_t a; b_t b; }\n"
+					 "parser p(inout s_t hdr) {\n"
+					 "    state start { transition next; }\n"
+					 "    state next { hdr.a.f = 1; transition accept; }\n"
+					 "}\n"
+					 "control c(inout s_t hdr) {\n"
+					 "    apply { hdr.b.type = hdr.a.type; }\n"
+					 "}\n");
+	auto const& symbols = unit.table.get_symbols();
+	auto const& names = unit.table.get_names();
+	auto const& occurrences = unit.table.get_occurrences();
+	auto occurrences_of = [&](std::uint32_t name) {
+		std::vector<std::uint32_t> result;
+		for (auto it = names[name].first; it != p4l::ast::none; it = occurrences[it].next) {
+			result.push_back(unit.arena[occurrences[it].token]._offset);
+		}
+		return result;
+	};
+	// the parameters of the parser and the control are different names
+	auto parser_hdr = unit.table.find_name("hdr", names[unit.table.find_name("p")].definition);
+	auto control_hdr = unit.table.find_name("hdr", names[unit.table.find_name("c")].definition);
+	BOOST_REQUIRE(parser_hdr != p4l::ast::none);
+	BOOST_REQUIRE(control_hdr != p4l::ast::none);
+	BOOST_TEST(occurrences_of(parser_hdr).size() == 2U);
+	BOOST_TEST(occurrences_of(control_hdr).size() == 3U);
+	BOOST_TEST(unit.table.find_name("hdr") == p4l::ast::none);
+	// a state is found before it is declared
+	auto next = unit.table.find_name("next", names[unit.table.find_name("p")].definition);
+	BOOST_REQUIRE(next != p4l::ast::none);
+	BOOST_TEST(occurrences_of(next).size() == 2U);
+	BOOST_TEST((symbols[names[next].definition].kind == p4l::node_kind::state));
+	// the fields of the headers are different names, a member with the text of only one field refers to it
+	auto type = unit.table.find_name("type", names[unit.table.find_name("a_t")].definition);
+	BOOST_REQUIRE(type != p4l::ast::none);
+	BOOST_TEST(occurrences_of(type).size() == 1U);
+	auto f = unit.table.find_name("f", names[unit.table.find_name("a_t")].definition);
+	BOOST_REQUIRE(f != p4l::ast::none);
+	BOOST_TEST(occurrences_of(f).size() == 2U);
+	// the members of the headers with the same text are not resolved
+	auto undeclared = unit.table.find_name("type");
+	BOOST_REQUIRE(undeclared != p4l::ast::none);
+	BOOST_TEST(names[undeclared].definition == p4l::ast::none);
+	BOOST_TEST(occurrences_of(undeclared).size() == 2U);
+}
+
+BOOST_AUTO_TEST_CASE(test_positions)
+{
+	compilation unit(source);
+	auto const& occurrences = unit.table.get_occurrences();
+	auto offset = static_cast<std::uint32_t>(source.find("s_t s"));
+	auto found = unit.table.find_occurrence(unit.file, offset);
+	BOOST_REQUIRE(found != p4l::ast::none);
+	BOOST_TEST(unit.table.get_names()[occurrences[found].name].text == "s_t");
+	// the position after the last character of a name is still on it
+	BOOST_TEST(unit.table.find_occurrence(unit.file, offset + 3) == found);
+	BOOST_TEST(unit.table.find_occurrence(unit.file, static_cast<std::uint32_t>(source.find("= 1;"))) == p4l::ast::none);
+	auto last = static_cast<std::uint32_t>(source.rfind("t.apply"));
+	found = unit.table.find_occurrence(unit.file, last);
+	BOOST_REQUIRE(found != p4l::ast::none);
+	BOOST_TEST(unit.table.get_names()[occurrences[found].name].text == "t");
+	auto line_character = unit.arena.get_line_character(unit.arena[occurrences[found].token]);
+	BOOST_TEST(line_character.first == 9U);
+	BOOST_TEST(line_character.second == 12U);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
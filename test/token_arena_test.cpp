@@ -0,0 +1,69 @@
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/wave.hpp>
+
+#include <string>
+
+#include "lexer.h"
+#include "token_arena.h"
+
+BOOST_AUTO_TEST_SUITE(token_arena_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_token_id_table)
+{
+	boost::wave::token_id ids[] = {boost::wave::T_IDENTIFIER, boost::wave::T_EOF, boost::wave::T_AND_ALT,
+								   boost::wave::token_id(boost::wave::T_HEADER), boost::wave::token_id(boost::wave::T_START)};
+	for (auto id : ids) {
+		auto code = p4l::token_id_table::encode(id);
+		BOOST_TEST(code == p4l::token_id_table::encode(id));
+		BOOST_TEST(p4l::token_id_table::decode(code) == id);
+	}
+	BOOST_TEST(p4l::token_id_table::encode(boost::wave::T_AND) != p4l::token_id_table::encode(boost::wave::T_AND_ALT));
+}
+
+BOOST_AUTO_TEST_CASE(test_preprocessed_tokens)
+{
+	using token_type = p4l::p4lex_token<>;
+	using lexer_type = p4l::p4lex_iterator<token_type>;
+	using context_type = boost::wave::context<std::string::iterator, lexer_type>;
+	std::string source("#define WIDTH 8\nheader h {\n\tbit<WIDTH> f;\n}\n");
+	// Wave reports the positions with the absolute path of the file
+	auto name = (boost::filesystem::current_path() / "main.p4").string();
+	p4l::token_arena arena;
+	arena.add_file(name, std::make_shared<const std::string>(source));
+	context_type ctx(source.begin(), source.end(), name.c_str());
+	std::vector<token_type> tokens;
+	for (auto token = ctx.begin(); token != ctx.end(); ++token) {
+		tokens.push_back(*token);
+		arena.append(*token);
+	}
+	BOOST_REQUIRE_EQUAL(arena.size(), tokens.size());
+	auto from_source = 0;
+	for (std::size_t it = 0; it != tokens.size(); ++it) {
+		auto& token = arena[it];
+		BOOST_TEST(arena.get_text(token) == std::string(tokens[it].get_value().c_str()));
+		BOOST_TEST(arena.get_id(token) == boost::wave::token_id(tokens[it]));
+		if (token._file != p4l::token_arena::scratch_file) {
+			++from_source;
+			auto materialized = arena.materialize(token);
+			BOOST_TEST(materialized.get_position().get_line() == tokens[it].get_position().get_line());
+			BOOST_TEST(materialized.get_position().get_column() == tokens[it].get_position().get_column());
+			BOOST_TEST(materialized.get_position().get_file() == tokens[it].get_position().get_file());
+		}
+	}
+	BOOST_TEST(from_source > 0);
+	auto f = std::find_if(arena.begin(), arena.end(), [&arena](const p4l::compact_token& token) {
+		return arena.get_text(token) == "f";
+	});
+	BOOST_REQUIRE(f != arena.end());
+	BOOST_TEST(arena.get_line_column(*f).first == 3U);
+	BOOST_TEST(arena.get_line_column(*f).second == 16U);
+	// LSP counts a tab as one character
+	BOOST_TEST(arena.get_line_character(*f).first == 2U);
+	BOOST_TEST(arena.get_line_character(*f).second == 12U);
+	BOOST_TEST((arena.get_offset(f->_file, 2, 12) == boost::optional<std::uint32_t>(f->_offset)));
+	BOOST_TEST(!arena.get_offset(f->_file, 2, 40));
+	BOOST_TEST(!arena.get_offset(f->_file, 9, 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,136 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parallel_lexer.h"
+#include "parser.h"
+#include "visitor.h"
+#include "main.p4"
+
+namespace {
+
+p4l::ast parse(std::string_view source)
+{
+	auto tokens = p4l::lex_sequential(source);
+	p4l::Parser parser(tokens);
+	auto tree = parser.run();
+	BOOST_TEST(parser.get_errors().empty());
+	return tree;
+}
+
+/// \brief the nodes in the order of their hooks, negated in postorder
+class order_visitor : public p4l::visitor<order_visitor> {
+ public:
+	bool preorder_node(p4l::ast const&, std::uint32_t index) {
+		_order.push_back(static_cast<long>(index));
+		return true;
+	}
+	void postorder_node(p4l::ast const&, std::uint32_t index) {
+		_order.push_back(-static_cast<long>(index) - 1);
+	}
+
+	std::vector<long> _order;
+};
+
+void walk(p4l::ast const& tree, std::uint32_t index, std::vector<long>& order)
+{
+	order.push_back(static_cast<long>(index));
+	for (auto child : tree.get_children(index)) {
+		walk(tree, child, order);
+	}
+	order.push_back(-static_cast<long>(index) - 1);
+}
+
+/// \brief the headers and their fields, the children of the controls are skipped
+class kind_visitor : public p4l::visitor<kind_visitor> {
+ public:
+	bool preorder(p4l::kind_tag<p4l::node_kind::header>, p4l::ast const&, std::uint32_t) {
+		++_headers;
+		return true;
+	}
+	void postorder(p4l::kind_tag<p4l::node_kind::header>, p4l::ast const&, std::uint32_t) {
+		++_left;
+	}
+	bool preorder(p4l::kind_tag<p4l::node_kind::field>, p4l::ast const&, std::uint32_t) {
+		++_fields;
+		return true;
+	}
+	bool preorder(p4l::kind_tag<p4l::node_kind::control>, p4l::ast const&, std::uint32_t) {
+		++_controls;
+		return false;
+	}
+	bool preorder_node(p4l::ast const& tree, std::uint32_t index) {
+		_others += tree[index].kind != p4l::node_kind::header && tree[index].kind != p4l::node_kind::field;
+		_in_control += tree[index].kind == p4l::node_kind::table;
+		return true;
+	}
+
+	std::size_t _headers = 0;
+	std::size_t _left = 0;
+	std::size_t _fields = 0;
+	std::size_t _controls = 0;
+	std::size_t _others = 0;
+	std::size_t _in_control = 0;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(visitor_test_suite);
+
+BOOST_AUTO_TEST_CASE(test_order)
+{
+	auto tree = parse(source_code);
+	order_visitor visitor;
+	visitor.visit(tree);
+	std::vector<long> expected;
+	walk(tree, tree.get_root(), expected);
+	BOOST_TEST(visitor._order.size() == 2 * tree.size());
+	BOOST_TEST(visitor._order == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(test_kinds)
+{
+	auto tree = parse(source_code);
+	kind_visitor visitor;
+	visitor.visit(tree);
+	BOOST_TEST(visitor._headers == 2U);
+	BOOST_TEST(visitor._left == 2U);
+	BOOST_TEST(visitor._fields > 0U);
+	BOOST_TEST(visitor._controls > 0U);
+	// the table is in a control
+	BOOST_TEST(visitor._in_control == 0U);
+	BOOST_TEST(visitor._others > 0U);
+}
+
+BOOST_AUTO_TEST_CASE(test_subtree)
+{
+	auto tree = parse("header h_t { bit<8> f; bit<16> g; } struct s_t { h_t h; }");
+	kind_visitor visitor;
+	visitor.visit(tree, tree.get_first_child(tree.get_root()));
+	BOOST_TEST(visitor._headers == 1U);
+	BOOST_TEST(visitor._fields == 2U);
+	kind_visitor empty;
+	empty.visit(p4l::ast());
+	BOOST_TEST(empty._others == 0U);
+}
+
+BOOST_AUTO_TEST_CASE(test_deep)
+{
+	// the binary operators of a long sum are a left-leaning spine as deep as the number of terms
+	constexpr std::size_t terms = 1000000;
+	std::string source = "const bit<32> x = 0";
+	for (std::size_t it = 0; it != terms; ++it) {
+		source += " + 1";
+	}
+	source += ";";
+	auto tree = parse(source);
+	order_visitor visitor;
+	visitor.visit(tree);
+	BOOST_TEST(visitor._order.size() == 2 * tree.size());
+	BOOST_TEST(visitor._order.front() == 0);
+	BOOST_TEST(visitor._order.back() == -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();